@@ -230,13 +230,10 @@ void display()
         static float mouseX = 0.f;
         static float mouseY = 0.f;
 
-        // Note: there is a risk of missing events since we only process the
-        // latest state available. For more advanced applications, event
-        // processing should be done in a separate thread.
-        while( deflectStream->hasEvent( ))
+        // Consecutive moves are merged, so the input received during a slow
+        // frame is processed at once instead of replaying each move.
+        for( const deflect::Event& event : deflectStream->getCoalescedEvents( ))
         {
-            const deflect::Event& event = deflectStream->getEvent();
-
             if( event.type == deflect::Event::EVT_CLOSE )
             {
                 std::cout << "Received close..." << std::endl;
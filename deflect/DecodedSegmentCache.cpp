@@ -0,0 +1,155 @@
+/*********************************************************************/
+/* Copyright (c) 2015, EPFL/Blue Brain Project                       */
+/*                     Raphael Dumusc <raphael.dumusc@epfl.ch>       */
+/* All rights reserved.                                              */
+/*                                                                   */
+/* Redistribution and use in source and binary forms, with or        */
+/* without modification, are permitted provided that the following   */
+/* conditions are met:                                               */
+/*                                                                   */
+/*   1. Redistributions of source code must retain the above         */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer.                                                  */
+/*                                                                   */
+/*   2. Redistributions in binary form must reproduce the above      */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer in the documentation and/or other materials       */
+/*      provided with the distribution.                              */
+/*                                                                   */
+/*    THIS  SOFTWARE IS PROVIDED  BY THE  UNIVERSITY OF  TEXAS AT    */
+/*    AUSTIN  ``AS IS''  AND ANY  EXPRESS OR  IMPLIED WARRANTIES,    */
+/*    INCLUDING, BUT  NOT LIMITED  TO, THE IMPLIED  WARRANTIES OF    */
+/*    MERCHANTABILITY  AND FITNESS FOR  A PARTICULAR  PURPOSE ARE    */
+/*    DISCLAIMED.  IN  NO EVENT SHALL THE UNIVERSITY  OF TEXAS AT    */
+/*    AUSTIN OR CONTRIBUTORS BE  LIABLE FOR ANY DIRECT, INDIRECT,    */
+/*    INCIDENTAL,  SPECIAL, EXEMPLARY,  OR  CONSEQUENTIAL DAMAGES    */
+/*    (INCLUDING, BUT  NOT LIMITED TO,  PROCUREMENT OF SUBSTITUTE    */
+/*    GOODS  OR  SERVICES; LOSS  OF  USE,  DATA,  OR PROFITS;  OR    */
+/*    BUSINESS INTERRUPTION) HOWEVER CAUSED  AND ON ANY THEORY OF    */
+/*    LIABILITY, WHETHER  IN CONTRACT, STRICT  LIABILITY, OR TORT    */
+/*    (INCLUDING NEGLIGENCE OR OTHERWISE)  ARISING IN ANY WAY OUT    */
+/*    OF  THE  USE OF  THIS  SOFTWARE,  EVEN  IF ADVISED  OF  THE    */
+/*    POSSIBILITY OF SUCH DAMAGE.                                    */
+/*                                                                   */
+/* The views and conclusions contained in the software and           */
+/* documentation are those of the authors and should not be          */
+/* interpreted as representing official policies, either expressed   */
+/* or implied, of The University of Texas at Austin.                 */
+/*********************************************************************/
+
+#include "DecodedSegmentCache.h"
+
+#include <QHash>
+
+namespace deflect
+{
+
+DecodedSegmentCache::DecodedSegmentCache()
+    : _maxSize( 0 )
+    , _size( 0 )
+    , _hits( 0 )
+    , _misses( 0 )
+{
+}
+
+void DecodedSegmentCache::setMaxSize( const size_t bytes )
+{
+    std::lock_guard< std::mutex > lock( _mutex );
+    _maxSize = bytes;
+    _evict( _maxSize );
+}
+
+size_t DecodedSegmentCache::getMaxSize() const
+{
+    std::lock_guard< std::mutex > lock( _mutex );
+    return _maxSize;
+}
+
+bool DecodedSegmentCache::find( const QByteArray& compressed,
+                                const unsigned int variant, Image& image )
+{
+    const size_t key = _getKey( compressed, variant );
+
+    std::lock_guard< std::mutex > lock( _mutex );
+    const auto it = _index.find( key );
+    if( it == _index.end() || it->second->variant != variant ||
+        it->second->compressed != compressed )
+    {
+        ++_misses;
+        return false;
+    }
+
+    _entries.splice( _entries.begin(), _entries, it->second );
+    image = it->second->image;
+    ++_hits;
+    return true;
+}
+
+void DecodedSegmentCache::insert( const QByteArray& compressed,
+                                  const unsigned int variant,
+                                  const Image& image )
+{
+    const size_t key = _getKey( compressed, variant );
+
+    std::lock_guard< std::mutex > lock( _mutex );
+    const size_t size = compressed.size() + image.data.size();
+    if( size > _maxSize )
+        return;
+
+    // Replace a colliding or concurrently inserted image
+    const auto it = _index.find( key );
+    if( it != _index.end( ))
+        _erase( it->second );
+
+    _evict( _maxSize - size );
+
+    _entries.push_front( Entry{ key, variant, compressed, image } );
+    _index[key] = _entries.begin();
+    _size += size;
+}
+
+size_t DecodedSegmentCache::getHits() const
+{
+    std::lock_guard< std::mutex > lock( _mutex );
+    return _hits;
+}
+
+size_t DecodedSegmentCache::getMisses() const
+{
+    std::lock_guard< std::mutex > lock( _mutex );
+    return _misses;
+}
+
+size_t DecodedSegmentCache::getEntryCount() const
+{
+    std::lock_guard< std::mutex > lock( _mutex );
+    return _entries.size();
+}
+
+size_t DecodedSegmentCache::getSize() const
+{
+    std::lock_guard< std::mutex > lock( _mutex );
+    return _size;
+}
+
+size_t DecodedSegmentCache::_getKey( const QByteArray& compressed,
+                                     const unsigned int variant )
+{
+    // qHash uses the CRC32 instruction when available
+    return qHash( compressed, variant );
+}
+
+void DecodedSegmentCache::_erase( const Entries::iterator entry )
+{
+    _size -= entry->getSize();
+    _index.erase( entry->key );
+    _entries.erase( entry );
+}
+
+void DecodedSegmentCache::_evict( const size_t maxSize )
+{
+    while( _size > maxSize )
+        _erase( std::prev( _entries.end( )));
+}
+
+}
@@ -0,0 +1,150 @@
+/*********************************************************************/
+/* Copyright (c) 2015, EPFL/Blue Brain Project                       */
+/*                     Raphael Dumusc <raphael.dumusc@epfl.ch>       */
+/* All rights reserved.                                              */
+/*                                                                   */
+/* Redistribution and use in source and binary forms, with or        */
+/* without modification, are permitted provided that the following   */
+/* conditions are met:                                               */
+/*                                                                   */
+/*   1. Redistributions of source code must retain the above         */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer.                                                  */
+/*                                                                   */
+/*   2. Redistributions in binary form must reproduce the above      */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer in the documentation and/or other materials       */
+/*      provided with the distribution.                              */
+/*                                                                   */
+/*    THIS  SOFTWARE IS PROVIDED  BY THE  UNIVERSITY OF  TEXAS AT    */
+/*    AUSTIN  ``AS IS''  AND ANY  EXPRESS OR  IMPLIED WARRANTIES,    */
+/*    INCLUDING, BUT  NOT LIMITED  TO, THE IMPLIED  WARRANTIES OF    */
+/*    MERCHANTABILITY  AND FITNESS FOR  A PARTICULAR  PURPOSE ARE    */
+/*    DISCLAIMED.  IN  NO EVENT SHALL THE UNIVERSITY  OF TEXAS AT    */
+/*    AUSTIN OR CONTRIBUTORS BE  LIABLE FOR ANY DIRECT, INDIRECT,    */
+/*    INCIDENTAL,  SPECIAL, EXEMPLARY,  OR  CONSEQUENTIAL DAMAGES    */
+/*    (INCLUDING, BUT  NOT LIMITED TO,  PROCUREMENT OF SUBSTITUTE    */
+/*    GOODS  OR  SERVICES; LOSS  OF  USE,  DATA,  OR PROFITS;  OR    */
+/*    BUSINESS INTERRUPTION) HOWEVER CAUSED  AND ON ANY THEORY OF    */
+/*    LIABILITY, WHETHER  IN CONTRACT, STRICT  LIABILITY, OR TORT    */
+/*    (INCLUDING NEGLIGENCE OR OTHERWISE)  ARISING IN ANY WAY OUT    */
+/*    OF  THE  USE OF  THIS  SOFTWARE,  EVEN  IF ADVISED  OF  THE    */
+/*    POSSIBILITY OF SUCH DAMAGE.                                    */
+/*                                                                   */
+/* The views and conclusions contained in the software and           */
+/* documentation are those of the authors and should not be          */
+/* interpreted as representing official policies, either expressed   */
+/* or implied, of The University of Texas at Austin.                 */
+/*********************************************************************/
+
+#ifndef DEFLECT_DECODEDSEGMENTCACHE_H
+#define DEFLECT_DECODEDSEGMENTCACHE_H
+
+#include <deflect/Segment.h>
+
+#include <QByteArray>
+
+#include <iterator>
+#include <list>
+#include <mutex>
+#include <unordered_map>
+
+namespace deflect
+{
+
+/**
+ * Thread-safe LRU cache of decoded segment images.
+ *
+ * Images are looked up by a hash of their compressed data, so that identical
+ * Jpeg segments sent in successive frames are only decoded once. The
+ * compressed data is kept and compared on lookup to rule out hash collisions.
+ * The total size of the cached data (compressed and decoded) is bounded, the
+ * least recently used images being evicted first.
+ */
+class DecodedSegmentCache
+{
+public:
+    /** A decoded image and its format */
+    struct Image
+    {
+        QByteArray data;
+        SegmentFormat format;
+    };
+
+    /** Construct a cache, disabled until setMaxSize() is called. */
+    DecodedSegmentCache();
+
+    /**
+     * Set the maximum amount of data to cache, evicting images if needed.
+     * @param bytes The maximum size, 0 disables the cache
+     */
+    void setMaxSize( size_t bytes );
+
+    /** @return the maximum amount of data to cache, 0 if disabled. */
+    size_t getMaxSize() const;
+
+    /**
+     * Look up the decoded image of some compressed data.
+     * @param compressed The compressed data
+     * @param variant Identifies the decoding options (resolution, format)
+     * @param image The output decoded image, set on success
+     * @return true on a cache hit, false otherwise
+     */
+    bool find( const QByteArray& compressed, unsigned int variant,
+               Image& image );
+
+    /**
+     * Add the decoded image of some compressed data.
+     * @param compressed The compressed data
+     * @param variant Identifies the decoding options (resolution, format)
+     * @param image The decoded image
+     */
+    void insert( const QByteArray& compressed, unsigned int variant,
+                 const Image& image );
+
+    /** @return the number of successful lookups. */
+    size_t getHits() const;
+
+    /** @return the number of failed lookups. */
+    size_t getMisses() const;
+
+    /** @return the number of cached images. */
+    size_t getEntryCount() const;
+
+    /** @return the size of the cached data. */
+    size_t getSize() const;
+
+private:
+    struct Entry
+    {
+        size_t key;
+        unsigned int variant;
+        QByteArray compressed;
+        Image image;
+
+        size_t getSize() const
+        {
+            return compressed.size() + image.data.size();
+        }
+    };
+    typedef std::list< Entry > Entries;
+
+    mutable std::mutex _mutex;
+    size_t _maxSize;
+    size_t _size;
+    size_t _hits;
+    size_t _misses;
+
+    /** Most recently used first */
+    Entries _entries;
+    std::unordered_map< size_t, Entries::iterator > _index;
+
+    static size_t _getKey( const QByteArray& compressed,
+                           unsigned int variant );
+    void _erase( Entries::iterator entry );
+    void _evict( size_t maxSize );
+};
+
+}
+
+#endif
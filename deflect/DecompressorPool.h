@@ -0,0 +1,89 @@
+/*********************************************************************/
+/* Copyright (c) 2015, EPFL/Blue Brain Project                       */
+/*                     Raphael Dumusc <raphael.dumusc@epfl.ch>       */
+/* All rights reserved.                                              */
+/*                                                                   */
+/* Redistribution and use in source and binary forms, with or        */
+/* without modification, are permitted provided that the following   */
+/* conditions are met:                                               */
+/*                                                                   */
+/*   1. Redistributions of source code must retain the above         */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer.                                                  */
+/*                                                                   */
+/*   2. Redistributions in binary form must reproduce the above      */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer in the documentation and/or other materials       */
+/*      provided with the distribution.                              */
+/*                                                                   */
+/*    THIS  SOFTWARE IS PROVIDED  BY THE  UNIVERSITY OF  TEXAS AT    */
+/*    AUSTIN  ``AS IS''  AND ANY  EXPRESS OR  IMPLIED WARRANTIES,    */
+/*    INCLUDING, BUT  NOT LIMITED  TO, THE IMPLIED  WARRANTIES OF    */
+/*    MERCHANTABILITY  AND FITNESS FOR  A PARTICULAR  PURPOSE ARE    */
+/*    DISCLAIMED.  IN  NO EVENT SHALL THE UNIVERSITY  OF TEXAS AT    */
+/*    AUSTIN OR CONTRIBUTORS BE  LIABLE FOR ANY DIRECT, INDIRECT,    */
+/*    INCIDENTAL,  SPECIAL, EXEMPLARY,  OR  CONSEQUENTIAL DAMAGES    */
+/*    (INCLUDING, BUT  NOT LIMITED TO,  PROCUREMENT OF SUBSTITUTE    */
+/*    GOODS  OR  SERVICES; LOSS  OF  USE,  DATA,  OR PROFITS;  OR    */
+/*    BUSINESS INTERRUPTION) HOWEVER CAUSED  AND ON ANY THEORY OF    */
+/*    LIABILITY, WHETHER  IN CONTRACT, STRICT  LIABILITY, OR TORT    */
+/*    (INCLUDING NEGLIGENCE OR OTHERWISE)  ARISING IN ANY WAY OUT    */
+/*    OF  THE  USE OF  THIS  SOFTWARE,  EVEN  IF ADVISED  OF  THE    */
+/*    POSSIBILITY OF SUCH DAMAGE.                                    */
+/*                                                                   */
+/* The views and conclusions contained in the software and           */
+/* documentation are those of the authors and should not be          */
+/* interpreted as representing official policies, either expressed   */
+/* or implied, of The University of Texas at Austin.                 */
+/*********************************************************************/
+
+#ifndef DEFLECT_DECOMPRESSORPOOL_H
+#define DEFLECT_DECOMPRESSORPOOL_H
+
+#include "ImageJpegDecompressor.h"
+
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace deflect
+{
+
+/**
+ * Thread-safe pool of Jpeg decompressors.
+ *
+ * Concurrent decoding tasks each borrow a decompressor, so that the pool
+ * never holds more of them than the maximum number of tasks run in parallel.
+ */
+class DecompressorPool
+{
+public:
+    typedef std::unique_ptr< ImageJpegDecompressor > DecompressorPtr;
+
+    /** Get an idle decompressor from the pool, or a new one. */
+    DecompressorPtr acquire()
+    {
+        std::lock_guard< std::mutex > lock( _mutex );
+        if( _decompressors.empty( ))
+            return DecompressorPtr( new ImageJpegDecompressor );
+
+        DecompressorPtr decompressor = std::move( _decompressors.back( ));
+        _decompressors.pop_back();
+        return decompressor;
+    }
+
+    /** Return a decompressor to the pool for the next tasks. */
+    void release( DecompressorPtr decompressor )
+    {
+        std::lock_guard< std::mutex > lock( _mutex );
+        _decompressors.push_back( std::move( decompressor ));
+    }
+
+private:
+    std::vector< DecompressorPtr > _decompressors;
+    std::mutex _mutex;
+};
+
+}
+
+#endif
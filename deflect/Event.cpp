@@ -47,6 +47,25 @@ namespace deflect
 const uint32_t Event::serializedSize = 3*sizeof(quint32) + 4*sizeof(double) +
                                        3*sizeof(bool) + UNICODE_TEXT_SIZE;
 
+bool coalesceEvents( Event& previous, const Event& next )
+{
+    if( previous.type != next.type ||
+        ( next.type != Event::EVT_MOVE && next.type != Event::EVT_WHEEL ) ||
+        previous.mouseLeft != next.mouseLeft ||
+        previous.mouseRight != next.mouseRight ||
+        previous.mouseMiddle != next.mouseMiddle ||
+        previous.modifiers != next.modifiers )
+    {
+        return false;
+    }
+
+    previous.mouseX = next.mouseX;
+    previous.mouseY = next.mouseY;
+    previous.dx += next.dx;
+    previous.dy += next.dy;
+    return true;
+}
+
 QDataStream& operator<<( QDataStream& out, const deflect::Event& event )
 {
     out << (qint32)event.type;
@@ -133,6 +133,20 @@ struct Event
 DEFLECT_API QDataStream& operator<<( QDataStream& out, const Event& event );
 DEFLECT_API QDataStream& operator>>( QDataStream& in, Event& event );
 
+/**
+ * Merge an event into the previous one if the latter becomes redundant.
+ *
+ * Consecutive moves, or wheels, with the same buttons and modifiers are
+ * merged: the position is the latest one and the deltas add up. Any other
+ * event, in particular presses, releases and keys, is never merged.
+ *
+ * @param previous The previous event, updated if the events are merged
+ * @param next The event following previous
+ * @return true if next was merged into previous, false otherwise
+ * @version 1.3
+ */
+DEFLECT_API bool coalesceEvents( Event& previous, const Event& next );
+
 }
 
 #endif
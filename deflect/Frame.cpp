@@ -39,9 +39,44 @@
 
 #include "Frame.h"
 
+#include <QtEndian>
+
+#include <cstring>
+
 namespace deflect
 {
 
+namespace
+{
+// Flat binary layout, all integers little-endian:
+// - header: magic, version, segment count, uri size
+// - uri (UTF-8), padded to the alignment
+// - segment table: x, y, width, height, compressed, format, 2 padding bytes,
+//   image data size, image data offset (64 bits, from the buffer start)
+// - image data, each segment padded to the alignment
+const char flatMagic[4] = { 'D', 'F', 'L', 'F' };
+const quint32 flatVersion = 1;
+const int flatHeaderSize = 16;
+const int flatSegmentSize = 32;
+const int flatAlignment = 8;
+
+int align( const int size )
+{
+    return ( size + flatAlignment - 1 ) / flatAlignment * flatAlignment;
+}
+
+uchar* writeUInt32( uchar* data, const quint32 value )
+{
+    qToLittleEndian<quint32>( value, data );
+    return data + sizeof( quint32 );
+}
+
+quint32 readUInt32( const uchar* data )
+{
+    return qFromLittleEndian<quint32>( data );
+}
+}
+
 QSize Frame::computeDimensions() const
 {
     QSize size( 0, 0 );
@@ -58,4 +93,95 @@ QSize Frame::computeDimensions() const
     return size;
 }
 
+void Frame::serializeFlat( QByteArray& buffer ) const
+{
+    const QByteArray uriData = uri.toUtf8();
+    const int tableOffset = align( flatHeaderSize + uriData.size( ));
+    int size = align( tableOffset + flatSegmentSize * (int)segments.size( ));
+    for( const Segment& segment : segments )
+        size += align( segment.imageData.size( ));
+
+    buffer.resize( size );
+    uchar* data = reinterpret_cast< uchar* >( buffer.data( ));
+    std::memset( data, 0, tableOffset );
+
+    std::memcpy( data, flatMagic, sizeof( flatMagic ));
+    writeUInt32( data + 4, flatVersion );
+    writeUInt32( data + 8, segments.size( ));
+    writeUInt32( data + 12, uriData.size( ));
+    std::memcpy( data + flatHeaderSize, uriData.constData(), uriData.size( ));
+
+    const int tableEnd = tableOffset + flatSegmentSize * (int)segments.size();
+    int offset = align( tableEnd );
+    std::memset( data + tableEnd, 0, offset - tableEnd );
+
+    uchar* entry = data + tableOffset;
+    for( const Segment& segment : segments )
+    {
+        const SegmentParameters& params = segment.parameters;
+        entry = writeUInt32( entry, params.x );
+        entry = writeUInt32( entry, params.y );
+        entry = writeUInt32( entry, params.width );
+        entry = writeUInt32( entry, params.height );
+        *entry++ = params.compressed ? 1 : 0;
+        *entry++ = uchar( segment.format );
+        *entry++ = 0;
+        *entry++ = 0;
+        entry = writeUInt32( entry, segment.imageData.size( ));
+        qToLittleEndian<quint64>( offset, entry );
+        entry += sizeof( quint64 );
+
+        const int dataSize = segment.imageData.size();
+        std::memcpy( data + offset, segment.imageData.constData(), dataSize );
+        std::memset( data + offset + dataSize, 0, align( dataSize ) - dataSize );
+        offset += align( dataSize );
+    }
+}
+
+bool Frame::deserializeFlat( const QByteArray& buffer )
+{
+    const uchar* data = reinterpret_cast< const uchar* >( buffer.constData( ));
+    const qint64 size = buffer.size();
+    if( size < flatHeaderSize ||
+        std::memcmp( data, flatMagic, sizeof( flatMagic )) != 0 ||
+        readUInt32( data + 4 ) != flatVersion )
+    {
+        return false;
+    }
+
+    const quint32 count = readUInt32( data + 8 );
+    const quint32 uriSize = readUInt32( data + 12 );
+    const qint64 tableOffset = align( flatHeaderSize + uriSize );
+    if( uriSize > size || tableOffset + qint64( count ) * flatSegmentSize > size )
+        return false;
+
+    Segments newSegments( count );
+    const uchar* entry = data + tableOffset;
+    for( Segment& segment : newSegments )
+    {
+        SegmentParameters& params = segment.parameters;
+        params.x = readUInt32( entry );
+        params.y = readUInt32( entry + 4 );
+        params.width = readUInt32( entry + 8 );
+        params.height = readUInt32( entry + 12 );
+        params.compressed = entry[16] != 0;
+        if( entry[17] > SEGMENT_FORMAT_GRAY )
+            return false;
+        segment.format = SegmentFormat( entry[17] );
+
+        const quint32 dataSize = readUInt32( entry + 20 );
+        const quint64 offset = qFromLittleEndian<quint64>( entry + 24 );
+        if( offset > quint64( size ) || dataSize > quint64( size ) - offset )
+            return false;
+        segment.imageData = QByteArray::fromRawData( buffer.constData() +
+                                                     offset, dataSize );
+        entry += flatSegmentSize;
+    }
+
+    uri = QString::fromUtf8( buffer.constData() + flatHeaderSize, uriSize );
+    segments.swap( newSegments );
+    _flatData = buffer;
+    return true;
+}
+
 }
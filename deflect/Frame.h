@@ -64,10 +64,42 @@ public:
     /** The PixelStream uri to which this frame is associated. */
     QString uri;
 
-    /** Get the total dimensions of this frame. */
+    /**
+     * Get the total dimensions of this frame.
+     * @see SegmentIndex to also query the segments of a region.
+     */
     DEFLECT_API QSize computeDimensions() const;
 
+    /**
+     * Write the frame to a flat binary buffer.
+     *
+     * The buffer starts with a versioned header and a fixed-size table of the
+     * segment parameters, followed by the image data of all the segments.
+     * Contrary to the boost archives, it is written in one pass into a single
+     * allocation and read back without copying the image data, which suits
+     * the broadcast of frames to many processes.
+     * @param buffer The output, resized to fit. Its memory is reused if it is
+     *        large enough, so that successive frames do not reallocate.
+     */
+    DEFLECT_API void serializeFlat( QByteArray& buffer ) const;
+
+    /**
+     * Read a frame written by serializeFlat().
+     *
+     * The image data of the segments is not copied but refers to the buffer,
+     * which the frame keeps a (shallow) reference to. A segment copied out of
+     * the frame must thus not outlive both the frame and the buffer, unless
+     * its image data is modified or assigned.
+     * @param buffer The input, which must remain unmodified.
+     * @return false if the buffer is truncated, corrupted or of an
+     *         unsupported version, in which case the frame is left unchanged.
+     */
+    DEFLECT_API bool deserializeFlat( const QByteArray& buffer );
+
 private:
+    /** Storage of the segments' image data after deserializeFlat() */
+    QByteArray _flatData;
+
     friend class boost::serialization::access;
 
     template<class Archive>
@@ -0,0 +1,129 @@
+/*********************************************************************/
+/* Copyright (c) 2015, EPFL/Blue Brain Project                       */
+/*                     Raphael Dumusc <raphael.dumusc@epfl.ch>       */
+/* All rights reserved.                                              */
+/*                                                                   */
+/* Redistribution and use in source and binary forms, with or        */
+/* without modification, are permitted provided that the following   */
+/* conditions are met:                                               */
+/*                                                                   */
+/*   1. Redistributions of source code must retain the above         */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer.                                                  */
+/*                                                                   */
+/*   2. Redistributions in binary form must reproduce the above      */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer in the documentation and/or other materials       */
+/*      provided with the distribution.                              */
+/*                                                                   */
+/*    THIS  SOFTWARE IS PROVIDED  BY THE  UNIVERSITY OF  TEXAS AT    */
+/*    AUSTIN  ``AS IS''  AND ANY  EXPRESS OR  IMPLIED WARRANTIES,    */
+/*    INCLUDING, BUT  NOT LIMITED  TO, THE IMPLIED  WARRANTIES OF    */
+/*    MERCHANTABILITY  AND FITNESS FOR  A PARTICULAR  PURPOSE ARE    */
+/*    DISCLAIMED.  IN  NO EVENT SHALL THE UNIVERSITY  OF TEXAS AT    */
+/*    AUSTIN OR CONTRIBUTORS BE  LIABLE FOR ANY DIRECT, INDIRECT,    */
+/*    INCIDENTAL,  SPECIAL, EXEMPLARY,  OR  CONSEQUENTIAL DAMAGES    */
+/*    (INCLUDING, BUT  NOT LIMITED TO,  PROCUREMENT OF SUBSTITUTE    */
+/*    GOODS  OR  SERVICES; LOSS  OF  USE,  DATA,  OR PROFITS;  OR    */
+/*    BUSINESS INTERRUPTION) HOWEVER CAUSED  AND ON ANY THEORY OF    */
+/*    LIABILITY, WHETHER  IN CONTRACT, STRICT  LIABILITY, OR TORT    */
+/*    (INCLUDING NEGLIGENCE OR OTHERWISE)  ARISING IN ANY WAY OUT    */
+/*    OF  THE  USE OF  THIS  SOFTWARE,  EVEN  IF ADVISED  OF  THE    */
+/*    POSSIBILITY OF SUCH DAMAGE.                                    */
+/*                                                                   */
+/* The views and conclusions contained in the software and           */
+/* documentation are those of the authors and should not be          */
+/* interpreted as representing official policies, either expressed   */
+/* or implied, of The University of Texas at Austin.                 */
+/*********************************************************************/
+
+#include "FrameAssembler.h"
+
+#include "Frame.h"
+#include "SegmentDecoder.h"
+
+#include <QtConcurrentMap>
+
+#include <algorithm>
+#include <atomic>
+#include <iostream>
+
+namespace deflect
+{
+
+namespace
+{
+const int bytesPerPixel = 4;
+}
+
+class FrameAssembler::Impl
+{
+public:
+    SegmentDecoder decoder;
+    QSize size;
+    QByteArray image;
+};
+
+FrameAssembler::FrameAssembler()
+    : _impl( new Impl )
+{
+}
+
+FrameAssembler::~FrameAssembler()
+{
+    delete _impl;
+}
+
+bool FrameAssembler::assemble( const Frame& frame,
+                               const unsigned int downscale )
+{
+    QSize size( 0, 0 );
+    for( const Segment& segment : frame.segments )
+    {
+        const SegmentParameters params =
+             SegmentDecoder::getScaledParameters( segment.parameters, downscale );
+        size.setWidth( std::max( size.width(), int( params.x + params.width )));
+        size.setHeight( std::max( size.height(),
+                                  int( params.y + params.height )));
+    }
+    const int pitch = size.width() * bytesPerPixel;
+
+    // Clear the new image, segments may not cover it entirely
+    if( size != _impl->size )
+    {
+        _impl->size = size;
+        _impl->image = QByteArray( size.height() * pitch, '\0' );
+    }
+
+    SegmentDecoder& decoder = _impl->decoder;
+    char* image = _impl->image.data();
+    std::atomic< bool > success( true );
+
+    QtConcurrent::blockingMap( frame.segments.begin(), frame.segments.end(),
+                               [&decoder, image, pitch, downscale, &success]
+                               ( const Segment& segment )
+    {
+        const SegmentParameters params =
+             SegmentDecoder::getScaledParameters( segment.parameters, downscale );
+        char* target = image + params.y * pitch + params.x * bytesPerPixel;
+        if( !decoder.decode( segment, target, pitch, downscale ))
+            success = false;
+    });
+
+    if( !success )
+        std::cerr << "FrameAssembler: could not decode all the segments of "
+                  << frame.uri.toStdString() << std::endl;
+    return success;
+}
+
+QSize FrameAssembler::getSize() const
+{
+    return _impl->size;
+}
+
+const QByteArray& FrameAssembler::getImage() const
+{
+    return _impl->image;
+}
+
+}
@@ -0,0 +1,103 @@
+/*********************************************************************/
+/* Copyright (c) 2015, EPFL/Blue Brain Project                       */
+/*                     Raphael Dumusc <raphael.dumusc@epfl.ch>       */
+/* All rights reserved.                                              */
+/*                                                                   */
+/* Redistribution and use in source and binary forms, with or        */
+/* without modification, are permitted provided that the following   */
+/* conditions are met:                                               */
+/*                                                                   */
+/*   1. Redistributions of source code must retain the above         */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer.                                                  */
+/*                                                                   */
+/*   2. Redistributions in binary form must reproduce the above      */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer in the documentation and/or other materials       */
+/*      provided with the distribution.                              */
+/*                                                                   */
+/*    THIS  SOFTWARE IS PROVIDED  BY THE  UNIVERSITY OF  TEXAS AT    */
+/*    AUSTIN  ``AS IS''  AND ANY  EXPRESS OR  IMPLIED WARRANTIES,    */
+/*    INCLUDING, BUT  NOT LIMITED  TO, THE IMPLIED  WARRANTIES OF    */
+/*    MERCHANTABILITY  AND FITNESS FOR  A PARTICULAR  PURPOSE ARE    */
+/*    DISCLAIMED.  IN  NO EVENT SHALL THE UNIVERSITY  OF TEXAS AT    */
+/*    AUSTIN OR CONTRIBUTORS BE  LIABLE FOR ANY DIRECT, INDIRECT,    */
+/*    INCIDENTAL,  SPECIAL, EXEMPLARY,  OR  CONSEQUENTIAL DAMAGES    */
+/*    (INCLUDING, BUT  NOT LIMITED TO,  PROCUREMENT OF SUBSTITUTE    */
+/*    GOODS  OR  SERVICES; LOSS  OF  USE,  DATA,  OR PROFITS;  OR    */
+/*    BUSINESS INTERRUPTION) HOWEVER CAUSED  AND ON ANY THEORY OF    */
+/*    LIABILITY, WHETHER  IN CONTRACT, STRICT  LIABILITY, OR TORT    */
+/*    (INCLUDING NEGLIGENCE OR OTHERWISE)  ARISING IN ANY WAY OUT    */
+/*    OF  THE  USE OF  THIS  SOFTWARE,  EVEN  IF ADVISED  OF  THE    */
+/*    POSSIBILITY OF SUCH DAMAGE.                                    */
+/*                                                                   */
+/* The views and conclusions contained in the software and           */
+/* documentation are those of the authors and should not be          */
+/* interpreted as representing official policies, either expressed   */
+/* or implied, of The University of Texas at Austin.                 */
+/*********************************************************************/
+
+#ifndef DEFLECT_FRAMEASSEMBLER_H
+#define DEFLECT_FRAMEASSEMBLER_H
+
+#include <deflect/api.h>
+#include <deflect/types.h>
+
+#include <QByteArray>
+#include <QSize>
+
+#include <boost/noncopyable.hpp>
+
+namespace deflect
+{
+
+/**
+ * Compose the segments of frames into a single RGBA image.
+ *
+ * Each segment is decoded directly into its rectangle of the image, without
+ * intermediate buffers, and the segments are processed in parallel in the
+ * global QThreadPool. The image is reused for successive frames of the same
+ * dimensions.
+ */
+class FrameAssembler : public boost::noncopyable
+{
+public:
+    /** Construct an assembler. */
+    DEFLECT_API FrameAssembler();
+
+    /** Destruct the assembler. */
+    DEFLECT_API ~FrameAssembler();
+
+    /**
+     * Assemble a frame into the image.
+     *
+     * This function blocks until all the segments have been written. Regions
+     * of the image which are not covered by any segment keep the content of
+     * the previous frame, or are transparent black if the dimensions of the
+     * image changed.
+     * @param frame The frame to assemble, with compressed or raw segments.
+     * @param downscale Reduction factor of the image resolution, applied
+     *        while decoding the segments.
+     * @return false if any segment could not be decoded.
+     * @see SegmentDecoder::isDownscaleSupported()
+     */
+    DEFLECT_API bool assemble( const Frame& frame,
+                               unsigned int downscale = 1 );
+
+    /** @return the dimensions of the last assembled frame. */
+    DEFLECT_API QSize getSize() const;
+
+    /**
+     * @return the image of the last assembled frame in (GL_)RGBA format, with
+     *         rows of getSize().width() pixels from top to bottom.
+     */
+    DEFLECT_API const QByteArray& getImage() const;
+
+private:
+    class Impl;
+    Impl* _impl;
+};
+
+}
+
+#endif
@@ -40,41 +40,235 @@
 #include "FrameDispatcher.h"
 
 #include "Frame.h"
+#include "FrameRecorder.h"
+#include "MPSCQueue.h"
 #include "ReceiveBuffer.h"
 
+#include <QThread>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <mutex>
+
 namespace deflect
 {
 
+namespace
+{
+typedef std::chrono::steady_clock Clock;
+
+/** Interval over which the per-second rates are measured */
+const Clock::duration rateInterval = std::chrono::seconds( 1 );
+
+/** Counters of a source, updated in the dispatcher thread */
+struct SourceCounters
+{
+    SourceCounters() : firstFrame( 0 ), framesFinished( 0 ) {}
+
+    /** @return the number of frames of the stream the source has finished */
+    uint64_t getFrameCount() const { return firstFrame + framesFinished; }
+
+    /** The frame of the stream from which the source contributes */
+    uint64_t firstFrame;
+    uint64_t framesFinished;
+};
+
+/** Counters of a stream, updated in the dispatcher thread */
+struct StreamCounters
+{
+    StreamCounters()
+        : framesReceived( 0 ), framesDispatched( 0 ), segmentsReceived( 0 )
+        , bytesReceived( 0 ), framesDropped( 0 ), bufferedFrames( 0 )
+        , bufferedBytes( 0 ), intervalStart( Clock::now( )), intervalFrames( 0 )
+        , intervalBytes( 0 ), framesPerSecond( 0 ), bytesPerSecond( 0 )
+    {}
+
+    void updateRates( const Clock::time_point now )
+    {
+        const Clock::duration elapsed = now - intervalStart;
+        if( elapsed < rateInterval )
+            return;
+
+        const double seconds =
+                std::chrono::duration< double >( elapsed ).count();
+        framesPerSecond = intervalFrames / seconds;
+        bytesPerSecond = intervalBytes / seconds;
+        intervalStart = now;
+        intervalFrames = 0;
+        intervalBytes = 0;
+    }
+
+    void updateBuffer( const ReceiveBuffer& buffer )
+    {
+        framesDropped = buffer.getDroppedFrameCount();
+        bufferedFrames = buffer.getBufferedFrameCount();
+        bufferedBytes = buffer.getBufferedBytes();
+    }
+
+    uint64_t framesReceived;
+    uint64_t framesDispatched;
+    uint64_t segmentsReceived;
+    uint64_t bytesReceived;
+    uint64_t framesDropped;
+    size_t bufferedFrames;
+    size_t bufferedBytes;
+    std::map< size_t, SourceCounters > sources;
+
+    Clock::time_point intervalStart;
+    uint64_t intervalFrames;
+    uint64_t intervalBytes;
+    double framesPerSecond;
+    double bytesPerSecond;
+};
+}
+
 class FrameDispatcher::Impl
 {
 public:
-    Impl() {}
+    explicit Impl( FrameDispatcher& dispatcher_ )
+        : dispatcher( dispatcher_ )
+        , thread( QThread::currentThread( ))
+        , processingScheduled( false )
+        , maxBufferedFrames( 0 )
+        , maxBufferedBytes( 0 )
+    {}
+
+    typedef std::function< void() > Task;
 
-    FramePtr consumeLatestFrame( const QString& uri )
+    /**
+     * Execute a task in the thread of the dispatcher.
+     *
+     * Tasks submitted from the dispatcher thread are executed immediately,
+     * others are queued and processed asynchronously by processTasks().
+     */
+    void execute( const Task& task )
+    {
+        // QObject::thread() is not safe to read while the dispatcher is being
+        // moved, the latched thread is
+        const QThread* target = thread.load( std::memory_order_acquire );
+        if( QThread::currentThread() == target )
+        {
+            task();
+            return;
+        }
+
+        tasks.enqueue( task );
+
+        // Only one notification for all the tasks queued until processed
+        if( !processingScheduled.exchange( true, std::memory_order_acq_rel ))
+            emit dispatcher._tasksAvailable();
+    }
+
+    void processTasks()
+    {
+        processingScheduled.exchange( false, std::memory_order_acq_rel );
+
+        Task task;
+        while( tasks.dequeue( task ))
+            task();
+    }
+
+    FramePtr consumeFrame( const QString& uri )
     {
         FramePtr frame( new Frame );
         frame->uri = uri;
 
+        // Superseded frames have already been dropped by the buffer if the
+        // stream only wants the latest one
         ReceiveBuffer& buffer = streamBuffers[uri];
-
-        while( buffer.hasCompleteFrame( ))
-            frame->segments = buffer.popFrame();
+        frame->segments = buffer.popFrame();
 
         assert( !frame->segments.empty( ));
 
         // receiver will request a new frame once this frame was consumed
         buffer.setAllowedToSend( false );
 
+        acknowledgeFrames( uri, buffer );
+
+        {
+            std::lock_guard< std::mutex > lock( metricsMutex );
+            StreamCounters& counters = metrics[uri];
+            ++counters.framesDispatched;
+            counters.updateBuffer( buffer );
+        }
+
         return frame;
     }
 
+    /**
+     * Notify the senders of all the frames released by the buffer since the
+     * last acknowledgement, including the ones dropped without being sent.
+     *
+     * Each source is credited with its own frames, which differ between the
+     * sources in partial updates mode.
+     */
+    void acknowledgeFrames( const QString& uri, const ReceiveBuffer& buffer )
+    {
+        std::map< size_t, FrameIndex >& acknowledged = acknowledgedFrames[uri];
+        std::unique_ptr< std::map< size_t, unsigned int >> counts(
+                    new std::map< size_t, unsigned int > );
+        for( const size_t sourceIndex : buffer.getSourceIndexes( ))
+        {
+            const FrameIndex released =
+                    buffer.getReleasedFrameCount( sourceIndex );
+            FrameIndex& sourceAcknowledged = acknowledged[sourceIndex];
+            if( released == sourceAcknowledged )
+                continue;
+
+            (*counts)[sourceIndex] = released - sourceAcknowledged;
+            sourceAcknowledged = released;
+        }
+
+        if( !counts->empty( ))
+            emit dispatcher.framesConsumed(
+                    uri, SourceFrameCountsPtr( counts.release( )));
+    }
+
+    ReceiveBuffer& getBuffer( const QString& uri )
+    {
+        StreamBuffers::iterator it = streamBuffers.find( uri );
+        if( it != streamBuffers.end( ))
+            return it->second;
+
+        ReceiveBuffer& buffer = streamBuffers[uri];
+        if( deliveryModes.count( uri ))
+            buffer.setDeliveryMode( deliveryModes[uri] );
+        buffer.setMaxBufferedFrames( maxBufferedFrames );
+        buffer.setMaxBufferedBytes( maxBufferedBytes );
+        return buffer;
+    }
+
+    FrameDispatcher& dispatcher;
+
+    /** The thread executing the tasks, latched by moveToDispatcherThread() */
+    std::atomic< QThread* > thread;
+
     typedef std::map<QString, ReceiveBuffer> StreamBuffers;
     StreamBuffers streamBuffers;
+
+    MPSCQueue< Task > tasks;
+    std::atomic< bool > processingScheduled;
+
+    std::map<QString, DeliveryMode> deliveryModes;
+    std::map<QString, std::map<size_t, FrameIndex>> acknowledgedFrames;
+    size_t maxBufferedFrames;
+    size_t maxBufferedBytes;
+
+    std::shared_ptr< FrameRecorder > recorder;
+
+    /** Counters of the open streams, read by any thread for the snapshots */
+    mutable std::mutex metricsMutex;
+    std::map< QString, StreamCounters > metrics;
 };
 
 FrameDispatcher::FrameDispatcher()
-    : _impl( new Impl )
+    : _impl( new Impl( *this ))
 {
+    connect( this, &FrameDispatcher::_tasksAvailable,
+             this, &FrameDispatcher::_processTasks, Qt::QueuedConnection );
 }
 
 FrameDispatcher::~FrameDispatcher()
@@ -82,65 +276,265 @@ FrameDispatcher::~FrameDispatcher()
     delete _impl;
 }
 
+void FrameDispatcher::moveToDispatcherThread( QThread* thread )
+{
+    moveToThread( thread );
+    _impl->thread.store( thread, std::memory_order_release );
+}
+
+void FrameDispatcher::setDeliveryMode( const QString uri,
+                                       const DeliveryMode mode )
+{
+    _impl->execute( [this, uri, mode]
+    {
+        _impl->deliveryModes[uri] = mode;
+        if( !_impl->streamBuffers.count( uri ))
+            return;
+
+        // The new mode may complete a frame while the stream is idle
+        ReceiveBuffer& buffer = _impl->streamBuffers[uri];
+        buffer.setDeliveryMode( mode );
+        if( buffer.isAllowedToSend() && buffer.hasCompleteFrame( ))
+            emit sendFrame( _impl->consumeFrame( uri ));
+    });
+}
+
+void FrameDispatcher::setMaxBufferedFrames( const size_t count )
+{
+    _impl->execute( [this, count]
+    {
+        _impl->maxBufferedFrames = count;
+        for( auto& stream : _impl->streamBuffers )
+            stream.second.setMaxBufferedFrames( count );
+    });
+}
+
+void FrameDispatcher::setMaxBufferedBytes( const size_t bytes )
+{
+    _impl->execute( [this, bytes]
+    {
+        _impl->maxBufferedBytes = bytes;
+        for( auto& stream : _impl->streamBuffers )
+            stream.second.setMaxBufferedBytes( bytes );
+    });
+}
+
+bool FrameDispatcher::startRecording( const QString& filename )
+{
+    std::shared_ptr< FrameRecorder > recorder( new FrameRecorder );
+    if( !recorder->open( filename ))
+        return false;
+
+    _impl->execute( [this, recorder]
+    {
+        // The sources which are already streaming must be known to replay
+        // their segments
+        for( const auto& stream : _impl->streamBuffers )
+            for( const size_t sourceIndex : stream.second.getSourceIndexes( ))
+                recorder->addSource( stream.first, sourceIndex );
+        _impl->recorder = recorder;
+    });
+    return true;
+}
+
+void FrameDispatcher::stopRecording()
+{
+    _impl->execute( [this] { _impl->recorder.reset(); });
+}
+
+std::vector< StreamMetrics > FrameDispatcher::getMetrics() const
+{
+    std::vector< StreamMetrics > snapshot;
+
+    std::lock_guard< std::mutex > lock( _impl->metricsMutex );
+    const Clock::time_point now = Clock::now();
+    for( const auto& stream : _impl->metrics )
+    {
+        const StreamCounters& counters = stream.second;
+
+        StreamMetrics metrics;
+        metrics.uri = stream.first;
+        metrics.framesReceived = counters.framesReceived;
+        metrics.framesDispatched = counters.framesDispatched;
+        metrics.framesDropped = counters.framesDropped;
+        metrics.segmentsReceived = counters.segmentsReceived;
+        metrics.bytesReceived = counters.bytesReceived;
+        metrics.bufferedFrames = counters.bufferedFrames;
+        metrics.bufferedBytes = counters.bufferedBytes;
+        if( counters.framesReceived > 0 )
+            metrics.segmentsPerFrame = double( counters.segmentsReceived ) /
+                                       counters.framesReceived;
+
+        // The rates are only updated while receiving, a stream which stopped
+        // sending for more than an interval has none
+        if( now - counters.intervalStart < 2 * rateInterval )
+        {
+            metrics.framesPerSecond = counters.framesPerSecond;
+            metrics.bytesPerSecond = counters.bytesPerSecond;
+        }
+
+        for( const auto& source : counters.sources )
+        {
+            const uint64_t frames = source.second.getFrameCount();
+            SourceMetrics sourceMetrics;
+            sourceMetrics.sourceIndex = source.first;
+            sourceMetrics.framesFinished = source.second.framesFinished;
+            sourceMetrics.framesBehind = counters.framesReceived -
+                                         std::min( counters.framesReceived,
+                                                   frames );
+            metrics.sources.push_back( sourceMetrics );
+        }
+        snapshot.push_back( metrics );
+    }
+    return snapshot;
+}
+
 void FrameDispatcher::addSource( const QString uri, const size_t sourceIndex )
 {
-    _impl->streamBuffers[uri].addSource( sourceIndex );
+    _impl->execute( [this, uri, sourceIndex]
+    {
+        if( _impl->recorder )
+            _impl->recorder->addSource( uri, sourceIndex );
+
+        ReceiveBuffer& buffer = _impl->getBuffer( uri );
+        if( buffer.addSource( sourceIndex ))
+        {
+            _impl->acknowledgedFrames[uri][sourceIndex] = 0;
+
+            // The buffer aligns a source joining mid-stream with the frames
+            // released so far, it is only behind the frames received since
+            std::lock_guard< std::mutex > lock( _impl->metricsMutex );
+            SourceCounters& source = _impl->metrics[uri].sources[sourceIndex];
+            source = SourceCounters();
+            source.firstFrame = buffer.getReleasedFrameCount();
+        }
 
-    if( _impl->streamBuffers[uri].getSourceCount() == 1 )
-        emit openPixelStream( uri );
+        if( buffer.getSourceCount() == 1 )
+            emit openPixelStream( uri );
+    });
 }
 
 void FrameDispatcher::removeSource( const QString uri,
                                     const size_t sourceIndex )
 {
-    if( !_impl->streamBuffers.count( uri ))
-        return;
+    _impl->execute( [this, uri, sourceIndex]
+    {
+        if( !_impl->streamBuffers.count( uri ))
+            return;
 
-    _impl->streamBuffers[uri].removeSource( sourceIndex );
+        if( _impl->recorder )
+            _impl->recorder->removeSource( uri, sourceIndex );
+        _impl->streamBuffers[uri].removeSource( sourceIndex );
+        _impl->acknowledgedFrames[uri].erase( sourceIndex );
+        {
+            std::lock_guard< std::mutex > lock( _impl->metricsMutex );
+            _impl->metrics[uri].sources.erase( sourceIndex );
+        }
 
-    if( _impl->streamBuffers[uri].getSourceCount() == 0 )
-        deleteStream( uri );
+        if( _impl->streamBuffers[uri].getSourceCount() == 0 )
+            deleteStream( uri );
+    });
 }
 
 void FrameDispatcher::processSegment( const QString uri,
                                       const size_t sourceIndex,
                                       deflect::Segment segment )
 {
-    if( _impl->streamBuffers.count( uri ))
-        _impl->streamBuffers[uri].insert( segment, sourceIndex );
+    _impl->execute( [this, uri, sourceIndex, segment]
+    {
+        if( !_impl->streamBuffers.count( uri ))
+            return;
+
+        if( _impl->recorder )
+            _impl->recorder->addSegment( uri, sourceIndex, segment );
+        ReceiveBuffer& buffer = _impl->streamBuffers[uri];
+        const size_t droppedFrames = buffer.getDroppedFrameCount();
+        buffer.insert( segment, sourceIndex );
+        if( buffer.getDroppedFrameCount() != droppedFrames )
+            _impl->acknowledgeFrames( uri, buffer );
+        {
+            std::lock_guard< std::mutex > lock( _impl->metricsMutex );
+            StreamCounters& counters = _impl->metrics[uri];
+            ++counters.segmentsReceived;
+            counters.bytesReceived += segment.imageData.size();
+            counters.intervalBytes += segment.imageData.size();
+            counters.updateRates( Clock::now( ));
+            counters.updateBuffer( buffer );
+        }
+    });
 }
 
 void FrameDispatcher::processFrameFinished( const QString uri,
                                             const size_t sourceIndex )
 {
-    if( !_impl->streamBuffers.count( uri ))
-        return;
+    _impl->execute( [this, uri, sourceIndex]
+    {
+        if( !_impl->streamBuffers.count( uri ))
+            return;
 
-    ReceiveBuffer& buffer = _impl->streamBuffers[uri];
-    buffer.finishFrameForSource( sourceIndex );
+        if( _impl->recorder )
+            _impl->recorder->finishFrame( uri, sourceIndex );
+        ReceiveBuffer& buffer = _impl->streamBuffers[uri];
+        buffer.finishFrameForSource( sourceIndex );
+        {
+            std::lock_guard< std::mutex > lock( _impl->metricsMutex );
+            StreamCounters& counters = _impl->metrics[uri];
+            SourceCounters& source = counters.sources[sourceIndex];
+            ++source.framesFinished;
+            const uint64_t frames = source.getFrameCount();
+            if( frames > counters.framesReceived )
+            {
+                counters.framesReceived = frames;
+                ++counters.intervalFrames;
+            }
+            counters.updateRates( Clock::now( ));
+            counters.updateBuffer( buffer );
+        }
 
-    if( buffer.isAllowedToSend() && buffer.hasCompleteFrame( ))
-        emit sendFrame( _impl->consumeLatestFrame( uri ));
+        // Also credit the frames dropped or superseded by the buffer while
+        // the receiver does not request any, so that the senders never wait
+        // for them
+        if( buffer.isAllowedToSend() && buffer.hasCompleteFrame( ))
+            emit sendFrame( _impl->consumeFrame( uri ));
+        else
+            _impl->acknowledgeFrames( uri, buffer );
+    });
 }
 
 void FrameDispatcher::deleteStream( const QString uri )
 {
-    if( _impl->streamBuffers.count( uri ))
+    _impl->execute( [this, uri]
     {
-        _impl->streamBuffers.erase( uri );
-        emit deletePixelStream( uri );
-    }
+        if( _impl->streamBuffers.count( uri ))
+        {
+            _impl->streamBuffers.erase( uri );
+            _impl->acknowledgedFrames.erase( uri );
+            {
+                std::lock_guard< std::mutex > lock( _impl->metricsMutex );
+                _impl->metrics.erase( uri );
+            }
+            emit deletePixelStream( uri );
+        }
+    });
 }
 
 void FrameDispatcher::requestFrame( const QString uri )
 {
-    if( !_impl->streamBuffers.count( uri ))
-        return;
+    _impl->execute( [this, uri]
+    {
+        if( !_impl->streamBuffers.count( uri ))
+            return;
 
-    ReceiveBuffer& buffer = _impl->streamBuffers[uri];
-    buffer.setAllowedToSend( true );
-    if( buffer.hasCompleteFrame( ))
-        emit sendFrame( _impl->consumeLatestFrame( uri ));
+        ReceiveBuffer& buffer = _impl->streamBuffers[uri];
+        buffer.setAllowedToSend( true );
+        if( buffer.hasCompleteFrame( ))
+            emit sendFrame( _impl->consumeFrame( uri ));
+    });
+}
+
+void FrameDispatcher::_processTasks()
+{
+    _impl->processTasks();
 }
 
 }
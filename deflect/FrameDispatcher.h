@@ -43,15 +43,26 @@
 #include <deflect/api.h>
 #include <deflect/types.h>
 #include <deflect/Segment.h>
+#include <deflect/ServerMetrics.h>
 
 #include <QObject>
 #include <map>
+#include <vector>
 
 namespace deflect
 {
 
 /**
  * Gather segments from multiple sources and dispatch full frames.
+ *
+ * The slots of this class are thread-safe. When called from a thread other
+ * than the one the dispatcher lives in (typically from the ServerWorker
+ * threads), the request is pushed to a lock-free queue and processed later in
+ * the dispatcher's thread, in the order of submission for each caller. This
+ * allows moving the dispatcher to a dedicated thread with
+ * moveToDispatcherThread(), so that assembling frames does not compete with the
+ * application's GUI thread.
+ * The signals are always emitted from the dispatcher's thread.
  */
 class FrameDispatcher : public QObject
 {
@@ -64,6 +75,79 @@ public:
     /** Destructor. */
     DEFLECT_API ~FrameDispatcher();
 
+    /**
+     * Move the dispatcher to the thread which processes its tasks.
+     *
+     * Unlike a plain QObject::moveToThread(), the thread is also latched
+     * atomically for the slots called from other threads. It must be called
+     * from the dispatcher's current thread, before the thread is started.
+     * @param thread the thread which will process the tasks
+     */
+    DEFLECT_API void moveToDispatcherThread( QThread* thread );
+
+    /**
+     * Set how the frames of a stream are delivered by sendFrame().
+     *
+     * In DELIVERY_LATEST_ONLY mode (default), frames which are superseded by
+     * a more recent complete frame before the receiver requests them are
+     * discarded as soon as possible. In DELIVERY_EVERY_FRAME mode, every
+     * complete frame is dispatched in order, one per requestFrame().
+     * In DELIVERY_PARTIAL_UPDATES mode, meant for sources covering disjoint
+     * regions, a frame is dispatched as soon as any source finishes one,
+     * reusing the latest segments of the other sources.
+     * The mode is retained for streams which are opened later.
+     *
+     * @param uri Identifier for the stream
+     * @param mode the delivery mode
+     */
+    DEFLECT_API void setDeliveryMode( QString uri, DeliveryMode mode );
+
+    /**
+     * Limit the number of complete frames buffered for each stream.
+     *
+     * Frames accumulate while the receiver does not call requestFrame(), for
+     * instance when the window of the stream is hidden. The oldest frames
+     * exceeding the limit are dropped.
+     * @param count the maximum number of frames, 0 for unlimited (default)
+     * @see ReceiveBuffer::setMaxBufferedFrames()
+     */
+    DEFLECT_API void setMaxBufferedFrames( size_t count );
+
+    /**
+     * Limit the amount of image data buffered for each stream.
+     *
+     * The limit is enforced as the segments arrive, dropping the oldest
+     * frames whether they are complete or not.
+     * @param bytes the maximum size in bytes, 0 for unlimited (default)
+     * @see ReceiveBuffer::setMaxBufferedBytes()
+     */
+    DEFLECT_API void setMaxBufferedBytes( size_t bytes );
+
+    /**
+     * Record the sources, segments and frame boundaries of all the streams.
+     *
+     * Everything received from now on is appended to the file, which can be
+     * replayed with a FrameRecordReader. The file starts with the sources of
+     * the open streams; the first recorded frame of these streams lacks the
+     * segments received before this call. A previous recording is stopped.
+     * @param filename The path of the file, replaced if it exists
+     * @return false if the file could not be opened
+     * @see FrameRecorder
+     */
+    DEFLECT_API bool startRecording( const QString& filename );
+
+    /** Stop recording and close the file. */
+    DEFLECT_API void stopRecording();
+
+    /**
+     * Get a snapshot of the metrics of all the streams.
+     *
+     * The metrics are updated as the segments are processed, so that taking a
+     * snapshot never waits for the dispatcher's thread. Thread-safe.
+     * @return the metrics of the open streams, ordered by uri
+     */
+    DEFLECT_API std::vector< StreamMetrics > getMetrics() const;
+
 public slots:
     /**
      * Add a source of Segments for a Stream.
@@ -136,6 +220,27 @@ signals:
      */
     DEFLECT_API void sendFrame( deflect::FramePtr frame );
 
+    /**
+     * Notify that frames of a stream have been consumed.
+     *
+     * Emitted when a frame is dispatched, counting for each source the frames
+     * it finished which were dispatched, dropped or superseded since the
+     * previous notification. It is used to return credits to the senders
+     * which limit their number of frames in flight.
+     *
+     * @param uri Identifier for the Stream
+     * @param counts The number of frames consumed for each source index since
+     *        the last notification; sources without new frames are omitted
+     */
+    DEFLECT_API void framesConsumed( QString uri,
+                                     deflect::SourceFrameCountsPtr counts );
+
+    /** @internal Notify that requests are pending in the queue. */
+    void _tasksAvailable();
+
+private slots:
+    void _processTasks();
+
 private:
     class Impl;
     Impl* _impl;
@@ -0,0 +1,146 @@
+/*********************************************************************/
+/* Copyright (c) 2015, EPFL/Blue Brain Project                       */
+/*                     Raphael Dumusc <raphael.dumusc@epfl.ch>       */
+/* All rights reserved.                                              */
+/*                                                                   */
+/* Redistribution and use in source and binary forms, with or        */
+/* without modification, are permitted provided that the following   */
+/* conditions are met:                                               */
+/*                                                                   */
+/*   1. Redistributions of source code must retain the above         */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer.                                                  */
+/*                                                                   */
+/*   2. Redistributions in binary form must reproduce the above      */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer in the documentation and/or other materials       */
+/*      provided with the distribution.                              */
+/*                                                                   */
+/*    THIS  SOFTWARE IS PROVIDED  BY THE  UNIVERSITY OF  TEXAS AT    */
+/*    AUSTIN  ``AS IS''  AND ANY  EXPRESS OR  IMPLIED WARRANTIES,    */
+/*    INCLUDING, BUT  NOT LIMITED  TO, THE IMPLIED  WARRANTIES OF    */
+/*    MERCHANTABILITY  AND FITNESS FOR  A PARTICULAR  PURPOSE ARE    */
+/*    DISCLAIMED.  IN  NO EVENT SHALL THE UNIVERSITY  OF TEXAS AT    */
+/*    AUSTIN OR CONTRIBUTORS BE  LIABLE FOR ANY DIRECT, INDIRECT,    */
+/*    INCIDENTAL,  SPECIAL, EXEMPLARY,  OR  CONSEQUENTIAL DAMAGES    */
+/*    (INCLUDING, BUT  NOT LIMITED TO,  PROCUREMENT OF SUBSTITUTE    */
+/*    GOODS  OR  SERVICES; LOSS  OF  USE,  DATA,  OR PROFITS;  OR    */
+/*    BUSINESS INTERRUPTION) HOWEVER CAUSED  AND ON ANY THEORY OF    */
+/*    LIABILITY, WHETHER  IN CONTRACT, STRICT  LIABILITY, OR TORT    */
+/*    (INCLUDING NEGLIGENCE OR OTHERWISE)  ARISING IN ANY WAY OUT    */
+/*    OF  THE  USE OF  THIS  SOFTWARE,  EVEN  IF ADVISED  OF  THE    */
+/*    POSSIBILITY OF SUCH DAMAGE.                                    */
+/*                                                                   */
+/* The views and conclusions contained in the software and           */
+/* documentation are those of the authors and should not be          */
+/* interpreted as representing official policies, either expressed   */
+/* or implied, of The University of Texas at Austin.                 */
+/*********************************************************************/
+
+#ifndef DEFLECT_FRAMERECORDHEADER_H
+#define DEFLECT_FRAMERECORDHEADER_H
+
+#include <QtEndian>
+
+#include <cstring>
+
+namespace deflect
+{
+
+/**
+ * Header of a record in the files written by the FrameRecorder.
+ *
+ * A file starts with the 4 bytes "DFLR" followed by the version, then the
+ * records are appended one after the other. Each record is a header, the uri
+ * of the stream (UTF-8) and, for segments, the image data. All integers are
+ * little-endian:
+ * - type, compressed, format: 1 byte each, then 1 reserved byte
+ * - uri size: 4 bytes
+ * - timestamp in microseconds since the recording started: 8 bytes
+ * - source index: 8 bytes
+ * - x, y, width, height: 4 bytes each
+ * - image data size: 4 bytes, then 4 reserved bytes
+ */
+struct FrameRecordHeader
+{
+    /** The version of the file format. */
+    static const quint32 fileVersion = 1;
+
+    /** The size of the file header (magic and version). */
+    static const size_t fileHeaderSize = 8;
+
+    /** The size of the serialized record header. */
+    static const size_t serializedSize = 48;
+
+    FrameRecordHeader()
+        : type( 0 ), compressed( 0 ), format( 0 ), uriSize( 0 )
+        , timestamp( 0 ), sourceIndex( 0 ), x( 0 ), y( 0 ), width( 0 )
+        , height( 0 ), dataSize( 0 )
+    {}
+
+    quint8 type;
+    quint8 compressed;
+    quint8 format;
+    quint32 uriSize;
+    quint64 timestamp;
+    quint64 sourceIndex;
+    quint32 x;
+    quint32 y;
+    quint32 width;
+    quint32 height;
+    quint32 dataSize;
+
+    /** Write the file header to fileHeaderSize bytes. */
+    static void serializeFileHeader( char* data )
+    {
+        std::memcpy( data, "DFLR", 4 );
+        qToLittleEndian< quint32 >( fileVersion, (uchar*)data + 4 );
+    }
+
+    /** @return true if the fileHeaderSize bytes are a supported file header */
+    static bool isValidFileHeader( const char* data )
+    {
+        return std::memcmp( data, "DFLR", 4 ) == 0 &&
+               qFromLittleEndian< quint32 >( (const uchar*)data + 4 ) ==
+                   fileVersion;
+    }
+
+    /** Write the header to serializedSize bytes. */
+    void serialize( char* data ) const
+    {
+        uchar* out = reinterpret_cast< uchar* >( data );
+        std::memset( out, 0, serializedSize );
+        out[0] = type;
+        out[1] = compressed;
+        out[2] = format;
+        qToLittleEndian< quint32 >( uriSize, out + 4 );
+        qToLittleEndian< quint64 >( timestamp, out + 8 );
+        qToLittleEndian< quint64 >( sourceIndex, out + 16 );
+        qToLittleEndian< quint32 >( x, out + 24 );
+        qToLittleEndian< quint32 >( y, out + 28 );
+        qToLittleEndian< quint32 >( width, out + 32 );
+        qToLittleEndian< quint32 >( height, out + 36 );
+        qToLittleEndian< quint32 >( dataSize, out + 40 );
+    }
+
+    /** Read the header from serializedSize bytes. */
+    void deserialize( const char* data )
+    {
+        const uchar* in = reinterpret_cast< const uchar* >( data );
+        type = in[0];
+        compressed = in[1];
+        format = in[2];
+        uriSize = qFromLittleEndian< quint32 >( in + 4 );
+        timestamp = qFromLittleEndian< quint64 >( in + 8 );
+        sourceIndex = qFromLittleEndian< quint64 >( in + 16 );
+        x = qFromLittleEndian< quint32 >( in + 24 );
+        y = qFromLittleEndian< quint32 >( in + 28 );
+        width = qFromLittleEndian< quint32 >( in + 32 );
+        height = qFromLittleEndian< quint32 >( in + 36 );
+        dataSize = qFromLittleEndian< quint32 >( in + 40 );
+    }
+};
+
+}
+
+#endif
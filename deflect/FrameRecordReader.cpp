@@ -0,0 +1,259 @@
+/*********************************************************************/
+/* Copyright (c) 2015, EPFL/Blue Brain Project                       */
+/*                     Raphael Dumusc <raphael.dumusc@epfl.ch>       */
+/* All rights reserved.                                              */
+/*                                                                   */
+/* Redistribution and use in source and binary forms, with or        */
+/* without modification, are permitted provided that the following   */
+/* conditions are met:                                               */
+/*                                                                   */
+/*   1. Redistributions of source code must retain the above         */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer.                                                  */
+/*                                                                   */
+/*   2. Redistributions in binary form must reproduce the above      */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer in the documentation and/or other materials       */
+/*      provided with the distribution.                              */
+/*                                                                   */
+/*    THIS  SOFTWARE IS PROVIDED  BY THE  UNIVERSITY OF  TEXAS AT    */
+/*    AUSTIN  ``AS IS''  AND ANY  EXPRESS OR  IMPLIED WARRANTIES,    */
+/*    INCLUDING, BUT  NOT LIMITED  TO, THE IMPLIED  WARRANTIES OF    */
+/*    MERCHANTABILITY  AND FITNESS FOR  A PARTICULAR  PURPOSE ARE    */
+/*    DISCLAIMED.  IN  NO EVENT SHALL THE UNIVERSITY  OF TEXAS AT    */
+/*    AUSTIN OR CONTRIBUTORS BE  LIABLE FOR ANY DIRECT, INDIRECT,    */
+/*    INCIDENTAL,  SPECIAL, EXEMPLARY,  OR  CONSEQUENTIAL DAMAGES    */
+/*    (INCLUDING, BUT  NOT LIMITED TO,  PROCUREMENT OF SUBSTITUTE    */
+/*    GOODS  OR  SERVICES; LOSS  OF  USE,  DATA,  OR PROFITS;  OR    */
+/*    BUSINESS INTERRUPTION) HOWEVER CAUSED  AND ON ANY THEORY OF    */
+/*    LIABILITY, WHETHER  IN CONTRACT, STRICT  LIABILITY, OR TORT    */
+/*    (INCLUDING NEGLIGENCE OR OTHERWISE)  ARISING IN ANY WAY OUT    */
+/*    OF  THE  USE OF  THIS  SOFTWARE,  EVEN  IF ADVISED  OF  THE    */
+/*    POSSIBILITY OF SUCH DAMAGE.                                    */
+/*                                                                   */
+/* The views and conclusions contained in the software and           */
+/* documentation are those of the authors and should not be          */
+/* interpreted as representing official policies, either expressed   */
+/* or implied, of The University of Texas at Austin.                 */
+/*********************************************************************/
+
+#include "FrameRecordReader.h"
+
+#include "Frame.h"
+#include "FrameRecordHeader.h"
+#include "ReceiveBuffer.h"
+
+#include <QFile>
+
+#include <algorithm>
+#include <chrono>
+#include <map>
+#include <thread>
+
+namespace deflect
+{
+
+class FrameRecordReader::Impl
+{
+public:
+    Impl()
+        : data( nullptr )
+        , size( 0 )
+        , position( 0 )
+    {}
+
+    ReceiveBuffer& getBuffer( const QString& uri )
+    {
+        StreamBuffers::iterator it = streamBuffers.find( uri );
+        if( it != streamBuffers.end( ))
+            return it->second;
+
+        ReceiveBuffer& buffer = streamBuffers[uri];
+        buffer.setDeliveryMode( DELIVERY_EVERY_FRAME );
+        return buffer;
+    }
+
+    static bool hasSource( const ReceiveBuffer& buffer,
+                           const size_t sourceIndex )
+    {
+        const std::vector< size_t >& sources = buffer.getSourceIndexes();
+        return std::find( sources.begin(), sources.end(), sourceIndex ) !=
+               sources.end();
+    }
+
+    QFile file;
+    const char* data;
+    qint64 size;
+    qint64 position;
+
+    typedef std::map< QString, ReceiveBuffer > StreamBuffers;
+    StreamBuffers streamBuffers;
+};
+
+FrameRecordReader::FrameRecordReader()
+    : _impl( new Impl )
+{}
+
+FrameRecordReader::~FrameRecordReader()
+{
+    close();
+}
+
+bool FrameRecordReader::open( const QString& filename )
+{
+    close();
+
+    _impl->file.setFileName( filename );
+    if( !_impl->file.open( QIODevice::ReadOnly ))
+        return false;
+
+    const qint64 size = _impl->file.size();
+    uchar* data = size >= qint64( FrameRecordHeader::fileHeaderSize ) ?
+                      _impl->file.map( 0, size ) : nullptr;
+    if( !data || !FrameRecordHeader::isValidFileHeader( (const char*)data ))
+    {
+        close();
+        return false;
+    }
+
+    _impl->data = reinterpret_cast< const char* >( data );
+    _impl->size = size;
+    rewind();
+    return true;
+}
+
+void FrameRecordReader::close()
+{
+    if( _impl->data )
+        _impl->file.unmap( (uchar*)_impl->data );
+    if( _impl->file.isOpen( ))
+        _impl->file.close();
+
+    _impl->data = nullptr;
+    _impl->size = 0;
+    _impl->position = 0;
+    _impl->streamBuffers.clear();
+}
+
+bool FrameRecordReader::isOpen() const
+{
+    return _impl->data != nullptr;
+}
+
+void FrameRecordReader::rewind()
+{
+    _impl->position = FrameRecordHeader::fileHeaderSize;
+    _impl->streamBuffers.clear();
+}
+
+bool FrameRecordReader::readRecord( Record& record )
+{
+    const qint64 remaining = _impl->size - _impl->position;
+    if( !_impl->data || remaining < qint64( FrameRecordHeader::serializedSize ))
+        return false;
+
+    const char* data = _impl->data + _impl->position;
+    FrameRecordHeader header;
+    header.deserialize( data );
+
+    // A recording interrupted while writing may end with a partial record
+    const qint64 recordSize = FrameRecordHeader::serializedSize +
+                              qint64( header.uriSize ) + header.dataSize;
+    if( recordSize > remaining ||
+        header.type > FrameRecorder::RECORD_FRAME_FINISHED ||
+        header.format > SEGMENT_FORMAT_GRAY )
+    {
+        return false;
+    }
+
+    data += FrameRecordHeader::serializedSize;
+    record.type = FrameRecorder::RecordType( header.type );
+    record.timestamp = header.timestamp;
+    record.uri = QString::fromUtf8( data, header.uriSize );
+    record.sourceIndex = header.sourceIndex;
+
+    Segment segment;
+    if( record.type == FrameRecorder::RECORD_SEGMENT )
+    {
+        segment.parameters.x = header.x;
+        segment.parameters.y = header.y;
+        segment.parameters.width = header.width;
+        segment.parameters.height = header.height;
+        segment.parameters.compressed = header.compressed != 0;
+        segment.format = SegmentFormat( header.format );
+        segment.imageData = QByteArray::fromRawData( data + header.uriSize,
+                                                     header.dataSize );
+    }
+    record.segment = segment;
+
+    _impl->position += recordSize;
+    return true;
+}
+
+FramePtr FrameRecordReader::readFrame( quint64& timestamp )
+{
+    Record record;
+    while( readRecord( record ))
+    {
+        ReceiveBuffer& buffer = _impl->getBuffer( record.uri );
+
+        // Skip the records of a source which was never added, for instance
+        // in a file which was not written by a FrameRecorder
+        if( record.type != FrameRecorder::RECORD_ADD_SOURCE &&
+            !_impl->hasSource( buffer, record.sourceIndex ))
+        {
+            continue;
+        }
+
+        switch( record.type )
+        {
+        case FrameRecorder::RECORD_ADD_SOURCE:
+            buffer.addSource( record.sourceIndex );
+            break;
+        case FrameRecorder::RECORD_REMOVE_SOURCE:
+            buffer.removeSource( record.sourceIndex );
+            break;
+        case FrameRecorder::RECORD_SEGMENT:
+            buffer.insert( record.segment, record.sourceIndex );
+            break;
+        case FrameRecorder::RECORD_FRAME_FINISHED:
+            buffer.finishFrameForSource( record.sourceIndex );
+            break;
+        }
+
+        if( buffer.getSourceCount() > 0 && buffer.hasCompleteFrame( ))
+        {
+            FramePtr frame( new Frame );
+            frame->uri = record.uri;
+            frame->segments = buffer.popFrame();
+            timestamp = record.timestamp;
+            return frame;
+        }
+    }
+    return FramePtr();
+}
+
+size_t FrameRecordReader::replay(
+        const std::function< void( FramePtr ) >& callback,
+        const bool originalSpeed )
+{
+    typedef std::chrono::steady_clock Clock;
+    const Clock::time_point start = Clock::now();
+
+    size_t count = 0;
+    quint64 firstTimestamp = 0;
+    quint64 timestamp = 0;
+    while( FramePtr frame = readFrame( timestamp ))
+    {
+        if( count == 0 )
+            firstTimestamp = timestamp;
+        else if( originalSpeed )
+            std::this_thread::sleep_until( start + std::chrono::microseconds(
+                                               timestamp - firstTimestamp ));
+        callback( frame );
+        ++count;
+    }
+    return count;
+}
+
+}
@@ -0,0 +1,152 @@
+/*********************************************************************/
+/* Copyright (c) 2015, EPFL/Blue Brain Project                       */
+/*                     Raphael Dumusc <raphael.dumusc@epfl.ch>       */
+/* All rights reserved.                                              */
+/*                                                                   */
+/* Redistribution and use in source and binary forms, with or        */
+/* without modification, are permitted provided that the following   */
+/* conditions are met:                                               */
+/*                                                                   */
+/*   1. Redistributions of source code must retain the above         */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer.                                                  */
+/*                                                                   */
+/*   2. Redistributions in binary form must reproduce the above      */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer in the documentation and/or other materials       */
+/*      provided with the distribution.                              */
+/*                                                                   */
+/*    THIS  SOFTWARE IS PROVIDED  BY THE  UNIVERSITY OF  TEXAS AT    */
+/*    AUSTIN  ``AS IS''  AND ANY  EXPRESS OR  IMPLIED WARRANTIES,    */
+/*    INCLUDING, BUT  NOT LIMITED  TO, THE IMPLIED  WARRANTIES OF    */
+/*    MERCHANTABILITY  AND FITNESS FOR  A PARTICULAR  PURPOSE ARE    */
+/*    DISCLAIMED.  IN  NO EVENT SHALL THE UNIVERSITY  OF TEXAS AT    */
+/*    AUSTIN OR CONTRIBUTORS BE  LIABLE FOR ANY DIRECT, INDIRECT,    */
+/*    INCIDENTAL,  SPECIAL, EXEMPLARY,  OR  CONSEQUENTIAL DAMAGES    */
+/*    (INCLUDING, BUT  NOT LIMITED TO,  PROCUREMENT OF SUBSTITUTE    */
+/*    GOODS  OR  SERVICES; LOSS  OF  USE,  DATA,  OR PROFITS;  OR    */
+/*    BUSINESS INTERRUPTION) HOWEVER CAUSED  AND ON ANY THEORY OF    */
+/*    LIABILITY, WHETHER  IN CONTRACT, STRICT  LIABILITY, OR TORT    */
+/*    (INCLUDING NEGLIGENCE OR OTHERWISE)  ARISING IN ANY WAY OUT    */
+/*    OF  THE  USE OF  THIS  SOFTWARE,  EVEN  IF ADVISED  OF  THE    */
+/*    POSSIBILITY OF SUCH DAMAGE.                                    */
+/*                                                                   */
+/* The views and conclusions contained in the software and           */
+/* documentation are those of the authors and should not be          */
+/* interpreted as representing official policies, either expressed   */
+/* or implied, of The University of Texas at Austin.                 */
+/*********************************************************************/
+
+#ifndef DEFLECT_FRAMERECORDREADER_H
+#define DEFLECT_FRAMERECORDREADER_H
+
+#include <deflect/api.h>
+#include <deflect/types.h>
+#include <deflect/FrameRecorder.h>
+#include <deflect/Segment.h>
+
+#include <QString>
+
+#include <functional>
+#include <memory>
+
+namespace deflect
+{
+
+/**
+ * Read and replay a file written by a FrameRecorder.
+ *
+ * The file is memory-mapped: the image data of the segments and frames which
+ * are read refers to the mapping instead of being copied, and is thus only
+ * valid until the reader is closed or destroyed. Copy the data (for instance
+ * by detaching the QByteArray) to keep it longer.
+ */
+class FrameRecordReader
+{
+public:
+    /** A record of the file. */
+    struct Record
+    {
+        Record() : type( FrameRecorder::RECORD_ADD_SOURCE ), timestamp( 0 )
+                 , sourceIndex( 0 ) {}
+
+        /** The type of record. */
+        FrameRecorder::RecordType type;
+
+        /** The time of reception in microseconds since recording started. */
+        quint64 timestamp;
+
+        /** The stream to which the record belongs. */
+        QString uri;
+
+        /** The source of the stream. */
+        size_t sourceIndex;
+
+        /** The segment, only for RECORD_SEGMENT records. */
+        Segment segment;
+    };
+
+    /** Construct a reader, which needs to be opened. */
+    DEFLECT_API FrameRecordReader();
+
+    /** Destructor, closes the file. */
+    DEFLECT_API ~FrameRecordReader();
+
+    /**
+     * Open and map a recording.
+     * @param filename The path of the file
+     * @return false if the file could not be mapped or is not a recording
+     */
+    DEFLECT_API bool open( const QString& filename );
+
+    /** Unmap and close the file. */
+    DEFLECT_API void close();
+
+    /** @return true if the reader has an open file. */
+    DEFLECT_API bool isOpen() const;
+
+    /** Restart reading from the first record. */
+    DEFLECT_API void rewind();
+
+    /**
+     * Read the next record.
+     * @param record The record read
+     * @return false at the end of the file or if the next record is invalid
+     */
+    DEFLECT_API bool readRecord( Record& record );
+
+    /**
+     * Read the records until the next complete frame of any stream.
+     *
+     * The segments are assembled like the FrameDispatcher does in
+     * DELIVERY_EVERY_FRAME mode, so every frame which was completed during
+     * the recording is returned, in order. The records of a source which was
+     * not added first are skipped.
+     * @param timestamp The reception time of the frame's last segment in
+     *        microseconds since the recording started
+     * @return The frame, or an empty pointer at the end of the file
+     */
+    DEFLECT_API FramePtr readFrame( quint64& timestamp );
+
+    /**
+     * Replay all the remaining frames of the recording.
+     *
+     * @param callback Called with each frame, like FrameDispatcher::sendFrame
+     * @param originalSpeed If true, wait to reproduce the timing of the
+     *        recording, otherwise replay the frames as fast as possible
+     * @return the number of frames replayed
+     */
+    DEFLECT_API size_t replay( const std::function< void( FramePtr ) >& callback,
+                               bool originalSpeed );
+
+private:
+    FrameRecordReader( const FrameRecordReader& ) = delete;
+    FrameRecordReader& operator=( const FrameRecordReader& ) = delete;
+
+    class Impl;
+    std::unique_ptr< Impl > _impl;
+};
+
+}
+
+#endif
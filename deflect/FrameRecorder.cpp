@@ -0,0 +1,169 @@
+/*********************************************************************/
+/* Copyright (c) 2015, EPFL/Blue Brain Project                       */
+/*                     Raphael Dumusc <raphael.dumusc@epfl.ch>       */
+/* All rights reserved.                                              */
+/*                                                                   */
+/* Redistribution and use in source and binary forms, with or        */
+/* without modification, are permitted provided that the following   */
+/* conditions are met:                                               */
+/*                                                                   */
+/*   1. Redistributions of source code must retain the above         */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer.                                                  */
+/*                                                                   */
+/*   2. Redistributions in binary form must reproduce the above      */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer in the documentation and/or other materials       */
+/*      provided with the distribution.                              */
+/*                                                                   */
+/*    THIS  SOFTWARE IS PROVIDED  BY THE  UNIVERSITY OF  TEXAS AT    */
+/*    AUSTIN  ``AS IS''  AND ANY  EXPRESS OR  IMPLIED WARRANTIES,    */
+/*    INCLUDING, BUT  NOT LIMITED  TO, THE IMPLIED  WARRANTIES OF    */
+/*    MERCHANTABILITY  AND FITNESS FOR  A PARTICULAR  PURPOSE ARE    */
+/*    DISCLAIMED.  IN  NO EVENT SHALL THE UNIVERSITY  OF TEXAS AT    */
+/*    AUSTIN OR CONTRIBUTORS BE  LIABLE FOR ANY DIRECT, INDIRECT,    */
+/*    INCIDENTAL,  SPECIAL, EXEMPLARY,  OR  CONSEQUENTIAL DAMAGES    */
+/*    (INCLUDING, BUT  NOT LIMITED TO,  PROCUREMENT OF SUBSTITUTE    */
+/*    GOODS  OR  SERVICES; LOSS  OF  USE,  DATA,  OR PROFITS;  OR    */
+/*    BUSINESS INTERRUPTION) HOWEVER CAUSED  AND ON ANY THEORY OF    */
+/*    LIABILITY, WHETHER  IN CONTRACT, STRICT  LIABILITY, OR TORT    */
+/*    (INCLUDING NEGLIGENCE OR OTHERWISE)  ARISING IN ANY WAY OUT    */
+/*    OF  THE  USE OF  THIS  SOFTWARE,  EVEN  IF ADVISED  OF  THE    */
+/*    POSSIBILITY OF SUCH DAMAGE.                                    */
+/*                                                                   */
+/* The views and conclusions contained in the software and           */
+/* documentation are those of the authors and should not be          */
+/* interpreted as representing official policies, either expressed   */
+/* or implied, of The University of Texas at Austin.                 */
+/*********************************************************************/
+
+#include "FrameRecorder.h"
+
+#include "FrameRecordHeader.h"
+
+#include <QFile>
+
+#include <chrono>
+#include <iostream>
+
+namespace deflect
+{
+
+class FrameRecorder::Impl
+{
+public:
+    typedef std::chrono::steady_clock Clock;
+
+    void write( const RecordType type, const QString& uri,
+                const size_t sourceIndex, const Segment* segment = nullptr )
+    {
+        if( !file.isOpen( ))
+            return;
+
+        // Consecutive records mostly belong to the same stream
+        if( uri != lastUri )
+        {
+            lastUri = uri;
+            lastUriData = uri.toUtf8();
+        }
+
+        FrameRecordHeader header;
+        header.type = type;
+        header.uriSize = lastUriData.size();
+        header.timestamp = std::chrono::duration_cast<
+            std::chrono::microseconds >( Clock::now() - start ).count();
+        header.sourceIndex = sourceIndex;
+        if( segment )
+        {
+            const SegmentParameters& params = segment->parameters;
+            header.compressed = params.compressed ? 1 : 0;
+            header.format = segment->format;
+            header.x = params.x;
+            header.y = params.y;
+            header.width = params.width;
+            header.height = params.height;
+            header.dataSize = segment->imageData.size();
+        }
+
+        char data[FrameRecordHeader::serializedSize];
+        header.serialize( data );
+        if( file.write( data, sizeof( data )) != sizeof( data ) ||
+            file.write( lastUriData ) != lastUriData.size() ||
+            ( segment && file.write( segment->imageData ) !=
+                         segment->imageData.size( )))
+        {
+            std::cerr << "FrameRecorder: could not write to "
+                      << file.fileName().toStdString() << ", stopping: "
+                      << file.errorString().toStdString() << std::endl;
+            file.close();
+        }
+    }
+
+    QFile file;
+    Clock::time_point start;
+    QString lastUri;
+    QByteArray lastUriData;
+};
+
+FrameRecorder::FrameRecorder()
+    : _impl( new Impl )
+{}
+
+FrameRecorder::~FrameRecorder()
+{
+    close();
+}
+
+bool FrameRecorder::open( const QString& filename )
+{
+    close();
+
+    _impl->file.setFileName( filename );
+    if( !_impl->file.open( QIODevice::WriteOnly | QIODevice::Truncate ))
+        return false;
+
+    char header[FrameRecordHeader::fileHeaderSize];
+    FrameRecordHeader::serializeFileHeader( header );
+    if( _impl->file.write( header, sizeof( header )) != sizeof( header ))
+    {
+        _impl->file.close();
+        return false;
+    }
+
+    _impl->start = Impl::Clock::now();
+    return true;
+}
+
+void FrameRecorder::close()
+{
+    if( _impl->file.isOpen( ))
+        _impl->file.close();
+}
+
+bool FrameRecorder::isOpen() const
+{
+    return _impl->file.isOpen();
+}
+
+void FrameRecorder::addSource( const QString& uri, const size_t sourceIndex )
+{
+    _impl->write( RECORD_ADD_SOURCE, uri, sourceIndex );
+}
+
+void FrameRecorder::removeSource( const QString& uri, const size_t sourceIndex )
+{
+    _impl->write( RECORD_REMOVE_SOURCE, uri, sourceIndex );
+}
+
+void FrameRecorder::addSegment( const QString& uri, const size_t sourceIndex,
+                                const Segment& segment )
+{
+    _impl->write( RECORD_SEGMENT, uri, sourceIndex, &segment );
+}
+
+void FrameRecorder::finishFrame( const QString& uri, const size_t sourceIndex )
+{
+    _impl->write( RECORD_FRAME_FINISHED, uri, sourceIndex );
+}
+
+}
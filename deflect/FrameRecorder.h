@@ -0,0 +1,120 @@
+/*********************************************************************/
+/* Copyright (c) 2015, EPFL/Blue Brain Project                       */
+/*                     Raphael Dumusc <raphael.dumusc@epfl.ch>       */
+/* All rights reserved.                                              */
+/*                                                                   */
+/* Redistribution and use in source and binary forms, with or        */
+/* without modification, are permitted provided that the following   */
+/* conditions are met:                                               */
+/*                                                                   */
+/*   1. Redistributions of source code must retain the above         */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer.                                                  */
+/*                                                                   */
+/*   2. Redistributions in binary form must reproduce the above      */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer in the documentation and/or other materials       */
+/*      provided with the distribution.                              */
+/*                                                                   */
+/*    THIS  SOFTWARE IS PROVIDED  BY THE  UNIVERSITY OF  TEXAS AT    */
+/*    AUSTIN  ``AS IS''  AND ANY  EXPRESS OR  IMPLIED WARRANTIES,    */
+/*    INCLUDING, BUT  NOT LIMITED  TO, THE IMPLIED  WARRANTIES OF    */
+/*    MERCHANTABILITY  AND FITNESS FOR  A PARTICULAR  PURPOSE ARE    */
+/*    DISCLAIMED.  IN  NO EVENT SHALL THE UNIVERSITY  OF TEXAS AT    */
+/*    AUSTIN OR CONTRIBUTORS BE  LIABLE FOR ANY DIRECT, INDIRECT,    */
+/*    INCIDENTAL,  SPECIAL, EXEMPLARY,  OR  CONSEQUENTIAL DAMAGES    */
+/*    (INCLUDING, BUT  NOT LIMITED TO,  PROCUREMENT OF SUBSTITUTE    */
+/*    GOODS  OR  SERVICES; LOSS  OF  USE,  DATA,  OR PROFITS;  OR    */
+/*    BUSINESS INTERRUPTION) HOWEVER CAUSED  AND ON ANY THEORY OF    */
+/*    LIABILITY, WHETHER  IN CONTRACT, STRICT  LIABILITY, OR TORT    */
+/*    (INCLUDING NEGLIGENCE OR OTHERWISE)  ARISING IN ANY WAY OUT    */
+/*    OF  THE  USE OF  THIS  SOFTWARE,  EVEN  IF ADVISED  OF  THE    */
+/*    POSSIBILITY OF SUCH DAMAGE.                                    */
+/*                                                                   */
+/* The views and conclusions contained in the software and           */
+/* documentation are those of the authors and should not be          */
+/* interpreted as representing official policies, either expressed   */
+/* or implied, of The University of Texas at Austin.                 */
+/*********************************************************************/
+
+#ifndef DEFLECT_FRAMERECORDER_H
+#define DEFLECT_FRAMERECORDER_H
+
+#include <deflect/api.h>
+#include <deflect/types.h>
+#include <deflect/Segment.h>
+
+#include <QString>
+
+#include <memory>
+
+namespace deflect
+{
+
+/**
+ * Record the segments received by a Server to a binary file.
+ *
+ * The sources, segments and frame boundaries of all the streams are appended
+ * to the file in the order they are received, along with the time of their
+ * reception. The FrameRecordReader replays the recording, to benchmark the
+ * decoding and display of the frames with exactly the data that the senders
+ * transmitted.
+ *
+ * The recorder is not thread-safe. It is typically attached to a
+ * FrameDispatcher, see FrameDispatcher::startRecording().
+ */
+class FrameRecorder
+{
+public:
+    /** The types of records. */
+    enum RecordType
+    {
+        RECORD_ADD_SOURCE,
+        RECORD_REMOVE_SOURCE,
+        RECORD_SEGMENT,
+        RECORD_FRAME_FINISHED
+    };
+
+    /** Construct a recorder, which needs to be opened. */
+    DEFLECT_API FrameRecorder();
+
+    /** Destructor, closes the file. */
+    DEFLECT_API ~FrameRecorder();
+
+    /**
+     * Open a file for recording, replacing its previous content.
+     * @param filename The path of the file
+     * @return true if the file could be opened for writing
+     */
+    DEFLECT_API bool open( const QString& filename );
+
+    /** Flush and close the file. */
+    DEFLECT_API void close();
+
+    /** @return true if the recorder has an open file. */
+    DEFLECT_API bool isOpen() const;
+
+    /** Record a new source for a stream. @sa FrameDispatcher::addSource */
+    DEFLECT_API void addSource( const QString& uri, size_t sourceIndex );
+
+    /** Record the removal of a source. @sa FrameDispatcher::removeSource */
+    DEFLECT_API void removeSource( const QString& uri, size_t sourceIndex );
+
+    /** Record a segment. @sa FrameDispatcher::processSegment */
+    DEFLECT_API void addSegment( const QString& uri, size_t sourceIndex,
+                                 const Segment& segment );
+
+    /** Record a frame boundary. @sa FrameDispatcher::processFrameFinished */
+    DEFLECT_API void finishFrame( const QString& uri, size_t sourceIndex );
+
+private:
+    FrameRecorder( const FrameRecorder& ) = delete;
+    FrameRecorder& operator=( const FrameRecorder& ) = delete;
+
+    class Impl;
+    std::unique_ptr< Impl > _impl;
+};
+
+}
+
+#endif
@@ -78,6 +78,22 @@ int getTurboJpegFormat( const PixelFormat pixelFormat )
     }
 }
 
+int getTurboJpegSubsamp( const ChromaSubsampling subsampling )
+{
+    switch( subsampling )
+    {
+        case SUBSAMPLING_444:
+            return TJSAMP_444;
+        case SUBSAMPLING_422:
+            return TJSAMP_422;
+        case SUBSAMPLING_420:
+            return TJSAMP_420;
+        default:
+            std::cerr << "unknown chroma subsampling" << std::endl;
+            return TJSAMP_444;
+    }
+}
+
 QByteArray ImageJpegCompressor::computeJpeg( const ImageWrapper& sourceImage,
                                              const QRect& imageRegion )
 {
@@ -96,7 +112,7 @@ QByteArray ImageJpegCompressor::computeJpeg( const ImageWrapper& sourceImage,
     const int tjPixelFormat = getTurboJpegFormat( sourceImage.pixelFormat );
     unsigned char* tjJpegBuf = 0;
     unsigned long tjJpegSize = 0;
-    const int tjJpegSubsamp = TJSAMP_444;
+    const int tjJpegSubsamp = getTurboJpegSubsamp( sourceImage.subsampling );
     const int tjJpegQual = sourceImage.compressionQuality;
     const int tjFlags = 0; // or: TJFLAG_BOTTOMUP
 
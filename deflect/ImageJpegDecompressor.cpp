@@ -44,6 +44,29 @@
 namespace deflect
 {
 
+namespace
+{
+SegmentFormat getSegmentFormat( const int tjSubsamp )
+{
+    switch( tjSubsamp )
+    {
+    case TJSAMP_444:
+        return SEGMENT_FORMAT_YUV444;
+    case TJSAMP_422:
+        return SEGMENT_FORMAT_YUV422;
+    case TJSAMP_420:
+        return SEGMENT_FORMAT_YUV420;
+    case TJSAMP_440:
+        return SEGMENT_FORMAT_YUV440;
+    case TJSAMP_411:
+        return SEGMENT_FORMAT_YUV411;
+    case TJSAMP_GRAY:
+    default:
+        return SEGMENT_FORMAT_GRAY;
+    }
+}
+}
+
 ImageJpegDecompressor::ImageJpegDecompressor()
     : _tjHandle( tjInitDecompress( ))
 {
@@ -55,6 +78,21 @@ ImageJpegDecompressor::~ImageJpegDecompressor()
 }
 
 QByteArray ImageJpegDecompressor::decompress( const QByteArray& jpegData )
+{
+    const QSize size = decompressHeader( jpegData );
+    if( size.isEmpty( ))
+        return QByteArray();
+
+    const int pitch = size.width() * tjPixelSize[TJPF_RGBX];
+    QByteArray decodedData( size.height() * pitch, Qt::Uninitialized );
+
+    if( !decompress( jpegData, decodedData.data(), pitch ))
+        return QByteArray();
+
+    return decodedData;
+}
+
+QSize ImageJpegDecompressor::decompressHeader( const QByteArray& jpegData )
 {
     // get information from header
     int width, height, jpegSubsamp;
@@ -64,26 +102,108 @@ QByteArray ImageJpegDecompressor::decompress( const QByteArray& jpegData )
     if( err != 0 )
     {
         std::cerr << "libjpeg-turbo header decompression failure" << std::endl;
-        return QByteArray();
+        return QSize();
+    }
+    return QSize( width, height );
+}
+
+bool ImageJpegDecompressor::decompress( const QByteArray& jpegData,
+                                        char* buffer, const int pitch,
+                                        const unsigned int downscale )
+{
+    // width and height of 0 decompress the image at its full size
+    int width = 0, height = 0;
+    if( downscale > 1 )
+    {
+        if( !isDownscaleSupported( downscale ))
+        {
+            std::cerr << "libjpeg-turbo does not support downscaling by "
+                      << downscale << std::endl;
+            return false;
+        }
+
+        const QSize size = decompressHeader( jpegData );
+        if( size.isEmpty( ))
+            return false;
+
+        const tjscalingfactor factor = { 1, (int)downscale };
+        width = TJSCALED( size.width(), factor );
+        height = TJSCALED( size.height(), factor );
     }
 
     // decompress image data
     int pixelFormat = TJPF_RGBX; // Format for OpenGL texture (GL_RGBA)
-    int pitch = width * tjPixelSize[pixelFormat];
     int flags = TJ_FASTUPSAMPLE;
-    QByteArray decodedData( height * pitch, Qt::Uninitialized );
 
-    err = tjDecompress2( _tjHandle, (unsigned char*)jpegData.data(),
-                         (unsigned long)jpegData.size(),
-                         (unsigned char*)decodedData.data(),
-                         width, pitch, height, pixelFormat, flags );
+    int err = tjDecompress2( _tjHandle, (unsigned char*)jpegData.data(),
+                             (unsigned long)jpegData.size(),
+                             (unsigned char*)buffer, width, pitch, height,
+                             pixelFormat, flags );
     if( err != 0 )
     {
         std::cerr << "libjpeg-turbo image decompression failure" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+QByteArray ImageJpegDecompressor::decompressToYUV( const QByteArray& jpegData,
+                                                   SegmentFormat& format,
+                                                   const unsigned int downscale )
+{
+    if( !isDownscaleSupported( downscale ))
+    {
+        std::cerr << "libjpeg-turbo does not support downscaling by "
+                  << downscale << std::endl;
+        return QByteArray();
+    }
+
+    // get information from header
+    int width, height, jpegSubsamp;
+    int err = tjDecompressHeader2( _tjHandle, (unsigned char*)jpegData.data(),
+                                   (unsigned long)jpegData.size(), &width,
+                                   &height, &jpegSubsamp );
+    if( err != 0 )
+    {
+        std::cerr << "libjpeg-turbo header decompression failure" << std::endl;
         return QByteArray();
     }
 
+    const tjscalingfactor factor = { 1, (int)downscale };
+    width = TJSCALED( width, factor );
+    height = TJSCALED( height, factor );
+
+    // decompress image data to unpadded planes (pad of 1)
+    const int pad = 1;
+    const int flags = 0;
+    QByteArray decodedData( (int)tjBufSizeYUV2( width, pad, height,
+                                                jpegSubsamp ),
+                            Qt::Uninitialized );
+
+    err = tjDecompressToYUV2( _tjHandle, (unsigned char*)jpegData.data(),
+                              (unsigned long)jpegData.size(),
+                              (unsigned char*)decodedData.data(),
+                              width, pad, height, flags );
+    if( err != 0 )
+    {
+        std::cerr << "libjpeg-turbo YUV decompression failure" << std::endl;
+        return QByteArray();
+    }
+
+    format = getSegmentFormat( jpegSubsamp );
     return decodedData;
 }
 
+bool ImageJpegDecompressor::isDownscaleSupported( const unsigned int downscale )
+{
+    int count = 0;
+    const tjscalingfactor* factors = tjGetScalingFactors( &count );
+    for( int i = 0; i < count; ++i )
+    {
+        if( factors[i].num == 1 && factors[i].denom == (int)downscale )
+            return true;
+    }
+    return false;
+}
+
 }
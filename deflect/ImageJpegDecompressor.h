@@ -41,10 +41,12 @@
 #define DEFLECT_IMAGEJPEGDECOMPRESSOR_H
 
 #include <deflect/api.h>
+#include <deflect/Segment.h> // SegmentFormat
 
 #include <turbojpeg.h>
 
 #include <QByteArray>
+#include <QSize>
 
 namespace deflect
 {
@@ -67,6 +69,56 @@ public:
      */
     DEFLECT_API QByteArray decompress( const QByteArray& jpegData );
 
+    /**
+     * Read the dimensions of a Jpeg image.
+     *
+     * @param jpegData The compressed Jpeg data
+     * @return The dimensions of the image, or an empty size if the header
+     *         could not be decoded.
+     */
+    DEFLECT_API QSize decompressHeader( const QByteArray& jpegData );
+
+    /**
+     * Decompress a Jpeg image into an existing buffer.
+     *
+     * The image can be scaled down during decompression by libjpeg-turbo,
+     * which skips most of the IDCT work for the discarded resolution.
+     *
+     * @param jpegData The compressed Jpeg data
+     * @param buffer The destination for the image data in (GL_)RGBA format.
+     *        It must hold decompressHeader().height() / downscale rows
+     *        (rounded up) of pitch bytes.
+     * @param pitch The number of bytes between two rows of the buffer
+     * @param downscale The reduction factor of the image dimensions
+     * @return true if the image could be decoded, false otherwise.
+     * @see isDownscaleSupported()
+     */
+    DEFLECT_API bool decompress( const QByteArray& jpegData, char* buffer,
+                                 int pitch, unsigned int downscale = 1 );
+
+    /**
+     * Decompress a Jpeg image to planar YUV.
+     *
+     * This skips the color conversion and the upsampling of the chrominance,
+     * which are left to the consumer of the image (e.g. in a shader).
+     *
+     * @param jpegData The compressed Jpeg data
+     * @param format Output: the YUV layout of the returned planes
+     * @param downscale The reduction factor of the image dimensions
+     * @return The image planes, or an empty array if the image could not be
+     *         decoded.
+     * @see SegmentFormat
+     */
+    DEFLECT_API QByteArray decompressToYUV( const QByteArray& jpegData,
+                                            SegmentFormat& format,
+                                            unsigned int downscale = 1 );
+
+    /**
+     * @param downscale A reduction factor of the image dimensions
+     * @return true if libjpeg-turbo can decompress at 1/downscale resolution.
+     */
+    DEFLECT_API static bool isDownscaleSupported( unsigned int downscale );
+
 private:
     /** libjpeg-turbo handle for decompression */
     tjhandle _tjHandle;
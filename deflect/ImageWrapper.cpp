@@ -58,6 +58,7 @@ ImageWrapper::ImageWrapper( const void* data_, const unsigned int width_,
     , y( y_ )
     , compressionPolicy( COMPRESSION_AUTO )
     , compressionQuality( DEFAULT_COMPRESSION_QUALITY )
+    , subsampling( SUBSAMPLING_444 )
 {}
 
 unsigned int ImageWrapper::getBytesPerPixel() const
@@ -59,6 +59,13 @@ enum CompressionPolicy {
     COMPRESSION_OFF    /**< Force disable */
 };
 
+/** Chroma subsampling of compressed images. @version 1.3 */
+enum ChromaSubsampling {
+    SUBSAMPLING_444,   /**< Full resolution chroma */
+    SUBSAMPLING_422,   /**< Chroma of half the width */
+    SUBSAMPLING_420    /**< Chroma of half the width and height */
+};
+
 /**
  * A simple wrapper around an image data buffer.
  *
@@ -118,6 +125,8 @@ struct ImageWrapper
     unsigned int compressionQuality;      /**< Compression quality (0 worst,
                                                100 best, default: 75).
                                                @version 1.0 */
+    ChromaSubsampling subsampling;        /**< Chroma subsampling (default:
+                                               444). @version 1.3 */
     //@}
 
     /**
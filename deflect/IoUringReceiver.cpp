@@ -0,0 +1,777 @@
+/*********************************************************************/
+/* Copyright (c) 2015, EPFL/Blue Brain Project                       */
+/*                     Raphael Dumusc <raphael.dumusc@epfl.ch>       */
+/* All rights reserved.                                              */
+/*                                                                   */
+/* Redistribution and use in source and binary forms, with or        */
+/* without modification, are permitted provided that the following   */
+/* conditions are met:                                               */
+/*                                                                   */
+/*   1. Redistributions of source code must retain the above         */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer.                                                  */
+/*                                                                   */
+/*   2. Redistributions in binary form must reproduce the above      */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer in the documentation and/or other materials       */
+/*      provided with the distribution.                              */
+/*                                                                   */
+/*    THIS  SOFTWARE IS PROVIDED  BY THE  UNIVERSITY OF  TEXAS AT    */
+/*    AUSTIN  ``AS IS''  AND ANY  EXPRESS OR  IMPLIED WARRANTIES,    */
+/*    INCLUDING, BUT  NOT LIMITED  TO, THE IMPLIED  WARRANTIES OF    */
+/*    MERCHANTABILITY  AND FITNESS FOR  A PARTICULAR  PURPOSE ARE    */
+/*    DISCLAIMED.  IN  NO EVENT SHALL THE UNIVERSITY  OF TEXAS AT    */
+/*    AUSTIN OR CONTRIBUTORS BE  LIABLE FOR ANY DIRECT, INDIRECT,    */
+/*    INCIDENTAL,  SPECIAL, EXEMPLARY,  OR  CONSEQUENTIAL DAMAGES    */
+/*    (INCLUDING, BUT  NOT LIMITED TO,  PROCUREMENT OF SUBSTITUTE    */
+/*    GOODS  OR  SERVICES; LOSS  OF  USE,  DATA,  OR PROFITS;  OR    */
+/*    BUSINESS INTERRUPTION) HOWEVER CAUSED  AND ON ANY THEORY OF    */
+/*    LIABILITY, WHETHER  IN CONTRACT, STRICT  LIABILITY, OR TORT    */
+/*    (INCLUDING NEGLIGENCE OR OTHERWISE)  ARISING IN ANY WAY OUT    */
+/*    OF  THE  USE OF  THIS  SOFTWARE,  EVEN  IF ADVISED  OF  THE    */
+/*    POSSIBILITY OF SUCH DAMAGE.                                    */
+/*                                                                   */
+/* The views and conclusions contained in the software and           */
+/* documentation are those of the authors and should not be          */
+/* interpreted as representing official policies, either expressed   */
+/* or implied, of The University of Texas at Austin.                 */
+/*********************************************************************/
+
+#include "IoUringReceiver.h"
+
+#include "MessageHeader.h"
+#include "MPSCQueue.h"
+#include "ServerWorker.h"
+
+#include <QDataStream>
+#include <QIODevice>
+#include <QThread>
+
+#include <liburing.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <functional>
+#include <iostream>
+#include <limits>
+#include <map>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+namespace deflect
+{
+
+namespace
+{
+/** Size of the registered buffer of each connection. */
+const size_t bufferSize = 64 * 1024;
+
+/** A socket which is closed once the receiver and its worker are done. */
+class SocketHandle
+{
+public:
+    explicit SocketHandle( const int fd_ ) : fd( fd_ ) {}
+    ~SocketHandle() { ::close( fd ); }
+
+    const int fd;
+};
+typedef std::shared_ptr< SocketHandle > SocketHandlePtr;
+
+/** Tag of the user data of send requests; Connections and Outboxes are
+ *  aligned, so the lowest bit of their address is free. */
+const uintptr_t sendTag = 1;
+
+/** The replies of a ServerWorker waiting to be sent on its socket. */
+struct Outbox
+{
+    explicit Outbox( SocketHandlePtr socket_ )
+        : socket( socket_ )
+        , posted( false )
+        , closing( false )
+        , broken( false )
+        , sending( false )
+        , sent( 0 )
+    {}
+
+    SocketHandlePtr socket;
+
+    /** Shared by the thread of the worker and the receiving thread. */
+    std::mutex mutex;
+    std::deque< QByteArray > queue;
+    bool posted;  //!< Waiting to be processed by the receiving thread
+    bool closing; //!< Shut the socket down once the queue is sent
+    bool broken;  //!< A send failed, further writes are rejected
+
+    /** Only accessed by the receiving thread. */
+    bool sending;
+    size_t sent; //!< Bytes of the first buffer of the queue already sent
+};
+typedef std::shared_ptr< Outbox > OutboxPtr;
+
+/**
+ * Write the replies of a ServerWorker to a socket read by the receiver.
+ *
+ * The data is only queued, the receiving thread sends it with io_uring so
+ * that a slow client never blocks the thread shared by all the workers.
+ */
+class SocketDevice : public QIODevice
+{
+public:
+    typedef std::function< void( const OutboxPtr& ) > PostFunc;
+
+    SocketDevice( OutboxPtr outbox, const PostFunc& post )
+        : _outbox( outbox )
+        , _post( post )
+    {
+        open( QIODevice::ReadWrite | QIODevice::Unbuffered );
+    }
+
+    ~SocketDevice()
+    {
+        close();
+    }
+
+    bool isSequential() const final { return true; }
+
+    void close() final
+    {
+        if( !isOpen( ))
+            return;
+
+        // The queued replies are sent before the socket is shut down, which
+        // completes the pending read, upon which the receiver releases the
+        // connection
+        bool post = false;
+        {
+            std::lock_guard< std::mutex > lock( _outbox->mutex );
+            _outbox->closing = true;
+            post = !_outbox->posted;
+            _outbox->posted = true;
+        }
+        if( post )
+            _post( _outbox );
+        QIODevice::close();
+    }
+
+protected:
+    qint64 readData( char*, qint64 ) final
+    {
+        // Only the receiver reads from the socket
+        return -1;
+    }
+
+    qint64 writeData( const char* data, const qint64 size ) final
+    {
+        if( size <= 0 )
+            return 0;
+
+        bool post = false;
+        {
+            std::lock_guard< std::mutex > lock( _outbox->mutex );
+            if( _outbox->broken || _outbox->closing )
+            {
+                setErrorString( "connection closed" );
+                return -1;
+            }
+            _outbox->queue.emplace_back( data, int( size ));
+            post = !_outbox->posted;
+            _outbox->posted = true;
+        }
+        if( post )
+            _post( _outbox );
+        return size;
+    }
+
+private:
+    OutboxPtr _outbox;
+    PostFunc _post;
+};
+
+/** A message received on a connection, or its closing if 'closed'. */
+struct Message
+{
+    Message() : connection( 0 ), compact( false ), closed( false ) {}
+
+    uint64_t connection;
+    bool compact;
+    MessageHeader header;
+    CompactMessageHeader compactHeader;
+    QByteArray body;
+    bool closed;
+};
+
+/** The state of a connection, only accessed by the receiving thread. */
+struct Connection
+{
+    Connection()
+        : id( 0 )
+        , buffer( nullptr )
+        , buffered( 0 )
+        , hasHeader( false )
+        , compact( false )
+        , bodySize( 0 )
+        , bodyReceived( 0 )
+        , readingBody( false )
+    {}
+
+    uint64_t id;
+    SocketHandlePtr socket;
+
+    /** Registered buffer, starting with the bytes not parsed yet. */
+    char* buffer;
+    size_t buffered;
+
+    /** The message being received. */
+    bool hasHeader;
+    bool compact;
+    MessageHeader header;
+    CompactMessageHeader compactHeader;
+    QByteArray body;
+    size_t bodySize;
+    size_t bodyReceived;
+
+    /** True if the pending read targets the body instead of the buffer. */
+    bool readingBody;
+};
+}
+
+class IoUringReceiver::Impl
+{
+public:
+    Impl( IoUringReceiver& receiver_, const size_t maxConnections )
+        : receiver( receiver_ )
+        , buffers( new char[maxConnections * bufferSize] )
+        , connections( maxConnections )
+        , fixedBuffers( false )
+        , wakeUpFd( ::eventfd( 0, 0 ))
+        , wakeUpValue( 0 )
+        , stopping( false )
+        , activeConnections( 0 )
+        , lastConnectionId( 0 )
+        , dispatchScheduled( false )
+    {
+        if( wakeUpFd < 0 )
+            throw std::runtime_error( "could not create eventfd" );
+
+        // One read and one send in flight per connection plus the wake up read
+        const int result = io_uring_queue_init( 2 * maxConnections + 1, &ring,
+                                                0 );
+        if( result < 0 )
+        {
+            ::close( wakeUpFd );
+            throw std::runtime_error( std::string( "io_uring not available: " )
+                                      + std::strerror( -result ));
+        }
+
+        std::vector< iovec > iovecs( maxConnections );
+        for( size_t i = 0; i < maxConnections; ++i )
+        {
+            connections[i].buffer = buffers.get() + i * bufferSize;
+            iovecs[i].iov_base = connections[i].buffer;
+            iovecs[i].iov_len = bufferSize;
+            freeSlots.push_back( maxConnections - 1 - i );
+        }
+        // May fail if the buffers exceed RLIMIT_MEMLOCK on older kernels; the
+        // regular read operations are used then.
+        fixedBuffers = io_uring_register_buffers( &ring, iovecs.data(),
+                                                  iovecs.size( )) == 0;
+
+        workerThread.start();
+        context.moveToThread( &workerThread );
+        QObject::connect( &receiver, &IoUringReceiver::_messagesReceived,
+                          &context, [this] { dispatchMessages(); },
+                          Qt::QueuedConnection );
+
+        thread = std::thread( [this] { run(); } );
+    }
+
+    ~Impl()
+    {
+        stopping = true;
+        wakeUp();
+        thread.join();
+
+        workerThread.quit();
+        workerThread.wait();
+
+        // Delete the workers of the remaining connections from this thread,
+        // which sends them a quit message
+        std::map< uint64_t, ServerWorker* > remaining;
+        {
+            std::lock_guard< std::mutex > lock( workersMutex );
+            remaining.swap( workers );
+        }
+        for( auto& worker : remaining )
+            delete worker.second;
+
+        io_uring_queue_exit( &ring );
+        ::close( wakeUpFd );
+    }
+
+    void wakeUp()
+    {
+        const uint64_t value = 1;
+        if( ::write( wakeUpFd, &value, sizeof( value )) < 0 )
+            std::perror( "IoUringReceiver could not wake up" );
+    }
+
+    ServerWorker* addConnection( const int fd )
+    {
+        if( ++activeConnections > connections.size( ))
+        {
+            --activeConnections;
+            return nullptr;
+        }
+
+        // Reads and sends are submitted to io_uring, which waits for blocking
+        // sockets to be ready without returning EAGAIN
+        const int flags = ::fcntl( fd, F_GETFL );
+        ::fcntl( fd, F_SETFL, flags & ~O_NONBLOCK );
+
+        SocketHandlePtr socket( new SocketHandle( fd ));
+        const uint64_t id = ++lastConnectionId;
+
+        OutboxPtr outbox( new Outbox( socket ));
+        SocketDevice* device = new SocketDevice( outbox,
+                                                 [this]( const OutboxPtr& box )
+        {
+            std::lock_guard< std::mutex > lock( pendingMutex );
+            pendingWrites.push_back( box );
+            wakeUp();
+        });
+        ServerWorker* worker = new ServerWorker( fd, device );
+        worker->moveToThread( &workerThread );
+        QObject::connect( worker, &ServerWorker::connectionClosed,
+                          worker, &ServerWorker::deleteLater );
+        QObject::connect( worker, &QObject::destroyed, [this, id]
+        {
+            std::lock_guard< std::mutex > lock( workersMutex );
+            workers.erase( id );
+        });
+        {
+            std::lock_guard< std::mutex > lock( workersMutex );
+            workers[id] = worker;
+        }
+        {
+            std::lock_guard< std::mutex > lock( pendingMutex );
+            pendingConnections.push_back( std::make_pair( id, socket ));
+        }
+        wakeUp();
+        return worker;
+    }
+
+    /** The loop of the receiving thread. */
+    void run()
+    {
+        submitWakeUpRead();
+        while( true )
+        {
+            const int result = io_uring_submit_and_wait( &ring, 1 );
+            if( result < 0 && result != -EINTR )
+            {
+                std::cerr << "IoUringReceiver: " << std::strerror( -result )
+                          << std::endl;
+                return;
+            }
+
+            bool received = false;
+            io_uring_cqe* cqe = nullptr;
+            while( io_uring_peek_cqe( &ring, &cqe ) == 0 )
+            {
+                const uintptr_t data =
+                        uintptr_t( io_uring_cqe_get_data( cqe ));
+                const int count = cqe->res;
+                io_uring_cqe_seen( &ring, cqe );
+
+                if( data & sendTag )
+                {
+                    processSend( (Outbox*)( data & ~sendTag ), count );
+                    continue;
+                }
+                if( data )
+                {
+                    received |= processRead( *(Connection*)data, count );
+                    continue;
+                }
+                if( stopping )
+                    return;
+                startPendingConnections();
+                startPendingWrites();
+                submitWakeUpRead();
+            }
+
+            // Only one notification for all the messages of this iteration
+            if( received &&
+                !dispatchScheduled.exchange( true, std::memory_order_acq_rel ))
+            {
+                emit receiver._messagesReceived();
+            }
+        }
+    }
+
+    io_uring_sqe* getSqe()
+    {
+        io_uring_sqe* sqe = io_uring_get_sqe( &ring );
+        while( !sqe )
+        {
+            io_uring_submit( &ring );
+            sqe = io_uring_get_sqe( &ring );
+        }
+        return sqe;
+    }
+
+    void submitWakeUpRead()
+    {
+        io_uring_sqe* sqe = getSqe();
+        io_uring_prep_read( sqe, wakeUpFd, &wakeUpValue, sizeof( wakeUpValue ),
+                            0 );
+        io_uring_sqe_set_data( sqe, nullptr );
+    }
+
+    void startPendingConnections()
+    {
+        std::vector< std::pair< uint64_t, SocketHandlePtr >> pending;
+        {
+            std::lock_guard< std::mutex > lock( pendingMutex );
+            pending.swap( pendingConnections );
+        }
+        for( auto& newConnection : pending )
+        {
+            Connection& connection = connections[freeSlots.back()];
+            freeSlots.pop_back();
+            connection.id = newConnection.first;
+            connection.socket = newConnection.second;
+            submitRead( connection );
+        }
+    }
+
+    void submitRead( Connection& connection )
+    {
+        io_uring_sqe* sqe = getSqe();
+        const int fd = connection.socket->fd;
+        const size_t missing = connection.bodySize - connection.bodyReceived;
+
+        connection.readingBody = connection.hasHeader && missing >= bufferSize;
+        if( connection.readingBody )
+        {
+            io_uring_prep_read( sqe, fd,
+                                connection.body.data() + connection.bodyReceived,
+                                missing, 0 );
+        }
+        else
+        {
+            char* buffer = connection.buffer + connection.buffered;
+            const size_t available = bufferSize - connection.buffered;
+            if( fixedBuffers )
+                io_uring_prep_read_fixed( sqe, fd, buffer, available, 0,
+                                          &connection - connections.data( ));
+            else
+                io_uring_prep_read( sqe, fd, buffer, available, 0 );
+        }
+        io_uring_sqe_set_data( sqe, &connection );
+    }
+
+    void startPendingWrites()
+    {
+        std::vector< OutboxPtr > pending;
+        {
+            std::lock_guard< std::mutex > lock( pendingMutex );
+            pending.swap( pendingWrites );
+        }
+        for( OutboxPtr& outbox : pending )
+        {
+            {
+                std::lock_guard< std::mutex > lock( outbox->mutex );
+                outbox->posted = false;
+            }
+            // Otherwise the new data is sent once the current send completes
+            if( !outbox->sending )
+                submitSend( outbox );
+        }
+    }
+
+    /** Send the remainder of the first queued buffer of an outbox. */
+    void submitSend( const OutboxPtr outbox )
+    {
+        const QByteArray* buffer = nullptr;
+        bool closing = false;
+        {
+            std::lock_guard< std::mutex > lock( outbox->mutex );
+            if( outbox->queue.empty( ))
+                closing = outbox->closing;
+            else
+                buffer = &outbox->queue.front();
+        }
+
+        const int fd = outbox->socket->fd;
+        if( !buffer )
+        {
+            outbox->sending = false;
+            sendingOutboxes.erase( outbox.get( ));
+            if( closing )
+                ::shutdown( fd, SHUT_RDWR );
+            return;
+        }
+
+        // Keep the outbox alive until the completion of the send
+        outbox->sending = true;
+        sendingOutboxes[outbox.get()] = outbox;
+
+        io_uring_sqe* sqe = getSqe();
+        io_uring_prep_send( sqe, fd, buffer->constData() + outbox->sent,
+                            buffer->size() - outbox->sent, MSG_NOSIGNAL );
+        io_uring_sqe_set_data( sqe, (void*)( uintptr_t( outbox.get( )) |
+                                             sendTag ));
+    }
+
+    /** Process the completion of a send. */
+    void processSend( Outbox* sentOutbox, const int count )
+    {
+        const auto it = sendingOutboxes.find( sentOutbox );
+        if( it == sendingOutboxes.end( ))
+            return;
+        const OutboxPtr outbox = it->second;
+
+        if( count == -EINTR || count == -EAGAIN )
+        {
+            submitSend( outbox );
+            return;
+        }
+
+        {
+            std::lock_guard< std::mutex > lock( outbox->mutex );
+            if( count < 0 )
+            {
+                // The read of the broken connection fails too and closes it
+                outbox->broken = true;
+                outbox->queue.clear();
+                outbox->sent = 0;
+            }
+            else
+            {
+                outbox->sent += count;
+                if( outbox->sent == size_t( outbox->queue.front().size( )))
+                {
+                    outbox->queue.pop_front();
+                    outbox->sent = 0;
+                }
+            }
+        }
+        submitSend( outbox );
+    }
+
+    /**
+     * Process the completion of a read.
+     * @return true if messages were queued for the workers.
+     */
+    bool processRead( Connection& connection, const int count )
+    {
+        if( count == -EINTR || count == -EAGAIN )
+        {
+            submitRead( connection );
+            return false;
+        }
+        if( count <= 0 )
+        {
+            closeConnection( connection );
+            return true;
+        }
+
+        bool received = false;
+        if( connection.readingBody )
+        {
+            connection.bodyReceived += count;
+            received = finishMessage( connection );
+        }
+        else
+        {
+            connection.buffered += count;
+            if( !parseBuffer( connection, received ))
+            {
+                closeConnection( connection );
+                return true;
+            }
+        }
+        submitRead( connection );
+        return received;
+    }
+
+    /**
+     * Extract the messages from the buffer of a connection.
+     * @return false if the connection sent an invalid message.
+     */
+    bool parseBuffer( Connection& connection, bool& received )
+    {
+        size_t offset = 0;
+        while( offset < connection.buffered )
+        {
+            if( !connection.hasHeader )
+            {
+                const char* data = connection.buffer + offset;
+                const bool compact = CompactMessageHeader::isCompact( *data );
+                const size_t headerSize =
+                        compact ? CompactMessageHeader::serializedSize
+                                : MessageHeader::serializedSize;
+                if( connection.buffered - offset < headerSize )
+                    break;
+
+                if( compact )
+                {
+                    connection.compactHeader.deserialize( data );
+                    connection.bodySize = connection.compactHeader.size;
+                }
+                else
+                {
+                    QDataStream stream( QByteArray::fromRawData( data,
+                                                                 headerSize ));
+                    stream >> connection.header;
+                    connection.bodySize = connection.header.size;
+                }
+                offset += headerSize;
+
+                if( connection.bodySize >
+                        size_t( std::numeric_limits< int >::max( )))
+                {
+                    std::cerr << "Warning: closing connection sending a "
+                              << "message of invalid size" << std::endl;
+                    return false;
+                }
+                connection.hasHeader = true;
+                connection.compact = compact;
+                connection.body.resize( connection.bodySize );
+                connection.bodyReceived = 0;
+            }
+
+            const size_t count =
+                    std::min( connection.bodySize - connection.bodyReceived,
+                              connection.buffered - offset );
+            std::memcpy( connection.body.data() + connection.bodyReceived,
+                         connection.buffer + offset, count );
+            connection.bodyReceived += count;
+            offset += count;
+
+            received |= finishMessage( connection );
+        }
+
+        // Keep the beginning of an incomplete header for the next read
+        connection.buffered -= offset;
+        std::memmove( connection.buffer, connection.buffer + offset,
+                      connection.buffered );
+        return true;
+    }
+
+    /** Queue the message of a connection if complete. */
+    bool finishMessage( Connection& connection )
+    {
+        if( connection.bodyReceived < connection.bodySize )
+            return false;
+
+        Message message;
+        message.connection = connection.id;
+        message.compact = connection.compact;
+        message.header = connection.header;
+        message.compactHeader = connection.compactHeader;
+        message.body = connection.body;
+        messages.enqueue( message );
+
+        connection.hasHeader = false;
+        connection.body = QByteArray();
+        connection.bodySize = 0;
+        connection.bodyReceived = 0;
+        return true;
+    }
+
+    void closeConnection( Connection& connection )
+    {
+        Message message;
+        message.connection = connection.id;
+        message.closed = true;
+        messages.enqueue( message );
+
+        freeSlots.push_back( &connection - connections.data( ));
+        connection = Connection();
+        connection.buffer = buffers.get() + freeSlots.back() * bufferSize;
+        --activeConnections;
+    }
+
+    /** Pass the received messages to the workers, in their thread. */
+    void dispatchMessages()
+    {
+        dispatchScheduled.exchange( false, std::memory_order_acq_rel );
+
+        Message message;
+        while( messages.dequeue( message ))
+        {
+            ServerWorker* worker = nullptr;
+            {
+                std::lock_guard< std::mutex > lock( workersMutex );
+                auto it = workers.find( message.connection );
+                if( it != workers.end( ))
+                    worker = it->second;
+            }
+            if( !worker )
+                continue;
+
+            if( message.closed )
+                worker->processDisconnection();
+            else if( message.compact )
+                worker->processMessage( message.compactHeader, message.body );
+            else
+                worker->processMessage( message.header, message.body );
+        }
+    }
+
+    IoUringReceiver& receiver;
+
+    io_uring ring;
+    std::unique_ptr< char[] > buffers;
+    std::vector< Connection > connections;
+    std::vector< size_t > freeSlots;
+    bool fixedBuffers;
+
+    int wakeUpFd;
+    uint64_t wakeUpValue;
+    std::atomic< bool > stopping;
+    std::thread thread;
+
+    std::mutex pendingMutex;
+    std::vector< std::pair< uint64_t, SocketHandlePtr >> pendingConnections;
+    std::vector< OutboxPtr > pendingWrites;
+    std::map< Outbox*, OutboxPtr > sendingOutboxes;
+    std::atomic< size_t > activeConnections;
+    uint64_t lastConnectionId;
+
+    MPSCQueue< Message > messages;
+    std::atomic< bool > dispatchScheduled;
+
+    QThread workerThread;
+    QObject context;
+    std::mutex workersMutex;
+    std::map< uint64_t, ServerWorker* > workers;
+};
+
+IoUringReceiver::IoUringReceiver( const size_t maxConnections )
+    : _impl( new Impl( *this, maxConnections ))
+{}
+
+IoUringReceiver::~IoUringReceiver()
+{}
+
+ServerWorker* IoUringReceiver::addConnection( const int socketDescriptor )
+{
+    return _impl->addConnection( socketDescriptor );
+}
+
+}
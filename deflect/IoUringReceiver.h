@@ -0,0 +1,105 @@
+/*********************************************************************/
+/* Copyright (c) 2015, EPFL/Blue Brain Project                       */
+/*                     Raphael Dumusc <raphael.dumusc@epfl.ch>       */
+/* All rights reserved.                                              */
+/*                                                                   */
+/* Redistribution and use in source and binary forms, with or        */
+/* without modification, are permitted provided that the following   */
+/* conditions are met:                                               */
+/*                                                                   */
+/*   1. Redistributions of source code must retain the above         */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer.                                                  */
+/*                                                                   */
+/*   2. Redistributions in binary form must reproduce the above      */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer in the documentation and/or other materials       */
+/*      provided with the distribution.                              */
+/*                                                                   */
+/*    THIS  SOFTWARE IS PROVIDED  BY THE  UNIVERSITY OF  TEXAS AT    */
+/*    AUSTIN  ``AS IS''  AND ANY  EXPRESS OR  IMPLIED WARRANTIES,    */
+/*    INCLUDING, BUT  NOT LIMITED  TO, THE IMPLIED  WARRANTIES OF    */
+/*    MERCHANTABILITY  AND FITNESS FOR  A PARTICULAR  PURPOSE ARE    */
+/*    DISCLAIMED.  IN  NO EVENT SHALL THE UNIVERSITY  OF TEXAS AT    */
+/*    AUSTIN OR CONTRIBUTORS BE  LIABLE FOR ANY DIRECT, INDIRECT,    */
+/*    INCIDENTAL,  SPECIAL, EXEMPLARY,  OR  CONSEQUENTIAL DAMAGES    */
+/*    (INCLUDING, BUT  NOT LIMITED TO,  PROCUREMENT OF SUBSTITUTE    */
+/*    GOODS  OR  SERVICES; LOSS  OF  USE,  DATA,  OR PROFITS;  OR    */
+/*    BUSINESS INTERRUPTION) HOWEVER CAUSED  AND ON ANY THEORY OF    */
+/*    LIABILITY, WHETHER  IN CONTRACT, STRICT  LIABILITY, OR TORT    */
+/*    (INCLUDING NEGLIGENCE OR OTHERWISE)  ARISING IN ANY WAY OUT    */
+/*    OF  THE  USE OF  THIS  SOFTWARE,  EVEN  IF ADVISED  OF  THE    */
+/*    POSSIBILITY OF SUCH DAMAGE.                                    */
+/*                                                                   */
+/* The views and conclusions contained in the software and           */
+/* documentation are those of the authors and should not be          */
+/* interpreted as representing official policies, either expressed   */
+/* or implied, of The University of Texas at Austin.                 */
+/*********************************************************************/
+
+#ifndef DEFLECT_IOURINGRECEIVER_H
+#define DEFLECT_IOURINGRECEIVER_H
+
+#include <QObject>
+
+#include <memory>
+
+namespace deflect
+{
+
+class ServerWorker;
+
+/**
+ * Receive the messages of many Stream connections from a single thread,
+ * using the Linux io_uring interface.
+ *
+ * Instead of one thread and several read() calls per message for each
+ * connection, the receiver keeps one read request in flight per connection
+ * and processes the completions of all of them at once. Headers and small
+ * messages are read into a buffer registered with the kernel, large segment
+ * payloads directly into their final destination.
+ *
+ * The parsed messages are passed to one ServerWorker per connection, which
+ * emits the usual signals. All the workers share one thread. Their replies
+ * are queued and sent by the receiving thread with io_uring as well, so that
+ * a client which does not read them never blocks the other connections.
+ */
+class IoUringReceiver : public QObject
+{
+    Q_OBJECT
+
+public:
+    /**
+     * Create the receiver and start its threads.
+     * @param maxConnections The maximum number of simultaneous connections.
+     * @throw std::runtime_error if io_uring is not available.
+     */
+    explicit IoUringReceiver( size_t maxConnections = 256 );
+
+    /** Stop the threads and close all remaining connections. */
+    ~IoUringReceiver();
+
+    /**
+     * Receive the messages of a connected socket.
+     *
+     * The caller must connect the signals of the worker, then invoke its
+     * initConnection() slot.
+     * @param socketDescriptor The socket, owned by the receiver on success.
+     * @return the worker for the connection, which lives in the thread of
+     *         the receiver and deletes itself once the connection is closed,
+     *         or nullptr if the maximum number of connections is reached.
+     */
+    ServerWorker* addConnection( int socketDescriptor );
+
+signals:
+    /** @internal */
+    void _messagesReceived();
+
+private:
+    class Impl;
+    std::unique_ptr< Impl > _impl;
+};
+
+}
+
+#endif
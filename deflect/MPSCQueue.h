@@ -0,0 +1,147 @@
+/*********************************************************************/
+/* Copyright (c) 2015, EPFL/Blue Brain Project                       */
+/*                     Raphael Dumusc <raphael.dumusc@epfl.ch>       */
+/* All rights reserved.                                              */
+/*                                                                   */
+/* Redistribution and use in source and binary forms, with or        */
+/* without modification, are permitted provided that the following   */
+/* conditions are met:                                               */
+/*                                                                   */
+/*   1. Redistributions of source code must retain the above         */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer.                                                  */
+/*                                                                   */
+/*   2. Redistributions in binary form must reproduce the above      */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer in the documentation and/or other materials       */
+/*      provided with the distribution.                              */
+/*                                                                   */
+/*    THIS  SOFTWARE IS PROVIDED  BY THE  UNIVERSITY OF  TEXAS AT    */
+/*    AUSTIN  ``AS IS''  AND ANY  EXPRESS OR  IMPLIED WARRANTIES,    */
+/*    INCLUDING, BUT  NOT LIMITED  TO, THE IMPLIED  WARRANTIES OF    */
+/*    MERCHANTABILITY  AND FITNESS FOR  A PARTICULAR  PURPOSE ARE    */
+/*    DISCLAIMED.  IN  NO EVENT SHALL THE UNIVERSITY  OF TEXAS AT    */
+/*    AUSTIN OR CONTRIBUTORS BE  LIABLE FOR ANY DIRECT, INDIRECT,    */
+/*    INCIDENTAL,  SPECIAL, EXEMPLARY,  OR  CONSEQUENTIAL DAMAGES    */
+/*    (INCLUDING, BUT  NOT LIMITED TO,  PROCUREMENT OF SUBSTITUTE    */
+/*    GOODS  OR  SERVICES; LOSS  OF  USE,  DATA,  OR PROFITS;  OR    */
+/*    BUSINESS INTERRUPTION) HOWEVER CAUSED  AND ON ANY THEORY OF    */
+/*    LIABILITY, WHETHER  IN CONTRACT, STRICT  LIABILITY, OR TORT    */
+/*    (INCLUDING NEGLIGENCE OR OTHERWISE)  ARISING IN ANY WAY OUT    */
+/*    OF  THE  USE OF  THIS  SOFTWARE,  EVEN  IF ADVISED  OF  THE    */
+/*    POSSIBILITY OF SUCH DAMAGE.                                    */
+/*                                                                   */
+/* The views and conclusions contained in the software and           */
+/* documentation are those of the authors and should not be          */
+/* interpreted as representing official policies, either expressed   */
+/* or implied, of The University of Texas at Austin.                 */
+/*********************************************************************/
+
+#ifndef DEFLECT_MPSCQUEUE_H
+#define DEFLECT_MPSCQUEUE_H
+
+#include <atomic>
+#include <utility>
+
+namespace deflect
+{
+
+/**
+ * Lock-free, unbounded multiple producer, single consumer queue.
+ *
+ * enqueue() may be called concurrently from any number of threads, while
+ * dequeue() must only ever be called from one (consumer) thread at a time.
+ * Based on the intrusive node queue described by Dmitry Vyukov; producers
+ * never wait for each other nor for the consumer.
+ */
+template< class T >
+class MPSCQueue
+{
+public:
+    /** Construct an empty queue. */
+    MPSCQueue()
+        : _head( new Node )
+        , _tail( _head.load( ))
+    {}
+
+    /** Destruct the queue, discarding the remaining elements. */
+    ~MPSCQueue()
+    {
+        while( Node* node = _tail )
+        {
+            _tail = node->next.load( std::memory_order_relaxed );
+            delete node;
+        }
+    }
+
+    /** Push a new value to the end of the queue. Never blocks. */
+    void enqueue( const T& value )
+    {
+        Node* node = new Node( value );
+        Node* previous = _head.exchange( node, std::memory_order_acq_rel );
+        previous->next.store( node, std::memory_order_release );
+    }
+
+    /**
+     * Pop a value from the front of the queue. Never blocks.
+     *
+     * An element whose enqueue() is still in progress may not be visible yet.
+     * @param value the popped value, unmodified if the queue is empty.
+     * @return true if a value was popped, false if the queue is empty.
+     */
+    bool dequeue( T& value )
+    {
+        Node* tail = _tail;
+        Node* next = tail->next.load( std::memory_order_acquire );
+        if( !next )
+            return false;
+
+        value = std::move( next->value );
+        next->value = T();
+        _tail = next;
+        delete tail;
+        return true;
+    }
+
+    /**
+     * Pop the values enqueued before the call. Never blocks.
+     *
+     * The values enqueued concurrently are left for the next call, so that
+     * producers which keep enqueueing cannot hold the consumer here forever.
+     * @param func called with each popped value, in order
+     */
+    template< class Func >
+    void dequeueAvailable( const Func& func )
+    {
+        const Node* last = _head.load( std::memory_order_acquire );
+        T value;
+        while( _tail != last && dequeue( value ))
+            func( value );
+    }
+
+    /** @return true if the queue is empty. Only valid for the consumer. */
+    bool empty() const
+    {
+        return !_tail->next.load( std::memory_order_acquire );
+    }
+
+private:
+    MPSCQueue( const MPSCQueue& ) = delete;
+    MPSCQueue& operator=( const MPSCQueue& ) = delete;
+
+    struct Node
+    {
+        Node() : next( nullptr ) {}
+        explicit Node( const T& value_ ) : value( value_ ), next( nullptr ) {}
+
+        T value;
+        std::atomic< Node* > next;
+    };
+
+    std::atomic< Node* > _head;
+    Node* _tail;
+};
+
+}
+
+#endif
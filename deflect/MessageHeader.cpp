@@ -40,6 +40,9 @@
 #include "MessageHeader.h"
 
 #include <QDataStream>
+#include <QtEndian>
+
+#include <cstring>
 
 namespace deflect
 {
@@ -66,6 +69,55 @@ MessageHeader::MessageHeader( const MessageType type_, const uint32_t size_,
     uri[len] = '\0';
 }
 
+const uint8_t CompactMessageHeader::magicNumber;
+const size_t CompactMessageHeader::serializedSize;
+
+static_assert( sizeof( CompactMessageHeader ) ==
+               CompactMessageHeader::serializedSize,
+               "CompactMessageHeader must not be padded" );
+
+CompactMessageHeader::CompactMessageHeader()
+    : magic( magicNumber )
+    , type( MESSAGE_TYPE_NONE )
+    , reserved( 0 )
+    , streamId( 0 )
+    , size( 0 )
+{}
+
+CompactMessageHeader::CompactMessageHeader( const MessageType type_,
+                                            const uint32_t size_,
+                                            const uint32_t streamId_ )
+    : magic( magicNumber )
+    , type( type_ )
+    , reserved( 0 )
+    , streamId( streamId_ )
+    , size( size_ )
+{}
+
+MessageHeader CompactMessageHeader::toMessageHeader() const
+{
+    return MessageHeader( MessageType( type ), size );
+}
+
+void CompactMessageHeader::serialize( char* data ) const
+{
+    // The conversions are no-ops on little-endian hosts
+    CompactMessageHeader header( *this );
+    header.reserved = qToLittleEndian( reserved );
+    header.streamId = qToLittleEndian( streamId );
+    header.size = qToLittleEndian( size );
+    std::memcpy( data, &header, serializedSize );
+}
+
+bool CompactMessageHeader::deserialize( const char* data )
+{
+    std::memcpy( this, data, serializedSize );
+    reserved = qFromLittleEndian( reserved );
+    streamId = qFromLittleEndian( streamId );
+    size = qFromLittleEndian( size );
+    return magic == magicNumber;
+}
+
 }
 
 QDataStream& operator<<( QDataStream& out,
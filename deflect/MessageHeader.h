@@ -67,7 +67,14 @@ enum MessageType
     MESSAGE_TYPE_EVENT = 9,
     MESSAGE_TYPE_COMMAND = 11,
     MESSAGE_TYPE_QUIT = 12,
-    MESSAGE_TYPE_SIZE_HINTS = 13
+    MESSAGE_TYPE_SIZE_HINTS = 13,
+    MESSAGE_TYPE_BIND_FRAME_ACKS = 14,
+    MESSAGE_TYPE_BIND_FRAME_ACKS_REPLY = 15,
+    MESSAGE_TYPE_FRAME_ACK = 16,
+    MESSAGE_TYPE_BIND_SHARED_MEMORY = 17,
+    MESSAGE_TYPE_BIND_SHARED_MEMORY_REPLY = 18,
+    MESSAGE_TYPE_PIXELSTREAM_SHARED_MEMORY = 19,
+    MESSAGE_TYPE_PIXELSTREAM_OPEN_REPLY = 20
 };
 
 #define MESSAGE_HEADER_URI_LENGTH 64
@@ -98,6 +105,64 @@ struct MessageHeader
     static const size_t serializedSize;
 };
 
+/**
+ * Compact message header of protocol version 9.
+ *
+ * Once a stream is opened, its messages identify it by the numeric id
+ * assigned by the server instead of its uri. The little-endian layout is
+ * (de)serialized with a single memcpy. Its first byte is never 0, unlike the
+ * big-endian type which starts a serialized MessageHeader, so that both
+ * headers can be distinguished on the same connection.
+ */
+struct CompactMessageHeader
+{
+    /** Always magicNumber. */
+    uint8_t magic;
+
+    /** Message type. */
+    uint8_t type;
+
+    /** Unused, for alignment. */
+    uint16_t reserved;
+
+    /** Stream identifier assigned by the server. */
+    uint32_t streamId;
+
+    /** Size of the message payload. */
+    uint32_t size;
+
+    /** Construct a default message header */
+    DEFLECT_API CompactMessageHeader();
+
+    /** Construct a message header for a stream */
+    DEFLECT_API CompactMessageHeader( MessageType type, uint32_t size,
+                                      uint32_t streamId );
+
+    /** Convert to a MessageHeader, without uri. */
+    DEFLECT_API MessageHeader toMessageHeader() const;
+
+    /** Write the header to serializedSize bytes. */
+    DEFLECT_API void serialize( char* data ) const;
+
+    /**
+     * Read the header from serializedSize bytes.
+     * @return false if the data is not a compact header.
+     */
+    DEFLECT_API bool deserialize( const char* data );
+
+    /** @return true if a header starting with this byte is compact. */
+    static bool isCompact( const char firstByte )
+    {
+        return uint8_t( firstByte ) == magicNumber;
+    }
+
+    /** The value of the first byte. */
+    static const uint8_t magicNumber = 0xDF;
+
+    /** The size of the serialized output. */
+    static const size_t serializedSize = 12;
+};
+
 }
 
 /**
@@ -59,6 +59,8 @@ struct MetaTypeRegistration
         qRegisterMetaType< deflect::SizeHints >( "deflect::SizeHints" );
         qRegisterMetaType< deflect::Event >( "deflect::Event" );
         qRegisterMetaType< deflect::FramePtr >( "deflect::FramePtr" );
+        qRegisterMetaType< deflect::SourceFrameCountsPtr >(
+                    "deflect::SourceFrameCountsPtr" );
     }
 };
 
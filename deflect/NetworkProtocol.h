@@ -39,7 +39,12 @@
 #ifndef DEFLECT_NETWORK_PROTOCOL_H
 #define DEFLECT_NETWORK_PROTOCOL_H
 
+/** Version sent by servers in the handshake, which clients check exactly. */
 #define NETWORK_PROTOCOL_VERSION    8
+/** Version requested by Streams at PIXELSTREAM_OPEN to use compact headers */
+#define COMPACT_HEADER_PROTOCOL_VERSION 9
+/** Features announced by servers in PIXELSTREAM_OPEN_REPLY, as bit flags */
+#define PROTOCOL_FEATURE_FRAME_ACKS 0x1
 #define DEFAULT_PORT_NUMBER         1701
 #define SERVUS_SERVICE_NAME         "_displaycluster._tcp"
 
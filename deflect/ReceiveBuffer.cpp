@@ -39,32 +39,91 @@
 
 #include "ReceiveBuffer.h"
 
+#include <algorithm>
+
 namespace deflect
 {
 
 ReceiveBuffer::ReceiveBuffer()
     : _lastFrameComplete( 0 )
+    , _completeFrames( 0 )
+    , _sourcesWithLatest( 0 )
+    , _abandonedFrames( 0 )
     , _allowedToSend( true )
+    , _deliveryMode( DELIVERY_LATEST_ONLY )
+    , _maxFrames( 0 )
+    , _maxBytes( 0 )
+    , _bufferedBytes( 0 )
+    , _peakBufferedBytes( 0 )
+    , _droppedFrames( 0 )
+    , _hasPartialUpdate( false )
 {
 }
 
 bool ReceiveBuffer::addSource( const size_t sourceIndex )
 {
-    assert( !_sourceBuffers.count( sourceIndex ));
+    assert( !_sourcePositions.count( sourceIndex ));
 
     // TODO: This function must return false if the stream was already started!
     // This requires an full adaptation of the Stream library (DISCL-241)
-    if ( _sourceBuffers.count( sourceIndex ))
+    if ( _sourcePositions.count( sourceIndex ))
         return false;
 
-    _sourceBuffers[sourceIndex] = SourceBuffer();
-    _sourceBuffers[sourceIndex].segments.push( Segments( ));
+    _sourcePositions[sourceIndex] = _sourceBuffers.size();
+    _sourceIndexes.push_back( sourceIndex );
+    _sourceBuffers.push_back( SourceBuffer( ));
+
+    // The new source starts contributing from the current frame
+    SourceBuffer& buffer = _sourceBuffers.back();
+    buffer.frontFrameIndex = _lastFrameComplete;
+    buffer.backFrameIndex = _lastFrameComplete;
+    buffer.segments.push_back( Segments( ));
+
+    _countCompleteFrames();
     return true;
 }
 
 void ReceiveBuffer::removeSource( const size_t sourceIndex )
 {
-    _sourceBuffers.erase( sourceIndex );
+    std::unordered_map<size_t, size_t>::iterator it =
+            _sourcePositions.find( sourceIndex );
+    if( it == _sourcePositions.end( ))
+        return;
+
+    const size_t position = it->second;
+    SourceBuffer& buffer = _sourceBuffers[position];
+    _bufferedBytes -= buffer.bytes + buffer.latestBytes;
+
+    if( _deliveryMode == DELIVERY_PARTIAL_UPDATES )
+    {
+        if( buffer.hasLatest )
+            --_sourcesWithLatest;
+    }
+    else
+    {
+        const size_t finished = buffer.backFrameIndex - _lastFrameComplete;
+        for( size_t i = 0; i < finished; ++i )
+            --_finishedSources[i];
+    }
+
+    // Move the last source in place of the removed one
+    if( position != _sourceBuffers.size() - 1 )
+    {
+        std::swap( _sourceBuffers[position], _sourceBuffers.back( ));
+        _sourceIndexes[position] = _sourceIndexes.back();
+        _sourcePositions[_sourceIndexes[position]] = position;
+    }
+    _sourceBuffers.pop_back();
+    _sourceIndexes.pop_back();
+    _sourcePositions.erase( sourceIndex );
+
+    if( _sourceBuffers.empty( ))
+    {
+        _finishedSources.clear();
+        _abandonedFrames = 0;
+    }
+    _countCompleteFrames();
+    _releaseAbandonedFrames();
 }
 
 size_t ReceiveBuffer::getSourceCount() const
@@ -74,45 +133,93 @@ size_t ReceiveBuffer::getSourceCount() const
 
 void ReceiveBuffer::insert( const Segment& segment, const size_t sourceIndex )
 {
-    assert( _sourceBuffers.count( sourceIndex ));
+    SourceBuffer& buffer = _getBuffer( sourceIndex );
+
+    // The frame was dropped while the source was still sending it
+    if( _abandonedFrames > 0 &&
+        buffer.backFrameIndex - _lastFrameComplete < _abandonedFrames )
+    {
+        return;
+    }
+
+    buffer.segments.back().push_back( segment );
+    buffer.bytes += segment.imageData.size();
+
+    _bufferedBytes += segment.imageData.size();
+    _peakBufferedBytes = std::max( _peakBufferedBytes, _bufferedBytes );
 
-    _sourceBuffers[sourceIndex].segments.back().push_back( segment );
+    if( _maxBytes > 0 && _bufferedBytes > _maxBytes )
+        _enforceLimits();
 }
 
 void ReceiveBuffer::finishFrameForSource( const size_t sourceIndex )
 {
-    assert( _sourceBuffers.count( sourceIndex ));
+    SourceBuffer& buffer = _getBuffer( sourceIndex );
+    const size_t frame = buffer.backFrameIndex - _lastFrameComplete;
+    buffer.push();
+
+    if( _deliveryMode == DELIVERY_PARTIAL_UPDATES )
+    {
+        _updateLatestFrame( buffer );
+        return;
+    }
+
+    if( frame == _finishedSources.size( ))
+        _finishedSources.push_back( 0 );
+    if( ++_finishedSources[frame] == _sourceBuffers.size( ))
+        ++_completeFrames;
+    _releaseAbandonedFrames();
 
-    _sourceBuffers[sourceIndex].push();
+    if( _deliveryMode == DELIVERY_LATEST_ONLY )
+        _dropSupersededFrames();
+    _enforceLimits();
 }
 
 bool ReceiveBuffer::hasCompleteFrame() const
 {
     assert( !_sourceBuffers.empty( ));
 
-    // Check if all sources for Stream have reached the same index
-    for( SourceBufferMap::const_iterator it = _sourceBuffers.begin();
-         it != _sourceBuffers.end(); ++it )
-    {
-        const SourceBuffer& buffer = it->second;
-        if( buffer.backFrameIndex <= _lastFrameComplete )
-            return false;
-    }
-    return true;
+    // The first frame waits for all the sources
+    if( _deliveryMode == DELIVERY_PARTIAL_UPDATES )
+        return _hasPartialUpdate &&
+               _sourcesWithLatest == _sourceBuffers.size();
+
+    return _completeFrames > 0;
 }
 
 Segments ReceiveBuffer::popFrame()
 {
+    const bool partial = _deliveryMode == DELIVERY_PARTIAL_UPDATES;
+
+    size_t segmentCount = 0;
+    for( const SourceBuffer& buffer : _sourceBuffers )
+    {
+        segmentCount += partial ? buffer.latest.size()
+                                : buffer.segments.front().size();
+    }
+
     Segments frame;
-    for( SourceBufferMap::iterator it = _sourceBuffers.begin();
-         it != _sourceBuffers.end(); ++it )
+    frame.reserve( segmentCount );
+
+    if( partial )
     {
-        SourceBuffer& buffer = it->second;
-        frame.insert( frame.end(), buffer.segments.front().begin(),
-                      buffer.segments.front().end( ));
-        buffer.pop();
+        // The latest segments are kept for the next partial updates
+        for( SourceBuffer& buffer : _sourceBuffers )
+        {
+            frame.insert( frame.end(), buffer.latest.begin(),
+                          buffer.latest.end( ));
+            if( buffer.latestPending )
+            {
+                ++buffer.releasedFrames;
+                buffer.latestPending = false;
+            }
+        }
+        _hasPartialUpdate = false;
+        ++_lastFrameComplete;
+        return frame;
     }
-    ++_lastFrameComplete;
+
+    _popFrontFrame( &frame );
     return frame;
 }
 
@@ -126,4 +233,221 @@ bool ReceiveBuffer::isAllowedToSend() const
     return _allowedToSend;
 }
 
+void ReceiveBuffer::setDeliveryMode( const DeliveryMode mode )
+{
+    if( mode == _deliveryMode )
+        return;
+
+    if( _deliveryMode == DELIVERY_PARTIAL_UPDATES )
+    {
+        // Restart the frame count of all the sources from the current frame
+        for( SourceBuffer& buffer : _sourceBuffers )
+        {
+            if( buffer.latestPending )
+            {
+                ++buffer.releasedFrames;
+                buffer.latestPending = false;
+            }
+            _bufferedBytes -= buffer.latestBytes;
+            buffer.clearLatest();
+            buffer.frontFrameIndex = _lastFrameComplete;
+            buffer.backFrameIndex = _lastFrameComplete;
+        }
+        _sourcesWithLatest = 0;
+        _hasPartialUpdate = false;
+    }
+
+    _deliveryMode = mode;
+
+    if( _deliveryMode == DELIVERY_PARTIAL_UPDATES )
+    {
+        for( SourceBuffer& buffer : _sourceBuffers )
+        {
+            while( buffer.frontFrameIndex < buffer.backFrameIndex )
+                _updateLatestFrame( buffer );
+        }
+        _finishedSources.clear();
+        _completeFrames = 0;
+        _abandonedFrames = 0;
+    }
+    else if( _deliveryMode == DELIVERY_LATEST_ONLY )
+        _dropSupersededFrames();
+}
+
+DeliveryMode ReceiveBuffer::getDeliveryMode() const
+{
+    return _deliveryMode;
+}
+
+void ReceiveBuffer::setMaxBufferedFrames( const size_t count )
+{
+    _maxFrames = count;
+    _enforceLimits();
+}
+
+void ReceiveBuffer::setMaxBufferedBytes( const size_t bytes )
+{
+    _maxBytes = bytes;
+    _enforceLimits();
+}
+
+size_t ReceiveBuffer::getBufferedFrameCount() const
+{
+    if( _sourceBuffers.empty( ))
+        return 0;
+
+    if( _deliveryMode == DELIVERY_PARTIAL_UPDATES )
+        return hasCompleteFrame() ? 1 : 0;
+
+    return _completeFrames;
+}
+
+size_t ReceiveBuffer::getBufferedBytes() const
+{
+    return _bufferedBytes;
+}
+
+size_t ReceiveBuffer::getPeakBufferedBytes() const
+{
+    return _peakBufferedBytes;
+}
+
+size_t ReceiveBuffer::getDroppedFrameCount() const
+{
+    return _droppedFrames;
+}
+
+FrameIndex ReceiveBuffer::getReleasedFrameCount() const
+{
+    return _lastFrameComplete;
+}
+
+FrameIndex ReceiveBuffer::getReleasedFrameCount(
+        const size_t sourceIndex ) const
+{
+    std::unordered_map<size_t, size_t>::const_iterator it =
+            _sourcePositions.find( sourceIndex );
+    if( it == _sourcePositions.end( ))
+        return 0;
+    return _sourceBuffers[it->second].releasedFrames;
+}
+
+const std::vector<size_t>& ReceiveBuffer::getSourceIndexes() const
+{
+    return _sourceIndexes;
+}
+
+SourceBuffer& ReceiveBuffer::_getBuffer( const size_t sourceIndex )
+{
+    assert( _sourcePositions.count( sourceIndex ));
+    return _sourceBuffers[_sourcePositions[sourceIndex]];
+}
+
+void ReceiveBuffer::_popFrontFrame( Segments* frame )
+{
+    assert( _completeFrames > 0 );
+
+    for( SourceBuffer& buffer : _sourceBuffers )
+    {
+        _bufferedBytes -= buffer.bytes;
+        buffer.pop( frame );
+        _bufferedBytes += buffer.bytes;
+        ++buffer.releasedFrames;
+    }
+    _finishedSources.pop_front();
+    --_completeFrames;
+    ++_lastFrameComplete;
+}
+
+void ReceiveBuffer::_countCompleteFrames()
+{
+    // The counts are decreasing since each source finishes frames in order
+    _completeFrames = 0;
+    while( _completeFrames < _finishedSources.size() &&
+           _finishedSources[_completeFrames] == _sourceBuffers.size( ))
+    {
+        ++_completeFrames;
+    }
+}
+
+void ReceiveBuffer::_dropFrame()
+{
+    _popFrontFrame( nullptr );
+    ++_droppedFrames;
+}
+
+bool ReceiveBuffer::_abandonFrame()
+{
+    // Only the oldest frame which is not complete yet can be abandoned, so
+    // that the abandoned frames are the first ones to complete
+    const FrameIndex frameIndex = _lastFrameComplete + _abandonedFrames;
+
+    bool received = false;
+    for( SourceBuffer& buffer : _sourceBuffers )
+    {
+        if( buffer.backFrameIndex < frameIndex )
+            continue;
+
+        _bufferedBytes -= buffer.clear( frameIndex );
+        received = true;
+    }
+    if( !received )
+        return false;
+
+    ++_abandonedFrames;
+    ++_droppedFrames;
+    return true;
+}
+
+void ReceiveBuffer::_releaseAbandonedFrames()
+{
+    while( _abandonedFrames > 0 && _completeFrames > 0 )
+    {
+        _popFrontFrame( nullptr );
+        --_abandonedFrames;
+    }
+}
+
+void ReceiveBuffer::_dropSupersededFrames()
+{
+    while( _completeFrames > 1 )
+        _dropFrame();
+}
+
+void ReceiveBuffer::_updateLatestFrame( SourceBuffer& buffer )
+{
+    if( !buffer.hasLatest )
+        ++_sourcesWithLatest;
+
+    // The previous latest frame is superseded before being dispatched
+    if( buffer.latestPending )
+        ++buffer.releasedFrames;
+    buffer.latestPending = true;
+
+    _bufferedBytes -= buffer.bytes + buffer.latestBytes;
+    buffer.popLatest();
+    _bufferedBytes += buffer.bytes + buffer.latestBytes;
+    _hasPartialUpdate = true;
+}
+
+void ReceiveBuffer::_enforceLimits()
+{
+    // Each source keeps at most one frame in partial updates mode
+    if( _deliveryMode == DELIVERY_PARTIAL_UPDATES )
+        return;
+
+    while( _maxFrames > 0 && _completeFrames > _maxFrames )
+        _dropFrame();
+
+    // The byte limit is strict: the oldest frames are dropped, complete or
+    // not, until the data fits
+    while( _maxBytes > 0 && _bufferedBytes > _maxBytes )
+    {
+        if( _completeFrames > 0 )
+            _dropFrame();
+        else if( !_abandonFrame( ))
+            break;
+    }
+}
+
 }
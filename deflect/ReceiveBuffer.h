@@ -46,8 +46,10 @@
 
 #include <QSize>
 
-#include <queue>
-#include <map>
+#include <deque>
+#include <iterator>
+#include <unordered_map>
+#include <vector>
 
 namespace deflect
 {
@@ -59,36 +61,134 @@ typedef unsigned int FrameIndex;
  */
 struct SourceBuffer
 {
-    SourceBuffer() : frontFrameIndex( 0 ), backFrameIndex( 0 ) {}
+    SourceBuffer()
+        : frontFrameIndex( 0 ), backFrameIndex( 0 ), bytes( 0 )
+        , latestBytes( 0 ), hasLatest( false ), releasedFrames( 0 )
+        , latestPending( false )
+    {}
 
     /** The current indexes of the frame for this source */
     FrameIndex frontFrameIndex, backFrameIndex;
 
-    /** The collection of segments */
-    std::queue<Segments> segments;
+    /** The collection of segments, one element per frame */
+    std::deque<Segments> segments;
 
-    /** Pop the first element of the buffer */
-    void pop()
+    /** The size of the image data of all the buffered segments */
+    size_t bytes;
+
+    /** An emptied collection, recycled to avoid reallocations */
+    Segments recycled;
+
+    /** The last frame finished by the source, in partial updates mode */
+    Segments latest;
+
+    /** The size of the image data of the latest frame */
+    size_t latestBytes;
+
+    /** Has the source finished a frame since partial updates were enabled */
+    bool hasLatest;
+
+    /** The number of finished frames popped, dropped or superseded */
+    FrameIndex releasedFrames;
+
+    /** Is the latest frame neither dispatched nor released yet */
+    bool latestPending;
+
+    /**
+     * Pop the first element of the buffer.
+     * @param frame optional output to which the segments are moved
+     */
+    void pop( Segments* frame = nullptr )
     {
-        segments.pop();
+        Segments& front = segments.front();
+        for( const Segment& segment : front )
+            bytes -= segment.imageData.size();
+
+        if( frame )
+            frame->insert( frame->end(), std::make_move_iterator( front.begin( )),
+                           std::make_move_iterator( front.end( )));
+
+        front.clear();
+        recycled.swap( front );
+        segments.pop_front();
         ++frontFrameIndex;
     }
 
     /** Push a new element to the back of the buffer */
     void push()
     {
-        segments.push( Segments( ));
+        segments.push_back( Segments( ));
+        segments.back().swap( recycled );
         ++backFrameIndex;
     }
+
+    /**
+     * Discard the segments of a buffered frame, keeping its place.
+     * @param frameIndex the frame, between frontFrameIndex and backFrameIndex
+     * @return the size of the image data discarded
+     */
+    size_t clear( const FrameIndex frameIndex )
+    {
+        Segments& frame = segments[frameIndex - frontFrameIndex];
+        size_t frameBytes = 0;
+        for( const Segment& segment : frame )
+            frameBytes += segment.imageData.size();
+
+        frame.clear();
+        bytes -= frameBytes;
+        return frameBytes;
+    }
+
+    /** Replace the latest frame by the first element of the buffer */
+    void popLatest()
+    {
+        const size_t queuedBytes = bytes;
+        latest.clear();
+        pop( &latest );
+        latestBytes = queuedBytes - bytes;
+        hasLatest = true;
+    }
+
+    /** Discard the latest frame */
+    void clearLatest()
+    {
+        latest.clear();
+        latestBytes = 0;
+        hasLatest = false;
+    }
 };
 
-typedef std::map<size_t, SourceBuffer> SourceBufferMap;
+typedef std::vector<SourceBuffer> SourceBuffers;
 
 /**
  * Buffer Segments from (multiple) sources.
  *
  * The buffer aggregates segments coming from different sources and delivers
  * complete frames.
+ *
+ * In the default DELIVERY_LATEST_ONLY mode, a complete frame is discarded as
+ * soon as a more recent one is completed by all the sources, so that at most
+ * one complete frame is ever buffered. In DELIVERY_EVERY_FRAME mode, all the
+ * complete frames are kept until popped.
+ *
+ * In DELIVERY_PARTIAL_UPDATES mode, intended for sources which cover disjoint
+ * regions of the stream, each source completes its frames independently. The
+ * first frame waits for all the sources; afterwards, a frame is complete as
+ * soon as any source finishes one, and is composed of the latest segments of
+ * every source. A slow source thus no longer holds back the others.
+ *
+ * The amount of buffered data can be bounded with setMaxBufferedFrames() and
+ * setMaxBufferedBytes(). When the frame limit is exceeded, the oldest complete
+ * frames are dropped. The byte limit is checked as the segments arrive and
+ * drops the oldest frames until the data fits, including the last complete
+ * frame and the frames which are not complete yet, for instance when a source
+ * runs ahead of a stalled one. The segments still received for a dropped frame
+ * are discarded, and the frame is skipped once all the sources finished it.
+ *
+ * The sources are stored contiguously and the number of sources which
+ * finished each buffered frame is counted, so that finishing a frame and
+ * checking for its completion take constant time regardless of the number of
+ * sources.
  */
 class ReceiveBuffer
 {
@@ -141,10 +241,91 @@ public:
     /** @return true if this buffer can be sent by FrameDispatcher */
     DEFLECT_API bool isAllowedToSend() const;
 
+    /** Set the delivery mode of the frames (default: latest only). */
+    DEFLECT_API void setDeliveryMode( DeliveryMode mode );
+
+    /** @return the delivery mode of the frames. */
+    DEFLECT_API DeliveryMode getDeliveryMode() const;
+
+    /**
+     * Set the maximum number of complete frames to keep in the buffer.
+     * @param count the maximum number of frames, 0 for unlimited (default)
+     */
+    DEFLECT_API void setMaxBufferedFrames( size_t count );
+
+    /**
+     * Set the maximum size of the image data kept in the buffer.
+     *
+     * The limit should leave room for at least two frames, the one waiting to
+     * be popped and the one being received; a frame larger than the limit is
+     * never delivered.
+     * @param bytes the maximum size in bytes, 0 for unlimited (default)
+     */
+    DEFLECT_API void setMaxBufferedBytes( size_t bytes );
+
+    /** @return the number of complete frames waiting to be popped. */
+    DEFLECT_API size_t getBufferedFrameCount() const;
+
+    /** @return the size of the image data currently in the buffer. */
+    DEFLECT_API size_t getBufferedBytes() const;
+
+    /** @return the maximum size reached by the buffered image data. */
+    DEFLECT_API size_t getPeakBufferedBytes() const;
+
+    /** @return the number of frames dropped without being popped. */
+    DEFLECT_API size_t getDroppedFrameCount() const;
+
+    /** @return the number of complete frames popped or dropped so far. */
+    DEFLECT_API FrameIndex getReleasedFrameCount() const;
+
+    /**
+     * Get the number of frames of a source which were released.
+     *
+     * A frame is released when it is popped or dropped. In partial updates
+     * mode, where each source finishes frames at its own pace, it is released
+     * when it is first part of a popped frame or when the source supersedes it
+     * before that.
+     * @param sourceIndex Unique source identifier
+     * @return the number of frames, 0 for an unknown source
+     */
+    DEFLECT_API FrameIndex getReleasedFrameCount( size_t sourceIndex ) const;
+
+    /** @return the identifiers of the sources, in no particular order. */
+    DEFLECT_API const std::vector<size_t>& getSourceIndexes() const;
+
 private:
     FrameIndex _lastFrameComplete;
-    SourceBufferMap _sourceBuffers;
+    SourceBuffers _sourceBuffers;
+    std::vector<size_t> _sourceIndexes;
+    std::unordered_map<size_t, size_t> _sourcePositions;
+
+    /** Number of sources having finished each frame after _lastFrameComplete */
+    std::deque<size_t> _finishedSources;
+    size_t _completeFrames;
+    size_t _sourcesWithLatest;
+
+    /** Number of frames after _lastFrameComplete dropped before completion */
+    size_t _abandonedFrames;
+
     bool _allowedToSend;
+    DeliveryMode _deliveryMode;
+
+    size_t _maxFrames;
+    size_t _maxBytes;
+    size_t _bufferedBytes;
+    size_t _peakBufferedBytes;
+    size_t _droppedFrames;
+    bool _hasPartialUpdate;
+
+    SourceBuffer& _getBuffer( size_t sourceIndex );
+    void _popFrontFrame( Segments* frame );
+    void _countCompleteFrames();
+    void _dropFrame();
+    bool _abandonFrame();
+    void _releaseAbandonedFrames();
+    void _dropSupersededFrames();
+    void _updateLatestFrame( SourceBuffer& buffer );
+    void _enforceLimits();
 };
 
 }
@@ -44,6 +44,7 @@
 
 #include <boost/serialization/binary_object.hpp>
 #include <boost/serialization/split_member.hpp>
+#include <boost/serialization/version.hpp>
 
 #include <QByteArray>
 
@@ -52,11 +53,32 @@ namespace deflect
 
 struct ImageWrapper;
 
+/**
+ * The layout of the uncompressed image data of a Segment.
+ *
+ * Planar YUV formats store the Y plane at full resolution followed by the U
+ * and V planes, whose dimensions are divided by the chroma subsampling
+ * (rounded up). The rows of the planes are not padded.
+ */
+enum SegmentFormat
+{
+    SEGMENT_FORMAT_RGBA,    /**< 4 bytes per pixel (default) */
+    SEGMENT_FORMAT_YUV444,  /**< Planar YUV, full resolution chroma */
+    SEGMENT_FORMAT_YUV422,  /**< Planar YUV, chroma of half the width */
+    SEGMENT_FORMAT_YUV420,  /**< Planar YUV, chroma of half width and height */
+    SEGMENT_FORMAT_YUV440,  /**< Planar YUV, chroma of half the height */
+    SEGMENT_FORMAT_YUV411,  /**< Planar YUV, chroma of a quarter the width */
+    SEGMENT_FORMAT_GRAY     /**< Y plane only */
+};
+
 /**
  * Image data and parameters for a single segment of a PixelStream.
  */
 struct Segment
 {
+    /** Construct an empty segment. */
+    Segment() : sourceImage( 0 ), format( SEGMENT_FORMAT_RGBA ) {}
+
     /** Parameters of the segment. */
     SegmentParameters parameters;
 
@@ -66,6 +88,13 @@ struct Segment
     /** @internal raw, uncompressed source image, used for compression */
     const ImageWrapper* sourceImage;
 
+    /**
+     * Layout of the image data once decoded, set by the SegmentDecoder.
+     * Only meaningful if parameters.compressed is false, it is not sent by
+     * the Stream.
+     */
+    SegmentFormat format;
+
 private:
     friend class boost::serialization::access;
 
@@ -73,6 +102,7 @@ private:
     void save( Archive & ar, const unsigned int ) const
     {
         ar & parameters;
+        ar & format;
 
         int size = imageData.size();
         ar & size;
@@ -82,9 +112,11 @@ private:
     }
 
     template<class Archive>
-    void load( Archive & ar, const unsigned int )
+    void load( Archive & ar, const unsigned int version )
     {
         ar & parameters;
+        if( version > 0 )
+            ar & format;
 
         int size = 0;
         ar & size;
@@ -99,4 +131,6 @@ private:
 
 }
 
+BOOST_CLASS_VERSION( deflect::Segment, 1 )
+
 #endif
@@ -39,12 +39,21 @@
 
 #include "SegmentDecoder.h"
 
+#include "DecodedSegmentCache.h"
+#include "DecompressorPool.h"
+#include "Frame.h"
 #include "ImageJpegDecompressor.h"
 #include "Segment.h"
 
+#include <cstring>
+#include <functional>
 #include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
 
 #include <QFuture>
+#include <QtConcurrentMap>
 #include <QtConcurrentRun>
 
 namespace deflect
@@ -61,6 +70,12 @@ public:
 
     /** Async image decoding future */
     QFuture<void> decodingFuture;
+
+    /** Decompressors for decodeFrame() */
+    DecompressorPool pool;
+
+    /** Decoded images of previous frames */
+    DecodedSegmentCache cache;
 };
 
 SegmentDecoder::SegmentDecoder()
@@ -109,4 +124,173 @@ bool SegmentDecoder::isRunning() const
     return _impl->decodingFuture.isRunning();
 }
 
+QFuture<size_t> SegmentDecoder::decodeFrame( Frame& frame,
+                                             const unsigned int downscale )
+{
+    return _decodeFrame( frame, downscale, false );
+}
+
+QFuture<size_t> SegmentDecoder::decodeFrameToYUV( Frame& frame,
+                                                  const unsigned int downscale )
+{
+    return _decodeFrame( frame, downscale, true );
+}
+
+bool SegmentDecoder::decode( const Segment& segment, char* buffer,
+                             const int pitch, const unsigned int downscale )
+{
+    if( !isDownscaleSupported( downscale ))
+        return false;
+
+    const SegmentParameters& params = segment.parameters;
+    const SegmentParameters scaled = getScaledParameters( params, downscale );
+    if( pitch < (int)scaled.width * 4 )
+        return false;
+
+    if( !params.compressed )
+    {
+        const int rowSize = params.width * 4;
+        if( segment.imageData.size() < rowSize * (int)params.height )
+            return false;
+
+        const char* source = segment.imageData.constData();
+        for( unsigned int y = 0; y < scaled.height; ++y )
+        {
+            const char* sourceRow = source + y * downscale * rowSize;
+            char* row = buffer + y * pitch;
+            if( downscale == 1 )
+            {
+                std::memcpy( row, sourceRow, rowSize );
+                continue;
+            }
+            for( unsigned int x = 0; x < scaled.width; ++x )
+                std::memcpy( row + x * 4, sourceRow + x * downscale * 4, 4 );
+        }
+        return true;
+    }
+
+    DecompressorPool::DecompressorPtr decompressor = _impl->pool.acquire();
+
+    // Guard against writing outside of the given memory
+    const QSize size = decompressor->decompressHeader( segment.imageData );
+    const bool success =
+            size == QSize( params.width, params.height ) &&
+            decompressor->decompress( segment.imageData, buffer, pitch,
+                                      downscale );
+
+    _impl->pool.release( std::move( decompressor ));
+    return success;
+}
+
+void SegmentDecoder::setCacheSize( const size_t bytes )
+{
+    _impl->cache.setMaxSize( bytes );
+}
+
+SegmentDecoder::CacheStatistics SegmentDecoder::getCacheStatistics() const
+{
+    CacheStatistics statistics;
+    statistics.hits = _impl->cache.getHits();
+    statistics.misses = _impl->cache.getMisses();
+    statistics.entries = _impl->cache.getEntryCount();
+    statistics.bytes = _impl->cache.getSize();
+    return statistics;
+}
+
+bool SegmentDecoder::isDownscaleSupported( const unsigned int downscale )
+{
+    return ImageJpegDecompressor::isDownscaleSupported( downscale );
+}
+
+namespace
+{
+void countFailures( size_t& failures, const bool decoded )
+{
+    if( !decoded )
+        ++failures;
+}
+}
+
+QFuture<size_t> SegmentDecoder::_decodeFrame( Frame& frame,
+                                              const unsigned int downscale,
+                                              const bool toYUV )
+{
+    if( !isDownscaleSupported( downscale ))
+        throw std::invalid_argument( "Unsupported downscale factor: " +
+                                     std::to_string( downscale ));
+
+    // Map over pointers, QtConcurrent::mappedReduced() iterates over a copy
+    std::vector< Segment* > segments;
+    segments.reserve( frame.segments.size( ));
+    for( Segment& segment : frame.segments )
+        segments.push_back( &segment );
+
+    const std::function< bool( Segment* ) > decodeSegment =
+            [this, downscale, toYUV]( Segment* segment )
+    {
+        return _decode( *segment, downscale, toYUV );
+    };
+    return QtConcurrent::mappedReduced( segments, decodeSegment,
+                                        &countFailures );
+}
+
+SegmentParameters SegmentDecoder::getScaledParameters(
+        const SegmentParameters& parameters, const unsigned int downscale )
+{
+    // Same rounding as libjpeg-turbo for the dimensions (TJSCALED)
+    SegmentParameters scaled = parameters;
+    scaled.x = parameters.x / downscale;
+    scaled.y = parameters.y / downscale;
+    scaled.width = ( parameters.width + downscale - 1 ) / downscale;
+    scaled.height = ( parameters.height + downscale - 1 ) / downscale;
+    return scaled;
+}
+
+bool SegmentDecoder::_decode( Segment& segment, const unsigned int downscale,
+                              const bool toYUV )
+{
+    if( !segment.parameters.compressed && downscale == 1 )
+        return true;
+
+    const SegmentParameters params =
+            getScaledParameters( segment.parameters, downscale );
+    const bool useCache = segment.parameters.compressed &&
+                          _impl->cache.getMaxSize() > 0;
+    const unsigned int variant = downscale * 2 + ( toYUV ? 1 : 0 );
+
+    DecodedSegmentCache::Image image;
+    if( !useCache || !_impl->cache.find( segment.imageData, variant, image ))
+    {
+        if( toYUV && segment.parameters.compressed )
+        {
+            DecompressorPool::DecompressorPtr decompressor =
+                    _impl->pool.acquire();
+            image.data = decompressor->decompressToYUV( segment.imageData,
+                                                        image.format,
+                                                        downscale );
+            _impl->pool.release( std::move( decompressor ));
+        }
+        else
+        {
+            const int pitch = params.width * 4;
+            image.data = QByteArray( params.height * pitch, Qt::Uninitialized );
+            image.format = SEGMENT_FORMAT_RGBA;
+            if( !decode( segment, image.data.data(), pitch, downscale ))
+                image.data.clear();
+        }
+
+        if( image.data.isEmpty( ))
+            return false;
+
+        if( useCache )
+            _impl->cache.insert( segment.imageData, variant, image );
+    }
+
+    segment.imageData = image.data;
+    segment.parameters = params;
+    segment.parameters.compressed = false;
+    segment.format = image.format;
+    return true;
+}
+
 }
@@ -42,6 +42,9 @@
 
 #include <deflect/api.h>
 #include <deflect/types.h>
+#include <deflect/SegmentParameters.h>
+
+#include <QFuture>
 
 #include <boost/noncopyable.hpp>
 
@@ -50,6 +53,9 @@ namespace deflect
 
 /**
  * Decode a Segment's image asynchronously.
+ *
+ * A pool of decompressors is shared by the decoding tasks, so that the
+ * segments of a frame can be decoded concurrently in the global QThreadPool.
  */
 class SegmentDecoder : public boost::noncopyable
 {
@@ -78,9 +84,116 @@ public:
     /** Check if the decoding thread is running. */
     DEFLECT_API bool isRunning() const;
 
+    /**
+     * Start decoding all the segments of a frame in parallel.
+     *
+     * Contrary to startDecoding(), this function can be called again before
+     * the previous decoding has finished; the frames are all decoded.
+     * Segments which are not compressed are left untouched unless the frame
+     * is downscaled. Segments which fail to decode are left untouched (their
+     * parameters remain compressed) and counted in the result of the future.
+     * @param frame The frame to decode, modified by this function. It must
+     *        remain valid and should not be accessed until the decoding
+     *        has completed.
+     * @param downscale Reduction factor of the frame resolution, the
+     *        parameters of the decoded segments are scaled accordingly.
+     * @return a future which is finished once all the segments are decoded,
+     *         holding the number of segments which could not be decoded.
+     * @throw std::invalid_argument if the downscale factor is not supported
+     * @see isDownscaleSupported()
+     */
+    DEFLECT_API QFuture<size_t> decodeFrame( Frame& frame,
+                                             unsigned int downscale = 1 );
+
+    /**
+     * Start decoding all the segments of a frame to planar YUV, in parallel.
+     *
+     * Same as decodeFrame(), except that Jpeg segments are decoded to the
+     * planar YUV layout of their chroma subsampling, indicated by
+     * Segment::format. Colour conversion is thus left to the consumer, for
+     * instance in a shader, and 4:2:0 planes take 1.5 bytes per pixel instead
+     * of 4. Raw segments remain in RGBA format.
+     * @param frame The frame to decode, modified by this function. It must
+     *        remain valid and should not be accessed until the decoding
+     *        has completed.
+     * @param downscale Reduction factor of the frame resolution
+     * @return a future which is finished once all the segments are decoded,
+     *         holding the number of segments which could not be decoded.
+     * @throw std::invalid_argument if the downscale factor is not supported
+     */
+    DEFLECT_API QFuture<size_t> decodeFrameToYUV( Frame& frame,
+                                                  unsigned int downscale = 1 );
+
+    /**
+     * Decode a segment into caller-provided memory.
+     *
+     * Compressed segments are decoded directly into the buffer and raw
+     * segments are copied, without any intermediate allocation. This allows
+     * decoding into a mapped pixel buffer or a tile of a larger image. This
+     * function is synchronous and can be called concurrently.
+     *
+     * Jpeg segments are downscaled by libjpeg-turbo during decompression,
+     * skipping most of the work for the discarded resolution. Raw segments
+     * are subsampled.
+     * @param segment The segment to decode, which is not modified.
+     * @param buffer The destination for the image data in (GL_)RGBA format.
+     *        It must hold getScaledParameters().height rows of pitch bytes.
+     * @param pitch The number of bytes between two rows of the buffer, at
+     *        least 4 * getScaledParameters().width.
+     * @param downscale Reduction factor of the segment resolution
+     * @return true if the segment could be decoded, false otherwise.
+     * @see isDownscaleSupported()
+     */
+    DEFLECT_API bool decode( const Segment& segment, char* buffer, int pitch,
+                             unsigned int downscale = 1 );
+
+    /** Statistics of the decoded segment cache. */
+    struct CacheStatistics
+    {
+        size_t hits;    //!< Segments found in the cache
+        size_t misses;  //!< Segments decoded while the cache was enabled
+        size_t entries; //!< Number of cached segments
+        size_t bytes;   //!< Size of the cached compressed and decoded data
+    };
+
+    /**
+     * Enable caching the decoded segments of decodeFrame() and
+     * decodeFrameToYUV().
+     *
+     * Static content is often sent as byte-identical Jpeg segments frame after
+     * frame. With the cache enabled, such segments are decoded only once. The
+     * compressed data is hashed for the lookup and compared on each hit. When
+     * the cache is full, the least recently used segments are evicted.
+     * @param bytes The maximum size of the cache, 0 to disable it (default).
+     */
+    DEFLECT_API void setCacheSize( size_t bytes );
+
+    /** @return the statistics of the cache; hit rate = hits/(hits+misses). */
+    DEFLECT_API CacheStatistics getCacheStatistics() const;
+
+    /**
+     * @param downscale A reduction factor of the resolution
+     * @return true if segments can be decoded at 1/downscale resolution
+     *         (1, 2, 4 and 8 with all versions of libjpeg-turbo).
+     */
+    DEFLECT_API static bool isDownscaleSupported( unsigned int downscale );
+
+    /**
+     * Get the parameters of a segment decoded at a reduced resolution.
+     * @param parameters The parameters at full resolution
+     * @param downscale Reduction factor of the resolution
+     * @return The parameters of the decoded segment
+     */
+    DEFLECT_API static SegmentParameters getScaledParameters(
+            const SegmentParameters& parameters, unsigned int downscale );
+
 private:
     class Impl;
     Impl* _impl;
+
+    QFuture<size_t> _decodeFrame( Frame& frame, unsigned int downscale,
+                                  bool toYUV );
+    bool _decode( Segment& segment, unsigned int downscale, bool toYUV );
 };
 
 }
@@ -0,0 +1,191 @@
+/*********************************************************************/
+/* Copyright (c) 2015, EPFL/Blue Brain Project                       */
+/*                     Raphael Dumusc <raphael.dumusc@epfl.ch>       */
+/* All rights reserved.                                              */
+/*                                                                   */
+/* Redistribution and use in source and binary forms, with or        */
+/* without modification, are permitted provided that the following   */
+/* conditions are met:                                               */
+/*                                                                   */
+/*   1. Redistributions of source code must retain the above         */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer.                                                  */
+/*                                                                   */
+/*   2. Redistributions in binary form must reproduce the above      */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer in the documentation and/or other materials       */
+/*      provided with the distribution.                              */
+/*                                                                   */
+/*    THIS  SOFTWARE IS PROVIDED  BY THE  UNIVERSITY OF  TEXAS AT    */
+/*    AUSTIN  ``AS IS''  AND ANY  EXPRESS OR  IMPLIED WARRANTIES,    */
+/*    INCLUDING, BUT  NOT LIMITED  TO, THE IMPLIED  WARRANTIES OF    */
+/*    MERCHANTABILITY  AND FITNESS FOR  A PARTICULAR  PURPOSE ARE    */
+/*    DISCLAIMED.  IN  NO EVENT SHALL THE UNIVERSITY  OF TEXAS AT    */
+/*    AUSTIN OR CONTRIBUTORS BE  LIABLE FOR ANY DIRECT, INDIRECT,    */
+/*    INCIDENTAL,  SPECIAL, EXEMPLARY,  OR  CONSEQUENTIAL DAMAGES    */
+/*    (INCLUDING, BUT  NOT LIMITED TO,  PROCUREMENT OF SUBSTITUTE    */
+/*    GOODS  OR  SERVICES; LOSS  OF  USE,  DATA,  OR PROFITS;  OR    */
+/*    BUSINESS INTERRUPTION) HOWEVER CAUSED  AND ON ANY THEORY OF    */
+/*    LIABILITY, WHETHER  IN CONTRACT, STRICT  LIABILITY, OR TORT    */
+/*    (INCLUDING NEGLIGENCE OR OTHERWISE)  ARISING IN ANY WAY OUT    */
+/*    OF  THE  USE OF  THIS  SOFTWARE,  EVEN  IF ADVISED  OF  THE    */
+/*    POSSIBILITY OF SUCH DAMAGE.                                    */
+/*                                                                   */
+/* The views and conclusions contained in the software and           */
+/* documentation are those of the authors and should not be          */
+/* interpreted as representing official policies, either expressed   */
+/* or implied, of The University of Texas at Austin.                 */
+/*********************************************************************/
+
+#include "SegmentIndex.h"
+
+#include "Frame.h"
+
+#include <algorithm>
+
+namespace deflect
+{
+
+namespace
+{
+// Limits the memory used by the grid for sparse frames
+const size_t maxCellsPerSegment = 4;
+}
+
+SegmentIndex::SegmentIndex()
+    : _dimensions( 0, 0 )
+    , _cellWidth( 1 )
+    , _cellHeight( 1 )
+    , _columns( 0 )
+    , _rows( 0 )
+{
+}
+
+SegmentIndex::SegmentIndex( const Frame& frame )
+    : SegmentIndex()
+{
+    build( frame );
+}
+
+void SegmentIndex::build( const Frame& frame )
+{
+    _segments.clear();
+    _segments.reserve( frame.segments.size( ));
+
+    int width = 0, height = 0;
+    size_t totalWidth = 0, totalHeight = 0;
+    for( const Segment& segment : frame.segments )
+    {
+        const SegmentParameters& params = segment.parameters;
+        const Rect rect = { (int)params.x, (int)params.y,
+                            (int)params.width, (int)params.height };
+        _segments.push_back( rect );
+        width = std::max( width, rect.x + rect.width );
+        height = std::max( height, rect.y + rect.height );
+        totalWidth += rect.width;
+        totalHeight += rect.height;
+    }
+    _dimensions = QSize( width, height );
+
+    const size_t count = std::max( _segments.size(), size_t( 1 ));
+    _cellWidth = std::max( int( totalWidth / count ), 1 );
+    _cellHeight = std::max( int( totalHeight / count ), 1 );
+    for( ;; )
+    {
+        _columns = ( width + _cellWidth - 1 ) / _cellWidth;
+        _rows = ( height + _cellHeight - 1 ) / _cellHeight;
+        if( size_t( _columns ) * _rows <= maxCellsPerSegment * count )
+            break;
+        _cellWidth *= 2;
+        _cellHeight *= 2;
+    }
+
+    // Counting sort of the segments in the cells they overlap
+    const size_t cellCount = size_t( _columns ) * _rows;
+    _cellOffsets.assign( cellCount + 1, 0 );
+    for( int pass = 0; pass < 2; ++pass )
+    {
+        if( pass == 1 )
+        {
+            for( size_t i = 0; i < cellCount; ++i )
+                _cellOffsets[i + 1] += _cellOffsets[i];
+            _cellSegments.resize( _cellOffsets[cellCount] );
+        }
+
+        std::vector< size_t > fill( _cellOffsets.begin(),
+                                    _cellOffsets.end() - 1 );
+        for( size_t i = 0; i < _segments.size(); ++i )
+        {
+            const Rect& rect = _segments[i];
+            if( rect.width <= 0 || rect.height <= 0 )
+                continue;
+
+            const int col0 = rect.x / _cellWidth;
+            const int col1 = ( rect.x + rect.width - 1 ) / _cellWidth;
+            const int row0 = rect.y / _cellHeight;
+            const int row1 = ( rect.y + rect.height - 1 ) / _cellHeight;
+            for( int row = row0; row <= row1; ++row )
+            {
+                for( int col = col0; col <= col1; ++col )
+                {
+                    const size_t cell = size_t( row ) * _columns + col;
+                    if( pass == 0 )
+                        ++_cellOffsets[cell + 1];
+                    else
+                        _cellSegments[fill[cell]++] = i;
+                }
+            }
+        }
+    }
+}
+
+QSize SegmentIndex::getDimensions() const
+{
+    return _dimensions;
+}
+
+SegmentIndex::Indices SegmentIndex::findSegments( const QRect& region ) const
+{
+    Indices indices;
+
+    const int left = std::max( region.x(), 0 );
+    const int top = std::max( region.y(), 0 );
+    const int right = std::min( region.x() + region.width(),
+                                _dimensions.width( ));
+    const int bottom = std::min( region.y() + region.height(),
+                                 _dimensions.height( ));
+    if( left >= right || top >= bottom )
+        return indices;
+
+    const int col0 = left / _cellWidth;
+    const int col1 = ( right - 1 ) / _cellWidth;
+    const int row0 = top / _cellHeight;
+    const int row1 = ( bottom - 1 ) / _cellHeight;
+    for( int row = row0; row <= row1; ++row )
+    {
+        for( int col = col0; col <= col1; ++col )
+        {
+            const size_t cell = size_t( row ) * _columns + col;
+            for( size_t i = _cellOffsets[cell]; i < _cellOffsets[cell + 1]; ++i )
+            {
+                const size_t index = _cellSegments[i];
+                const Rect& rect = _segments[index];
+                const int x = std::max( rect.x, left );
+                const int y = std::max( rect.y, top );
+                if( x >= std::min( rect.x + rect.width, right ) ||
+                    y >= std::min( rect.y + rect.height, bottom ))
+                {
+                    continue;
+                }
+                // A segment spanning several cells is only reported by the
+                // cell which contains the corner of its intersection
+                if( x / _cellWidth == col && y / _cellHeight == row )
+                    indices.push_back( index );
+            }
+        }
+    }
+    std::sort( indices.begin(), indices.end( ));
+    return indices;
+}
+
+}
@@ -0,0 +1,114 @@
+/*********************************************************************/
+/* Copyright (c) 2015, EPFL/Blue Brain Project                       */
+/*                     Raphael Dumusc <raphael.dumusc@epfl.ch>       */
+/* All rights reserved.                                              */
+/*                                                                   */
+/* Redistribution and use in source and binary forms, with or        */
+/* without modification, are permitted provided that the following   */
+/* conditions are met:                                               */
+/*                                                                   */
+/*   1. Redistributions of source code must retain the above         */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer.                                                  */
+/*                                                                   */
+/*   2. Redistributions in binary form must reproduce the above      */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer in the documentation and/or other materials       */
+/*      provided with the distribution.                              */
+/*                                                                   */
+/*    THIS  SOFTWARE IS PROVIDED  BY THE  UNIVERSITY OF  TEXAS AT    */
+/*    AUSTIN  ``AS IS''  AND ANY  EXPRESS OR  IMPLIED WARRANTIES,    */
+/*    INCLUDING, BUT  NOT LIMITED  TO, THE IMPLIED  WARRANTIES OF    */
+/*    MERCHANTABILITY  AND FITNESS FOR  A PARTICULAR  PURPOSE ARE    */
+/*    DISCLAIMED.  IN  NO EVENT SHALL THE UNIVERSITY  OF TEXAS AT    */
+/*    AUSTIN OR CONTRIBUTORS BE  LIABLE FOR ANY DIRECT, INDIRECT,    */
+/*    INCIDENTAL,  SPECIAL, EXEMPLARY,  OR  CONSEQUENTIAL DAMAGES    */
+/*    (INCLUDING, BUT  NOT LIMITED TO,  PROCUREMENT OF SUBSTITUTE    */
+/*    GOODS  OR  SERVICES; LOSS  OF  USE,  DATA,  OR PROFITS;  OR    */
+/*    BUSINESS INTERRUPTION) HOWEVER CAUSED  AND ON ANY THEORY OF    */
+/*    LIABILITY, WHETHER  IN CONTRACT, STRICT  LIABILITY, OR TORT    */
+/*    (INCLUDING NEGLIGENCE OR OTHERWISE)  ARISING IN ANY WAY OUT    */
+/*    OF  THE  USE OF  THIS  SOFTWARE,  EVEN  IF ADVISED  OF  THE    */
+/*    POSSIBILITY OF SUCH DAMAGE.                                    */
+/*                                                                   */
+/* The views and conclusions contained in the software and           */
+/* documentation are those of the authors and should not be          */
+/* interpreted as representing official policies, either expressed   */
+/* or implied, of The University of Texas at Austin.                 */
+/*********************************************************************/
+
+#ifndef DEFLECT_SEGMENTINDEX_H
+#define DEFLECT_SEGMENTINDEX_H
+
+#include <deflect/api.h>
+#include <deflect/types.h>
+
+#include <QRect>
+#include <QSize>
+
+#include <vector>
+
+namespace deflect
+{
+
+/**
+ * Spatial index of the segments of a Frame.
+ *
+ * The index is built once per frame and answers region queries in time
+ * proportional to the number of segments found, rather than to the total
+ * number of segments. It is intended for frames with thousands of small
+ * segments, for which every display node would otherwise test all segments
+ * against its screen region.
+ *
+ * The segments are binned in a uniform grid whose cells have the average
+ * dimensions of the segments. The index keeps no reference to the frame and
+ * must be rebuilt if its segments change. Queries can run concurrently.
+ */
+class SegmentIndex
+{
+public:
+    typedef std::vector< size_t > Indices;
+
+    /** Construct an empty index. */
+    DEFLECT_API SegmentIndex();
+
+    /** Construct the index of a frame. */
+    DEFLECT_API explicit SegmentIndex( const Frame& frame );
+
+    /** Rebuild the index for a frame. */
+    DEFLECT_API void build( const Frame& frame );
+
+    /** @return the dimensions of the frame, same as Frame::computeDimensions() */
+    DEFLECT_API QSize getDimensions() const;
+
+    /**
+     * Find the segments which intersect a region.
+     * @param region The region, in the pixel coordinates of the frame
+     * @return the indices in Frame::segments of the segments intersecting the
+     *         region, in increasing order.
+     */
+    DEFLECT_API Indices findSegments( const QRect& region ) const;
+
+private:
+    struct Rect
+    {
+        int x, y, width, height;
+    };
+
+    QSize _dimensions;
+    int _cellWidth;
+    int _cellHeight;
+    int _columns;
+    int _rows;
+
+    /** Bounding rectangle of each segment */
+    std::vector< Rect > _segments;
+
+    /** Segments of cell i: _cellSegments[_cellOffsets[i], _cellOffsets[i+1]) */
+    std::vector< size_t > _cellOffsets;
+    std::vector< size_t > _cellSegments;
+};
+
+}
+
+#endif
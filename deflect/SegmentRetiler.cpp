@@ -0,0 +1,286 @@
+/*********************************************************************/
+/* Copyright (c) 2015, EPFL/Blue Brain Project                       */
+/*                     Raphael Dumusc <raphael.dumusc@epfl.ch>       */
+/* All rights reserved.                                              */
+/*                                                                   */
+/* Redistribution and use in source and binary forms, with or        */
+/* without modification, are permitted provided that the following   */
+/* conditions are met:                                               */
+/*                                                                   */
+/*   1. Redistributions of source code must retain the above         */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer.                                                  */
+/*                                                                   */
+/*   2. Redistributions in binary form must reproduce the above      */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer in the documentation and/or other materials       */
+/*      provided with the distribution.                              */
+/*                                                                   */
+/*    THIS  SOFTWARE IS PROVIDED  BY THE  UNIVERSITY OF  TEXAS AT    */
+/*    AUSTIN  ``AS IS''  AND ANY  EXPRESS OR  IMPLIED WARRANTIES,    */
+/*    INCLUDING, BUT  NOT LIMITED  TO, THE IMPLIED  WARRANTIES OF    */
+/*    MERCHANTABILITY  AND FITNESS FOR  A PARTICULAR  PURPOSE ARE    */
+/*    DISCLAIMED.  IN  NO EVENT SHALL THE UNIVERSITY  OF TEXAS AT    */
+/*    AUSTIN OR CONTRIBUTORS BE  LIABLE FOR ANY DIRECT, INDIRECT,    */
+/*    INCIDENTAL,  SPECIAL, EXEMPLARY,  OR  CONSEQUENTIAL DAMAGES    */
+/*    (INCLUDING, BUT  NOT LIMITED TO,  PROCUREMENT OF SUBSTITUTE    */
+/*    GOODS  OR  SERVICES; LOSS  OF  USE,  DATA,  OR PROFITS;  OR    */
+/*    BUSINESS INTERRUPTION) HOWEVER CAUSED  AND ON ANY THEORY OF    */
+/*    LIABILITY, WHETHER  IN CONTRACT, STRICT  LIABILITY, OR TORT    */
+/*    (INCLUDING NEGLIGENCE OR OTHERWISE)  ARISING IN ANY WAY OUT    */
+/*    OF  THE  USE OF  THIS  SOFTWARE,  EVEN  IF ADVISED  OF  THE    */
+/*    POSSIBILITY OF SUCH DAMAGE.                                    */
+/*                                                                   */
+/* The views and conclusions contained in the software and           */
+/* documentation are those of the authors and should not be          */
+/* interpreted as representing official policies, either expressed   */
+/* or implied, of The University of Texas at Austin.                 */
+/*********************************************************************/
+
+#include "SegmentRetiler.h"
+
+#include "Frame.h"
+#include "SegmentIndex.h"
+
+#include <turbojpeg.h>
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+namespace deflect
+{
+
+namespace
+{
+typedef std::vector< unsigned int > Cuts;
+
+/**
+ * Get the start of the sub-segments along one axis, in segment coordinates.
+ * @param position The position of the segment
+ * @param size The size of the segment
+ * @param edges The tile boundaries along the axis
+ * @param alignment Cuts are moved to a multiple of this value
+ */
+Cuts computeCuts( const unsigned int position, const unsigned int size,
+                  const std::vector< int >& edges, const unsigned int alignment )
+{
+    Cuts cuts = { 0 };
+    for( const int edge : edges )
+    {
+        if( edge <= (int)position || edge >= int( position + size ))
+            continue;
+        const unsigned int cut = edge - position;
+        cuts.push_back( cut - cut % alignment );
+    }
+    std::sort( cuts.begin(), cuts.end( ));
+    cuts.erase( std::unique( cuts.begin(), cuts.end( )), cuts.end( ));
+    cuts.push_back( size ); // end of the last sub-segment
+    return cuts;
+}
+}
+
+class SegmentRetiler::Impl
+{
+public:
+    Impl()
+        : tjHandle( tjInitTransform( ))
+    {}
+
+    ~Impl()
+    {
+        tjDestroy( tjHandle );
+    }
+
+    bool cutJpeg( const Segment& segment, Segments& output )
+    {
+        int width, height, jpegSubsamp;
+        if( tjDecompressHeader2( tjHandle,
+                                 (unsigned char*)segment.imageData.data(),
+                                 (unsigned long)segment.imageData.size(),
+                                 &width, &height, &jpegSubsamp ) != 0 ||
+            width != (int)segment.parameters.width ||
+            height != (int)segment.parameters.height )
+        {
+            std::cerr << "libjpeg-turbo header decompression failure"
+                      << std::endl;
+            output.push_back( segment );
+            return false;
+        }
+
+        // Recent libjpeg-turbo versions report TJSAMP_UNKNOWN (-1) for
+        // subsamplings which have no MCU size in the tables
+        if( jpegSubsamp < 0 || jpegSubsamp >= TJ_NUMSAMP )
+        {
+            std::cerr << "Unsupported JPEG subsampling: " << jpegSubsamp
+                      << std::endl;
+            output.push_back( segment );
+            return false;
+        }
+
+        const Cuts xCuts = computeCuts( segment.parameters.x, width, xEdges,
+                                        tjMCUWidth[jpegSubsamp] );
+        const Cuts yCuts = computeCuts( segment.parameters.y, height, yEdges,
+                                        tjMCUHeight[jpegSubsamp] );
+        if( xCuts.size() == 2 && yCuts.size() == 2 )
+        {
+            output.push_back( segment );
+            return true;
+        }
+
+        std::vector< tjtransform > transforms;
+        for( size_t j = 0; j < yCuts.size() - 1; ++j )
+        {
+            for( size_t i = 0; i < xCuts.size() - 1; ++i )
+            {
+                tjtransform transform;
+                std::memset( &transform, 0, sizeof( transform ));
+                transform.r.x = xCuts[i];
+                transform.r.y = yCuts[j];
+                transform.r.w = xCuts[i+1] - xCuts[i];
+                transform.r.h = yCuts[j+1] - yCuts[j];
+                transform.op = TJXOP_NONE;
+                transform.options = TJXOPT_CROP;
+                transforms.push_back( transform );
+            }
+        }
+
+        // All the crops are done in one pass over the DCT coefficients
+        std::vector< unsigned char* > buffers( transforms.size(), nullptr );
+        std::vector< unsigned long > sizes( transforms.size(), 0 );
+        const int err = tjTransform( tjHandle,
+                                     (unsigned char*)segment.imageData.data(),
+                                     (unsigned long)segment.imageData.size(),
+                                     transforms.size(), buffers.data(),
+                                     sizes.data(), transforms.data(), 0 );
+        if( err == 0 )
+        {
+            for( size_t i = 0; i < transforms.size(); ++i )
+            {
+                Segment subSegment;
+                subSegment.parameters = segment.parameters;
+                subSegment.parameters.x += transforms[i].r.x;
+                subSegment.parameters.y += transforms[i].r.y;
+                subSegment.parameters.width = transforms[i].r.w;
+                subSegment.parameters.height = transforms[i].r.h;
+                subSegment.imageData = QByteArray( (const char*)buffers[i],
+                                                   sizes[i] );
+                output.push_back( subSegment );
+            }
+        }
+        else
+        {
+            std::cerr << "libjpeg-turbo lossless crop failure" << std::endl;
+            output.push_back( segment );
+        }
+
+        for( unsigned char* buffer : buffers )
+            tjFree( buffer );
+        return err == 0;
+    }
+
+    void cutRaw( const Segment& segment, Segments& output ) const
+    {
+        const SegmentParameters& params = segment.parameters;
+        const int rowSize = params.width * 4;
+        const Cuts xCuts = computeCuts( params.x, params.width, xEdges, 1 );
+        const Cuts yCuts = computeCuts( params.y, params.height, yEdges, 1 );
+        if(( xCuts.size() == 2 && yCuts.size() == 2 ) ||
+            segment.imageData.size() < rowSize * (int)params.height )
+        {
+            output.push_back( segment );
+            return;
+        }
+
+        for( size_t j = 0; j < yCuts.size() - 1; ++j )
+        {
+            for( size_t i = 0; i < xCuts.size() - 1; ++i )
+            {
+                Segment subSegment;
+                subSegment.parameters = params;
+                subSegment.parameters.x += xCuts[i];
+                subSegment.parameters.y += yCuts[j];
+                subSegment.parameters.width = xCuts[i+1] - xCuts[i];
+                subSegment.parameters.height = yCuts[j+1] - yCuts[j];
+
+                const int subRowSize = subSegment.parameters.width * 4;
+                subSegment.imageData = QByteArray( subRowSize *
+                                                   subSegment.parameters.height,
+                                                   Qt::Uninitialized );
+                const char* source = segment.imageData.constData() +
+                                     yCuts[j] * rowSize + xCuts[i] * 4;
+                char* dest = subSegment.imageData.data();
+                for( unsigned int y = 0; y < subSegment.parameters.height; ++y )
+                    std::memcpy( dest + y * subRowSize, source + y * rowSize,
+                                 subRowSize );
+                output.push_back( subSegment );
+            }
+        }
+    }
+
+    tjhandle tjHandle;
+
+    std::vector< QRect > tiles;
+    std::vector< int > xEdges;
+    std::vector< int > yEdges;
+
+    std::vector< std::vector< size_t >> tileSegments;
+};
+
+SegmentRetiler::SegmentRetiler()
+    : _impl( new Impl )
+{
+}
+
+SegmentRetiler::~SegmentRetiler()
+{
+    delete _impl;
+}
+
+void SegmentRetiler::setTiles( const std::vector< QRect >& tiles )
+{
+    _impl->tiles = tiles;
+    _impl->xEdges.clear();
+    _impl->yEdges.clear();
+    for( const QRect& tile : tiles )
+    {
+        _impl->xEdges.push_back( tile.x( ));
+        _impl->xEdges.push_back( tile.x() + tile.width( ));
+        _impl->yEdges.push_back( tile.y( ));
+        _impl->yEdges.push_back( tile.y() + tile.height( ));
+    }
+    _impl->tileSegments.assign( tiles.size(), std::vector< size_t >( ));
+}
+
+const std::vector< QRect >& SegmentRetiler::getTiles() const
+{
+    return _impl->tiles;
+}
+
+bool SegmentRetiler::retile( Frame& frame )
+{
+    bool success = true;
+    Segments output;
+    output.reserve( frame.segments.size( ));
+    for( const Segment& segment : frame.segments )
+    {
+        if( segment.parameters.compressed )
+            success = _impl->cutJpeg( segment, output ) && success;
+        else
+            _impl->cutRaw( segment, output );
+    }
+    frame.segments.swap( output );
+
+    const SegmentIndex index( frame );
+    for( size_t tile = 0; tile < _impl->tiles.size(); ++tile )
+        _impl->tileSegments[tile] = index.findSegments( _impl->tiles[tile] );
+    return success;
+}
+
+const std::vector< size_t >&
+SegmentRetiler::getTileSegments( const size_t tileIndex ) const
+{
+    return _impl->tileSegments.at( tileIndex );
+}
+
+}
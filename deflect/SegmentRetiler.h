@@ -0,0 +1,115 @@
+/*********************************************************************/
+/* Copyright (c) 2015, EPFL/Blue Brain Project                       */
+/*                     Raphael Dumusc <raphael.dumusc@epfl.ch>       */
+/* All rights reserved.                                              */
+/*                                                                   */
+/* Redistribution and use in source and binary forms, with or        */
+/* without modification, are permitted provided that the following   */
+/* conditions are met:                                               */
+/*                                                                   */
+/*   1. Redistributions of source code must retain the above         */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer.                                                  */
+/*                                                                   */
+/*   2. Redistributions in binary form must reproduce the above      */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer in the documentation and/or other materials       */
+/*      provided with the distribution.                              */
+/*                                                                   */
+/*    THIS  SOFTWARE IS PROVIDED  BY THE  UNIVERSITY OF  TEXAS AT    */
+/*    AUSTIN  ``AS IS''  AND ANY  EXPRESS OR  IMPLIED WARRANTIES,    */
+/*    INCLUDING, BUT  NOT LIMITED  TO, THE IMPLIED  WARRANTIES OF    */
+/*    MERCHANTABILITY  AND FITNESS FOR  A PARTICULAR  PURPOSE ARE    */
+/*    DISCLAIMED.  IN  NO EVENT SHALL THE UNIVERSITY  OF TEXAS AT    */
+/*    AUSTIN OR CONTRIBUTORS BE  LIABLE FOR ANY DIRECT, INDIRECT,    */
+/*    INCIDENTAL,  SPECIAL, EXEMPLARY,  OR  CONSEQUENTIAL DAMAGES    */
+/*    (INCLUDING, BUT  NOT LIMITED TO,  PROCUREMENT OF SUBSTITUTE    */
+/*    GOODS  OR  SERVICES; LOSS  OF  USE,  DATA,  OR PROFITS;  OR    */
+/*    BUSINESS INTERRUPTION) HOWEVER CAUSED  AND ON ANY THEORY OF    */
+/*    LIABILITY, WHETHER  IN CONTRACT, STRICT  LIABILITY, OR TORT    */
+/*    (INCLUDING NEGLIGENCE OR OTHERWISE)  ARISING IN ANY WAY OUT    */
+/*    OF  THE  USE OF  THIS  SOFTWARE,  EVEN  IF ADVISED  OF  THE    */
+/*    POSSIBILITY OF SUCH DAMAGE.                                    */
+/*                                                                   */
+/* The views and conclusions contained in the software and           */
+/* documentation are those of the authors and should not be          */
+/* interpreted as representing official policies, either expressed   */
+/* or implied, of The University of Texas at Austin.                 */
+/*********************************************************************/
+
+#ifndef DEFLECT_SEGMENTRETILER_H
+#define DEFLECT_SEGMENTRETILER_H
+
+#include <deflect/api.h>
+#include <deflect/types.h>
+
+#include <QRect>
+
+#include <boost/noncopyable.hpp>
+
+#include <vector>
+
+namespace deflect
+{
+
+/**
+ * Cut the segments of frames along the boundaries of display tiles.
+ *
+ * Streamers send segments of a fixed size (512x512 by default) which usually
+ * straddle the screens of a display wall, so that each node would decode
+ * whole segments only to use a part of them. The retiler splits the segments
+ * at the tile boundaries beforehand, so that each node receives and decodes
+ * only what it displays.
+ *
+ * Jpeg segments are cut with the lossless crop transform of libjpeg-turbo,
+ * which works on the DCT coefficients without decoding the image. A crop must
+ * start on an MCU boundary (8 or 16 pixels depending on the chroma
+ * subsampling), so each cut is moved left or up to the closest MCU boundary;
+ * the sub-segment after the cut may thus overlap the previous tile by a few
+ * pixels. Raw segments are cut exactly at the tile boundaries.
+ */
+class SegmentRetiler : public boost::noncopyable
+{
+public:
+    /** Construct a retiler without tiles. */
+    DEFLECT_API SegmentRetiler();
+
+    /** Destruct the retiler. */
+    DEFLECT_API ~SegmentRetiler();
+
+    /**
+     * Set the display tiles.
+     * @param tiles The regions covered by each tile (for instance each wall
+     *        node), in the pixel coordinates of the frames.
+     */
+    DEFLECT_API void setTiles( const std::vector< QRect >& tiles );
+
+    /** @return the display tiles. */
+    DEFLECT_API const std::vector< QRect >& getTiles() const;
+
+    /**
+     * Cut the segments of a frame at the boundaries of the tiles.
+     *
+     * Segments which fail to be transformed are kept whole.
+     * @param frame The frame whose segments are replaced by the sub-segments.
+     * @return false if any Jpeg segment could not be transformed.
+     */
+    DEFLECT_API bool retile( Frame& frame );
+
+    /**
+     * Get the segments needed by a tile, as computed by the last retile().
+     * @param tileIndex The index of the tile in setTiles()
+     * @return the indices of the segments of the last retiled frame which
+     *         intersect the tile.
+     */
+    DEFLECT_API const std::vector< size_t >&
+    getTileSegments( size_t tileIndex ) const;
+
+private:
+    class Impl;
+    Impl* _impl;
+};
+
+}
+
+#endif
@@ -45,12 +45,25 @@
 #include "NetworkProtocol.h"
 #include "ServerWorker.h"
 
+#ifdef DEFLECT_USE_IOURING
+#  include "IoUringReceiver.h"
+#endif
+
 #ifdef DEFLECT_USE_SERVUS
 #  include <servus/servus.h>
 #  include <boost/lexical_cast.hpp>
 #endif
 
+#include <QLocalServer>
+#include <QSaveFile>
+#include <QTcpSocket>
 #include <QThread>
+#include <QTimer>
+
+#include <atomic>
+#include <functional>
+#include <iostream>
+#include <memory>
 #include <stdexcept>
 
 namespace deflect
@@ -58,25 +71,70 @@ namespace deflect
 const int Server::defaultPortNumber = DEFAULT_PORT_NUMBER;
 const std::string Server::serviceName = SERVUS_SERVICE_NAME;
 
+namespace
+{
+/** Forward the connections on a Unix domain socket to the Server. */
+class LocalServer : public QLocalServer
+{
+public:
+    LocalServer( QObject* parent,
+                 const std::function< void( quintptr ) >& callback )
+        : QLocalServer( parent )
+        , onConnection( callback )
+    {}
+
+    const std::function< void( quintptr ) > onConnection;
+
+private:
+    void incomingConnection( const quintptr socketHandle ) final
+    {
+        onConnection( socketHandle );
+    }
+};
+}
+
 class Server::Impl
 {
 public:
     Impl()
+        : connections( std::make_shared< std::atomic< size_t >>( 0 ))
+        , metricsTimer( nullptr )
+        , metricsServer( nullptr )
+        , ioUringEnabled( false )
 #ifdef DEFLECT_USE_SERVUS
-        : servus( Server::serviceName )
+        , servus( Server::serviceName )
 #endif
     {}
 
     FrameDispatcher pixelStreamDispatcher;
+    QThread dispatcherThread;
     CommandHandler commandHandler;
+    /** Child of the Server so that it moves along to its thread */
+    LocalServer* localServer;
+    /** Shared with the workers, which may outlive the Server */
+    std::shared_ptr< std::atomic< size_t >> connections;
+    /** Children of the Server, created on demand */
+    QTimer* metricsTimer;
+    QTcpServer* metricsServer;
+    QString metricsFile;
+    bool ioUringEnabled;
 #ifdef DEFLECT_USE_SERVUS
     servus::Servus servus;
 #endif
+#ifdef DEFLECT_USE_IOURING
+    /** Last member: its workers are deleted before the dispatcher */
+    std::unique_ptr< IoUringReceiver > ioUringReceiver;
+#endif
 };
 
 Server::Server( const int port )
     : _impl( new Impl )
 {
+    _impl->localServer = new LocalServer( this, [this]( quintptr handle )
+    {
+        _startWorker( handle, true );
+    });
+
     if( !listen( QHostAddress::Any, port ))
     {
         const QString err =
@@ -90,6 +148,19 @@ Server::Server( const int port )
 
 Server::~Server()
 {
+    _impl->localServer->close();
+
+    // The workers call the dispatcher directly, including from their
+    // destructor, which runs when their thread finishes
+    for( QThread* workerThread :
+         findChildren< QThread* >( QString(), Qt::FindDirectChildrenOnly ))
+    {
+        workerThread->quit();
+        workerThread->wait();
+    }
+
+    _impl->dispatcherThread.quit();
+    _impl->dispatcherThread.wait();
     delete _impl;
 }
 
@@ -103,6 +174,153 @@ FrameDispatcher& Server::getPixelStreamDispatcher()
     return _impl->pixelStreamDispatcher;
 }
 
+void Server::startDispatcherThread()
+{
+    if( _impl->dispatcherThread.isRunning( ))
+        return;
+
+    _impl->pixelStreamDispatcher.moveToDispatcherThread(
+                &_impl->dispatcherThread );
+    _impl->dispatcherThread.start();
+}
+
+bool Server::listenLocal( const QString& path )
+{
+    _impl->localServer->close();
+
+    QLocalServer::removeServer( path );
+    if( _impl->localServer->listen( path ))
+        return true;
+
+    std::cerr << "could not listen on local socket " << path.toStdString()
+              << ": " << _impl->localServer->errorString().toStdString()
+              << std::endl;
+    return false;
+}
+
+QString Server::getLocalSocketPath() const
+{
+    return _impl->localServer->fullServerName();
+}
+
+bool Server::setIoUringEnabled( const bool enabled )
+{
+#ifdef DEFLECT_USE_IOURING
+    if( enabled && !_impl->ioUringReceiver )
+    {
+        try
+        {
+            _impl->ioUringReceiver.reset( new IoUringReceiver );
+        }
+        catch( const std::runtime_error& e )
+        {
+            std::cerr << "could not start the io_uring receiver: " << e.what()
+                      << std::endl;
+            return false;
+        }
+    }
+    _impl->ioUringEnabled = enabled;
+    return true;
+#else
+    return !enabled;
+#endif
+}
+
+bool Server::isIoUringEnabled() const
+{
+    return _impl->ioUringEnabled;
+}
+
+ServerMetrics Server::getMetrics() const
+{
+    ServerMetrics metrics;
+    metrics.connections = *_impl->connections;
+    metrics.streams = _impl->pixelStreamDispatcher.getMetrics();
+    return metrics;
+}
+
+void Server::setMetricsFile( const QString& filename,
+                             const unsigned int intervalMs )
+{
+    _impl->metricsFile = filename;
+    if( filename.isEmpty( ))
+    {
+        if( _impl->metricsTimer )
+            _impl->metricsTimer->stop();
+        return;
+    }
+
+    if( !_impl->metricsTimer )
+    {
+        _impl->metricsTimer = new QTimer( this );
+        connect( _impl->metricsTimer, &QTimer::timeout, [this]
+        {
+            QSaveFile file( _impl->metricsFile );
+            if( !file.open( QIODevice::WriteOnly ))
+                return;
+            const std::string metrics = getMetrics().toPrometheus();
+            file.write( QByteArray::fromStdString( metrics ));
+            if( !file.commit( ))
+                std::cerr << "could not write metrics to "
+                          << _impl->metricsFile.toStdString() << std::endl;
+        });
+    }
+    _impl->metricsTimer->start( intervalMs );
+}
+
+bool Server::listenMetrics( const quint16 port )
+{
+    if( !_impl->metricsServer )
+    {
+        _impl->metricsServer = new QTcpServer( this );
+        connect( _impl->metricsServer, &QTcpServer::newConnection, [this]
+        {
+            while( QTcpSocket* socket =
+                   _impl->metricsServer->nextPendingConnection( ))
+            {
+                connect( socket, &QTcpSocket::disconnected,
+                         socket, &QTcpSocket::deleteLater );
+                connect( socket, &QTcpSocket::readyRead, [this, socket]
+                {
+                    // Answer once the request is complete, closing the socket
+                    // with unread data would reset the connection
+                    const QByteArray request = socket->peek(
+                                socket->bytesAvailable( ));
+                    if( !request.contains( "\r\n\r\n" ))
+                        return;
+                    socket->readAll();
+
+                    const QByteArray body = QByteArray::fromStdString(
+                                getMetrics().toPrometheus( ));
+                    socket->write( "HTTP/1.0 200 OK\r\n"
+                                   "Content-Type: text/plain; "
+                                   "version=0.0.4\r\n"
+                                   "Content-Length: " +
+                                   QByteArray::number( body.size( )) +
+                                   "\r\n\r\n" + body );
+                    socket->disconnectFromHost();
+                });
+            }
+        });
+    }
+
+    _impl->metricsServer->close();
+    if( _impl->metricsServer->listen( QHostAddress::LocalHost, port ))
+        return true;
+
+    std::cerr << "could not serve metrics on port " << port << ": "
+              << _impl->metricsServer->errorString().toStdString()
+              << std::endl;
+    return false;
+}
+
+quint16 Server::getMetricsPort() const
+{
+    if( !_impl->metricsServer || !_impl->metricsServer->isListening( ))
+        return 0;
+    return _impl->metricsServer->serverPort();
+}
+
 void Server::onPixelStreamerClosed( const QString uri )
 {
     emit _pixelStreamerClosed( uri );
@@ -115,8 +333,28 @@ void Server::onEventRegistrationReply( const QString uri, const bool success )
 
 void Server::incomingConnection( const qintptr socketHandle )
 {
+    _startWorker( socketHandle, false );
+}
+
+void Server::_startWorker( const int socketHandle, const bool localSocket )
+{
+#ifdef DEFLECT_USE_IOURING
+    if( _impl->ioUringEnabled )
+    {
+        ServerWorker* worker =
+                _impl->ioUringReceiver->addConnection( socketHandle );
+        if( worker )
+        {
+            _connectWorker( worker );
+            QMetaObject::invokeMethod( worker, "initConnection",
+                                       Qt::QueuedConnection );
+            return;
+        }
+    }
+#endif
+
     QThread* workerThread = new QThread( this );
-    ServerWorker* worker = new ServerWorker( socketHandle );
+    ServerWorker* worker = new ServerWorker( socketHandle, localSocket );
 
     worker->moveToThread( workerThread );
 
@@ -131,6 +369,17 @@ void Server::incomingConnection( const qintptr socketHandle )
     connect( workerThread, &QThread::finished,
              workerThread, &QThread::deleteLater );
 
+    _connectWorker( worker );
+
+    workerThread->start();
+}
+
+void Server::_connectWorker( ServerWorker* worker )
+{
+    std::shared_ptr< std::atomic< size_t >> connections = _impl->connections;
+    ++*connections;
+    connect( worker, &QObject::destroyed, [connections] { --*connections; });
+
     // public signals/slots, forwarding from/to worker
     connect( worker, &ServerWorker::registerToEvents,
              this, &Server::registerToEvents );
@@ -145,23 +394,25 @@ void Server::incomingConnection( const qintptr socketHandle )
     connect( worker, &ServerWorker::receivedCommand,
              &_impl->commandHandler, &CommandHandler::process );
 
-    // PixelStreamDispatcher
+    // PixelStreamDispatcher, thread-safe: direct calls from the worker thread
+    // feed its lock-free queue instead of going through Qt's event queue.
     connect( worker, &ServerWorker::addStreamSource,
-             &_impl->pixelStreamDispatcher, &FrameDispatcher::addSource );
+             &_impl->pixelStreamDispatcher, &FrameDispatcher::addSource,
+             Qt::DirectConnection );
     connect( worker,
              &ServerWorker::receivedSegment,
              &_impl->pixelStreamDispatcher,
-             &FrameDispatcher::processSegment );
+             &FrameDispatcher::processSegment, Qt::DirectConnection );
     connect( worker,
              &ServerWorker::receivedFrameFinished,
              &_impl->pixelStreamDispatcher,
-             &FrameDispatcher::processFrameFinished );
+             &FrameDispatcher::processFrameFinished, Qt::DirectConnection );
     connect( worker,
              &ServerWorker::removeStreamSource,
              &_impl->pixelStreamDispatcher,
-             &FrameDispatcher::removeSource );
-
-    workerThread->start();
+             &FrameDispatcher::removeSource, Qt::DirectConnection );
+    connect( &_impl->pixelStreamDispatcher, &FrameDispatcher::framesConsumed,
+             worker, &ServerWorker::acknowledgeFrames );
 }
 
 }
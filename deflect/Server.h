@@ -43,6 +43,7 @@
 
 #include <deflect/api.h>
 #include <deflect/types.h>
+#include <deflect/ServerMetrics.h>
 #include <deflect/SizeHints.h>
 
 #include <QtNetwork/QTcpServer>
@@ -50,6 +51,8 @@
 namespace deflect
 {
 
+class ServerWorker;
+
 /**
  * Listen to incoming PixelStream connections from Stream clients.
  */
@@ -80,6 +83,84 @@ public:
     /** Get the PixelStreamDispatcher. */
     DEFLECT_API FrameDispatcher& getPixelStreamDispatcher();
 
+    /**
+     * Move the PixelStreamDispatcher to a dedicated ingest thread.
+     *
+     * By default, segments are assembled into frames in the thread of the
+     * Server, which is usually the GUI thread of the application. After this
+     * call, all the ingest work happens in a separate thread and the
+     * dispatcher's signals are delivered to their receivers through queued
+     * connections. The thread is stopped when the Server is destroyed.
+     * Call it before the Server accepts the first Stream connection.
+     */
+    DEFLECT_API void startDispatcherThread();
+
+    /**
+     * Also listen for Stream connections on a Unix domain socket.
+     *
+     * Streams on the same host can connect to it with the address
+     * "unix:<path>", which avoids the overhead of the TCP loopback. The
+     * connections are otherwise handled like TCP ones.
+     * @param path The path of the socket in the filesystem. A socket left
+     *        over at this path by a previous Server is removed.
+     * @return true on success, false if the socket could not be created.
+     */
+    DEFLECT_API bool listenLocal( const QString& path );
+
+    /** @return the path of the Unix domain socket, empty if not listening. */
+    DEFLECT_API QString getLocalSocketPath() const;
+
+    /**
+     * Receive the messages of all new connections with an io_uring engine.
+     *
+     * By default, each connection is read by a dedicated thread. The io_uring
+     * engine instead reads all of them from a single thread, which scales
+     * better to a large number of streams. It is only available on Linux when
+     * Deflect is built with the DEFLECT_ENABLE_IOURING CMake option.
+     * Connections beyond the capacity of the engine (256) fall back to a
+     * dedicated thread.
+     * @param enabled true to use the engine for the next connections.
+     * @return false if the engine is not available.
+     */
+    DEFLECT_API bool setIoUringEnabled( bool enabled );
+
+    /** @return true if new connections are received with io_uring. */
+    DEFLECT_API bool isIoUringEnabled() const;
+
+    /**
+     * Get a snapshot of the metrics of the Server and of its streams.
+     *
+     * Cheap and thread-safe, it can be called periodically in production.
+     * @see FrameDispatcher::getMetrics()
+     */
+    DEFLECT_API ServerMetrics getMetrics() const;
+
+    /**
+     * Periodically write the metrics to a file.
+     *
+     * The file is replaced atomically with the metrics in the Prometheus text
+     * exposition format, for instance for the textfile collector of the
+     * node exporter. Must be called from the thread of the Server.
+     * @param filename The path of the file, empty to stop writing it
+     * @param intervalMs The interval between two updates of the file
+     */
+    DEFLECT_API void setMetricsFile( const QString& filename,
+                                     unsigned int intervalMs = 1000 );
+
+    /**
+     * Serve the metrics over HTTP on the loopback interface.
+     *
+     * Any request on the port is answered with the metrics in the Prometheus
+     * text exposition format. Must be called from the thread of the Server.
+     * @param port The port to listen on, 0 for any available port
+     * @return true on success, false if the port could not be opened
+     * @see getMetricsPort()
+     */
+    DEFLECT_API bool listenMetrics( quint16 port );
+
+    /** @return the port serving the metrics, 0 if not listening. */
+    DEFLECT_API quint16 getMetricsPort() const;
+
 signals:
     DEFLECT_API void registerToEvents( QString uri, bool exclusive,
                                        deflect::EventReceiver* receiver );
@@ -97,6 +178,9 @@ private:
     /** Re-implemented handling of connections from QTCPSocket. */
     void incomingConnection( qintptr socketHandle ) final;
 
+    void _startWorker( int socketHandle, bool localSocket );
+    void _connectWorker( ServerWorker* worker );
+
 signals:
     void _pixelStreamerClosed( QString uri );
     void _eventRegistrationReply( QString uri, bool success );
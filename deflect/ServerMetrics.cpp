@@ -0,0 +1,148 @@
+/*********************************************************************/
+/* Copyright (c) 2015, EPFL/Blue Brain Project                       */
+/*                     Raphael Dumusc <raphael.dumusc@epfl.ch>       */
+/* All rights reserved.                                              */
+/*                                                                   */
+/* Redistribution and use in source and binary forms, with or        */
+/* without modification, are permitted provided that the following   */
+/* conditions are met:                                               */
+/*                                                                   */
+/*   1. Redistributions of source code must retain the above         */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer.                                                  */
+/*                                                                   */
+/*   2. Redistributions in binary form must reproduce the above      */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer in the documentation and/or other materials       */
+/*      provided with the distribution.                              */
+/*                                                                   */
+/*    THIS  SOFTWARE IS PROVIDED  BY THE  UNIVERSITY OF  TEXAS AT    */
+/*    AUSTIN  ``AS IS''  AND ANY  EXPRESS OR  IMPLIED WARRANTIES,    */
+/*    INCLUDING, BUT  NOT LIMITED  TO, THE IMPLIED  WARRANTIES OF    */
+/*    MERCHANTABILITY  AND FITNESS FOR  A PARTICULAR  PURPOSE ARE    */
+/*    DISCLAIMED.  IN  NO EVENT SHALL THE UNIVERSITY  OF TEXAS AT    */
+/*    AUSTIN OR CONTRIBUTORS BE  LIABLE FOR ANY DIRECT, INDIRECT,    */
+/*    INCIDENTAL,  SPECIAL, EXEMPLARY,  OR  CONSEQUENTIAL DAMAGES    */
+/*    (INCLUDING, BUT  NOT LIMITED TO,  PROCUREMENT OF SUBSTITUTE    */
+/*    GOODS  OR  SERVICES; LOSS  OF  USE,  DATA,  OR PROFITS;  OR    */
+/*    BUSINESS INTERRUPTION) HOWEVER CAUSED  AND ON ANY THEORY OF    */
+/*    LIABILITY, WHETHER  IN CONTRACT, STRICT  LIABILITY, OR TORT    */
+/*    (INCLUDING NEGLIGENCE OR OTHERWISE)  ARISING IN ANY WAY OUT    */
+/*    OF  THE  USE OF  THIS  SOFTWARE,  EVEN  IF ADVISED  OF  THE    */
+/*    POSSIBILITY OF SUCH DAMAGE.                                    */
+/*                                                                   */
+/* The views and conclusions contained in the software and           */
+/* documentation are those of the authors and should not be          */
+/* interpreted as representing official policies, either expressed   */
+/* or implied, of The University of Texas at Austin.                 */
+/*********************************************************************/
+
+#include "ServerMetrics.h"
+
+#include <sstream>
+
+namespace deflect
+{
+
+namespace
+{
+std::string escapeLabel( const QString& value )
+{
+    std::string escaped;
+    for( const char c : value.toStdString( ))
+    {
+        switch( c )
+        {
+        case '\\': escaped += "\\\\"; break;
+        case '"':  escaped += "\\\""; break;
+        case '\n': escaped += "\\n"; break;
+        default:   escaped += c; break;
+        }
+    }
+    return escaped;
+}
+
+void writeHeader( std::ostream& out, const char* name, const char* type,
+                  const char* help )
+{
+    out << "# HELP " << name << " " << help << "\n"
+        << "# TYPE " << name << " " << type << "\n";
+}
+
+template< typename T >
+void writeStreamMetric( std::ostream& out, const ServerMetrics& metrics,
+                        const char* name, const char* type, const char* help,
+                        T StreamMetrics::* member )
+{
+    writeHeader( out, name, type, help );
+    for( const StreamMetrics& stream : metrics.streams )
+        out << name << "{stream=\"" << escapeLabel( stream.uri ) << "\"} "
+            << stream.*member << "\n";
+}
+
+template< typename T >
+void writeSourceMetric( std::ostream& out, const ServerMetrics& metrics,
+                        const char* name, const char* type, const char* help,
+                        T SourceMetrics::* member )
+{
+    writeHeader( out, name, type, help );
+    for( const StreamMetrics& stream : metrics.streams )
+    {
+        const std::string uri = escapeLabel( stream.uri );
+        for( const SourceMetrics& source : stream.sources )
+            out << name << "{stream=\"" << uri << "\",source=\""
+                << source.sourceIndex << "\"} " << source.*member << "\n";
+    }
+}
+}
+
+std::string ServerMetrics::toPrometheus() const
+{
+    std::ostringstream out;
+
+    writeHeader( out, "deflect_connections", "gauge",
+                 "Number of open Stream connections." );
+    out << "deflect_connections " << connections << "\n";
+
+    writeStreamMetric( out, *this, "deflect_stream_frames_received_total",
+                       "counter", "Frames finished by the fastest source.",
+                       &StreamMetrics::framesReceived );
+    writeStreamMetric( out, *this, "deflect_stream_frames_dispatched_total",
+                       "counter", "Frames dispatched to the application.",
+                       &StreamMetrics::framesDispatched );
+    writeStreamMetric( out, *this, "deflect_stream_frames_dropped_total",
+                       "counter", "Complete frames dropped before dispatch.",
+                       &StreamMetrics::framesDropped );
+    writeStreamMetric( out, *this, "deflect_stream_segments_received_total",
+                       "counter", "Segments received.",
+                       &StreamMetrics::segmentsReceived );
+    writeStreamMetric( out, *this, "deflect_stream_bytes_received_total",
+                       "counter", "Image data received in bytes.",
+                       &StreamMetrics::bytesReceived );
+    writeStreamMetric( out, *this, "deflect_stream_frames_per_second", "gauge",
+                       "Frames received per second.",
+                       &StreamMetrics::framesPerSecond );
+    writeStreamMetric( out, *this, "deflect_stream_bytes_per_second", "gauge",
+                       "Image data received per second in bytes.",
+                       &StreamMetrics::bytesPerSecond );
+    writeStreamMetric( out, *this, "deflect_stream_segments_per_frame", "gauge",
+                       "Average number of segments per frame.",
+                       &StreamMetrics::segmentsPerFrame );
+    writeStreamMetric( out, *this, "deflect_stream_buffered_frames", "gauge",
+                       "Complete frames waiting in the receive buffer.",
+                       &StreamMetrics::bufferedFrames );
+    writeStreamMetric( out, *this, "deflect_stream_buffered_bytes", "gauge",
+                       "Image data in the receive buffer in bytes.",
+                       &StreamMetrics::bufferedBytes );
+
+    writeSourceMetric( out, *this, "deflect_source_frames_finished_total",
+                       "counter", "Frames finished by the source.",
+                       &SourceMetrics::framesFinished );
+    writeSourceMetric( out, *this, "deflect_source_frames_behind", "gauge",
+                       "Frames behind the fastest source of the stream.",
+                       &SourceMetrics::framesBehind );
+
+    return out.str();
+}
+
+}
@@ -0,0 +1,142 @@
+/*********************************************************************/
+/* Copyright (c) 2015, EPFL/Blue Brain Project                       */
+/*                     Raphael Dumusc <raphael.dumusc@epfl.ch>       */
+/* All rights reserved.                                              */
+/*                                                                   */
+/* Redistribution and use in source and binary forms, with or        */
+/* without modification, are permitted provided that the following   */
+/* conditions are met:                                               */
+/*                                                                   */
+/*   1. Redistributions of source code must retain the above         */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer.                                                  */
+/*                                                                   */
+/*   2. Redistributions in binary form must reproduce the above      */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer in the documentation and/or other materials       */
+/*      provided with the distribution.                              */
+/*                                                                   */
+/*    THIS  SOFTWARE IS PROVIDED  BY THE  UNIVERSITY OF  TEXAS AT    */
+/*    AUSTIN  ``AS IS''  AND ANY  EXPRESS OR  IMPLIED WARRANTIES,    */
+/*    INCLUDING, BUT  NOT LIMITED  TO, THE IMPLIED  WARRANTIES OF    */
+/*    MERCHANTABILITY  AND FITNESS FOR  A PARTICULAR  PURPOSE ARE    */
+/*    DISCLAIMED.  IN  NO EVENT SHALL THE UNIVERSITY  OF TEXAS AT    */
+/*    AUSTIN OR CONTRIBUTORS BE  LIABLE FOR ANY DIRECT, INDIRECT,    */
+/*    INCIDENTAL,  SPECIAL, EXEMPLARY,  OR  CONSEQUENTIAL DAMAGES    */
+/*    (INCLUDING, BUT  NOT LIMITED TO,  PROCUREMENT OF SUBSTITUTE    */
+/*    GOODS  OR  SERVICES; LOSS  OF  USE,  DATA,  OR PROFITS;  OR    */
+/*    BUSINESS INTERRUPTION) HOWEVER CAUSED  AND ON ANY THEORY OF    */
+/*    LIABILITY, WHETHER  IN CONTRACT, STRICT  LIABILITY, OR TORT    */
+/*    (INCLUDING NEGLIGENCE OR OTHERWISE)  ARISING IN ANY WAY OUT    */
+/*    OF  THE  USE OF  THIS  SOFTWARE,  EVEN  IF ADVISED  OF  THE    */
+/*    POSSIBILITY OF SUCH DAMAGE.                                    */
+/*                                                                   */
+/* The views and conclusions contained in the software and           */
+/* documentation are those of the authors and should not be          */
+/* interpreted as representing official policies, either expressed   */
+/* or implied, of The University of Texas at Austin.                 */
+/*********************************************************************/
+
+#ifndef DEFLECT_SERVERMETRICS_H
+#define DEFLECT_SERVERMETRICS_H
+
+#include <deflect/api.h>
+#include <deflect/types.h>
+
+#include <QString>
+
+#include <string>
+#include <vector>
+
+namespace deflect
+{
+
+/** Metrics of one source of a stream. */
+struct SourceMetrics
+{
+    SourceMetrics()
+        : sourceIndex( 0 ), framesFinished( 0 ), framesBehind( 0 )
+    {}
+
+    /** The identifier of the source in its stream. */
+    size_t sourceIndex;
+
+    /** The number of frames finished by the source. */
+    uint64_t framesFinished;
+
+    /** The number of frames the source lags behind the most advanced one. */
+    uint64_t framesBehind;
+};
+
+/** Metrics of one stream, as seen by the FrameDispatcher. */
+struct StreamMetrics
+{
+    StreamMetrics()
+        : framesReceived( 0 ), framesDispatched( 0 ), framesDropped( 0 )
+        , segmentsReceived( 0 ), bytesReceived( 0 ), framesPerSecond( 0 )
+        , bytesPerSecond( 0 ), segmentsPerFrame( 0 ), bufferedFrames( 0 )
+        , bufferedBytes( 0 )
+    {}
+
+    /** The identifier of the stream. */
+    QString uri;
+
+    /** The number of frames received, finished by the most advanced source. */
+    uint64_t framesReceived;
+
+    /** The number of frames dispatched with FrameDispatcher::sendFrame(). */
+    uint64_t framesDispatched;
+
+    /** The number of complete frames dropped without being dispatched. */
+    uint64_t framesDropped;
+
+    /** The number of segments received. */
+    uint64_t segmentsReceived;
+
+    /** The amount of image data received, in bytes. */
+    uint64_t bytesReceived;
+
+    /** The frames received per second, over the last second. */
+    double framesPerSecond;
+
+    /** The image data received per second, over the last second. */
+    double bytesPerSecond;
+
+    /** The average number of segments per frame received. */
+    double segmentsPerFrame;
+
+    /** The number of complete frames waiting in the ReceiveBuffer. */
+    size_t bufferedFrames;
+
+    /** The amount of image data in the ReceiveBuffer, in bytes. */
+    size_t bufferedBytes;
+
+    /** The metrics of each source of the stream. */
+    std::vector< SourceMetrics > sources;
+};
+
+/**
+ * A snapshot of the metrics of a Server.
+ *
+ * @see Server::getMetrics()
+ */
+struct ServerMetrics
+{
+    ServerMetrics() : connections( 0 ) {}
+
+    /** The number of open Stream connections. */
+    size_t connections;
+
+    /** The metrics of each open stream. */
+    std::vector< StreamMetrics > streams;
+
+    /**
+     * Format the metrics in the Prometheus text exposition format.
+     * @return the metrics, one sample per line, labeled by stream and source
+     */
+    DEFLECT_API std::string toPrometheus() const;
+};
+
+}
+
+#endif
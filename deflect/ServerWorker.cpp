@@ -41,40 +41,77 @@
 #include "ServerWorker.h"
 
 #include "NetworkProtocol.h"
+#include "SharedMemoryRing.h"
 
 #include <stdint.h>
+#include <atomic>
 #include <iostream>
+#include <vector>
 
 #include <QDataStream>
+#include <QtEndian>
 
 #define RECEIVE_TIMEOUT_MS 3000
 
 namespace deflect
 {
 
-ServerWorker::ServerWorker( const int socketDescriptor )
-    // Ensure that tcpSocket_ parent is *this* so it gets moved to thread
-    : _tcpSocket( new QTcpSocket( this ))
+namespace
+{
+/** Unique ids of the streams using compact headers, 0 is reserved */
+std::atomic< uint32_t > lastStreamId( 0 );
+}
+
+ServerWorker::ServerWorker( const int socketDescriptor, const bool localSocket )
+    // Ensure that the socket's parent is *this* so it gets moved to thread
+    : _tcpSocket( localSocket ? nullptr : new QTcpSocket( this ))
+    , _localSocket( localSocket ? new QLocalSocket( this ) : nullptr )
+    , _socket( localSocket ? static_cast< QIODevice* >( _localSocket )
+                           : static_cast< QIODevice* >( _tcpSocket ))
     , _sourceId( socketDescriptor )
+    , _streamId( 0 )
     , _registeredToEvents( false )
+    , _frameAcksEnabled( false )
 {
-    if( !_tcpSocket->setSocketDescriptor( socketDescriptor ))
+    const bool success = localSocket ?
+                _localSocket->setSocketDescriptor( socketDescriptor ) :
+                _tcpSocket->setSocketDescriptor( socketDescriptor );
+    if( !success )
     {
         std::cerr << "could not set socket descriptor: "
-                  << _tcpSocket->errorString().toStdString() << std::endl;
+                  << _socket->errorString().toStdString() << std::endl;
         emit( connectionClosed( ));
         return;
     }
 
-    connect( _tcpSocket, &QTcpSocket::disconnected,
-             this, &ServerWorker::connectionClosed );
+    if( localSocket )
+        connect( _localSocket, &QLocalSocket::disconnected,
+                 this, &ServerWorker::connectionClosed );
+    else
+        connect( _tcpSocket, &QTcpSocket::disconnected,
+                 this, &ServerWorker::connectionClosed );
 
-    connect( _tcpSocket, &QTcpSocket::readyRead,
+    connect( _socket, &QIODevice::readyRead,
              this, &ServerWorker::_processMessages, Qt::QueuedConnection );
     connect( this, &ServerWorker::_dataAvailable,
              this, &ServerWorker::_processMessages, Qt::QueuedConnection );
 }
 
+ServerWorker::ServerWorker( const int sourceId, QIODevice* device )
+    : _tcpSocket( nullptr )
+    , _localSocket( nullptr )
+    , _socket( device )
+    , _sourceId( sourceId )
+    , _streamId( 0 )
+    , _registeredToEvents( false )
+    , _frameAcksEnabled( false )
+{
+    _socket->setParent( this );
+
+    connect( this, &ServerWorker::_dataAvailable,
+             this, &ServerWorker::_processMessages, Qt::QueuedConnection );
+}
+
 ServerWorker::~ServerWorker()
 {
     // If the sender crashed, we may not recieve the quit message.
@@ -84,10 +121,10 @@ ServerWorker::~ServerWorker()
     if( !_streamUri.isEmpty( ))
         emit removeStreamSource( _streamUri, _sourceId );
 
-    if( _tcpSocket->state() == QAbstractSocket::ConnectedState )
+    if( _isConnected( ))
         _sendQuit();
 
-    delete _tcpSocket;
+    delete _socket;
 }
 
 void ServerWorker::processEvent( const Event evt )
@@ -96,6 +133,24 @@ void ServerWorker::processEvent( const Event evt )
     emit _dataAvailable();
 }
 
+void ServerWorker::processMessage( const MessageHeader& messageHeader,
+                                   const QByteArray& byteArray )
+{
+    _handleMessage( messageHeader, byteArray );
+}
+
+void ServerWorker::processMessage( const CompactMessageHeader& messageHeader,
+                                   const QByteArray& byteArray )
+{
+    _handleCompactMessage( messageHeader, byteArray );
+}
+
+void ServerWorker::processDisconnection()
+{
+    _socket->close();
+    emit( connectionClosed( ));
+}
+
 void ServerWorker::initConnection()
 {
     _sendProtocolVersion();
@@ -108,7 +163,8 @@ void ServerWorker::closeConnection( const QString uri )
 
     Event closeEvent;
     closeEvent.type = Event::EVT_CLOSE;
-    _send( closeEvent );
+    _events.enqueue( closeEvent );
+    _sendEvents();
 
     emit( connectionClosed( ));
 }
@@ -123,47 +179,79 @@ void ServerWorker::replyToEventRegistration( const QString uri,
     _sendBindReply( _registeredToEvents );
 }
 
-void ServerWorker::_processMessages()
+void ServerWorker::acknowledgeFrames( const QString uri,
+                                      const SourceFrameCountsPtr counts )
 {
-    const qint64 headerSize( MessageHeader::serializedSize );
+    if( uri != _streamUri || !_frameAcksEnabled )
+        return;
 
-    if( _tcpSocket->bytesAvailable() >= headerSize )
-        _receiveMessage();
+    const auto it = counts->find( size_t( _sourceId ));
+    if( it != counts->end( ))
+        _sendFrameAck( it->second );
+}
 
-    // Send all events
-    foreach( const Event& evt, _events )
-        _send( evt );
-    _events.clear();
+void ServerWorker::_processMessages()
+{
+    if( _isHeaderAvailable( ))
+        _receiveMessage();
 
-    _tcpSocket->flush();
+    _sendEvents();
 
     // Finish reading messages from the socket if connection closed
-    if( _tcpSocket->state() != QAbstractSocket::ConnectedState )
+    if( !_isConnected( ))
     {
-        while( _tcpSocket->bytesAvailable() >= headerSize )
+        while( _isHeaderAvailable( ))
             _receiveMessage();
 
         emit( connectionClosed( ));
     }
-    else if( _tcpSocket->bytesAvailable() >= headerSize )
+    else if( _isHeaderAvailable( ))
         emit _dataAvailable();
 }
 
-void ServerWorker::_receiveMessage()
+bool ServerWorker::_isConnected() const
 {
-    const MessageHeader mh = _receiveMessageHeader();
-    const QByteArray messageByteArray = _receiveMessageBody( mh.size );
-    _handleMessage( mh, messageByteArray );
+    if( _localSocket )
+        return _localSocket->state() == QLocalSocket::ConnectedState;
+    if( _tcpSocket )
+        return _tcpSocket->state() == QAbstractSocket::ConnectedState;
+    return _socket->isOpen();
 }
 
-MessageHeader ServerWorker::_receiveMessageHeader()
+bool ServerWorker::_isHeaderAvailable()
 {
-    MessageHeader messageHeader;
+    char firstByte;
+    if( _socket->peek( &firstByte, 1 ) != 1 )
+        return false;
+
+    const size_t headerSize = CompactMessageHeader::isCompact( firstByte ) ?
+                CompactMessageHeader::serializedSize :
+                MessageHeader::serializedSize;
+    return _socket->bytesAvailable() >= qint64( headerSize );
+}
 
-    QDataStream stream( _tcpSocket );
-    stream >> messageHeader;
+void ServerWorker::_receiveMessage()
+{
+    char firstByte;
+    _socket->peek( &firstByte, 1 );
+    if( CompactMessageHeader::isCompact( firstByte ))
+    {
+        char data[CompactMessageHeader::serializedSize];
+        _socket->read( data, sizeof( data ));
+        CompactMessageHeader mh;
+        mh.deserialize( data );
+        const QByteArray messageByteArray = _receiveMessageBody( mh.size );
+        _handleCompactMessage( mh, messageByteArray );
+        return;
+    }
 
-    return messageHeader;
+    MessageHeader mh;
+    {
+        QDataStream stream( _socket );
+        stream >> mh;
+    }
+    const QByteArray messageByteArray = _receiveMessageBody( mh.size );
+    _handleMessage( mh, messageByteArray );
 }
 
 QByteArray ServerWorker::_receiveMessageBody( const int size )
@@ -172,18 +260,18 @@ QByteArray ServerWorker::_receiveMessageBody( const int size )
 
     if( size > 0 )
     {
-        messageByteArray = _tcpSocket->read( size );
+        messageByteArray = _socket->read( size );
 
         while( messageByteArray.size() < size )
         {
-            if( !_tcpSocket->waitForReadyRead( RECEIVE_TIMEOUT_MS ))
+            if( !_socket->waitForReadyRead( RECEIVE_TIMEOUT_MS ))
             {
                 emit connectionClosed();
                 return QByteArray();
             }
 
             messageByteArray.append(
-                        _tcpSocket->read( size - messageByteArray.size( )));
+                        _socket->read( size - messageByteArray.size( )));
         }
     }
 
@@ -210,21 +298,61 @@ void ServerWorker::_handleMessage( const MessageHeader& messageHeader,
         return;
     }
 
-    switch( messageHeader.type )
+    if( messageHeader.type == MESSAGE_TYPE_PIXELSTREAM_OPEN )
+        _openStream( uri, byteArray );
+    else
+        _dispatchMessage( messageHeader.type, byteArray );
+}
+
+void ServerWorker::_handleCompactMessage(
+        const CompactMessageHeader& messageHeader, const QByteArray& byteArray )
+{
+    // The stream is bound by id, which saves comparing uris for each message
+    if( _streamId == 0 || messageHeader.streamId != _streamId )
+    {
+        std::cerr << "Warning: ignoring message with incorrect stream id: "
+                  << messageHeader.streamId << ", expected: " << _streamId
+                  << std::endl;
+        return;
+    }
+
+    _dispatchMessage( MessageType( messageHeader.type ), byteArray );
+}
+
+void ServerWorker::_openStream( const QString& uri,
+                                const QByteArray& byteArray )
+{
+    if( !_streamUri.isEmpty( ))
+    {
+        std::cerr << "Warning: PixelStream already opened!" << std::endl;
+        return;
+    }
+    _streamUri = uri;
+    emit addStreamSource( _streamUri, _sourceId );
+
+    // Protocol version 8 clients send no payload
+    if( byteArray.size() < int( sizeof( quint32 )))
+        return;
+
+    const quint32 version =
+            qFromLittleEndian< quint32 >( (const uchar*)byteArray.constData( ));
+    if( version < COMPACT_HEADER_PROTOCOL_VERSION )
+        return;
+
+    while( _streamId == 0 )
+        _streamId = ++lastStreamId;
+    _sendOpenReply();
+}
+
+void ServerWorker::_dispatchMessage( const MessageType type,
+                                     const QByteArray& byteArray )
+{
+    switch( type )
     {
     case MESSAGE_TYPE_QUIT:
         emit removeStreamSource( _streamUri, _sourceId );
         _streamUri = QString();
-        break;
-
-    case MESSAGE_TYPE_PIXELSTREAM_OPEN:
-        if( !_streamUri.isEmpty( ))
-        {
-            std::cerr << "Warning: PixelStream already opened!" << std::endl;
-            return;
-        }
-        _streamUri = uri;
-        emit addStreamSource( _streamUri, _sourceId );
+        _streamId = 0;
         break;
 
     case MESSAGE_TYPE_PIXELSTREAM_FINISH_FRAME:
@@ -253,12 +381,24 @@ void ServerWorker::_handleMessage( const MessageHeader& messageHeader,
             std::cerr << "We are already bound!!" << std::endl;
         else
         {
-            const bool exclusive =
-                    (messageHeader.type == MESSAGE_TYPE_BIND_EVENTS_EX);
+            const bool exclusive = (type == MESSAGE_TYPE_BIND_EVENTS_EX);
             emit registerToEvents( _streamUri, exclusive, this );
         }
         break;
 
+    case MESSAGE_TYPE_BIND_FRAME_ACKS:
+        _frameAcksEnabled = true;
+        _sendFrameAcksBindReply();
+        break;
+
+    case MESSAGE_TYPE_BIND_SHARED_MEMORY:
+        _bindSharedMemory( byteArray );
+        break;
+
+    case MESSAGE_TYPE_PIXELSTREAM_SHARED_MEMORY:
+        _handleSharedMemoryMessage( byteArray );
+        break;
+
     default:
         break;
     }
@@ -279,10 +419,62 @@ void ServerWorker::_handlePixelStreamMessage( const QByteArray& byteArray )
     emit( receivedSegment( _streamUri, _sourceId, segment ));
 }
 
+void ServerWorker::_handleSharedMemoryMessage( const QByteArray& byteArray )
+{
+    SharedMemoryRing::Record record;
+    {
+        QDataStream stream( byteArray );
+        stream >> record.position >> record.size;
+        if( stream.status() != QDataStream::Ok )
+            return;
+    }
+
+    const char* data = _sharedMemory ? _sharedMemory->getData( record )
+                                     : nullptr;
+    if( !data || record.size < sizeof( SegmentParameters ))
+    {
+        std::cerr << "Warning: ignoring invalid shared memory segment"
+                  << std::endl;
+        return;
+    }
+
+    // Copy the image out of the ring to release its space for the streamer
+    Segment segment;
+    segment.parameters = *reinterpret_cast< const SegmentParameters* >( data );
+    segment.imageData = QByteArray( data + sizeof( SegmentParameters ),
+                                    record.size - sizeof( SegmentParameters ));
+    _sharedMemory->release( record );
+
+    emit( receivedSegment( _streamUri, _sourceId, segment ));
+}
+
+void ServerWorker::_bindSharedMemory( const QByteArray& byteArray )
+{
+    _sharedMemory.reset( new SharedMemoryRing );
+    if( !_sharedMemory->attach( QString::fromUtf8( byteArray )))
+        _sharedMemory.reset();
+
+    _sendSharedMemoryBindReply( !!_sharedMemory );
+}
+
 void ServerWorker::_sendProtocolVersion()
 {
     const int32_t protocolVersion = NETWORK_PROTOCOL_VERSION;
-    _tcpSocket->write( (char*)&protocolVersion, sizeof( int32_t ));
+    _socket->write( (char*)&protocolVersion, sizeof( int32_t ));
+    _flushSocket();
+}
+
+void ServerWorker::_sendOpenReply()
+{
+    // The stream id followed by the supported features
+    uchar reply[2 * sizeof( quint32 )];
+    qToLittleEndian< quint32 >( _streamId, reply );
+    qToLittleEndian< quint32 >( PROTOCOL_FEATURE_FRAME_ACKS,
+                                reply + sizeof( quint32 ));
+
+    MessageHeader mh( MESSAGE_TYPE_PIXELSTREAM_OPEN_REPLY, sizeof( reply ));
+    _send( mh );
+    _socket->write( (const char*)reply, sizeof( reply ));
     _flushSocket();
 }
 
@@ -291,23 +483,69 @@ void ServerWorker::_sendBindReply( const bool successful )
     MessageHeader mh( MESSAGE_TYPE_BIND_EVENTS_REPLY, sizeof( bool ));
     _send( mh );
 
-    _tcpSocket->write( (const char *)&successful, sizeof( bool ));
+    _socket->write( (const char *)&successful, sizeof( bool ));
     _flushSocket();
 }
 
-void ServerWorker::_send( const Event& evt )
+void ServerWorker::_sendFrameAcksBindReply()
 {
-    // send message header
-    MessageHeader mh( MESSAGE_TYPE_EVENT, Event::serializedSize );
+    MessageHeader mh( MESSAGE_TYPE_BIND_FRAME_ACKS_REPLY, 0 );
+    _send( mh );
+    _flushSocket();
+}
+
+void ServerWorker::_sendFrameAck( const unsigned int count )
+{
+    MessageHeader mh( MESSAGE_TYPE_FRAME_ACK, sizeof( quint32 ));
     _send( mh );
 
     {
-        QDataStream stream( _tcpSocket );
-        stream << evt;
+        QDataStream stream( _socket );
+        stream << quint32( count );
     }
     _flushSocket();
 }
 
+void ServerWorker::_sendSharedMemoryBindReply( const bool successful )
+{
+    MessageHeader mh( MESSAGE_TYPE_BIND_SHARED_MEMORY_REPLY, sizeof( bool ));
+    _send( mh );
+
+    _socket->write( (const char *)&successful, sizeof( bool ));
+    _flushSocket();
+}
+
+void ServerWorker::_sendEvents()
+{
+    if( _events.isEmpty( ))
+        return;
+
+    // Consecutive moves are merged, which during touch interaction typically
+    // leaves a single event per loop iteration
+    std::vector< Event > events;
+    events.reserve( _events.size( ));
+    for( const Event& evt : _events )
+    {
+        if( events.empty() || !coalesceEvents( events.back(), evt ))
+            events.push_back( evt );
+    }
+    _events.clear();
+
+    // All the events go out in one write and one flush
+    const MessageHeader mh( MESSAGE_TYPE_EVENT, Event::serializedSize );
+    QByteArray batch;
+    {
+        QDataStream stream( &batch, QIODevice::WriteOnly );
+        for( const Event& evt : events )
+        {
+            _writeHeader( stream, mh );
+            stream << evt;
+        }
+    }
+    _socket->write( batch );
+    _flushSocket();
+}
+
 void ServerWorker::_sendQuit()
 {
     MessageHeader mh( MESSAGE_TYPE_QUIT, 0 );
@@ -317,17 +555,35 @@ void ServerWorker::_sendQuit()
 
 bool ServerWorker::_send( const MessageHeader& messageHeader )
 {
-    QDataStream stream( _tcpSocket );
-    stream << messageHeader;
+    QDataStream stream( _socket );
+    _writeHeader( stream, messageHeader );
 
     return stream.status() == QDataStream::Ok;
 }
 
+void ServerWorker::_writeHeader( QDataStream& stream,
+                                 const MessageHeader& messageHeader ) const
+{
+    if( !_streamId )
+    {
+        stream << messageHeader;
+        return;
+    }
+
+    char data[CompactMessageHeader::serializedSize];
+    CompactMessageHeader( messageHeader.type, messageHeader.size,
+                          _streamId ).serialize( data );
+    stream.writeRawData( data, sizeof( data ));
+}
+
 void ServerWorker::_flushSocket()
 {
-    _tcpSocket->flush();
-    while( _tcpSocket->bytesToWrite() > 0 )
-        _tcpSocket->waitForBytesWritten();
+    if( _localSocket )
+        _localSocket->flush();
+    else if( _tcpSocket )
+        _tcpSocket->flush();
+    while( _socket->bytesToWrite() > 0 && _isConnected( ))
+        _socket->waitForBytesWritten( RECEIVE_TIMEOUT_MS );
 }
 
 }
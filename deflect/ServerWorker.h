@@ -47,26 +47,58 @@
 #include <deflect/Segment.h>
 #include <deflect/SizeHints.h>
 
+#include <QtNetwork/QLocalSocket>
 #include <QtNetwork/QTcpSocket>
 #include <QQueue>
 
+#include <memory>
+
 namespace deflect
 {
 
+class SharedMemoryRing;
+
 class ServerWorker : public EventReceiver
 {
     Q_OBJECT
 
 public:
-    explicit ServerWorker( int socketDescriptor );
+    /**
+     * Create a worker for an incoming connection.
+     * @param socketDescriptor The descriptor of the connected socket
+     * @param localSocket true for a Unix domain socket (QLocalSocket), false
+     *        for a TCP socket
+     */
+    explicit ServerWorker( int socketDescriptor, bool localSocket = false );
+
+    /**
+     * Create a worker for a connection whose messages are received by another
+     * object and passed to processMessage(), see IoUringReceiver.
+     * @param sourceId The unique identifier of the connection
+     * @param device The device to write the replies to, owned by the worker
+     */
+    ServerWorker( int sourceId, QIODevice* device );
+
     ~ServerWorker();
 
+    /** Handle a message received for this connection. */
+    void processMessage( const MessageHeader& messageHeader,
+                         const QByteArray& byteArray );
+
+    /** Handle a message with a compact header received for this connection. */
+    void processMessage( const CompactMessageHeader& messageHeader,
+                         const QByteArray& byteArray );
+
+    /** Handle the closing of the connection by the peer. */
+    void processDisconnection();
+
 public slots:
     void processEvent( Event evt ) final;
 
     void initConnection();
     void closeConnection( QString uri );
     void replyToEventRegistration( QString uri, bool success );
+    void acknowledgeFrames( QString uri, deflect::SourceFrameCountsPtr counts );
 
 signals:
     void addStreamSource( QString uri, size_t sourceIndex );
@@ -93,26 +125,49 @@ private slots:
 
 private:
     QTcpSocket* _tcpSocket;
+    QLocalSocket* _localSocket;
+    QIODevice* _socket;
 
     QString _streamUri;
     int _sourceId;
 
+    /** Id of the stream in compact headers, 0 if the client does not use
+     *  them (protocol version 8) */
+    uint32_t _streamId;
+
     bool _registeredToEvents;
     QQueue<Event> _events;
 
+    bool _frameAcksEnabled;
+
+    std::unique_ptr< SharedMemoryRing > _sharedMemory;
+
+    bool _isConnected() const;
+    bool _isHeaderAvailable();
     void _receiveMessage();
-    MessageHeader _receiveMessageHeader();
     QByteArray _receiveMessageBody( int size );
 
     void _handleMessage( const MessageHeader& messageHeader,
                          const QByteArray& byteArray );
+    void _handleCompactMessage( const CompactMessageHeader& messageHeader,
+                                const QByteArray& byteArray );
+    void _openStream( const QString& uri, const QByteArray& byteArray );
+    void _dispatchMessage( MessageType type, const QByteArray& byteArray );
     void _handlePixelStreamMessage( const QByteArray& byteArray );
+    void _handleSharedMemoryMessage( const QByteArray& byteArray );
+    void _bindSharedMemory( const QByteArray& byteArray );
 
     void _sendProtocolVersion();
+    void _sendOpenReply();
     void _sendBindReply( bool successful );
-    void _send( const Event &evt );
+    void _sendFrameAcksBindReply();
+    void _sendFrameAck( unsigned int count );
+    void _sendSharedMemoryBindReply( bool successful );
+    void _sendEvents();
     void _sendQuit();
     bool _send( const MessageHeader& messageHeader );
+    void _writeHeader( QDataStream& stream,
+                       const MessageHeader& messageHeader ) const;
     void _flushSocket();
 };
 
@@ -0,0 +1,196 @@
+/*********************************************************************/
+/* Copyright (c) 2015, EPFL/Blue Brain Project                       */
+/*                     Raphael Dumusc <raphael.dumusc@epfl.ch>       */
+/* All rights reserved.                                              */
+/*                                                                   */
+/* Redistribution and use in source and binary forms, with or        */
+/* without modification, are permitted provided that the following   */
+/* conditions are met:                                               */
+/*                                                                   */
+/*   1. Redistributions of source code must retain the above         */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer.                                                  */
+/*                                                                   */
+/*   2. Redistributions in binary form must reproduce the above      */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer in the documentation and/or other materials       */
+/*      provided with the distribution.                              */
+/*                                                                   */
+/*    THIS  SOFTWARE IS PROVIDED  BY THE  UNIVERSITY OF  TEXAS AT    */
+/*    AUSTIN  ``AS IS''  AND ANY  EXPRESS OR  IMPLIED WARRANTIES,    */
+/*    INCLUDING, BUT  NOT LIMITED  TO, THE IMPLIED  WARRANTIES OF    */
+/*    MERCHANTABILITY  AND FITNESS FOR  A PARTICULAR  PURPOSE ARE    */
+/*    DISCLAIMED.  IN  NO EVENT SHALL THE UNIVERSITY  OF TEXAS AT    */
+/*    AUSTIN OR CONTRIBUTORS BE  LIABLE FOR ANY DIRECT, INDIRECT,    */
+/*    INCIDENTAL,  SPECIAL, EXEMPLARY,  OR  CONSEQUENTIAL DAMAGES    */
+/*    (INCLUDING, BUT  NOT LIMITED TO,  PROCUREMENT OF SUBSTITUTE    */
+/*    GOODS  OR  SERVICES; LOSS  OF  USE,  DATA,  OR PROFITS;  OR    */
+/*    BUSINESS INTERRUPTION) HOWEVER CAUSED  AND ON ANY THEORY OF    */
+/*    LIABILITY, WHETHER  IN CONTRACT, STRICT  LIABILITY, OR TORT    */
+/*    (INCLUDING NEGLIGENCE OR OTHERWISE)  ARISING IN ANY WAY OUT    */
+/*    OF  THE  USE OF  THIS  SOFTWARE,  EVEN  IF ADVISED  OF  THE    */
+/*    POSSIBILITY OF SUCH DAMAGE.                                    */
+/*                                                                   */
+/* The views and conclusions contained in the software and           */
+/* documentation are those of the authors and should not be          */
+/* interpreted as representing official policies, either expressed   */
+/* or implied, of The University of Texas at Austin.                 */
+/*********************************************************************/
+
+#include "SharedMemoryRing.h"
+
+#include <QUuid>
+
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <thread>
+
+#define RING_MAGIC 0x44464c52 // "DFLR"
+#define RING_VERSION 1
+#define RING_HEADER_SIZE 64
+
+namespace deflect
+{
+
+struct SharedMemoryRing::Header
+{
+    quint32 magic;
+    quint32 version;
+    quint64 capacity;
+    std::atomic< quint64 > readPosition;
+};
+
+SharedMemoryRing::SharedMemoryRing()
+    : _header( nullptr )
+    , _data( nullptr )
+    , _capacity( 0 )
+    , _writePosition( 0 )
+{
+}
+
+SharedMemoryRing::~SharedMemoryRing()
+{
+    _detach();
+}
+
+bool SharedMemoryRing::create( const size_t capacity )
+{
+    static_assert( sizeof( Header ) <= RING_HEADER_SIZE,
+                   "Header does not fit in the reserved space" );
+
+    _detach();
+    if( capacity == 0 )
+        return false;
+
+    _memory.setKey( "deflect-" + QUuid::createUuid().toString( ));
+    if( !_memory.create( RING_HEADER_SIZE + capacity ))
+    {
+        std::cerr << "could not create shared memory: "
+                  << _memory.errorString().toStdString() << std::endl;
+        return false;
+    }
+
+    char* memory = static_cast< char* >( _memory.data( ));
+    _header = new( memory ) Header;
+    _header->magic = RING_MAGIC;
+    _header->version = RING_VERSION;
+    _header->capacity = capacity;
+    _header->readPosition.store( 0 );
+    _data = memory + RING_HEADER_SIZE;
+    _capacity = capacity;
+    _writePosition = 0;
+    return true;
+}
+
+bool SharedMemoryRing::attach( const QString& key )
+{
+    _detach();
+
+    _memory.setKey( key );
+    if( !_memory.attach( ))
+    {
+        std::cerr << "could not attach shared memory: "
+                  << _memory.errorString().toStdString() << std::endl;
+        return false;
+    }
+
+    char* memory = static_cast< char* >( _memory.data( ));
+    Header* header = reinterpret_cast< Header* >( memory );
+    if( _memory.size() < RING_HEADER_SIZE || header->magic != RING_MAGIC ||
+        header->version != RING_VERSION ||
+        header->capacity > quint64( _memory.size() - RING_HEADER_SIZE ))
+    {
+        std::cerr << "invalid shared memory ring: " << key.toStdString()
+                  << std::endl;
+        _memory.detach();
+        return false;
+    }
+
+    _header = header;
+    _data = memory + RING_HEADER_SIZE;
+    _capacity = header->capacity;
+    return true;
+}
+
+QString SharedMemoryRing::getKey() const
+{
+    return _memory.key();
+}
+
+size_t SharedMemoryRing::getCapacity() const
+{
+    return _capacity;
+}
+
+char* SharedMemoryRing::reserve( const size_t size, Record& record,
+                                 const std::function< bool() >& keepWaiting )
+{
+    if( !_header || size > _capacity )
+        return nullptr;
+
+    // Records are contiguous, skip the end of the buffer if needed
+    quint64 position = _writePosition;
+    const size_t offset = position % _capacity;
+    if( offset + size > _capacity )
+        position += _capacity - offset;
+
+    while( position + size - _header->readPosition.load( ) > _capacity )
+    {
+        if( !keepWaiting( ))
+            return nullptr;
+        std::this_thread::sleep_for( std::chrono::microseconds( 50 ));
+    }
+
+    _writePosition = position + size;
+    record.position = position;
+    record.size = size;
+    return _data + position % _capacity;
+}
+
+const char* SharedMemoryRing::getData( const Record& record ) const
+{
+    if( !_header || record.size > _capacity ||
+        record.position % _capacity + record.size > _capacity )
+    {
+        return nullptr;
+    }
+    return _data + record.position % _capacity;
+}
+
+void SharedMemoryRing::release( const Record& record )
+{
+    if( _header )
+        _header->readPosition.store( record.position + record.size );
+}
+
+void SharedMemoryRing::_detach()
+{
+    if( _memory.isAttached( ))
+        _memory.detach();
+    _header = nullptr;
+    _data = nullptr;
+    _capacity = 0;
+}
+
+}
@@ -0,0 +1,144 @@
+/*********************************************************************/
+/* Copyright (c) 2015, EPFL/Blue Brain Project                       */
+/*                     Raphael Dumusc <raphael.dumusc@epfl.ch>       */
+/* All rights reserved.                                              */
+/*                                                                   */
+/* Redistribution and use in source and binary forms, with or        */
+/* without modification, are permitted provided that the following   */
+/* conditions are met:                                               */
+/*                                                                   */
+/*   1. Redistributions of source code must retain the above         */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer.                                                  */
+/*                                                                   */
+/*   2. Redistributions in binary form must reproduce the above      */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer in the documentation and/or other materials       */
+/*      provided with the distribution.                              */
+/*                                                                   */
+/*    THIS  SOFTWARE IS PROVIDED  BY THE  UNIVERSITY OF  TEXAS AT    */
+/*    AUSTIN  ``AS IS''  AND ANY  EXPRESS OR  IMPLIED WARRANTIES,    */
+/*    INCLUDING, BUT  NOT LIMITED  TO, THE IMPLIED  WARRANTIES OF    */
+/*    MERCHANTABILITY  AND FITNESS FOR  A PARTICULAR  PURPOSE ARE    */
+/*    DISCLAIMED.  IN  NO EVENT SHALL THE UNIVERSITY  OF TEXAS AT    */
+/*    AUSTIN OR CONTRIBUTORS BE  LIABLE FOR ANY DIRECT, INDIRECT,    */
+/*    INCIDENTAL,  SPECIAL, EXEMPLARY,  OR  CONSEQUENTIAL DAMAGES    */
+/*    (INCLUDING, BUT  NOT LIMITED TO,  PROCUREMENT OF SUBSTITUTE    */
+/*    GOODS  OR  SERVICES; LOSS  OF  USE,  DATA,  OR PROFITS;  OR    */
+/*    BUSINESS INTERRUPTION) HOWEVER CAUSED  AND ON ANY THEORY OF    */
+/*    LIABILITY, WHETHER  IN CONTRACT, STRICT  LIABILITY, OR TORT    */
+/*    (INCLUDING NEGLIGENCE OR OTHERWISE)  ARISING IN ANY WAY OUT    */
+/*    OF  THE  USE OF  THIS  SOFTWARE,  EVEN  IF ADVISED  OF  THE    */
+/*    POSSIBILITY OF SUCH DAMAGE.                                    */
+/*                                                                   */
+/* The views and conclusions contained in the software and           */
+/* documentation are those of the authors and should not be          */
+/* interpreted as representing official policies, either expressed   */
+/* or implied, of The University of Texas at Austin.                 */
+/*********************************************************************/
+
+#ifndef DEFLECT_SHAREDMEMORYRING_H
+#define DEFLECT_SHAREDMEMORYRING_H
+
+#include <deflect/api.h>
+
+#include <QSharedMemory>
+#include <QString>
+
+#include <functional>
+
+namespace deflect
+{
+
+/**
+ * Single-producer, single-consumer ring buffer in shared memory.
+ *
+ * Used by a Stream to pass segments to a Server on the same host without
+ * going through the TCP stack. The Stream creates the ring and writes
+ * records into it; the Server attaches to it and reads the records in the
+ * order in which their positions are received on the (TCP) control channel,
+ * releasing each one after use. Records are contiguous in memory: a record
+ * which does not fit before the end of the buffer starts at its beginning.
+ *
+ * Only the read position is shared between the processes, the write position
+ * and the records' positions are sent through the control channel.
+ */
+class SharedMemoryRing
+{
+public:
+    /** A record in the ring. */
+    struct Record
+    {
+        quint64 position; //!< Monotonic position of the record
+        quint32 size;     //!< Size of the record in bytes
+    };
+
+    /** Construct an unallocated ring. */
+    DEFLECT_API SharedMemoryRing();
+
+    /** Detach from the shared memory. */
+    DEFLECT_API ~SharedMemoryRing();
+
+    /**
+     * Create a new ring, as the writer.
+     * @param capacity The size of the buffer for the records
+     * @return true on success, false if the shared memory could not be created
+     */
+    DEFLECT_API bool create( size_t capacity );
+
+    /**
+     * Attach to an existing ring, as the reader.
+     * @param key The key of the ring, see getKey()
+     * @return true on success, false if the ring could not be attached
+     */
+    DEFLECT_API bool attach( const QString& key );
+
+    /** @return the key which identifies the ring across processes. */
+    DEFLECT_API QString getKey() const;
+
+    /** @return the size of the buffer for the records, 0 if unallocated. */
+    DEFLECT_API size_t getCapacity() const;
+
+    /**
+     * Reserve the space for the next record.
+     *
+     * Waits until the reader has released enough space, for as long as
+     * keepWaiting allows it.
+     * @param size The size of the record
+     * @param record The record, set on success
+     * @param keepWaiting Called while waiting, returning false aborts, for
+     *        instance once a deadline has passed
+     * @return where to write the record, or nullptr if it is larger than the
+     *         capacity or if waiting was aborted.
+     */
+    DEFLECT_API char* reserve( size_t size, Record& record,
+                               const std::function< bool() >& keepWaiting );
+
+    /**
+     * Get the data of a record, for the reader.
+     * @param record The record received from the writer
+     * @return the data of the record, or nullptr if the record is invalid.
+     */
+    DEFLECT_API const char* getData( const Record& record ) const;
+
+    /**
+     * Release the space of a record and the preceding ones, for the reader.
+     * @param record The record received from the writer
+     */
+    DEFLECT_API void release( const Record& record );
+
+private:
+    struct Header;
+
+    QSharedMemory _memory;
+    Header* _header;
+    char* _data;
+    size_t _capacity;
+    quint64 _writePosition;
+
+    void _detach();
+};
+
+}
+
+#endif
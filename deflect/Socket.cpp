@@ -43,8 +43,10 @@
 
 #include <QCoreApplication>
 #include <QDataStream>
+#include <QLocalSocket>
 #include <QLoggingCategory>
 #include <QTcpSocket>
+#include <QtEndian>
 #include <iostream>
 
 #define INVALID_NETWORK_PROTOCOL_VERSION   -1
@@ -55,10 +57,14 @@ namespace deflect
 {
 
 const unsigned short Socket::defaultPortNumber = DEFAULT_PORT_NUMBER;
+const std::string Socket::localSocketPrefix( "unix:" );
 
 Socket::Socket( const std::string& hostname, const unsigned short port )
-    : _socket( new QTcpSocket( ))
+    : _tcpSocket( nullptr )
+    , _localSocket( nullptr )
+    , _socket( nullptr )
     , _remoteProtocolVersion( INVALID_NETWORK_PROTOCOL_VERSION )
+    , _streamId( 0 )
 {
     // disable warnings which occur if no QCoreApplication is present during
     // _connect(): QObject::connect: Cannot connect (null)::destroyed() to
@@ -69,10 +75,22 @@ Socket::Socket( const std::string& hostname, const unsigned short port )
         log->setEnabled( QtWarningMsg, false );
     }
 
-    _connect( hostname, port );
-
-    QObject::connect( _socket, &QTcpSocket::disconnected,
-                      this, &Socket::disconnected );
+    if( hostname.compare( 0, localSocketPrefix.size(), localSocketPrefix ) == 0 )
+    {
+        _localSocket = new QLocalSocket;
+        _socket = _localSocket;
+        _connectLocal( hostname.substr( localSocketPrefix.size( )));
+        QObject::connect( _localSocket, &QLocalSocket::disconnected,
+                          this, &Socket::disconnected );
+    }
+    else
+    {
+        _tcpSocket = new QTcpSocket;
+        _socket = _tcpSocket;
+        _connect( hostname, port );
+        QObject::connect( _tcpSocket, &QTcpSocket::disconnected,
+                          this, &Socket::disconnected );
+    }
 }
 
 Socket::~Socket()
@@ -82,12 +100,27 @@ Socket::~Socket()
 
 bool Socket::isConnected() const
 {
-    return _socket->state() == QTcpSocket::ConnectedState;
+    if( _localSocket )
+        return _localSocket->state() == QLocalSocket::ConnectedState;
+    return _tcpSocket->state() == QTcpSocket::ConnectedState;
+}
+
+bool Socket::isLocal() const
+{
+    if( !isConnected( ))
+        return false;
+    if( _localSocket )
+        return true;
+
+    const QHostAddress peer = _tcpSocket->peerAddress();
+    return peer.isLoopback() || peer == _tcpSocket->localAddress();
 }
 
 int Socket::getFileDescriptor() const
 {
-    return _socket->socketDescriptor();
+    if( _localSocket )
+        return _localSocket->socketDescriptor();
+    return _tcpSocket->socketDescriptor();
 }
 
 bool Socket::hasMessage( const size_t messageSize ) const
@@ -96,8 +129,33 @@ bool Socket::hasMessage( const size_t messageSize ) const
 
     // needed to 'wakeup' socket when no data was streamed for a while
     _socket->waitForReadyRead( 0 );
-    return _socket->bytesAvailable() >=
-            (int)(MessageHeader::serializedSize + messageSize);
+    const qint64 headerSize = _getHeaderSize();
+    return headerSize > 0 &&
+           _socket->bytesAvailable() >= headerSize + qint64( messageSize );
+}
+
+bool Socket::hasCompleteMessage() const
+{
+    QMutexLocker locker( &_socketMutex );
+
+    _socket->waitForReadyRead( 0 );
+    const qint64 headerSize = _getHeaderSize();
+    if( headerSize == 0 || _socket->bytesAvailable() < headerSize )
+        return false;
+
+    // The size follows the type in regular headers, the stream id in compact
+    const QByteArray header = _socket->peek( headerSize );
+    quint32 size = 0;
+    if( headerSize == qint64( MessageHeader::serializedSize ))
+        size = qFromBigEndian< quint32 >( (const uchar*)header.constData() +
+                                          sizeof( qint32 ));
+    else
+    {
+        CompactMessageHeader compactHeader;
+        compactHeader.deserialize( header.constData( ));
+        size = compactHeader.size;
+    }
+    return _socket->bytesAvailable() >= headerSize + qint64( size );
 }
 
 bool Socket::send( const MessageHeader& messageHeader,
@@ -106,10 +164,21 @@ bool Socket::send( const MessageHeader& messageHeader,
     QMutexLocker locker( &_socketMutex );
 
     // send header
-    QDataStream stream( _socket );
-    stream << messageHeader;
-    if( stream.status() != QDataStream::Ok )
-        return false;
+    if( _streamId )
+    {
+        char header[CompactMessageHeader::serializedSize];
+        CompactMessageHeader( messageHeader.type, messageHeader.size,
+                              _streamId ).serialize( header );
+        if( _socket->write( header, sizeof( header )) != sizeof( header ))
+            return false;
+    }
+    else
+    {
+        QDataStream stream( _socket );
+        stream << messageHeader;
+        if( stream.status() != QDataStream::Ok )
+            return false;
+    }
 
     if( message.isEmpty( ))
         return true;
@@ -125,7 +194,7 @@ bool Socket::send( const MessageHeader& messageHeader,
 
     // Needed in the absence of event loop, otherwise the reception is frozen.
     while( _socket->bytesToWrite() > 0 && isConnected( ))
-        _socket->waitForBytesWritten();
+        _socket->waitForBytesWritten( WAIT_FOR_BYTES_WRITTEN_TIMEOUT_MS );
 
     return sent == size;
 }
@@ -154,7 +223,7 @@ bool Socket::receive( MessageHeader& messageHeader, QByteArray& message )
 
     if( messageHeader.type == MESSAGE_TYPE_QUIT )
     {
-        _socket->disconnectFromHost();
+        _disconnect();
         return false;
     }
 
@@ -166,29 +235,63 @@ int32_t Socket::getRemoteProtocolVersion() const
     return _remoteProtocolVersion;
 }
 
+void Socket::setStreamId( const uint32_t streamId )
+{
+    QMutexLocker locker( &_socketMutex );
+    _streamId = streamId;
+}
+
+uint32_t Socket::getStreamId() const
+{
+    QMutexLocker locker( &_socketMutex );
+    return _streamId;
+}
+
+qint64 Socket::_getHeaderSize() const
+{
+    char firstByte;
+    if( _socket->peek( &firstByte, 1 ) != 1 )
+        return 0;
+
+    if( CompactMessageHeader::isCompact( firstByte ))
+        return CompactMessageHeader::serializedSize;
+    return MessageHeader::serializedSize;
+}
+
 bool Socket::_receiveHeader( MessageHeader& messageHeader )
 {
-    while( _socket->bytesAvailable() < qint64(MessageHeader::serializedSize) )
+    qint64 headerSize = _getHeaderSize();
+    while( headerSize == 0 || _socket->bytesAvailable() < headerSize )
     {
         if( !_socket->waitForReadyRead( RECEIVE_TIMEOUT_MS ))
             return false;
+        headerSize = _getHeaderSize();
     }
 
-    QDataStream stream( _socket );
-    stream >> messageHeader;
+    if( headerSize == qint64( MessageHeader::serializedSize ))
+    {
+        QDataStream stream( _socket );
+        stream >> messageHeader;
+        return stream.status() == QDataStream::Ok;
+    }
 
-    return stream.status() == QDataStream::Ok;
+    char data[CompactMessageHeader::serializedSize];
+    _socket->read( data, sizeof( data ));
+    CompactMessageHeader header;
+    header.deserialize( data );
+    messageHeader = header.toMessageHeader();
+    return true;
 }
 
 bool Socket::_connect( const std::string& hostname, const unsigned short port )
 {
     // make sure we're disconnected
-    _socket->disconnectFromHost();
+    _tcpSocket->disconnectFromHost();
 
     // open connection
-    _socket->connectToHost( hostname.c_str(), port );
+    _tcpSocket->connectToHost( hostname.c_str(), port );
 
-    if( !_socket->waitForConnected( RECEIVE_TIMEOUT_MS ))
+    if( !_tcpSocket->waitForConnected( RECEIVE_TIMEOUT_MS ))
     {
         std::cerr << "could not connect to host " << hostname << ":" << port
                   << std::endl;
@@ -201,10 +304,38 @@ bool Socket::_connect( const std::string& hostname, const unsigned short port )
 
     std::cerr << "Protocol version check failed for host: " << hostname << ":"
               << port << std::endl;
-    _socket->disconnectFromHost();
+    _tcpSocket->disconnectFromHost();
     return false;
 }
 
+bool Socket::_connectLocal( const std::string& path )
+{
+    _localSocket->connectToServer( QString::fromStdString( path ));
+
+    if( !_localSocket->waitForConnected( RECEIVE_TIMEOUT_MS ))
+    {
+        std::cerr << "could not connect to local socket " << path << std::endl;
+        return false;
+    }
+
+    // handshake
+    if( _checkProtocolVersion( ))
+        return true;
+
+    std::cerr << "Protocol version check failed for local socket: " << path
+              << std::endl;
+    _localSocket->disconnectFromServer();
+    return false;
+}
+
+void Socket::_disconnect()
+{
+    if( _localSocket )
+        _localSocket->disconnectFromServer();
+    else
+        _tcpSocket->disconnectFromHost();
+}
+
 bool Socket::_checkProtocolVersion()
 {
     while( _socket->bytesAvailable() < qint64(sizeof(int32_t)) )
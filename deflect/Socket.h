@@ -52,6 +52,8 @@ typedef __int32 int32_t;
 #include <QMutex>
 #include <QObject>
 
+class QIODevice;
+class QLocalSocket;
 class QTcpSocket;
 
 namespace deflect
@@ -68,10 +70,14 @@ public:
     /** The default communication port */
     static const unsigned short defaultPortNumber;
 
+    /** The prefix of Unix domain socket addresses */
+    static const std::string localSocketPrefix;
+
     /**
      * Construct a Socket and connect to host.
-     * @param hostname The target host (IP address or hostname)
-     * @param port The target port
+     * @param hostname The target host (IP address or hostname), or the path of
+     *        a Unix domain socket prefixed by localSocketPrefix ("unix:")
+     * @param port The target port, ignored for Unix domain sockets
      */
     DEFLECT_API Socket( const std::string& hostname,
                         unsigned short port = defaultPortNumber );
@@ -82,12 +88,19 @@ public:
     /** Is the Socket connected */
     DEFLECT_API bool isConnected() const;
 
+    /** Is the Socket connected to a host on the same machine (always true
+     *  for Unix domain sockets) */
+    bool isLocal() const;
+
     /**
      * Is there a pending message
      * @param messageSize Minimum size of the message
      */
     bool hasMessage( const size_t messageSize = 0 ) const;
 
+    /** Is there a pending message whose header and data are fully received */
+    bool hasCompleteMessage() const;
+
     /**
      * Get the FileDescriptor for the Socket (for use by poll())
      * @return The file descriptor if available, otherwise return -1.
@@ -96,19 +109,35 @@ public:
 
     /**
      * Send a message.
+     *
+     * Once a stream id is set, the message is sent with a compact header which
+     * replaces the uri by the stream id.
      * @param messageHeader The message header
      * @param message The message data
      * @return true if the message could be sent, false otherwise
      */
-    bool send( const MessageHeader& messageHeader, const QByteArray& message );
+    DEFLECT_API bool send( const MessageHeader& messageHeader,
+                           const QByteArray& message );
 
     /**
-     * Receive a message.
-     * @param messageHeader The received message header
+     * Receive a message, with either a regular or a compact header.
+     * @param messageHeader The received message header, without uri if it was
+     *        compact
      * @param message The received message data
      * @return true if a message could be received, false otherwise
      */
-    bool receive( MessageHeader& messageHeader, QByteArray& message );
+    DEFLECT_API bool receive( MessageHeader& messageHeader,
+                              QByteArray& message );
+
+    /**
+     * Send the next messages with compact headers.
+     * @param streamId The id assigned by the server to the stream, or 0 to
+     *        go back to regular headers.
+     */
+    DEFLECT_API void setStreamId( uint32_t streamId );
+
+    /** @return the stream id used for compact headers, 0 if not used. */
+    DEFLECT_API uint32_t getStreamId() const;
 
     /** Get the protocol version of the remote host */
     int32_t getRemoteProtocolVersion() const;
@@ -118,13 +147,19 @@ signals:
     void disconnected();
 
 private:
-    QTcpSocket* _socket;
+    QTcpSocket* _tcpSocket;
+    QLocalSocket* _localSocket;
+    QIODevice* _socket;
     int32_t _remoteProtocolVersion;
+    uint32_t _streamId;
     mutable QMutex _socketMutex;
 
     bool _connect( const std::string &hostname, const unsigned short port );
+    bool _connectLocal( const std::string& path );
+    void _disconnect();
     bool _checkProtocolVersion();
 
+    qint64 _getHeaderSize() const;
     bool _receiveHeader( MessageHeader& messageHeader );
 };
 
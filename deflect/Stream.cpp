@@ -51,6 +51,8 @@
 
 #include <iostream>
 
+#define EVENT_TIMEOUT_MS 1000
+
 namespace deflect
 {
 
@@ -109,8 +111,7 @@ bool Stream::registerForEvents( const bool exclusive )
 
     // Wait for bind reply
     QByteArray message;
-    const bool success = _impl->socket.receive( mh, message );
-    if( !success || mh.type != MESSAGE_TYPE_BIND_EVENTS_REPLY )
+    if( !_impl->receiveReply( MESSAGE_TYPE_BIND_EVENTS_REPLY, message ))
     {
         std::cerr << "Invalid reply from host" << std::endl;
         return false;
@@ -131,30 +132,75 @@ int Stream::getDescriptor() const
     return _impl->socket.getFileDescriptor();
 }
 
+bool Stream::startEventThread( const EventCallback& callback )
+{
+    if( !isRegisteredForEvents( ))
+    {
+        std::cerr << "Stream is not registered for events, "
+                  << "startEventThread failed" << std::endl;
+        return false;
+    }
+    return _impl->startEventThread( callback );
+}
+
 bool Stream::hasEvent() const
 {
-    return _impl->socket.hasMessage( Event::serializedSize );
+    return _impl->hasEvent();
 }
 
 Event Stream::getEvent()
 {
+    Event event;
+    if( _impl->isEventThreadRunning( ))
+    {
+        if( _impl->waitForEvent( EVENT_TIMEOUT_MS ))
+            _impl->pendingEvents.dequeue( event );
+        return event;
+    }
+
     MessageHeader mh;
     QByteArray message;
-    const bool success = _impl->socket.receive( mh, message );
-    if( !success || mh.type != MESSAGE_TYPE_EVENT )
+    while( _impl->pendingEvents.empty( ))
     {
-        std::cerr << "Invalid reply from host" << std::endl;
-        return Event();
+        if( !_impl->receive( mh, message ))
+        {
+            std::cerr << "Invalid reply from host" << std::endl;
+            return Event();
+        }
     }
+    _impl->pendingEvents.dequeue( event );
+    return event;
+}
 
-    assert( (size_t)message.size() == Event::serializedSize );
+std::vector< Event > Stream::getCoalescedEvents()
+{
+    // Only the events received so far are coalesced, the ones which keep
+    // arriving meanwhile, from the event thread in particular, are left for
+    // the next call
+    _impl->processPendingMessages();
 
-    Event event;
+    std::vector< Event > events;
+    _impl->pendingEvents.dequeueAvailable( [&events]( const Event& event )
     {
-        QDataStream stream( message );
-        stream >> event;
-    }
-    return event;
+        if( events.empty() || !coalesceEvents( events.back(), event ))
+            events.push_back( event );
+    });
+    return events;
+}
+
+bool Stream::setMaxFramesInFlight( const unsigned int count )
+{
+    return _impl->setMaxFramesInFlight( count );
+}
+
+void Stream::setSharedMemoryEnabled( const bool enable )
+{
+    _impl->setSharedMemoryEnabled( enable );
+}
+
+bool Stream::isUsingSharedMemory() const
+{
+    return _impl->isUsingSharedMemory();
 }
 
 void Stream::sendSizeHints( const SizeHints& hints )
@@ -47,8 +47,10 @@
 #include <deflect/Event.h>
 #include <deflect/ImageWrapper.h>
 
+#include <functional>
 #include <memory>
 #include <string>
+#include <vector>
 
 #ifndef Q_MOC_RUN  // See: https://bugreports.qt-project.org/browse/QTBUG-22829
 // needed for future.hpp with Boost 1.41
@@ -93,7 +95,10 @@ public:
      * @param name An identifier for the stream which cannot be empty.
      * @param address Address of the target DisplayCluster instance, can be a
      *                hostname like "localhost" or an IP in string format like
-     *                "192.168.1.83".
+     *                "192.168.1.83". The path of a Unix domain socket on
+     *                which the instance listens can be given as
+     *                "unix:/path/to/socket", in which case the port is
+     *                ignored.
      * @param port Port of the DisplayCluster instance, default 1701.
      * @version 1.0
      */
@@ -106,7 +111,16 @@ public:
     /** @return true if the stream is connected, false otherwise. @version 1.0*/
     DEFLECT_API bool isConnected() const;
 
-    /** Emitted after the stream was disconnected. @version 1.0 */
+    /**
+     * Emitted after the stream was disconnected.
+     *
+     * The signal is emitted in the thread which detected the disconnection:
+     * the caller of a send, finish or event function, the thread of
+     * asyncSend() or the thread started by startEventThread(). The connected
+     * slots must thus be thread-safe, and must not destroy the Stream or
+     * block waiting for one of these threads.
+     * @version 1.0
+     */
     boost::signals2::signal< void() > disconnected;
 
     /** @name Asynchronous send API */
@@ -114,6 +128,9 @@ public:
     /** Future signaling success of asyncSend(). @version 1.1 */
     typedef boost::unique_future< bool > Future;
 
+    /** Function receiving the Events in the event thread. */
+    typedef std::function< void( const Event& ) > EventCallback;
+
     /**
      * Send an image and finish the frame asynchronously.
      *
@@ -157,6 +174,53 @@ public:
      * @version 1.0
      */
     DEFLECT_API bool finishFrame();
+
+    /**
+     * Limit the number of frames sent ahead of the receiver.
+     *
+     * When enabled, finishFrame() blocks while the given number of frames
+     * have been finished but not yet consumed by the receiving application,
+     * which paces the Stream to the rate of the display instead of filling the
+     * network and the receive buffers. Events received while waiting remain
+     * available through getEvent().
+     *
+     * This method is synchronous and waits for a reply from the host the first
+     * time flow control is enabled. Hosts announce their support when the
+     * stream is opened. finishFrame() keeps waiting as long as the receiving
+     * application does not request frames, for instance while it is paused,
+     * and only returns false if the connection to the host is lost.
+     *
+     * @param count the maximum number of frames in flight, 0 to disable
+     *        (default)
+     * @return true on success, false if the host does not support it.
+     * @version 1.3
+     */
+    DEFLECT_API bool setMaxFramesInFlight( unsigned int count );
+
+    /**
+     * Allow sending segments through shared memory.
+     *
+     * When the host runs on the same machine, enabling it offers the host a
+     * 64 MB ring buffer in shared memory, allocated on the first call. Once
+     * the host has accepted it, which is checked at each finishFrame(),
+     * segments are copied into the ring instead of being sent through the TCP
+     * loopback, which then only carries small control messages. The host
+     * still copies each segment out of the ring to release its space, so this
+     * saves the copies through the kernel but not that one. This is disabled
+     * by default; hosts which do not support it are transparently served over
+     * TCP. Must not be called concurrently with send() or asyncSend().
+     *
+     * @param enable true to send the segments through shared memory when
+     *        possible, false to send all of them through TCP
+     * @version 1.3
+     */
+    DEFLECT_API void setSharedMemoryEnabled( bool enable );
+
+    /**
+     * @return true if segments are sent through shared memory.
+     * @version 1.3
+     */
+    DEFLECT_API bool isUsingSharedMemory() const;
     //@}
 
     /**
@@ -191,6 +255,26 @@ public:
      */
     DEFLECT_API bool isRegisteredForEvents() const;
 
+    /**
+     * Receive the Events in a background thread.
+     *
+     * The thread reads all the messages sent by the DisplayCluster application
+     * as soon as they arrive, independently of the images sent. The Events are
+     * then either queued for hasEvent() and getEvent(), which no longer access
+     * the socket and never block in hasEvent(), or passed to the callback.
+     *
+     * The thread runs until the Stream is destroyed or disconnected.
+     *
+     * @param callback Optional function called in the event thread for each
+     *        Event instead of queuing it. The Events already queued are passed
+     *        to it before this method returns.
+     * @return true if the thread is running, false if the Stream is not
+     *         registered for events.
+     * @version 1.3
+     */
+    DEFLECT_API bool startEventThread( const EventCallback& callback =
+                                           EventCallback( ));
+
     /**
      * Get the native descriptor for the data stream.
      *
@@ -209,7 +293,7 @@ public:
      *
      * This method is non-blocking. Use this method prior to calling getEvent(),
      * for example as the condition for a while() loop to process all pending
-     * events.
+     * events. It is wait-free once the event thread is started.
      *
      * @return True if an Event is available, false otherwise
      * @version 1.0
@@ -230,6 +314,23 @@ public:
      */
     DEFLECT_API Event getEvent();
 
+    /**
+     * Get all the available Events, coalesced.
+     *
+     * Consecutive moves and wheels are merged (see coalesceEvents()) so that
+     * only their latest position and accumulated deltas have to be processed,
+     * for example once per frame after a slow frame. The order of the other
+     * Events, such as presses, releases and keys, is preserved.
+     *
+     * This method is non-blocking and returns an empty vector if no Event is
+     * available. The Events received during the call, for instance by the
+     * event thread, are left for the next call.
+     *
+     * @return The available Events, in order of reception
+     * @version 1.3
+     */
+    DEFLECT_API std::vector< Event > getCoalescedEvents();
+
     /**
      * Send size hints to the stream host to indicate sizes that should be
      * respected by resize operations on the host side.
@@ -39,162 +39,61 @@
 
 #include "StreamEventThread.h"
 
-StreamEventThread::StreamEventThread()
-{
-}
+#include "MessageHeader.h"
+#include "StreamPrivate.h"
 
-void StreamEventThread::storeNewInteractionState(InteractionState state)
-{
-    QMutexLocker lock(&interactionStateMutex_);
-    interactionStates_.enqueue(state);
-}
+#ifdef _WIN32
+#  include <chrono>
+#else
+#  include <poll.h>
+#endif
 
-bool StreamEventThread::hasPendingInteractionState() const
-{
-    QMutexLocker lock(&interactionStateMutex_);
-    return !interactionStates_.empty();
-}
+#define POLL_TIMEOUT_MS 5
 
-InteractionState StreamEventThread::retrieveInteractionState()
+namespace deflect
 {
-    QMutexLocker lock(&interactionStateMutex_);
 
-    if (interactionStates_.empty())
-        return InteractionState();
+StreamEventThread::StreamEventThread( StreamPrivate& stream )
+    : _stream( stream )
+    , _running( true )
+    , _thread( &StreamEventThread::_run, this )
+{}
 
-    return interactionStates_.dequeue();
+StreamEventThread::~StreamEventThread()
+{
+    _running = false;
+    _thread.join();
 }
 
-void StreamEventThread::run()
+void StreamEventThread::_run()
 {
-    put_flog(LOG_DEBUG, "started");
-
-    while(true)
+    MessageHeader mh;
+    QByteArray message;
+    while( _running && _stream.socket.isConnected( ))
     {
-        // break here if we had a failure
-        if( !sendMessage_( ))
-            break;
-
-        MESSAGE_TYPE type;
-        receiveMessage_( type );
-
-        // make sure the socket is still connected
-        if(socket_->state() != QAbstractSocket::ConnectedState)
-        {
-            put_flog(LOG_ERROR, "socket disconnected");
-            break;
-        }
-
-        // flush the socket
-        socket_->flush();
-
-        // break if disconnect() was called
+        // Only complete messages are read to never keep the socket locked
+        // while waiting, which would delay the images sent by the Stream.
+        while( _running && _stream.socket.hasCompleteMessage( ))
         {
-            QMutexLocker locker(&disconnectFlagMutex_);
-
-            if(disconnectFlag_ == true)
-            {
+            if( !_stream.receive( mh, message ))
                 break;
-            }
         }
+        _waitForData();
     }
-
-    // delete the socket
-    delete socket_;
-    socket_ = NULL;
-
-    put_flog(LOG_DEBUG, "finished");
+    _stream.notifyReceived();
 }
 
-bool StreamEventThread::queueMessage(QByteArray message)
+void StreamEventThread::_waitForData()
 {
-    // only queue the message if we're connected
-    if(!isConnected())
-    {
-        return false;
-    }
-
-    {
-        QMutexLocker locker(&sendMessagesQueueMutex_);
-        sendMessagesQueue_.push(message);
-    }
-
-    sendMessage_();
-
-    return true;
+#ifdef _WIN32
+    std::this_thread::sleep_for( std::chrono::milliseconds( 1 ));
+#else
+    pollfd descriptor;
+    descriptor.fd = _stream.socket.getFileDescriptor();
+    descriptor.events = POLLIN;
+    descriptor.revents = 0;
+    ::poll( &descriptor, 1, POLL_TIMEOUT_MS );
+#endif
 }
 
-bool StreamEventThread::sendMessage_()
-{
-    // send a message if available
-    QByteArray sendMessage;
-
-    {
-        QMutexLocker locker(&sendMessagesQueueMutex_);
-
-        if(sendMessagesQueue_.size() > 0)
-        {
-            sendMessage = sendMessagesQueue_.front();
-            sendMessagesQueue_.pop();
-        }
-    }
-
-    if(!sendMessage.isEmpty())
-    {
-        bool success = socketSendMessage(sendMessage);
-
-        if(!success)
-        {
-            put_flog(LOG_ERROR, "error sending message");
-            return false;
-        }
-    }
-    return true;
-}
-
-bool StreamEventThread::receiveMessage_( MESSAGE_TYPE& type )
-{
-    type = MESSAGE_TYPE_NONE;
-
-    if(socket_->bytesAvailable() < (int)sizeof(MessageHeader))
-        return false;
-
-    MessageHeader messageHeader;
-    QByteArray message;
-
-    bool success = socketReceiveMessage(messageHeader, message);
-
-    if( !success )
-    {
-        put_flog(LOG_ERROR, "error receiving message");
-        return false;
-    }
-
-    type = messageHeader.type;
-
-    // handle the message
-    if(type == MESSAGE_TYPE_ACK)
-    {
-    }
-    else if(type == MESSAGE_TYPE_INTERACTION)
-    {
-        InteractionState interactionState = *(InteractionState *)(message.data());
-        emit received(interactionState);
-    }
-    else if(type == MESSAGE_TYPE_BIND_INTERACTION_REPLY)
-    {
-        bool success = *(bool*)(message.data());
-        emit receivedInteractionBindReply(success);
-    }
-    else if(type == MESSAGE_TYPE_QUIT)
-    {
-        put_flog(LOG_INFO, "Received QUIT - TODO implement this action");
-    }
-    else
-    {
-        put_flog(LOG_ERROR, "unknown message header type %i", type);
-        return false;
-    }
-    return true;
 }
-
@@ -40,49 +40,44 @@
 #ifndef DEFLECT_STREAMEVENTTHREAD_H
 #define DEFLECT_STREAMEVENTTHREAD_H
 
-#include <deflect/config.h>
-#include <QObject>
-#include <QMutex>
-#include <QQueue>
+#include <atomic>
+#include <thread>
+
+namespace deflect
+{
+
+class StreamPrivate;
 
 /**
- * This class might serve as an EventProcessing thread to read InteractionStates
- * from the Socket.
+ * Background thread receiving the messages sent by the host to a Stream.
  *
- * !!! IT IS NOT IMPLEMENTED YET !!!
+ * Complete messages are handed to StreamPrivate::receive(), which queues the
+ * events and accounts for the replies, so that reading events never blocks on
+ * the socket nor depends on the Stream sending images.
  */
-class StreamEventThread : public QObject
+class StreamEventThread
 {
-    Q_OBJECT
-
 public:
-    StreamEventThread();
-
-    // queue a message to be sent (non-blocking)
-    bool queueMessage(QByteArray message);
+    /** Start receiving the messages of an existing stream object. */
+    explicit StreamEventThread( StreamPrivate& stream );
 
-    // current interaction state
-    mutable QMutex interactionStateMutex_;
-    QQueue<InteractionState> interactionStates_;
-
-    bool hasPendingInteractionState() const;
-    InteractionState retrieveInteractionState();
-
-    // thread execution
-    void run() final;
-
-public slots:
-    void storeNewInteractionState(InteractionState state);
-    void setInteractionBound(bool success);
+    /** Stop the thread, leaving unread messages in the socket. */
+    ~StreamEventThread();
 
 private:
-    // mutex and queue for messages to send
-    QMutex sendMessagesQueueMutex_;
-    std::queue<QByteArray> sendMessagesQueue_;
+    StreamEventThread( const StreamEventThread& ) = delete;
+    StreamEventThread& operator=( const StreamEventThread& ) = delete;
+
+    /** Receive messages until stopped or disconnected. */
+    void _run();
 
-    bool sendMessage_();
-    bool receiveMessage_( MESSAGE_TYPE& type );
+    /** Wait for new data on the socket, without holding its lock. */
+    void _waitForData();
 
+    StreamPrivate& _stream;
+    std::atomic< bool > _running;
+    std::thread _thread;
 };
 
+}
 #endif
@@ -41,16 +41,29 @@
 
 #include "StreamPrivate.h"
 
+#include "NetworkProtocol.h"
 #include "Segment.h"
 #include "SegmentParameters.h"
+#include "SharedMemoryRing.h"
 #include "SizeHints.h"
 #include "Stream.h"
+#include "StreamEventThread.h"
 #include "StreamSendWorker.h"
 
+#include <QDataStream>
+#include <QtEndian>
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
 #include <iostream>
 
 #include <boost/thread/thread.hpp>
 #define SEGMENT_SIZE 512
+#define SHARED_MEMORY_SIZE ( 64 * 1024 * 1024 )
+#define REPLY_TIMEOUT_MS 1000
+#define SHARED_MEMORY_TIMEOUT_MS 100
+#define FRAME_ACKS_POLL_MS 100
 
 namespace deflect
 {
@@ -63,6 +76,14 @@ StreamPrivate::StreamPrivate( Stream* stream, const std::string &name_,
     , registeredForEvents( false )
     , _parent( stream )
     , _sendWorker( 0 )
+    , _frameAcksEnabled( false )
+    , _maxFramesInFlight( 0 )
+    , _framesInFlight( 0 )
+    , _openReplied( false )
+    , _hostFeatures( 0 )
+    , _sharedMemoryBound( false )
+    , _sharedMemoryEnabled( false )
+    , _eventThreadRunning( false )
 {
     imageSegmenter.setNominalSegmentDimensions( SEGMENT_SIZE, SEGMENT_SIZE );
 
@@ -71,16 +92,25 @@ StreamPrivate::StreamPrivate( Stream* stream, const std::string &name_,
 
     if( socket.isConnected( ))
     {
+        // The disconnection may be detected by the event or send threads,
+        // Stream::disconnected is emitted in the detecting thread
         connect( &socket, &Socket::disconnected,
-                 this, &StreamPrivate::_onDisconnected );
-        const MessageHeader mh( MESSAGE_TYPE_PIXELSTREAM_OPEN, 0, name );
-        socket.send( mh, QByteArray( ));
+                 this, &StreamPrivate::_onDisconnected,
+                 Qt::DirectConnection );
+        // Request compact headers, servers without support ignore the payload
+        QByteArray version( sizeof( quint32 ), '\0' );
+        qToLittleEndian< quint32 >( COMPACT_HEADER_PROTOCOL_VERSION,
+                                    (uchar*)version.data( ));
+        const MessageHeader mh( MESSAGE_TYPE_PIXELSTREAM_OPEN, version.size(),
+                                name );
+        socket.send( mh, version );
     }
 }
 
 StreamPrivate::~StreamPrivate()
 {
     delete _sendWorker;
+    _eventThread.reset();
 
     if( !socket.isConnected( ))
         return;
@@ -116,13 +146,213 @@ Stream::Future StreamPrivate::asyncSend( const ImageWrapper& image )
 
 bool StreamPrivate::finishFrame()
 {
+    // Compact headers and shared memory are used from the next frame on once
+    // the server replied
+    if( !socket.getStreamId() || ( _sharedMemory && !_sharedMemoryBound ))
+        processPendingMessages();
+
     // Open a window for the PixelStream
     const MessageHeader mh( MESSAGE_TYPE_PIXELSTREAM_FINISH_FRAME, 0, name );
-    return socket.send( mh, QByteArray( ));
+    if( !socket.send( mh, QByteArray( )))
+        return false;
+
+    if( !_frameAcksEnabled )
+        return true;
+
+    {
+        std::lock_guard< std::mutex > lock( _framesMutex );
+        ++_framesInFlight;
+    }
+    return _waitForFrameAcks();
+}
+
+bool StreamPrivate::setMaxFramesInFlight( const unsigned int count )
+{
+    if( count > 0 && !_frameAcksEnabled )
+    {
+        // Supporting servers announce it in the reply to the stream opening
+        if( !_waitForOpenReply() ||
+            !( _hostFeatures & PROTOCOL_FEATURE_FRAME_ACKS ))
+        {
+            std::cerr << "Host does not support frame acknowledgements"
+                      << std::endl;
+            return false;
+        }
+
+        const MessageHeader mh( MESSAGE_TYPE_BIND_FRAME_ACKS, 0, name );
+        QByteArray message;
+        if( !socket.send( mh, QByteArray( )) ||
+            !receiveReply( MESSAGE_TYPE_BIND_FRAME_ACKS_REPLY, message ))
+        {
+            std::cerr << "Could not enable frame acknowledgements"
+                      << std::endl;
+            return false;
+        }
+        _frameAcksEnabled = true;
+    }
+
+    _maxFramesInFlight = count;
+    return true;
+}
+
+void StreamPrivate::setSharedMemoryEnabled( const bool enable )
+{
+    _sharedMemoryEnabled = enable;
+
+    // The ring is only allocated for the streams which request it
+    if( enable && !_sharedMemory && socket.isConnected() && socket.isLocal( ))
+        _bindSharedMemory();
+}
+
+bool StreamPrivate::isUsingSharedMemory() const
+{
+    return _sharedMemory && _sharedMemoryEnabled && _sharedMemoryBound;
+}
+
+bool StreamPrivate::startEventThread( const Stream::EventCallback& callback )
+{
+    if( _eventThreadRunning )
+        return true;
+
+    if( !registeredForEvents || !socket.isConnected( ))
+        return false;
+
+    // Events received before are delivered first to preserve their order
+    _eventCallback = callback;
+    Event event;
+    while( _eventCallback && pendingEvents.dequeue( event ))
+        _eventCallback( event );
+
+    _eventThreadRunning = true;
+    _eventThread.reset( new StreamEventThread( *this ));
+    return true;
+}
+
+bool StreamPrivate::isEventThreadRunning() const
+{
+    return _eventThreadRunning;
+}
+
+bool StreamPrivate::hasEvent()
+{
+    if( _eventThreadRunning )
+        return !pendingEvents.empty();
+
+    MessageHeader mh;
+    QByteArray message;
+    while( pendingEvents.empty() && socket.hasCompleteMessage( ))
+    {
+        if( !receive( mh, message ))
+            break;
+    }
+    return !pendingEvents.empty();
+}
+
+void StreamPrivate::processPendingMessages()
+{
+    // The event thread already processes all incoming messages
+    if( _eventThreadRunning )
+        return;
+
+    MessageHeader mh;
+    QByteArray message;
+    while( socket.hasMessage( ) && receive( mh, message )) {}
+}
+
+bool StreamPrivate::waitForEvent( const unsigned int timeoutMs )
+{
+    std::unique_lock< std::mutex > lock( _receiveMutex );
+    _received.wait_for( lock, std::chrono::milliseconds( timeoutMs ), [this]
+        { return !pendingEvents.empty() || !socket.isConnected(); });
+    return !pendingEvents.empty();
+}
+
+void StreamPrivate::notifyReceived()
+{
+    // Locking guarantees that a waiting thread does not miss the notification
+    {
+        std::lock_guard< std::mutex > lock( _receiveMutex );
+    }
+    _received.notify_all();
+}
+
+bool StreamPrivate::receive( MessageHeader& messageHeader, QByteArray& message )
+{
+    if( !socket.receive( messageHeader, message ))
+        return false;
+
+    switch( messageHeader.type )
+    {
+    case MESSAGE_TYPE_EVENT:
+    {
+        assert( (size_t)message.size() == Event::serializedSize );
+
+        Event event;
+        {
+            QDataStream stream( message );
+            stream >> event;
+        }
+        if( _eventCallback )
+            _eventCallback( event );
+        else
+            pendingEvents.enqueue( event );
+        break;
+    }
+    case MESSAGE_TYPE_FRAME_ACK:
+        _processFrameAck( message );
+        break;
+    case MESSAGE_TYPE_PIXELSTREAM_OPEN_REPLY:
+    {
+        // The stream id, followed by the features of the host if any
+        const uchar* data = (const uchar*)message.constData();
+        if( message.size() >= int( sizeof( quint32 )))
+            socket.setStreamId( qFromLittleEndian< quint32 >( data ));
+        if( message.size() >= int( 2 * sizeof( quint32 )))
+            _hostFeatures = qFromLittleEndian< quint32 >(
+                                data + sizeof( quint32 ));
+        _openReplied = true;
+        break;
+    }
+    case MESSAGE_TYPE_BIND_SHARED_MEMORY_REPLY:
+        _sharedMemoryBound = message.size() == sizeof( bool ) &&
+                             *reinterpret_cast< const bool* >( message.data( ));
+        if( !_sharedMemoryBound )
+            std::cerr << "Host could not attach shared memory, using TCP only"
+                      << std::endl;
+        break;
+    default:
+        if( _eventThreadRunning )
+        {
+            std::lock_guard< std::mutex > lock( _receiveMutex );
+            _replies[messageHeader.type] = message;
+        }
+        break;
+    }
+
+    if( _eventThreadRunning )
+        notifyReceived();
+    return true;
+}
+
+bool StreamPrivate::receiveReply( const MessageType type, QByteArray& message )
+{
+    if( _eventThreadRunning )
+        return _waitForReply( type, message );
+
+    MessageHeader mh;
+    while( receive( mh, message ))
+    {
+        if( mh.type == type )
+            return true;
+    }
+    return false;
 }
 
 bool StreamPrivate::sendPixelStreamSegment( const Segment& segment )
 {
+    if( isUsingSharedMemory() && _sendThroughSharedMemory( segment ))
+        return true;
+
     // Create message header
     const uint32_t segmentSize( sizeof( SegmentParameters ) +
                                 segment.imageData.size( ));
@@ -159,6 +389,133 @@ bool StreamPrivate::sendCommand( const QString& command )
     return socket.send( mh, message );
 }
 
+unsigned int StreamPrivate::_getFramesInFlight()
+{
+    std::lock_guard< std::mutex > lock( _framesMutex );
+    return _framesInFlight;
+}
+
+void StreamPrivate::_processFrameAck( const QByteArray& message )
+{
+    quint32 count = 0;
+    {
+        QDataStream stream( message );
+        stream >> count;
+    }
+
+    // Acknowledgements may also cover frames finished before they were enabled
+    std::lock_guard< std::mutex > lock( _framesMutex );
+    _framesInFlight -= std::min( _framesInFlight, (unsigned int)count );
+}
+
+bool StreamPrivate::_waitForFrameAcks()
+{
+    std::unique_lock< std::mutex > lock( _receiveMutex, std::defer_lock );
+    if( _eventThreadRunning )
+        lock.lock();
+
+    MessageHeader mh;
+    QByteArray message;
+    while( _maxFramesInFlight > 0 &&
+           _getFramesInFlight() >= _maxFramesInFlight )
+    {
+        // The receiving application may be paused for any amount of time,
+        // only a lost connection ends the wait
+        if( !socket.isConnected( ))
+            return false;
+
+        if( _eventThreadRunning )
+            _received.wait_for( lock,
+                               std::chrono::milliseconds( FRAME_ACKS_POLL_MS ));
+        else
+            receive( mh, message ); // returns false on timeout
+    }
+    return true;
+}
+
+bool StreamPrivate::_waitForOpenReply()
+{
+    if( _eventThreadRunning )
+    {
+        const std::chrono::milliseconds timeout( REPLY_TIMEOUT_MS );
+        std::unique_lock< std::mutex > lock( _receiveMutex );
+        return _received.wait_for( lock, timeout,
+                                   [this] { return _openReplied.load(); });
+    }
+
+    // Hosts older than COMPACT_HEADER_PROTOCOL_VERSION never reply
+    MessageHeader mh;
+    QByteArray message;
+    while( !_openReplied && receive( mh, message )) {}
+    return _openReplied;
+}
+
+bool StreamPrivate::_waitForReply( const MessageType type, QByteArray& message )
+{
+    std::unique_lock< std::mutex > lock( _receiveMutex );
+    if( !_received.wait_for( lock, std::chrono::milliseconds( REPLY_TIMEOUT_MS ),
+                             [this, type] { return _replies.count( type ) > 0; }))
+    {
+        return false;
+    }
+    message = _replies[type];
+    _replies.erase( type );
+    return true;
+}
+
+void StreamPrivate::_bindSharedMemory()
+{
+    _sharedMemory.reset( new SharedMemoryRing );
+    if( !_sharedMemory->create( SHARED_MEMORY_SIZE ))
+    {
+        _sharedMemory.reset();
+        return;
+    }
+
+    // Servers which do not support shared memory never reply, so the reply is
+    // processed asynchronously and segments go through TCP until then.
+    const QByteArray key = _sharedMemory->getKey().toUtf8();
+    const MessageHeader mh( MESSAGE_TYPE_BIND_SHARED_MEMORY, key.size(), name );
+    if( !socket.send( mh, key ))
+        _sharedMemory.reset();
+}
+
+bool StreamPrivate::_sendThroughSharedMemory( const Segment& segment )
+{
+    const size_t size = sizeof( SegmentParameters ) + segment.imageData.size();
+
+    // Segments are released by the server in the order of the control
+    // messages, which must thus follow the order of the records in the ring.
+    std::lock_guard< std::mutex > lock( _sharedMemoryMutex );
+
+    // A host which is slow to release the ring gets the segment through the
+    // socket instead of blocking the Stream
+    typedef std::chrono::steady_clock Clock;
+    const Clock::time_point deadline =
+        Clock::now() + std::chrono::milliseconds( SHARED_MEMORY_TIMEOUT_MS );
+
+    SharedMemoryRing::Record record;
+    char* data = _sharedMemory->reserve( size, record, [this, deadline]
+    {
+        return socket.isConnected() && Clock::now() < deadline;
+    });
+    if( !data )
+        return false;
+
+    std::memcpy( data, &segment.parameters, sizeof( SegmentParameters ));
+    std::memcpy( data + sizeof( SegmentParameters ),
+                 segment.imageData.constData(), segment.imageData.size( ));
+
+    QByteArray message;
+    {
+        QDataStream stream( &message, QIODevice::WriteOnly );
+        stream << record.position << record.size;
+    }
+    const MessageHeader mh( MESSAGE_TYPE_PIXELSTREAM_SHARED_MEMORY,
+                            message.size(), name );
+    return socket.send( mh, message );
+}
+
 void StreamPrivate::_onDisconnected()
 {
     if( _parent )
@@ -47,9 +47,15 @@
 #include "Event.h"
 #include "MessageHeader.h"
 #include "ImageSegmenter.h"
+#include "MPSCQueue.h" // member
 #include "Socket.h" // member
 #include "Stream.h" // Stream::Future
 
+#include <atomic>
+#include <condition_variable>
+#include <map>
+#include <memory>
+#include <mutex>
 #include <string>
 
 class QString;
@@ -57,6 +63,8 @@ class QString;
 namespace deflect
 {
 
+class SharedMemoryRing;
+class StreamEventThread;
 class StreamSendWorker;
 
 /**
@@ -100,6 +108,70 @@ public:
     /** @sa Stream::finishFrame */
     bool finishFrame();
 
+    /** @sa Stream::setMaxFramesInFlight */
+    bool setMaxFramesInFlight( unsigned int count );
+
+    /** @sa Stream::setSharedMemoryEnabled */
+    void setSharedMemoryEnabled( bool enable );
+
+    /** @sa Stream::isUsingSharedMemory */
+    bool isUsingSharedMemory() const;
+
+    /** @sa Stream::startEventThread */
+    bool startEventThread( const Stream::EventCallback& callback );
+
+    /** @return true if the messages are received by the event thread. */
+    bool isEventThreadRunning() const;
+
+    /**
+     * Check if an event is available, without blocking.
+     *
+     * Unless the event thread runs, the messages already fully received are
+     * processed until an event is found, since frame acknowledgements and
+     * replies share the socket with the events.
+     * @return true if an event is in pendingEvents
+     */
+    bool hasEvent();
+
+    /**
+     * Process the messages already received, without blocking.
+     *
+     * Events are queued in pendingEvents and replies are accounted for. Does
+     * nothing when the event thread runs, since it processes all the messages.
+     */
+    void processPendingMessages();
+
+    /**
+     * Wait until the event thread queued an event in pendingEvents.
+     * @param timeoutMs The maximum time to wait
+     * @return true if an event is available, false otherwise
+     */
+    bool waitForEvent( unsigned int timeoutMs );
+
+    /** Wake up the threads waiting for messages from the event thread. */
+    void notifyReceived();
+
+    /**
+     * Receive a message from the host.
+     *
+     * Frame acknowledgements are accounted for and events are queued in
+     * pendingEvents (or given to the event callback) before the message is
+     * returned to the caller. When the event thread runs, the other messages
+     * are kept for receiveReply().
+     * @param messageHeader The received message header
+     * @param message The received message data
+     * @return true if a message could be received, false otherwise
+     */
+    bool receive( MessageHeader& messageHeader, QByteArray& message );
+
+    /**
+     * Receive messages until a reply of the given type is found.
+     * @param type The type of the expected reply
+     * @param message The received reply data
+     * @return true if the reply was received, false otherwise
+     */
+    bool receiveReply( MessageType type, QByteArray& message );
+
     /**
      * Send an existing PixelStreamSegment via the Socket.
      * @param socket The Socket instance
@@ -131,12 +203,44 @@ public:
     /** Has a successful event registration reply been received */
     bool registeredForEvents;
 
+    /** Events received but not yet retrieved with Stream::getEvent() */
+    MPSCQueue< Event > pendingEvents;
+
 private slots:
     void _onDisconnected();
 
 private:
     Stream* _parent;
     StreamSendWorker* _sendWorker;
+
+    bool _frameAcksEnabled;
+    unsigned int _maxFramesInFlight;
+    unsigned int _framesInFlight;
+    std::mutex _framesMutex;
+
+    std::atomic< bool > _openReplied;
+    std::atomic< quint32 > _hostFeatures;
+
+    std::unique_ptr< SharedMemoryRing > _sharedMemory;
+    std::atomic< bool > _sharedMemoryBound;
+    std::atomic< bool > _sharedMemoryEnabled;
+    std::mutex _sharedMemoryMutex;
+
+    Stream::EventCallback _eventCallback;
+    std::atomic< bool > _eventThreadRunning;
+    std::unique_ptr< StreamEventThread > _eventThread;
+    std::map< MessageType, QByteArray > _replies;
+    std::mutex _receiveMutex;
+    std::condition_variable _received;
+
+    unsigned int _getFramesInFlight();
+    void _processFrameAck( const QByteArray& message );
+    bool _waitForFrameAcks();
+    bool _waitForOpenReply();
+    bool _waitForReply( MessageType type, QByteArray& message );
+
+    void _bindSharedMemory();
+    bool _sendThroughSharedMemory( const Segment& segment );
 };
 
 }
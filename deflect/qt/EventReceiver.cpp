@@ -65,10 +65,8 @@ void EventReceiver::_onEvent( int socket )
     if( socket != _stream.getDescriptor( ))
         return;
 
-    while( _stream.hasEvent( ))
+    for( const Event& deflectEvent : _stream.getCoalescedEvents( ))
     {
-        const Event& deflectEvent = _stream.getEvent();
-
         switch( deflectEvent.type )
         {
         case Event::EVT_CLOSE:
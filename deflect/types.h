@@ -44,6 +44,7 @@
 #include <deflect/config.h>
 
 #include <boost/shared_ptr.hpp>
+#include <map>
 #include <vector>
 
 namespace deflect
@@ -54,8 +55,11 @@ class Command;
 class CommandHandler;
 class EventReceiver;
 class Frame;
+class FrameAssembler;
 class FrameDispatcher;
 class SegmentDecoder;
+class SegmentIndex;
+class SegmentRetiler;
 class Server;
 class Stream;
 
@@ -66,7 +70,18 @@ struct Segment;
 struct SegmentParameters;
 struct SizeHints;
 
+/** The policy for delivering the frames of a stream to its consumer. */
+enum DeliveryMode
+{
+    DELIVERY_LATEST_ONLY,    /**< Only the most recent complete frame */
+    DELIVERY_EVERY_FRAME,    /**< All complete frames, in order */
+    DELIVERY_PARTIAL_UPDATES /**< Latest frame of each source, independently */
+};
+
 typedef boost::shared_ptr< Frame > FramePtr;
+/** Number of frames for each source (by index) of a stream, shared read-only */
+typedef boost::shared_ptr< const std::map< size_t, unsigned int >>
+    SourceFrameCountsPtr;
 typedef std::vector< Segment > Segments;
 typedef std::vector< SegmentParameters > SegmentParametersList;
 
@@ -0,0 +1,127 @@
+/*********************************************************************/
+/* Copyright (c) 2015, EPFL/Blue Brain Project                       */
+/*                     Raphael Dumusc <raphael.dumusc@epfl.ch>       */
+/* All rights reserved.                                              */
+/*                                                                   */
+/* Redistribution and use in source and binary forms, with or        */
+/* without modification, are permitted provided that the following   */
+/* conditions are met:                                               */
+/*                                                                   */
+/*   1. Redistributions of source code must retain the above         */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer.                                                  */
+/*                                                                   */
+/*   2. Redistributions in binary form must reproduce the above      */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer in the documentation and/or other materials       */
+/*      provided with the distribution.                              */
+/*                                                                   */
+/*    THIS  SOFTWARE IS PROVIDED  BY THE  UNIVERSITY OF  TEXAS AT    */
+/*    AUSTIN  ``AS IS''  AND ANY  EXPRESS OR  IMPLIED WARRANTIES,    */
+/*    INCLUDING, BUT  NOT LIMITED  TO, THE IMPLIED  WARRANTIES OF    */
+/*    MERCHANTABILITY  AND FITNESS FOR  A PARTICULAR  PURPOSE ARE    */
+/*    DISCLAIMED.  IN  NO EVENT SHALL THE UNIVERSITY  OF TEXAS AT    */
+/*    AUSTIN OR CONTRIBUTORS BE  LIABLE FOR ANY DIRECT, INDIRECT,    */
+/*    INCIDENTAL,  SPECIAL, EXEMPLARY,  OR  CONSEQUENTIAL DAMAGES    */
+/*    (INCLUDING, BUT  NOT LIMITED TO,  PROCUREMENT OF SUBSTITUTE    */
+/*    GOODS  OR  SERVICES; LOSS  OF  USE,  DATA,  OR PROFITS;  OR    */
+/*    BUSINESS INTERRUPTION) HOWEVER CAUSED  AND ON ANY THEORY OF    */
+/*    LIABILITY, WHETHER  IN CONTRACT, STRICT  LIABILITY, OR TORT    */
+/*    (INCLUDING NEGLIGENCE OR OTHERWISE)  ARISING IN ANY WAY OUT    */
+/*    OF  THE  USE OF  THIS  SOFTWARE,  EVEN  IF ADVISED  OF  THE    */
+/*    POSSIBILITY OF SUCH DAMAGE.                                    */
+/*                                                                   */
+/* The views and conclusions contained in the software and           */
+/* documentation are those of the authors and should not be          */
+/* interpreted as representing official policies, either expressed   */
+/* or implied, of The University of Texas at Austin.                 */
+/*********************************************************************/
+
+#define BOOST_TEST_MODULE DecodedSegmentCacheTests
+#include <boost/test/unit_test.hpp>
+namespace ut = boost::unit_test;
+
+#include <deflect/DecodedSegmentCache.h>
+
+namespace
+{
+deflect::DecodedSegmentCache::Image makeImage( const int size )
+{
+    deflect::DecodedSegmentCache::Image image;
+    image.data = QByteArray( size, 'x' );
+    image.format = deflect::SEGMENT_FORMAT_RGBA;
+    return image;
+}
+}
+
+BOOST_AUTO_TEST_CASE( TestCacheIsDisabledByDefault )
+{
+    deflect::DecodedSegmentCache cache;
+    BOOST_CHECK_EQUAL( cache.getMaxSize(), 0 );
+
+    const QByteArray jpeg( 10, 'a' );
+    cache.insert( jpeg, 0, makeImage( 40 ));
+    deflect::DecodedSegmentCache::Image image;
+    BOOST_CHECK( !cache.find( jpeg, 0, image ));
+    BOOST_CHECK_EQUAL( cache.getEntryCount(), 0 );
+}
+
+BOOST_AUTO_TEST_CASE( TestCacheHitsAndMisses )
+{
+    deflect::DecodedSegmentCache cache;
+    cache.setMaxSize( 1000 );
+
+    const QByteArray jpeg( 10, 'a' );
+    deflect::DecodedSegmentCache::Image image;
+    BOOST_CHECK( !cache.find( jpeg, 0, image ));
+
+    cache.insert( jpeg, 0, makeImage( 40 ));
+    BOOST_CHECK_EQUAL( cache.getEntryCount(), 1 );
+    BOOST_CHECK_EQUAL( cache.getSize(), 50 );
+
+    // Identical data in a different buffer is found
+    const QByteArray copy( jpeg.constData(), jpeg.size( ));
+    BOOST_REQUIRE( cache.find( copy, 0, image ));
+    BOOST_CHECK_EQUAL( image.data.size(), 40 );
+    BOOST_CHECK_EQUAL( image.format, deflect::SEGMENT_FORMAT_RGBA );
+
+    // Different data or decoding options are not
+    BOOST_CHECK( !cache.find( QByteArray( 10, 'b' ), 0, image ));
+    BOOST_CHECK( !cache.find( jpeg, 1, image ));
+
+    BOOST_CHECK_EQUAL( cache.getHits(), 1 );
+    BOOST_CHECK_EQUAL( cache.getMisses(), 3 );
+}
+
+BOOST_AUTO_TEST_CASE( TestCacheEvictsLeastRecentlyUsed )
+{
+    deflect::DecodedSegmentCache cache;
+    cache.setMaxSize( 300 );
+
+    const QByteArray first( 10, '1' );
+    const QByteArray second( 10, '2' );
+    const QByteArray third( 10, '3' );
+    cache.insert( first, 0, makeImage( 90 ));
+    cache.insert( second, 0, makeImage( 90 ));
+    cache.insert( third, 0, makeImage( 90 ));
+    BOOST_CHECK_EQUAL( cache.getSize(), 300 );
+
+    // Using the first image makes the second one the least recently used
+    deflect::DecodedSegmentCache::Image image;
+    BOOST_REQUIRE( cache.find( first, 0, image ));
+
+    cache.insert( QByteArray( 10, '4' ), 0, makeImage( 90 ));
+    BOOST_CHECK_EQUAL( cache.getEntryCount(), 3 );
+    BOOST_CHECK_EQUAL( cache.getSize(), 300 );
+    BOOST_CHECK( cache.find( first, 0, image ));
+    BOOST_CHECK( !cache.find( second, 0, image ));
+    BOOST_CHECK( cache.find( third, 0, image ));
+
+    // Images larger than the cache are not inserted
+    cache.insert( QByteArray( 10, '5' ), 0, makeImage( 300 ));
+    BOOST_CHECK_EQUAL( cache.getEntryCount(), 3 );
+
+    cache.setMaxSize( 100 );
+    BOOST_CHECK_EQUAL( cache.getEntryCount(), 1 );
+    BOOST_CHECK_EQUAL( cache.getSize(), 100 );
+}
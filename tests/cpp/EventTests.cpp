@@ -0,0 +1,100 @@
+/*********************************************************************/
+/* Copyright (c) 2015, EPFL/Blue Brain Project                       */
+/*                     Raphael Dumusc <raphael.dumusc@epfl.ch>       */
+/* All rights reserved.                                              */
+/*                                                                   */
+/* Redistribution and use in source and binary forms, with or        */
+/* without modification, are permitted provided that the following   */
+/* conditions are met:                                               */
+/*                                                                   */
+/*   1. Redistributions of source code must retain the above         */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer.                                                  */
+/*                                                                   */
+/*   2. Redistributions in binary form must reproduce the above      */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer in the documentation and/or other materials       */
+/*      provided with the distribution.                              */
+/*                                                                   */
+/*    THIS  SOFTWARE IS PROVIDED  BY THE  UNIVERSITY OF  TEXAS AT    */
+/*    AUSTIN  ``AS IS''  AND ANY  EXPRESS OR  IMPLIED WARRANTIES,    */
+/*    INCLUDING, BUT  NOT LIMITED  TO, THE IMPLIED  WARRANTIES OF    */
+/*    MERCHANTABILITY  AND FITNESS FOR  A PARTICULAR  PURPOSE ARE    */
+/*    DISCLAIMED.  IN  NO EVENT SHALL THE UNIVERSITY  OF TEXAS AT    */
+/*    AUSTIN OR CONTRIBUTORS BE  LIABLE FOR ANY DIRECT, INDIRECT,    */
+/*    INCIDENTAL,  SPECIAL, EXEMPLARY,  OR  CONSEQUENTIAL DAMAGES    */
+/*    (INCLUDING, BUT  NOT LIMITED TO,  PROCUREMENT OF SUBSTITUTE    */
+/*    GOODS  OR  SERVICES; LOSS  OF  USE,  DATA,  OR PROFITS;  OR    */
+/*    BUSINESS INTERRUPTION) HOWEVER CAUSED  AND ON ANY THEORY OF    */
+/*    LIABILITY, WHETHER  IN CONTRACT, STRICT  LIABILITY, OR TORT    */
+/*    (INCLUDING NEGLIGENCE OR OTHERWISE)  ARISING IN ANY WAY OUT    */
+/*    OF  THE  USE OF  THIS  SOFTWARE,  EVEN  IF ADVISED  OF  THE    */
+/*    POSSIBILITY OF SUCH DAMAGE.                                    */
+/*                                                                   */
+/* The views and conclusions contained in the software and           */
+/* documentation are those of the authors and should not be          */
+/* interpreted as representing official policies, either expressed   */
+/* or implied, of The University of Texas at Austin.                 */
+/*********************************************************************/
+
+#define BOOST_TEST_MODULE EventTests
+#include <boost/test/unit_test.hpp>
+namespace ut = boost::unit_test;
+
+#include <deflect/Event.h>
+
+namespace
+{
+deflect::Event makeEvent( const deflect::Event::EventType type,
+                          const double x, const double dx )
+{
+    deflect::Event event;
+    event.type = type;
+    event.mouseX = x;
+    event.dx = dx;
+    return event;
+}
+}
+
+BOOST_AUTO_TEST_CASE( testMovesAndWheelsAreCoalesced )
+{
+    deflect::Event move = makeEvent( deflect::Event::EVT_MOVE, 0.1, 0.1 );
+    BOOST_CHECK( deflect::coalesceEvents( move, makeEvent(
+                                              deflect::Event::EVT_MOVE,
+                                              0.3, 0.2 )));
+    BOOST_CHECK_CLOSE( move.mouseX, 0.3, 1e-6 );
+    BOOST_CHECK_CLOSE( move.dx, 0.3, 1e-6 );
+
+    deflect::Event wheel = makeEvent( deflect::Event::EVT_WHEEL, 0.5, 0 );
+    wheel.dy = 120;
+    deflect::Event nextWheel = makeEvent( deflect::Event::EVT_WHEEL, 0.6, 0 );
+    nextWheel.dy = 240;
+    BOOST_CHECK( deflect::coalesceEvents( wheel, nextWheel ));
+    BOOST_CHECK_CLOSE( wheel.mouseX, 0.6, 1e-6 );
+    BOOST_CHECK_CLOSE( wheel.dy, 360, 1e-6 );
+}
+
+BOOST_AUTO_TEST_CASE( testOtherEventsAreNotCoalesced )
+{
+    deflect::Event move = makeEvent( deflect::Event::EVT_MOVE, 0.1, 0.1 );
+    deflect::Event drag = makeEvent( deflect::Event::EVT_MOVE, 0.2, 0.1 );
+    drag.mouseLeft = true;
+    BOOST_CHECK( !deflect::coalesceEvents( move, drag ));
+    BOOST_CHECK( !deflect::coalesceEvents( move, makeEvent(
+                                               deflect::Event::EVT_WHEEL,
+                                               0.2, 0.1 )));
+    BOOST_CHECK_CLOSE( move.mouseX, 0.1, 1e-6 );
+
+    deflect::Event press = makeEvent( deflect::Event::EVT_PRESS, 0.1, 0 );
+    BOOST_CHECK( !deflect::coalesceEvents( press, makeEvent(
+                                               deflect::Event::EVT_PRESS,
+                                               0.2, 0 )));
+
+    deflect::Event key;
+    key.type = deflect::Event::EVT_KEY_PRESS;
+    key.key = 'a';
+    deflect::Event nextKey = key;
+    nextKey.key = 'b';
+    BOOST_CHECK( !deflect::coalesceEvents( key, nextKey ));
+    BOOST_CHECK_EQUAL( key.key, 'a' );
+}
@@ -0,0 +1,171 @@
+/*********************************************************************/
+/* Copyright (c) 2015, EPFL/Blue Brain Project                       */
+/*                     Raphael Dumusc <raphael.dumusc@epfl.ch>       */
+/* All rights reserved.                                              */
+/*                                                                   */
+/* Redistribution and use in source and binary forms, with or        */
+/* without modification, are permitted provided that the following   */
+/* conditions are met:                                               */
+/*                                                                   */
+/*   1. Redistributions of source code must retain the above         */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer.                                                  */
+/*                                                                   */
+/*   2. Redistributions in binary form must reproduce the above      */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer in the documentation and/or other materials       */
+/*      provided with the distribution.                              */
+/*                                                                   */
+/*    THIS  SOFTWARE IS PROVIDED  BY THE  UNIVERSITY OF  TEXAS AT    */
+/*    AUSTIN  ``AS IS''  AND ANY  EXPRESS OR  IMPLIED WARRANTIES,    */
+/*    INCLUDING, BUT  NOT LIMITED  TO, THE IMPLIED  WARRANTIES OF    */
+/*    MERCHANTABILITY  AND FITNESS FOR  A PARTICULAR  PURPOSE ARE    */
+/*    DISCLAIMED.  IN  NO EVENT SHALL THE UNIVERSITY  OF TEXAS AT    */
+/*    AUSTIN OR CONTRIBUTORS BE  LIABLE FOR ANY DIRECT, INDIRECT,    */
+/*    INCIDENTAL,  SPECIAL, EXEMPLARY,  OR  CONSEQUENTIAL DAMAGES    */
+/*    (INCLUDING, BUT  NOT LIMITED TO,  PROCUREMENT OF SUBSTITUTE    */
+/*    GOODS  OR  SERVICES; LOSS  OF  USE,  DATA,  OR PROFITS;  OR    */
+/*    BUSINESS INTERRUPTION) HOWEVER CAUSED  AND ON ANY THEORY OF    */
+/*    LIABILITY, WHETHER  IN CONTRACT, STRICT  LIABILITY, OR TORT    */
+/*    (INCLUDING NEGLIGENCE OR OTHERWISE)  ARISING IN ANY WAY OUT    */
+/*    OF  THE  USE OF  THIS  SOFTWARE,  EVEN  IF ADVISED  OF  THE    */
+/*    POSSIBILITY OF SUCH DAMAGE.                                    */
+/*                                                                   */
+/* The views and conclusions contained in the software and           */
+/* documentation are those of the authors and should not be          */
+/* interpreted as representing official policies, either expressed   */
+/* or implied, of The University of Texas at Austin.                 */
+/*********************************************************************/
+
+#define BOOST_TEST_MODULE FrameAssemblerTests
+#include <boost/test/unit_test.hpp>
+namespace ut = boost::unit_test;
+
+#include <deflect/Frame.h>
+#include <deflect/FrameAssembler.h>
+#include <deflect/ImageSegmenter.h>
+#include <deflect/ImageWrapper.h>
+#include <deflect/Segment.h>
+
+#include <QMutex>
+
+#include <algorithm>
+#include <cstdlib>
+
+namespace
+{
+const unsigned int width = 32;
+const unsigned int height = 24;
+
+std::vector<char> makeTestImage()
+{
+    std::vector<char> data;
+    data.reserve( width * height * 4 );
+    for( unsigned int y = 0; y < height; ++y )
+    {
+        for( unsigned int x = 0; x < width; ++x )
+        {
+            data.push_back( x * 8 ); // R
+            data.push_back( y * 8 ); // G
+            data.push_back( 0 );     // B
+            data.push_back( -1 );    // A
+        }
+    }
+    return data;
+}
+
+deflect::Frame makeFrame( const std::vector<char>& data,
+                          const deflect::CompressionPolicy compression )
+{
+    deflect::ImageWrapper image( data.data(), width, height, deflect::RGBA );
+    image.compressionPolicy = compression;
+    image.compressionQuality = 100;
+
+    deflect::ImageSegmenter segmenter;
+    segmenter.setNominalSegmentDimensions( 8, 8 );
+
+    deflect::Frame frame;
+    QMutex mutex;
+    segmenter.generate( image, [&]( const deflect::Segment& segment )
+    {
+        QMutexLocker locker( &mutex );
+        frame.segments.push_back( segment );
+        return true;
+    });
+    return frame;
+}
+}
+
+BOOST_AUTO_TEST_CASE( testAssembleRawSegments )
+{
+    const std::vector<char> data = makeTestImage();
+    const deflect::Frame frame = makeFrame( data, deflect::COMPRESSION_OFF );
+    BOOST_REQUIRE_EQUAL( frame.segments.size(), 4 * 3 );
+
+    deflect::FrameAssembler assembler;
+    BOOST_REQUIRE( assembler.assemble( frame ));
+    BOOST_CHECK( assembler.getSize() == QSize( width, height ));
+
+    const QByteArray& image = assembler.getImage();
+    BOOST_REQUIRE_EQUAL( image.size(), data.size( ));
+    BOOST_CHECK_EQUAL_COLLECTIONS( data.data(), data.data() + data.size(),
+                                   image.constData(),
+                                   image.constData() + image.size( ));
+}
+
+BOOST_AUTO_TEST_CASE( testAssembleCompressedSegmentsReusesImage )
+{
+    const std::vector<char> data = makeTestImage();
+    const deflect::Frame frame = makeFrame( data, deflect::COMPRESSION_ON );
+    BOOST_REQUIRE( frame.segments.front().parameters.compressed );
+
+    deflect::FrameAssembler assembler;
+    BOOST_REQUIRE( assembler.assemble( frame ));
+    const char* imageData = assembler.getImage().constData();
+
+    // Jpeg compression is lossy even at maximum quality
+    const QByteArray& image = assembler.getImage();
+    BOOST_REQUIRE_EQUAL( image.size(), data.size( ));
+    for( size_t i = 0; i < data.size(); ++i )
+        BOOST_REQUIRE_LE( std::abs( (unsigned char)image[i] -
+                                    (unsigned char)data[i] ), 8 );
+
+    BOOST_REQUIRE( assembler.assemble( frame ));
+    BOOST_CHECK_EQUAL( assembler.getImage().constData(), imageData );
+}
+
+BOOST_AUTO_TEST_CASE( testAssembleClearsUncoveredRegionsOfNewImage )
+{
+    const std::vector<char> data = makeTestImage();
+    deflect::Frame frame = makeFrame( data, deflect::COMPRESSION_OFF );
+
+    // Remove the top-left segment, the bottom-right one gives the dimensions
+    const auto topLeft = std::find_if( frame.segments.begin(),
+                                       frame.segments.end(),
+                                       []( const deflect::Segment& segment )
+    {
+        return segment.parameters.x == 0 && segment.parameters.y == 0;
+    });
+    BOOST_REQUIRE( topLeft != frame.segments.end( ));
+    frame.segments.erase( topLeft );
+
+    deflect::FrameAssembler assembler;
+    BOOST_REQUIRE( assembler.assemble( frame ));
+    BOOST_REQUIRE( assembler.getSize() == QSize( width, height ));
+
+    const QByteArray& image = assembler.getImage();
+    for( unsigned int y = 0; y < 8; ++y )
+        for( unsigned int x = 0; x < 8 * 4; ++x )
+            BOOST_REQUIRE_EQUAL( image[y * width * 4 + x], 0 );
+}
+
+BOOST_AUTO_TEST_CASE( testAssembleInvalidSegment )
+{
+    const std::vector<char> data = makeTestImage();
+    deflect::Frame frame = makeFrame( data, deflect::COMPRESSION_ON );
+    frame.segments[1].imageData = QByteArray( "not a jpeg" );
+
+    deflect::FrameAssembler assembler;
+    BOOST_CHECK( !assembler.assemble( frame ));
+    BOOST_CHECK( assembler.getSize() == QSize( width, height ));
+}
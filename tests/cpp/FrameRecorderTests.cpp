@@ -0,0 +1,269 @@
+/*********************************************************************/
+/* Copyright (c) 2015, EPFL/Blue Brain Project                       */
+/*                     Raphael Dumusc <raphael.dumusc@epfl.ch>       */
+/* All rights reserved.                                              */
+/*                                                                   */
+/* Redistribution and use in source and binary forms, with or        */
+/* without modification, are permitted provided that the following   */
+/* conditions are met:                                               */
+/*                                                                   */
+/*   1. Redistributions of source code must retain the above         */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer.                                                  */
+/*                                                                   */
+/*   2. Redistributions in binary form must reproduce the above      */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer in the documentation and/or other materials       */
+/*      provided with the distribution.                              */
+/*                                                                   */
+/*    THIS  SOFTWARE IS PROVIDED  BY THE  UNIVERSITY OF  TEXAS AT    */
+/*    AUSTIN  ``AS IS''  AND ANY  EXPRESS OR  IMPLIED WARRANTIES,    */
+/*    INCLUDING, BUT  NOT LIMITED  TO, THE IMPLIED  WARRANTIES OF    */
+/*    MERCHANTABILITY  AND FITNESS FOR  A PARTICULAR  PURPOSE ARE    */
+/*    DISCLAIMED.  IN  NO EVENT SHALL THE UNIVERSITY  OF TEXAS AT    */
+/*    AUSTIN OR CONTRIBUTORS BE  LIABLE FOR ANY DIRECT, INDIRECT,    */
+/*    INCIDENTAL,  SPECIAL, EXEMPLARY,  OR  CONSEQUENTIAL DAMAGES    */
+/*    (INCLUDING, BUT  NOT LIMITED TO,  PROCUREMENT OF SUBSTITUTE    */
+/*    GOODS  OR  SERVICES; LOSS  OF  USE,  DATA,  OR PROFITS;  OR    */
+/*    BUSINESS INTERRUPTION) HOWEVER CAUSED  AND ON ANY THEORY OF    */
+/*    LIABILITY, WHETHER  IN CONTRACT, STRICT  LIABILITY, OR TORT    */
+/*    (INCLUDING NEGLIGENCE OR OTHERWISE)  ARISING IN ANY WAY OUT    */
+/*    OF  THE  USE OF  THIS  SOFTWARE,  EVEN  IF ADVISED  OF  THE    */
+/*    POSSIBILITY OF SUCH DAMAGE.                                    */
+/*                                                                   */
+/* The views and conclusions contained in the software and           */
+/* documentation are those of the authors and should not be          */
+/* interpreted as representing official policies, either expressed   */
+/* or implied, of The University of Texas at Austin.                 */
+/*********************************************************************/
+
+#define BOOST_TEST_MODULE FrameRecorderTests
+#include <boost/test/unit_test.hpp>
+namespace ut = boost::unit_test;
+
+#include <deflect/Frame.h>
+#include <deflect/FrameDispatcher.h>
+#include <deflect/FrameRecorder.h>
+#include <deflect/FrameRecordReader.h>
+
+#include <QFile>
+
+#include <set>
+
+namespace
+{
+const QString filename( "frameRecorderTests.dflr" );
+const QString uri( "teststream" );
+
+deflect::Segment createSegment( const unsigned int x, const char value )
+{
+    deflect::Segment segment;
+    segment.parameters.x = x;
+    segment.parameters.width = 8;
+    segment.parameters.height = 8;
+    segment.parameters.compressed = false;
+    segment.imageData = QByteArray( 8 * 8 * 4, value );
+    return segment;
+}
+
+/** Record two frames of a stream with two sources through a dispatcher. */
+void recordFrames()
+{
+    deflect::FrameDispatcher dispatcher;
+    BOOST_REQUIRE( dispatcher.startRecording( filename ));
+
+    dispatcher.addSource( uri, 0 );
+    dispatcher.addSource( uri, 1 );
+    for( char frame = 0; frame < 2; ++frame )
+    {
+        dispatcher.processSegment( uri, 0, createSegment( 0, 'a' + frame ));
+        dispatcher.processSegment( uri, 1, createSegment( 8, 'A' + frame ));
+        dispatcher.processFrameFinished( uri, 0 );
+        dispatcher.processFrameFinished( uri, 1 );
+    }
+    dispatcher.stopRecording();
+
+    // Not recorded
+    dispatcher.processSegment( uri, 0, createSegment( 0, 'z' ));
+}
+}
+
+BOOST_AUTO_TEST_CASE( testRecordedRecordsAreReadBack )
+{
+    recordFrames();
+
+    deflect::FrameRecordReader reader;
+    BOOST_REQUIRE( reader.open( filename ));
+
+    const deflect::FrameRecorder::RecordType expectedTypes[] = {
+        deflect::FrameRecorder::RECORD_ADD_SOURCE,
+        deflect::FrameRecorder::RECORD_ADD_SOURCE,
+        deflect::FrameRecorder::RECORD_SEGMENT,
+        deflect::FrameRecorder::RECORD_SEGMENT,
+        deflect::FrameRecorder::RECORD_FRAME_FINISHED,
+        deflect::FrameRecorder::RECORD_FRAME_FINISHED
+    };
+
+    deflect::FrameRecordReader::Record record;
+    quint64 previousTimestamp = 0;
+    for( const deflect::FrameRecorder::RecordType type : expectedTypes )
+    {
+        BOOST_REQUIRE( reader.readRecord( record ));
+        BOOST_CHECK_EQUAL( record.type, type );
+        BOOST_CHECK( record.uri == uri );
+        BOOST_CHECK_GE( record.timestamp, previousTimestamp );
+        previousTimestamp = record.timestamp;
+    }
+
+    reader.rewind();
+    for( size_t i = 0; i < 3; ++i )
+        BOOST_REQUIRE( reader.readRecord( record ));
+    BOOST_CHECK_EQUAL( record.sourceIndex, 0u );
+    BOOST_CHECK_EQUAL( record.segment.parameters.width, 8u );
+    BOOST_CHECK( !record.segment.parameters.compressed );
+    BOOST_CHECK( record.segment.imageData == createSegment( 0, 'a' ).imageData );
+
+    QFile::remove( filename );
+}
+
+BOOST_AUTO_TEST_CASE( testRecordedFramesAreReplayed )
+{
+    recordFrames();
+
+    deflect::FrameRecordReader reader;
+    BOOST_REQUIRE( reader.open( filename ));
+
+    std::vector< deflect::FramePtr > frames;
+    BOOST_CHECK_EQUAL( reader.replay( [&]( deflect::FramePtr frame )
+                                      { frames.push_back( frame ); },
+                                      false ), 2u );
+    BOOST_REQUIRE_EQUAL( frames.size(), 2u );
+    for( char i = 0; i < 2; ++i )
+    {
+        const deflect::Frame& frame = *frames[i];
+        BOOST_CHECK( frame.uri == uri );
+        BOOST_REQUIRE_EQUAL( frame.segments.size(), 2u );
+        BOOST_CHECK( frame.computeDimensions() == QSize( 16, 8 ));
+        BOOST_CHECK_EQUAL( frame.segments[0].imageData[0], 'a' + i );
+        BOOST_CHECK_EQUAL( frame.segments[1].imageData[0], 'A' + i );
+    }
+
+    quint64 timestamp;
+    BOOST_CHECK( !reader.readFrame( timestamp ));
+    reader.rewind();
+    BOOST_CHECK( reader.readFrame( timestamp ));
+
+    frames.clear();
+    reader.close();
+    QFile::remove( filename );
+}
+
+BOOST_AUTO_TEST_CASE( testRecordingStartedMidStreamIsReplayed )
+{
+    {
+        deflect::FrameDispatcher dispatcher;
+        dispatcher.addSource( uri, 0 );
+        dispatcher.addSource( uri, 1 );
+        dispatcher.processSegment( uri, 0, createSegment( 0, 'a' ));
+        dispatcher.processSegment( uri, 1, createSegment( 8, 'A' ));
+        dispatcher.processFrameFinished( uri, 0 );
+        dispatcher.processFrameFinished( uri, 1 );
+        dispatcher.processSegment( uri, 0, createSegment( 0, 'b' ));
+
+        BOOST_REQUIRE( dispatcher.startRecording( filename ));
+        dispatcher.processSegment( uri, 1, createSegment( 8, 'B' ));
+        dispatcher.processFrameFinished( uri, 0 );
+        dispatcher.processFrameFinished( uri, 1 );
+        dispatcher.processSegment( uri, 0, createSegment( 0, 'c' ));
+        dispatcher.processSegment( uri, 1, createSegment( 8, 'C' ));
+        dispatcher.processFrameFinished( uri, 0 );
+        dispatcher.processFrameFinished( uri, 1 );
+        dispatcher.stopRecording();
+    }
+
+    deflect::FrameRecordReader reader;
+    BOOST_REQUIRE( reader.open( filename ));
+
+    // The sources already streaming are recorded first
+    deflect::FrameRecordReader::Record record;
+    std::set< size_t > sources;
+    for( size_t i = 0; i < 2; ++i )
+    {
+        BOOST_REQUIRE( reader.readRecord( record ));
+        BOOST_CHECK_EQUAL( record.type,
+                           deflect::FrameRecorder::RECORD_ADD_SOURCE );
+        sources.insert( record.sourceIndex );
+    }
+    BOOST_CHECK_EQUAL( sources.size(), 2u );
+    reader.rewind();
+
+    // The segment received before the recording started is missing
+    std::vector< deflect::FramePtr > frames;
+    BOOST_CHECK_EQUAL( reader.replay( [&]( deflect::FramePtr frame )
+                                      { frames.push_back( frame ); },
+                                      false ), 2u );
+    BOOST_REQUIRE_EQUAL( frames.size(), 2u );
+    BOOST_REQUIRE_EQUAL( frames[0]->segments.size(), 1u );
+    BOOST_CHECK_EQUAL( frames[0]->segments[0].imageData[0], 'B' );
+    BOOST_REQUIRE_EQUAL( frames[1]->segments.size(), 2u );
+    BOOST_CHECK_EQUAL( frames[1]->segments[0].imageData[0], 'c' );
+    BOOST_CHECK_EQUAL( frames[1]->segments[1].imageData[0], 'C' );
+
+    frames.clear();
+    reader.close();
+    QFile::remove( filename );
+}
+
+BOOST_AUTO_TEST_CASE( testRecordsOfUnknownSourcesAreSkipped )
+{
+    {
+        deflect::FrameRecorder recorder;
+        BOOST_REQUIRE( recorder.open( filename ));
+        recorder.addSource( uri, 0 );
+        recorder.addSegment( uri, 1, createSegment( 8, 'X' ));
+        recorder.finishFrame( uri, 1 );
+        recorder.removeSource( uri, 1 );
+        recorder.addSegment( uri, 0, createSegment( 0, 'a' ));
+        recorder.finishFrame( uri, 0 );
+    }
+
+    deflect::FrameRecordReader reader;
+    BOOST_REQUIRE( reader.open( filename ));
+
+    quint64 timestamp;
+    const deflect::FramePtr frame = reader.readFrame( timestamp );
+    BOOST_REQUIRE( frame );
+    BOOST_REQUIRE_EQUAL( frame->segments.size(), 1u );
+    BOOST_CHECK_EQUAL( frame->segments[0].imageData[0], 'a' );
+    BOOST_CHECK( !reader.readFrame( timestamp ));
+
+    reader.close();
+    QFile::remove( filename );
+}
+
+BOOST_AUTO_TEST_CASE( testTruncatedRecordingIsReadUpToTheLastRecord )
+{
+    recordFrames();
+    {
+        QFile file( filename );
+        BOOST_REQUIRE( file.open( QIODevice::ReadWrite ));
+        BOOST_REQUIRE( file.resize( file.size() - 10 ));
+    }
+
+    deflect::FrameRecordReader reader;
+    BOOST_REQUIRE( reader.open( filename ));
+
+    quint64 timestamp;
+    BOOST_CHECK( reader.readFrame( timestamp ));
+    BOOST_CHECK( !reader.readFrame( timestamp ));
+    reader.close();
+
+    QFile invalid( filename );
+    BOOST_REQUIRE( invalid.open( QIODevice::WriteOnly | QIODevice::Truncate ));
+    invalid.write( "not a recording" );
+    invalid.close();
+    BOOST_CHECK( !reader.open( filename ));
+    BOOST_CHECK( !reader.isOpen( ));
+
+    QFile::remove( filename );
+}
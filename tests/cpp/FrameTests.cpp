@@ -0,0 +1,118 @@
+/*********************************************************************/
+/* Copyright (c) 2015, EPFL/Blue Brain Project                       */
+/*                     Raphael Dumusc <raphael.dumusc@epfl.ch>       */
+/* All rights reserved.                                              */
+/*                                                                   */
+/* Redistribution and use in source and binary forms, with or        */
+/* without modification, are permitted provided that the following   */
+/* conditions are met:                                               */
+/*                                                                   */
+/*   1. Redistributions of source code must retain the above         */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer.                                                  */
+/*                                                                   */
+/*   2. Redistributions in binary form must reproduce the above      */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer in the documentation and/or other materials       */
+/*      provided with the distribution.                              */
+/*                                                                   */
+/*    THIS  SOFTWARE IS PROVIDED  BY THE  UNIVERSITY OF  TEXAS AT    */
+/*    AUSTIN  ``AS IS''  AND ANY  EXPRESS OR  IMPLIED WARRANTIES,    */
+/*    INCLUDING, BUT  NOT LIMITED  TO, THE IMPLIED  WARRANTIES OF    */
+/*    MERCHANTABILITY  AND FITNESS FOR  A PARTICULAR  PURPOSE ARE    */
+/*    DISCLAIMED.  IN  NO EVENT SHALL THE UNIVERSITY  OF TEXAS AT    */
+/*    AUSTIN OR CONTRIBUTORS BE  LIABLE FOR ANY DIRECT, INDIRECT,    */
+/*    INCIDENTAL,  SPECIAL, EXEMPLARY,  OR  CONSEQUENTIAL DAMAGES    */
+/*    (INCLUDING, BUT  NOT LIMITED TO,  PROCUREMENT OF SUBSTITUTE    */
+/*    GOODS  OR  SERVICES; LOSS  OF  USE,  DATA,  OR PROFITS;  OR    */
+/*    BUSINESS INTERRUPTION) HOWEVER CAUSED  AND ON ANY THEORY OF    */
+/*    LIABILITY, WHETHER  IN CONTRACT, STRICT  LIABILITY, OR TORT    */
+/*    (INCLUDING NEGLIGENCE OR OTHERWISE)  ARISING IN ANY WAY OUT    */
+/*    OF  THE  USE OF  THIS  SOFTWARE,  EVEN  IF ADVISED  OF  THE    */
+/*    POSSIBILITY OF SUCH DAMAGE.                                    */
+/*                                                                   */
+/* The views and conclusions contained in the software and           */
+/* documentation are those of the authors and should not be          */
+/* interpreted as representing official policies, either expressed   */
+/* or implied, of The University of Texas at Austin.                 */
+/*********************************************************************/
+
+#define BOOST_TEST_MODULE FrameTests
+#include <boost/test/unit_test.hpp>
+namespace ut = boost::unit_test;
+
+#include <deflect/Frame.h>
+
+namespace
+{
+deflect::Frame createFrame()
+{
+    deflect::Frame frame;
+    frame.uri = "MyUri";
+    for( unsigned int i = 0; i < 3; ++i )
+    {
+        deflect::Segment segment;
+        segment.parameters.x = i * 64;
+        segment.parameters.y = 32;
+        segment.parameters.width = 64;
+        segment.parameters.height = 16;
+        segment.parameters.compressed = i != 1;
+        segment.format = i == 2 ? deflect::SEGMENT_FORMAT_YUV420
+                                : deflect::SEGMENT_FORMAT_RGBA;
+        segment.imageData = QByteArray( 100 + i * 13, char( 'a' + i ));
+        frame.segments.push_back( segment );
+    }
+    return frame;
+}
+}
+
+BOOST_AUTO_TEST_CASE( testFlatSerialization )
+{
+    const deflect::Frame frame = createFrame();
+
+    QByteArray buffer;
+    frame.serializeFlat( buffer );
+
+    deflect::Frame deserialized;
+    BOOST_REQUIRE( deserialized.deserializeFlat( buffer ));
+
+    BOOST_CHECK( deserialized.uri == frame.uri );
+    BOOST_REQUIRE_EQUAL( deserialized.segments.size(), frame.segments.size( ));
+    for( size_t i = 0; i < frame.segments.size(); ++i )
+    {
+        const deflect::Segment& expected = frame.segments[i];
+        const deflect::Segment& segment = deserialized.segments[i];
+        BOOST_CHECK_EQUAL( segment.parameters.x, expected.parameters.x );
+        BOOST_CHECK_EQUAL( segment.parameters.y, expected.parameters.y );
+        BOOST_CHECK_EQUAL( segment.parameters.width,
+                           expected.parameters.width );
+        BOOST_CHECK_EQUAL( segment.parameters.height,
+                           expected.parameters.height );
+        BOOST_CHECK_EQUAL( segment.parameters.compressed,
+                           expected.parameters.compressed );
+        BOOST_CHECK_EQUAL( segment.format, expected.format );
+        BOOST_CHECK( segment.imageData == expected.imageData );
+    }
+    BOOST_CHECK( deserialized.computeDimensions() == QSize( 192, 48 ));
+}
+
+BOOST_AUTO_TEST_CASE( testFlatSerializationRejectsInvalidBuffers )
+{
+    QByteArray buffer;
+    createFrame().serializeFlat( buffer );
+
+    deflect::Frame frame;
+    BOOST_CHECK( !frame.deserializeFlat( QByteArray( )));
+    BOOST_CHECK( !frame.deserializeFlat( buffer.left( 20 )));
+    BOOST_CHECK( !frame.deserializeFlat( buffer.left( buffer.size() - 8 )));
+    BOOST_CHECK( frame.segments.empty( ));
+
+    QByteArray wrongVersion = buffer;
+    wrongVersion.data()[4] = 42;
+    BOOST_CHECK( !frame.deserializeFlat( wrongVersion ));
+
+    QByteArray wrongMagic = buffer;
+    wrongMagic.data()[0] = 'X';
+    BOOST_CHECK( !frame.deserializeFlat( wrongMagic ));
+    BOOST_CHECK( frame.segments.empty( ));
+}
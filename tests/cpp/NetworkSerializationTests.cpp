@@ -66,6 +66,39 @@ BOOST_AUTO_TEST_CASE( testMessageHeaderSerialization )
                        std::string( header.uri ));
 }
 
+BOOST_AUTO_TEST_CASE( testCompactMessageHeaderSerialization )
+{
+    const deflect::CompactMessageHeader header(
+                deflect::MESSAGE_TYPE_PIXELSTREAM, 0x01020304, 42 );
+
+    char data[deflect::CompactMessageHeader::serializedSize];
+    header.serialize( data );
+
+    // Little-endian layout: magic, type, reserved, stream id, size
+    const unsigned char expected[] = { 0xDF, 5, 0, 0, 42, 0, 0, 0,
+                                       4, 3, 2, 1 };
+    BOOST_CHECK_EQUAL_COLLECTIONS( (const unsigned char*)data,
+                                   (const unsigned char*)data + sizeof( data ),
+                                   expected, expected + sizeof( expected ));
+
+    deflect::CompactMessageHeader deserialized;
+    BOOST_REQUIRE( deserialized.deserialize( data ));
+    BOOST_CHECK_EQUAL( deserialized.type, header.type );
+    BOOST_CHECK_EQUAL( deserialized.streamId, 42 );
+    BOOST_CHECK_EQUAL( deserialized.size, 0x01020304 );
+    BOOST_CHECK( deserialized.toMessageHeader().type ==
+                 deflect::MESSAGE_TYPE_PIXELSTREAM );
+
+    // Regular headers start with a big-endian type, which never looks compact
+    QByteArray storage;
+    QDataStream stream( &storage, QIODevice::Append );
+    stream << deflect::MessageHeader( deflect::MESSAGE_TYPE_PIXELSTREAM, 512,
+                                      std::string( "MyUri" ));
+    BOOST_CHECK( !deflect::CompactMessageHeader::isCompact( storage[0] ));
+    BOOST_CHECK( deflect::CompactMessageHeader::isCompact( data[0] ));
+    BOOST_CHECK( !deserialized.deserialize( storage.constData( )));
+}
+
 BOOST_AUTO_TEST_CASE( testEventSerialization )
 {
     QByteArray storage;
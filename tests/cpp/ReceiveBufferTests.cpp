@@ -45,6 +45,8 @@ namespace ut = boost::unit_test;
 #include <deflect/ReceiveBuffer.h>
 #include <deflect/Segment.h>
 
+#include <chrono>
+
 BOOST_AUTO_TEST_CASE( TestAddAndRemoveSources )
 {
     deflect::ReceiveBuffer buffer;
@@ -247,3 +249,388 @@ BOOST_AUTO_TEST_CASE( TestRemoveSourceWhileStreaming )
     BOOST_CHECK_EQUAL( frameSize.width(), 192 );
     BOOST_CHECK_EQUAL( frameSize.height(), 256 );
 }
+
+deflect::Segment makeSegment( const int dataSize )
+{
+    deflect::Segment segment;
+    segment.parameters.width = 64;
+    segment.parameters.height = 64;
+    segment.imageData = QByteArray( dataSize, 'x' );
+    return segment;
+}
+
+BOOST_AUTO_TEST_CASE( TestBufferedBytesAreCounted )
+{
+    const size_t sourceIndex1 = 46;
+    const size_t sourceIndex2 = 819;
+
+    deflect::ReceiveBuffer buffer;
+    buffer.addSource( sourceIndex1 );
+    buffer.addSource( sourceIndex2 );
+
+    buffer.insert( makeSegment( 100 ), sourceIndex1 );
+    buffer.insert( makeSegment( 200 ), sourceIndex2 );
+    buffer.finishFrameForSource( sourceIndex1 );
+    buffer.finishFrameForSource( sourceIndex2 );
+    buffer.insert( makeSegment( 50 ), sourceIndex1 );
+
+    BOOST_CHECK_EQUAL( buffer.getBufferedFrameCount(), 1 );
+    BOOST_CHECK_EQUAL( buffer.getBufferedBytes(), 350 );
+
+    buffer.popFrame();
+    BOOST_CHECK_EQUAL( buffer.getBufferedFrameCount(), 0 );
+    BOOST_CHECK_EQUAL( buffer.getBufferedBytes(), 50 );
+
+    buffer.removeSource( sourceIndex1 );
+    BOOST_CHECK_EQUAL( buffer.getBufferedBytes(), 0 );
+    BOOST_CHECK_EQUAL( buffer.getPeakBufferedBytes(), 350 );
+    BOOST_CHECK_EQUAL( buffer.getDroppedFrameCount(), 0 );
+}
+
+BOOST_AUTO_TEST_CASE( TestMaxBufferedFramesDropsOldestFrames )
+{
+    const size_t sourceIndex = 46;
+
+    deflect::ReceiveBuffer buffer;
+    buffer.addSource( sourceIndex );
+    buffer.setDeliveryMode( deflect::DELIVERY_EVERY_FRAME );
+    buffer.setMaxBufferedFrames( 2 );
+
+    for( int i = 1; i <= 5; ++i )
+    {
+        buffer.insert( makeSegment( i ), sourceIndex );
+        buffer.finishFrameForSource( sourceIndex );
+    }
+
+    BOOST_CHECK_EQUAL( buffer.getBufferedFrameCount(), 2 );
+    BOOST_CHECK_EQUAL( buffer.getDroppedFrameCount(), 3 );
+    BOOST_CHECK_EQUAL( buffer.getBufferedBytes(), 4 + 5 );
+
+    deflect::Segments segments = buffer.popFrame();
+    BOOST_REQUIRE_EQUAL( segments.size(), 1 );
+    BOOST_CHECK_EQUAL( segments[0].imageData.size(), 4 );
+    segments = buffer.popFrame();
+    BOOST_REQUIRE_EQUAL( segments.size(), 1 );
+    BOOST_CHECK_EQUAL( segments[0].imageData.size(), 5 );
+    BOOST_CHECK( !buffer.hasCompleteFrame( ));
+}
+
+BOOST_AUTO_TEST_CASE( TestMaxBufferedBytesDropsSupersededFramesFirst )
+{
+    const size_t sourceIndex1 = 46;
+    const size_t sourceIndex2 = 819;
+
+    deflect::ReceiveBuffer buffer;
+    buffer.addSource( sourceIndex1 );
+    buffer.addSource( sourceIndex2 );
+    buffer.setDeliveryMode( deflect::DELIVERY_EVERY_FRAME );
+    buffer.setMaxBufferedBytes( 1000 );
+
+    // Three complete frames of 400 bytes, the first two are dropped
+    for( int i = 0; i < 3; ++i )
+    {
+        buffer.insert( makeSegment( 200 ), sourceIndex1 );
+        buffer.insert( makeSegment( 200 ), sourceIndex2 );
+        buffer.finishFrameForSource( sourceIndex1 );
+        buffer.finishFrameForSource( sourceIndex2 );
+    }
+    BOOST_CHECK_EQUAL( buffer.getBufferedFrameCount(), 2 );
+    BOOST_CHECK_EQUAL( buffer.getDroppedFrameCount(), 1 );
+    BOOST_CHECK_EQUAL( buffer.getBufferedBytes(), 800 );
+
+    // Incomplete frame pushes the total over the limit
+    buffer.insert( makeSegment( 500 ), sourceIndex1 );
+    buffer.finishFrameForSource( sourceIndex1 );
+    BOOST_CHECK_EQUAL( buffer.getBufferedFrameCount(), 1 );
+    BOOST_CHECK_EQUAL( buffer.getDroppedFrameCount(), 2 );
+    BOOST_CHECK_EQUAL( buffer.getBufferedBytes(), 900 );
+    BOOST_CHECK_EQUAL( buffer.getPeakBufferedBytes(), 1300 );
+
+    // The limit is strict, the last complete frame is dropped too
+    buffer.insert( makeSegment( 500 ), sourceIndex1 );
+    BOOST_CHECK_EQUAL( buffer.getBufferedFrameCount(), 0 );
+    BOOST_CHECK_EQUAL( buffer.getDroppedFrameCount(), 3 );
+    BOOST_CHECK_EQUAL( buffer.getBufferedBytes(), 1000 );
+}
+
+BOOST_AUTO_TEST_CASE( TestMaxBufferedBytesBoundsSourceRunningAhead )
+{
+    const size_t sourceIndex1 = 46;
+    const size_t sourceIndex2 = 819;
+
+    deflect::ReceiveBuffer buffer;
+    buffer.addSource( sourceIndex1 );
+    buffer.addSource( sourceIndex2 );
+    buffer.setDeliveryMode( deflect::DELIVERY_EVERY_FRAME );
+    buffer.setMaxBufferedBytes( 1000 );
+
+    // Source 2 is stalled, the oldest incomplete frames of source 1 are dropped
+    for( int i = 0; i < 10; ++i )
+    {
+        buffer.insert( makeSegment( 300 ), sourceIndex1 );
+        buffer.finishFrameForSource( sourceIndex1 );
+        BOOST_CHECK_LE( buffer.getBufferedBytes(), 1000 );
+    }
+    BOOST_CHECK_EQUAL( buffer.getBufferedFrameCount(), 0 );
+    BOOST_CHECK_EQUAL( buffer.getDroppedFrameCount(), 7 );
+    BOOST_CHECK_EQUAL( buffer.getBufferedBytes(), 900 );
+
+    // The segments of source 2 for the dropped frames are discarded
+    for( int i = 0; i < 7; ++i )
+    {
+        buffer.insert( makeSegment( 100 ), sourceIndex2 );
+        buffer.finishFrameForSource( sourceIndex2 );
+        BOOST_CHECK( !buffer.hasCompleteFrame( ));
+    }
+    BOOST_CHECK_EQUAL( buffer.getBufferedBytes(), 900 );
+    BOOST_CHECK_EQUAL( buffer.getReleasedFrameCount(), 7 );
+
+    // Both sources are in sync again for the next frame
+    buffer.insert( makeSegment( 100 ), sourceIndex2 );
+    buffer.finishFrameForSource( sourceIndex2 );
+    BOOST_REQUIRE( buffer.hasCompleteFrame( ));
+    const deflect::Segments segments = buffer.popFrame();
+    BOOST_REQUIRE_EQUAL( segments.size(), 2 );
+    BOOST_CHECK_EQUAL( segments[0].imageData.size(), 300 );
+    BOOST_CHECK_EQUAL( segments[1].imageData.size(), 100 );
+    BOOST_CHECK_EQUAL( buffer.getDroppedFrameCount(), 7 );
+    BOOST_CHECK_EQUAL( buffer.getBufferedBytes(), 600 );
+}
+
+BOOST_AUTO_TEST_CASE( TestMaxBufferedBytesDropsFrameBeingReceived )
+{
+    const size_t sourceIndex = 46;
+
+    deflect::ReceiveBuffer buffer;
+    buffer.addSource( sourceIndex );
+    buffer.setMaxBufferedBytes( 1000 );
+
+    // A frame larger than the limit is dropped while it is received
+    for( int i = 0; i < 4; ++i )
+        buffer.insert( makeSegment( 400 ), sourceIndex );
+    BOOST_CHECK_EQUAL( buffer.getBufferedBytes(), 0 );
+    BOOST_CHECK_EQUAL( buffer.getDroppedFrameCount(), 1 );
+    BOOST_CHECK_EQUAL( buffer.getPeakBufferedBytes(), 1200 );
+
+    buffer.finishFrameForSource( sourceIndex );
+    BOOST_CHECK( !buffer.hasCompleteFrame( ));
+
+    buffer.insert( makeSegment( 400 ), sourceIndex );
+    buffer.finishFrameForSource( sourceIndex );
+    BOOST_REQUIRE( buffer.hasCompleteFrame( ));
+    BOOST_CHECK_EQUAL( buffer.popFrame().size(), 1 );
+}
+
+BOOST_AUTO_TEST_CASE( TestLatestOnlyDeliveryDropsSupersededFramesAtIngest )
+{
+    const size_t sourceIndex1 = 46;
+    const size_t sourceIndex2 = 819;
+
+    deflect::ReceiveBuffer buffer;
+    buffer.addSource( sourceIndex1 );
+    buffer.addSource( sourceIndex2 );
+    BOOST_REQUIRE_EQUAL( buffer.getDeliveryMode(),
+                         deflect::DELIVERY_LATEST_ONLY );
+
+    for( int i = 1; i <= 3; ++i )
+    {
+        buffer.insert( makeSegment( i ), sourceIndex1 );
+        buffer.finishFrameForSource( sourceIndex1 );
+    }
+    // Source 2 has not completed any frame yet, nothing can be dropped
+    BOOST_CHECK_EQUAL( buffer.getBufferedFrameCount(), 0 );
+    BOOST_CHECK_EQUAL( buffer.getBufferedBytes(), 1 + 2 + 3 );
+
+    buffer.insert( makeSegment( 10 ), sourceIndex2 );
+    buffer.finishFrameForSource( sourceIndex2 );
+    buffer.insert( makeSegment( 20 ), sourceIndex2 );
+    buffer.finishFrameForSource( sourceIndex2 );
+
+    BOOST_CHECK_EQUAL( buffer.getBufferedFrameCount(), 1 );
+    BOOST_CHECK_EQUAL( buffer.getDroppedFrameCount(), 1 );
+    BOOST_CHECK_EQUAL( buffer.getBufferedBytes(), 2 + 3 + 20 );
+
+    const deflect::Segments segments = buffer.popFrame();
+    BOOST_REQUIRE_EQUAL( segments.size(), 2 );
+    BOOST_CHECK_EQUAL( segments[0].imageData.size(), 2 );
+    BOOST_CHECK_EQUAL( segments[1].imageData.size(), 20 );
+    BOOST_CHECK( !buffer.hasCompleteFrame( ));
+    BOOST_CHECK_EQUAL( buffer.getBufferedBytes(), 3 );
+}
+
+BOOST_AUTO_TEST_CASE( TestEveryFrameDelivery )
+{
+    const size_t sourceIndex = 46;
+
+    deflect::ReceiveBuffer buffer;
+    buffer.addSource( sourceIndex );
+    buffer.setDeliveryMode( deflect::DELIVERY_EVERY_FRAME );
+
+    for( int i = 1; i <= 3; ++i )
+    {
+        buffer.insert( makeSegment( i ), sourceIndex );
+        buffer.finishFrameForSource( sourceIndex );
+    }
+    BOOST_CHECK_EQUAL( buffer.getBufferedFrameCount(), 3 );
+
+    for( int i = 1; i <= 3; ++i )
+    {
+        BOOST_REQUIRE( buffer.hasCompleteFrame( ));
+        const deflect::Segments segments = buffer.popFrame();
+        BOOST_REQUIRE_EQUAL( segments.size(), 1 );
+        BOOST_CHECK_EQUAL( segments[0].imageData.size(), i );
+    }
+    BOOST_CHECK( !buffer.hasCompleteFrame( ));
+    BOOST_CHECK_EQUAL( buffer.getDroppedFrameCount(), 0 );
+
+    // Switching to latest only discards the backlog
+    buffer.insert( makeSegment( 4 ), sourceIndex );
+    buffer.finishFrameForSource( sourceIndex );
+    buffer.insert( makeSegment( 5 ), sourceIndex );
+    buffer.finishFrameForSource( sourceIndex );
+    buffer.setDeliveryMode( deflect::DELIVERY_LATEST_ONLY );
+    BOOST_CHECK_EQUAL( buffer.getBufferedFrameCount(), 1 );
+    BOOST_CHECK_EQUAL( buffer.popFrame()[0].imageData.size(), 5 );
+}
+
+BOOST_AUTO_TEST_CASE( TestPartialUpdatesDoNotWaitForSlowSources )
+{
+    const size_t fastSource = 46;
+    const size_t slowSource = 819;
+
+    deflect::ReceiveBuffer buffer;
+    buffer.addSource( fastSource );
+    buffer.addSource( slowSource );
+    buffer.setDeliveryMode( deflect::DELIVERY_PARTIAL_UPDATES );
+
+    // The first frame waits for all the sources
+    buffer.insert( makeSegment( 1 ), fastSource );
+    buffer.finishFrameForSource( fastSource );
+    BOOST_CHECK( !buffer.hasCompleteFrame( ));
+
+    buffer.insert( makeSegment( 10 ), slowSource );
+    buffer.finishFrameForSource( slowSource );
+    BOOST_REQUIRE( buffer.hasCompleteFrame( ));
+    deflect::Segments segments = buffer.popFrame();
+    BOOST_REQUIRE_EQUAL( segments.size(), 2 );
+    BOOST_CHECK_EQUAL( segments[0].imageData.size(), 1 );
+    BOOST_CHECK_EQUAL( segments[1].imageData.size(), 10 );
+    BOOST_CHECK( !buffer.hasCompleteFrame( ));
+
+    // Then the fast source updates its region alone, reusing the latest
+    // segments of the slow source
+    for( int i = 2; i <= 3; ++i )
+    {
+        buffer.insert( makeSegment( i ), fastSource );
+        buffer.finishFrameForSource( fastSource );
+        BOOST_REQUIRE( buffer.hasCompleteFrame( ));
+        segments = buffer.popFrame();
+        BOOST_REQUIRE_EQUAL( segments.size(), 2 );
+        BOOST_CHECK_EQUAL( segments[0].imageData.size(), i );
+        BOOST_CHECK_EQUAL( segments[1].imageData.size(), 10 );
+    }
+
+    // The segments being received are not part of the latest frame
+    buffer.insert( makeSegment( 20 ), slowSource );
+    BOOST_CHECK( !buffer.hasCompleteFrame( ));
+    BOOST_CHECK_EQUAL( buffer.getBufferedBytes(), 3 + 10 + 20 );
+
+    buffer.finishFrameForSource( slowSource );
+    BOOST_CHECK_EQUAL( buffer.getBufferedBytes(), 3 + 20 );
+    segments = buffer.popFrame();
+    BOOST_REQUIRE_EQUAL( segments.size(), 2 );
+    BOOST_CHECK_EQUAL( segments[0].imageData.size(), 3 );
+    BOOST_CHECK_EQUAL( segments[1].imageData.size(), 20 );
+
+    // Back to complete frames, starting from the next one
+    buffer.setDeliveryMode( deflect::DELIVERY_LATEST_ONLY );
+    BOOST_CHECK_EQUAL( buffer.getBufferedBytes(), 0 );
+    buffer.insert( makeSegment( 4 ), fastSource );
+    buffer.finishFrameForSource( fastSource );
+    BOOST_CHECK( !buffer.hasCompleteFrame( ));
+    buffer.insert( makeSegment( 30 ), slowSource );
+    buffer.finishFrameForSource( slowSource );
+    BOOST_REQUIRE( buffer.hasCompleteFrame( ));
+    BOOST_CHECK_EQUAL( buffer.popFrame().size(), 2 );
+}
+
+BOOST_AUTO_TEST_CASE( TestReleasedFramesAreCountedPerSource )
+{
+    const size_t fastSource = 46;
+    const size_t slowSource = 819;
+
+    deflect::ReceiveBuffer buffer;
+    buffer.addSource( fastSource );
+    buffer.addSource( slowSource );
+    buffer.setDeliveryMode( deflect::DELIVERY_PARTIAL_UPDATES );
+
+    buffer.finishFrameForSource( fastSource );
+    buffer.finishFrameForSource( slowSource );
+    buffer.popFrame();
+    BOOST_CHECK_EQUAL( buffer.getReleasedFrameCount( fastSource ), 1 );
+    BOOST_CHECK_EQUAL( buffer.getReleasedFrameCount( slowSource ), 1 );
+
+    // Frames superseded before the next pop are released along with it
+    for( int i = 0; i < 3; ++i )
+        buffer.finishFrameForSource( fastSource );
+    BOOST_CHECK_EQUAL( buffer.getReleasedFrameCount( fastSource ), 3 );
+    buffer.popFrame();
+    BOOST_CHECK_EQUAL( buffer.getReleasedFrameCount( fastSource ), 4 );
+    BOOST_CHECK_EQUAL( buffer.getReleasedFrameCount( slowSource ), 1 );
+    BOOST_CHECK_EQUAL( buffer.getReleasedFrameCount(), 2 );
+
+    // Complete frames release the frame of every source
+    buffer.setDeliveryMode( deflect::DELIVERY_EVERY_FRAME );
+    buffer.finishFrameForSource( fastSource );
+    buffer.finishFrameForSource( slowSource );
+    buffer.popFrame();
+    BOOST_CHECK_EQUAL( buffer.getReleasedFrameCount( fastSource ), 5 );
+    BOOST_CHECK_EQUAL( buffer.getReleasedFrameCount( slowSource ), 2 );
+    BOOST_CHECK_EQUAL( buffer.getReleasedFrameCount( 1234 ), 0 );
+}
+
+BOOST_AUTO_TEST_CASE( TestCompleteFramesWithThousandsOfSources )
+{
+    const size_t sourceCount = 4096;
+    const size_t frameCount = 20;
+
+    deflect::ReceiveBuffer buffer;
+    buffer.setDeliveryMode( deflect::DELIVERY_EVERY_FRAME );
+    for( size_t i = 0; i < sourceCount; ++i )
+        buffer.addSource( i * 7 );
+
+    const deflect::Segment segment = makeSegment( 16 );
+
+    typedef std::chrono::high_resolution_clock clock;
+    const clock::time_point start = clock::now();
+
+    for( size_t frame = 0; frame < frameCount; ++frame )
+    {
+        for( size_t i = 0; i < sourceCount; ++i )
+        {
+            buffer.insert( segment, i * 7 );
+            buffer.finishFrameForSource( i * 7 );
+
+            // Checked after every source, like the FrameDispatcher does
+            BOOST_REQUIRE_EQUAL( buffer.hasCompleteFrame(),
+                                 i == sourceCount - 1 );
+        }
+        BOOST_REQUIRE_EQUAL( buffer.popFrame().size(), sourceCount );
+    }
+
+    const float elapsedMs = std::chrono::duration< float, std::milli >(
+                                clock::now() - start ).count();
+    BOOST_TEST_MESSAGE( "Completed " << frameCount << " frames of "
+                        << sourceCount << " sources in " << elapsedMs
+                        << " ms" );
+
+    // Removing a lagging source completes the frames of the others
+    buffer.insert( segment, 0 );
+    for( size_t i = 1; i < sourceCount; ++i )
+        buffer.finishFrameForSource( i * 7 );
+    BOOST_CHECK( !buffer.hasCompleteFrame( ));
+    buffer.removeSource( 0 );
+    BOOST_CHECK( buffer.hasCompleteFrame( ));
+    BOOST_CHECK_EQUAL( buffer.popFrame().size(), 0 );
+    BOOST_CHECK_EQUAL( buffer.getBufferedBytes(), 0 );
+}
@@ -41,6 +41,7 @@
 #include <boost/test/unit_test.hpp>
 namespace ut = boost::unit_test;
 
+#include <deflect/Frame.h>
 #include <deflect/ImageJpegCompressor.h>
 #include <deflect/ImageJpegDecompressor.h>
 #include <deflect/ImageSegmenter.h>
@@ -54,6 +55,8 @@ namespace ut = boost::unit_test;
 
 #include <QMutex>
 
+#include <stdexcept>
+
 void fillTestImage( std::vector<char>& data )
 {
     data.reserve( 8 * 8 * 4 );
@@ -140,3 +143,242 @@ BOOST_AUTO_TEST_CASE( testImageSegmentationWithCompressionAndDecompression )
                                    data.data() + segment.imageData.size(),
                                    dataOut, dataOut+segment.imageData.size( ));
 }
+
+BOOST_AUTO_TEST_CASE( testFrameDecodingInParallel )
+{
+    // Vector of rgba data, 4x4 tiles of 8x8 pixels
+    std::vector<char> data;
+    for( size_t i = 0; i < 16; ++i )
+        fillTestImage( data );
+    deflect::ImageWrapper imageWrapper( data.data(), 32, 32, deflect::RGBA );
+    imageWrapper.compressionPolicy = deflect::COMPRESSION_ON;
+    imageWrapper.compressionQuality = 100;
+
+    deflect::Frame frame;
+    deflect::ImageSegmenter segmenter;
+    segmenter.setNominalSegmentDimensions( 8, 8 );
+    const deflect::ImageSegmenter::Handler appendFunc =
+        boost::bind( &append, boost::ref( frame.segments ), _1 );
+
+    segmenter.generate( imageWrapper, appendFunc );
+    BOOST_REQUIRE_EQUAL( frame.segments.size(), 16 );
+
+    // Decode the frame twice concurrently, none of them may be dropped
+    deflect::Frame frameCopy = frame;
+    deflect::SegmentDecoder decoder;
+    QFuture<size_t> future = decoder.decodeFrame( frame );
+    QFuture<size_t> futureCopy = decoder.decodeFrame( frameCopy );
+    BOOST_CHECK_EQUAL( future.result(), 0 );
+    BOOST_CHECK_EQUAL( futureCopy.result(), 0 );
+
+    for( const deflect::Frame* decoded : { &frame, &frameCopy })
+    {
+        for( const deflect::Segment& segment : decoded->segments )
+        {
+            BOOST_REQUIRE( !segment.parameters.compressed );
+            BOOST_REQUIRE_EQUAL( segment.imageData.size(), 8 * 8 * 4 );
+
+            const char* dataOut = segment.imageData.constData();
+            BOOST_CHECK_EQUAL_COLLECTIONS( data.data(), data.data() + 8 * 8 * 4,
+                                           dataOut, dataOut + 8 * 8 * 4 );
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE( testFrameDecodingReportsFailedSegments )
+{
+    std::vector<char> data;
+    fillTestImage( data );
+    deflect::ImageWrapper imageWrapper( data.data(), 8, 8, deflect::RGBA );
+    imageWrapper.compressionPolicy = deflect::COMPRESSION_ON;
+
+    deflect::Frame frame;
+    deflect::ImageSegmenter segmenter;
+    segmenter.generate( imageWrapper,
+                        boost::bind( &append, boost::ref( frame.segments ),
+                                     _1 ));
+    BOOST_REQUIRE_EQUAL( frame.segments.size(), 1 );
+
+    deflect::Segment corrupted = frame.segments[0];
+    corrupted.imageData = QByteArray( 64, 'x' );
+    frame.segments.push_back( corrupted );
+
+    deflect::SegmentDecoder decoder;
+    BOOST_CHECK_EQUAL( decoder.decodeFrame( frame ).result(), 1 );
+    BOOST_CHECK( !frame.segments[0].parameters.compressed );
+    BOOST_CHECK( frame.segments[1].parameters.compressed );
+
+    BOOST_CHECK( !deflect::SegmentDecoder::isDownscaleSupported( 3 ));
+    BOOST_CHECK_THROW( decoder.decodeFrame( frame, 3 ),
+                       std::invalid_argument );
+    BOOST_CHECK_THROW( decoder.decodeFrameToYUV( frame, 0 ),
+                       std::invalid_argument );
+}
+
+BOOST_AUTO_TEST_CASE( testDecodeIntoCallerMemory )
+{
+    std::vector<char> data;
+    fillTestImage( data );
+    deflect::ImageWrapper imageWrapper( data.data(), 8, 8, deflect::RGBA );
+    imageWrapper.compressionQuality = 100;
+
+    deflect::Segment segment;
+    segment.parameters.width = 8;
+    segment.parameters.height = 8;
+    segment.parameters.compressed = true;
+    deflect::ImageJpegCompressor compressor;
+    segment.imageData = compressor.computeJpeg( imageWrapper,
+                                                QRect( 0, 0, 8, 8 ));
+
+    // Decode into the right half of a 16x8 canvas
+    const int pitch = 16 * 4;
+    std::vector<char> canvas( 8 * pitch, 0 );
+    deflect::SegmentDecoder decoder;
+    BOOST_REQUIRE( decoder.decode( segment, canvas.data() + 8 * 4, pitch ));
+    BOOST_CHECK( !decoder.decode( segment, canvas.data(), 4 * 4 ));
+
+    const std::vector<char> blackRow( 8 * 4, 0 );
+    for( size_t y = 0; y < 8; ++y )
+    {
+        const char* row = canvas.data() + y * pitch;
+        BOOST_CHECK_EQUAL_COLLECTIONS( row, row + 8 * 4,
+                                       blackRow.begin(), blackRow.end( ));
+        BOOST_CHECK_EQUAL_COLLECTIONS( row + 8 * 4, row + 16 * 4,
+                                       data.data() + y * 8 * 4,
+                                       data.data() + ( y + 1 ) * 8 * 4 );
+    }
+
+    // Raw segments are copied
+    segment.parameters.compressed = false;
+    segment.imageData = QByteArray( data.data(), data.size( ));
+    std::fill( canvas.begin(), canvas.end(), 0 );
+    BOOST_REQUIRE( decoder.decode( segment, canvas.data(), pitch ));
+    BOOST_CHECK_EQUAL_COLLECTIONS( canvas.data(), canvas.data() + 8 * 4,
+                                   data.data(), data.data() + 8 * 4 );
+}
+
+BOOST_AUTO_TEST_CASE( testDownscaledFrameDecoding )
+{
+    BOOST_CHECK( deflect::SegmentDecoder::isDownscaleSupported( 2 ));
+    BOOST_CHECK( deflect::SegmentDecoder::isDownscaleSupported( 8 ));
+    BOOST_CHECK( !deflect::SegmentDecoder::isDownscaleSupported( 3 ));
+
+    std::vector<char> data;
+    for( size_t i = 0; i < 16; ++i )
+        fillTestImage( data );
+
+    deflect::Frame frame;
+    for( const auto compression : { deflect::COMPRESSION_ON,
+                                    deflect::COMPRESSION_OFF })
+    {
+        deflect::ImageWrapper imageWrapper( data.data(), 32, 32,
+                                            deflect::RGBA, 32 );
+        imageWrapper.compressionPolicy = compression;
+        imageWrapper.compressionQuality = 100;
+
+        deflect::ImageSegmenter segmenter;
+        segmenter.generate( imageWrapper,
+                            boost::bind( &append, boost::ref( frame.segments ),
+                                         _1 ));
+    }
+    BOOST_REQUIRE_EQUAL( frame.segments.size(), 2 );
+
+    deflect::SegmentDecoder decoder;
+    BOOST_CHECK_EQUAL( decoder.decodeFrame( frame, 4 ).result(), 0 );
+
+    for( const deflect::Segment& segment : frame.segments )
+    {
+        BOOST_REQUIRE( !segment.parameters.compressed );
+        BOOST_CHECK_EQUAL( segment.parameters.x, 8 );
+        BOOST_CHECK_EQUAL( segment.parameters.width, 8 );
+        BOOST_CHECK_EQUAL( segment.parameters.height, 8 );
+        BOOST_REQUIRE_EQUAL( segment.imageData.size(), 8 * 8 * 4 );
+
+        const char* dataOut = segment.imageData.constData();
+        BOOST_CHECK_EQUAL_COLLECTIONS( data.data(), data.data() + 8 * 8 * 4,
+                                       dataOut, dataOut + 8 * 8 * 4 );
+    }
+}
+
+BOOST_AUTO_TEST_CASE( testFrameDecodingToYUV )
+{
+    std::vector<char> data;
+    for( size_t i = 0; i < 16; ++i )
+        fillTestImage( data );
+
+    deflect::Frame frame;
+    for( const auto subsampling : { deflect::SUBSAMPLING_444,
+                                    deflect::SUBSAMPLING_420 })
+    {
+        deflect::ImageWrapper imageWrapper( data.data(), 32, 32,
+                                            deflect::RGBA );
+        imageWrapper.compressionPolicy = deflect::COMPRESSION_ON;
+        imageWrapper.subsampling = subsampling;
+
+        deflect::ImageSegmenter segmenter;
+        segmenter.generate( imageWrapper,
+                            boost::bind( &append, boost::ref( frame.segments ),
+                                         _1 ));
+    }
+    // raw segments are left in RGBA format
+    deflect::Segment raw;
+    raw.parameters.width = 8;
+    raw.parameters.height = 8;
+    raw.imageData = QByteArray( data.data(), 8 * 8 * 4 );
+    frame.segments.push_back( raw );
+    BOOST_REQUIRE_EQUAL( frame.segments.size(), 3 );
+
+    deflect::SegmentDecoder decoder;
+    BOOST_CHECK_EQUAL( decoder.decodeFrameToYUV( frame ).result(), 0 );
+
+    for( const deflect::Segment& segment : frame.segments )
+        BOOST_REQUIRE( !segment.parameters.compressed );
+
+    BOOST_CHECK_EQUAL( frame.segments[0].format, deflect::SEGMENT_FORMAT_YUV444 );
+    BOOST_CHECK_EQUAL( frame.segments[0].imageData.size(), 32 * 32 * 3 );
+    BOOST_CHECK_EQUAL( frame.segments[1].format, deflect::SEGMENT_FORMAT_YUV420 );
+    BOOST_CHECK_EQUAL( frame.segments[1].imageData.size(), 32 * 32 * 3 / 2 );
+    BOOST_CHECK_EQUAL( frame.segments[2].format, deflect::SEGMENT_FORMAT_RGBA );
+    BOOST_CHECK_EQUAL( frame.segments[2].imageData.size(), 8 * 8 * 4 );
+}
+
+BOOST_AUTO_TEST_CASE( testCachedFrameDecoding )
+{
+    std::vector<char> data;
+    for( size_t i = 0; i < 16; ++i )
+        fillTestImage( data );
+    deflect::ImageWrapper imageWrapper( data.data(), 32, 32, deflect::RGBA );
+    imageWrapper.compressionPolicy = deflect::COMPRESSION_ON;
+    imageWrapper.compressionQuality = 100;
+
+    deflect::Frame frame;
+    deflect::ImageSegmenter segmenter;
+    segmenter.setNominalSegmentDimensions( 16, 16 );
+    segmenter.generate( imageWrapper,
+                        boost::bind( &append, boost::ref( frame.segments ),
+                                     _1 ));
+    BOOST_REQUIRE_EQUAL( frame.segments.size(), 4 );
+
+    deflect::SegmentDecoder decoder;
+    decoder.setCacheSize( 1024 * 1024 );
+
+    // The same image is sent again in the next frame
+    deflect::Frame nextFrame = frame;
+    decoder.decodeFrame( frame ).waitForFinished();
+    decoder.decodeFrame( nextFrame ).waitForFinished();
+
+    const deflect::SegmentDecoder::CacheStatistics stats =
+            decoder.getCacheStatistics();
+    // All the segments have the same content, the first frame might decode
+    // several of them concurrently but the next frame is entirely cached
+    BOOST_CHECK_EQUAL( stats.hits + stats.misses, 8 );
+    BOOST_CHECK_GE( stats.hits, 4 );
+    BOOST_CHECK_EQUAL( stats.entries, 1 );
+
+    for( const deflect::Segment& segment : nextFrame.segments )
+    {
+        BOOST_REQUIRE( !segment.parameters.compressed );
+        BOOST_REQUIRE_EQUAL( segment.imageData.size(), 16 * 16 * 4 );
+        BOOST_CHECK( segment.imageData == frame.segments[0].imageData );
+    }
+}
@@ -0,0 +1,142 @@
+/*********************************************************************/
+/* Copyright (c) 2015, EPFL/Blue Brain Project                       */
+/*                     Raphael Dumusc <raphael.dumusc@epfl.ch>       */
+/* All rights reserved.                                              */
+/*                                                                   */
+/* Redistribution and use in source and binary forms, with or        */
+/* without modification, are permitted provided that the following   */
+/* conditions are met:                                               */
+/*                                                                   */
+/*   1. Redistributions of source code must retain the above         */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer.                                                  */
+/*                                                                   */
+/*   2. Redistributions in binary form must reproduce the above      */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer in the documentation and/or other materials       */
+/*      provided with the distribution.                              */
+/*                                                                   */
+/*    THIS  SOFTWARE IS PROVIDED  BY THE  UNIVERSITY OF  TEXAS AT    */
+/*    AUSTIN  ``AS IS''  AND ANY  EXPRESS OR  IMPLIED WARRANTIES,    */
+/*    INCLUDING, BUT  NOT LIMITED  TO, THE IMPLIED  WARRANTIES OF    */
+/*    MERCHANTABILITY  AND FITNESS FOR  A PARTICULAR  PURPOSE ARE    */
+/*    DISCLAIMED.  IN  NO EVENT SHALL THE UNIVERSITY  OF TEXAS AT    */
+/*    AUSTIN OR CONTRIBUTORS BE  LIABLE FOR ANY DIRECT, INDIRECT,    */
+/*    INCIDENTAL,  SPECIAL, EXEMPLARY,  OR  CONSEQUENTIAL DAMAGES    */
+/*    (INCLUDING, BUT  NOT LIMITED TO,  PROCUREMENT OF SUBSTITUTE    */
+/*    GOODS  OR  SERVICES; LOSS  OF  USE,  DATA,  OR PROFITS;  OR    */
+/*    BUSINESS INTERRUPTION) HOWEVER CAUSED  AND ON ANY THEORY OF    */
+/*    LIABILITY, WHETHER  IN CONTRACT, STRICT  LIABILITY, OR TORT    */
+/*    (INCLUDING NEGLIGENCE OR OTHERWISE)  ARISING IN ANY WAY OUT    */
+/*    OF  THE  USE OF  THIS  SOFTWARE,  EVEN  IF ADVISED  OF  THE    */
+/*    POSSIBILITY OF SUCH DAMAGE.                                    */
+/*                                                                   */
+/* The views and conclusions contained in the software and           */
+/* documentation are those of the authors and should not be          */
+/* interpreted as representing official policies, either expressed   */
+/* or implied, of The University of Texas at Austin.                 */
+/*********************************************************************/
+
+#define BOOST_TEST_MODULE SegmentIndexTests
+#include <boost/test/unit_test.hpp>
+namespace ut = boost::unit_test;
+
+#include <deflect/Frame.h>
+#include <deflect/SegmentIndex.h>
+
+#include <cstdlib>
+
+namespace
+{
+deflect::Segment makeSegment( const unsigned int x, const unsigned int y,
+                              const unsigned int width,
+                              const unsigned int height )
+{
+    deflect::Segment segment;
+    segment.parameters.x = x;
+    segment.parameters.y = y;
+    segment.parameters.width = width;
+    segment.parameters.height = height;
+    return segment;
+}
+
+deflect::SegmentIndex::Indices findAll( const deflect::Frame& frame,
+                                        const QRect& region )
+{
+    deflect::SegmentIndex::Indices indices;
+    for( size_t i = 0; i < frame.segments.size(); ++i )
+    {
+        const deflect::SegmentParameters& params = frame.segments[i].parameters;
+        const QRect rect( params.x, params.y, params.width, params.height );
+        if( rect.intersects( region ))
+            indices.push_back( i );
+    }
+    return indices;
+}
+}
+
+BOOST_AUTO_TEST_CASE( TestEmptyIndex )
+{
+    const deflect::SegmentIndex index;
+    BOOST_CHECK( index.getDimensions() == QSize( 0, 0 ));
+    BOOST_CHECK( index.findSegments( QRect( 0, 0, 100, 100 )).empty( ));
+
+    const deflect::SegmentIndex frameIndex{ deflect::Frame() };
+    BOOST_CHECK( frameIndex.findSegments( QRect( 0, 0, 100, 100 )).empty( ));
+}
+
+BOOST_AUTO_TEST_CASE( TestRegionQueriesOnRegularGrid )
+{
+    // 64x64 grid of 32x32 segments
+    deflect::Frame frame;
+    for( unsigned int y = 0; y < 64; ++y )
+        for( unsigned int x = 0; x < 64; ++x )
+            frame.segments.push_back( makeSegment( x * 32, y * 32, 32, 32 ));
+
+    const deflect::SegmentIndex index( frame );
+    BOOST_CHECK( index.getDimensions() == frame.computeDimensions( ));
+    BOOST_CHECK( index.getDimensions() == QSize( 2048, 2048 ));
+
+    const deflect::SegmentIndex::Indices found =
+            index.findSegments( QRect( 40, 70, 30, 2 ));
+    BOOST_REQUIRE_EQUAL( found.size(), 2 );
+    BOOST_CHECK_EQUAL( found[0], 2 * 64 + 1 );
+    BOOST_CHECK_EQUAL( found[1], 2 * 64 + 2 );
+
+    // Regions partially or entirely outside of the frame
+    BOOST_CHECK_EQUAL( index.findSegments( QRect( -10, -10, 11, 11 )).size(),
+                       1 );
+    BOOST_CHECK( index.findSegments( QRect( 2048, 0, 10, 10 )).empty( ));
+    BOOST_CHECK_EQUAL( index.findSegments( QRect( 0, 0, 5000, 5000 )).size(),
+                       frame.segments.size( ));
+}
+
+BOOST_AUTO_TEST_CASE( TestRegionQueriesMatchExhaustiveSearch )
+{
+    // Overlapping segments of various sizes, including some much larger than
+    // the grid cells and some empty ones
+    std::srand( 42 );
+    deflect::Frame frame;
+    for( size_t i = 0; i < 2000; ++i )
+    {
+        const unsigned int size = i % 100 == 0 ? 1000 : 1 + std::rand() % 64;
+        frame.segments.push_back( makeSegment( std::rand() % 4000,
+                                               std::rand() % 2000,
+                                               size, i % 7 ? size : 0 ));
+    }
+
+    const deflect::SegmentIndex index( frame );
+    BOOST_CHECK( index.getDimensions() == frame.computeDimensions( ));
+
+    for( size_t i = 0; i < 200; ++i )
+    {
+        const QRect region( std::rand() % 4200 - 100, std::rand() % 2200 - 100,
+                            1 + std::rand() % 500, 1 + std::rand() % 500 );
+        const deflect::SegmentIndex::Indices expected = findAll( frame,
+                                                                 region );
+        const deflect::SegmentIndex::Indices found =
+                index.findSegments( region );
+        BOOST_CHECK_EQUAL_COLLECTIONS( found.begin(), found.end(),
+                                       expected.begin(), expected.end( ));
+    }
+}
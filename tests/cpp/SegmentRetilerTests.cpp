@@ -0,0 +1,163 @@
+/*********************************************************************/
+/* Copyright (c) 2015, EPFL/Blue Brain Project                       */
+/*                     Raphael Dumusc <raphael.dumusc@epfl.ch>       */
+/* All rights reserved.                                              */
+/*                                                                   */
+/* Redistribution and use in source and binary forms, with or        */
+/* without modification, are permitted provided that the following   */
+/* conditions are met:                                               */
+/*                                                                   */
+/*   1. Redistributions of source code must retain the above         */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer.                                                  */
+/*                                                                   */
+/*   2. Redistributions in binary form must reproduce the above      */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer in the documentation and/or other materials       */
+/*      provided with the distribution.                              */
+/*                                                                   */
+/*    THIS  SOFTWARE IS PROVIDED  BY THE  UNIVERSITY OF  TEXAS AT    */
+/*    AUSTIN  ``AS IS''  AND ANY  EXPRESS OR  IMPLIED WARRANTIES,    */
+/*    INCLUDING, BUT  NOT LIMITED  TO, THE IMPLIED  WARRANTIES OF    */
+/*    MERCHANTABILITY  AND FITNESS FOR  A PARTICULAR  PURPOSE ARE    */
+/*    DISCLAIMED.  IN  NO EVENT SHALL THE UNIVERSITY  OF TEXAS AT    */
+/*    AUSTIN OR CONTRIBUTORS BE  LIABLE FOR ANY DIRECT, INDIRECT,    */
+/*    INCIDENTAL,  SPECIAL, EXEMPLARY,  OR  CONSEQUENTIAL DAMAGES    */
+/*    (INCLUDING, BUT  NOT LIMITED TO,  PROCUREMENT OF SUBSTITUTE    */
+/*    GOODS  OR  SERVICES; LOSS  OF  USE,  DATA,  OR PROFITS;  OR    */
+/*    BUSINESS INTERRUPTION) HOWEVER CAUSED  AND ON ANY THEORY OF    */
+/*    LIABILITY, WHETHER  IN CONTRACT, STRICT  LIABILITY, OR TORT    */
+/*    (INCLUDING NEGLIGENCE OR OTHERWISE)  ARISING IN ANY WAY OUT    */
+/*    OF  THE  USE OF  THIS  SOFTWARE,  EVEN  IF ADVISED  OF  THE    */
+/*    POSSIBILITY OF SUCH DAMAGE.                                    */
+/*                                                                   */
+/* The views and conclusions contained in the software and           */
+/* documentation are those of the authors and should not be          */
+/* interpreted as representing official policies, either expressed   */
+/* or implied, of The University of Texas at Austin.                 */
+/*********************************************************************/
+
+#define BOOST_TEST_MODULE SegmentRetilerTests
+#include <boost/test/unit_test.hpp>
+namespace ut = boost::unit_test;
+
+#include <deflect/Frame.h>
+#include <deflect/ImageSegmenter.h>
+#include <deflect/ImageWrapper.h>
+#include <deflect/SegmentDecoder.h>
+#include <deflect/SegmentRetiler.h>
+
+#include <QMutex>
+
+namespace
+{
+// 64x32 image with a different colour for each 16x16 block
+std::vector<char> createTestImage()
+{
+    std::vector<char> data;
+    for( size_t y = 0; y < 32; ++y )
+    {
+        for( size_t x = 0; x < 64; ++x )
+        {
+            data.push_back( char( x / 16 * 60 ));
+            data.push_back( char( y / 16 * 120 ));
+            data.push_back( 0 );
+            data.push_back( -1 );
+        }
+    }
+    return data;
+}
+
+deflect::Frame createFrame( std::vector<char>& data,
+                            const deflect::CompressionPolicy compression )
+{
+    deflect::ImageWrapper image( data.data(), 64, 32, deflect::RGBA );
+    image.compressionPolicy = compression;
+    image.compressionQuality = 100;
+
+    deflect::Frame frame;
+    QMutex mutex;
+    deflect::ImageSegmenter segmenter;
+    segmenter.generate( image, [&]( const deflect::Segment& segment )
+    {
+        QMutexLocker locker( &mutex );
+        frame.segments.push_back( segment );
+        return true;
+    });
+    return frame;
+}
+
+// Two tiles split at x=20, which is not a multiple of the 8 or 16 pixels MCU
+const std::vector< QRect > tiles = { QRect( 0, 0, 20, 32 ),
+                                     QRect( 20, 0, 44, 32 ) };
+}
+
+BOOST_AUTO_TEST_CASE( testRawSegmentsAreCutAtTileBoundaries )
+{
+    std::vector<char> data = createTestImage();
+    deflect::Frame frame = createFrame( data, deflect::COMPRESSION_OFF );
+    BOOST_REQUIRE_EQUAL( frame.segments.size(), 1 );
+
+    deflect::SegmentRetiler retiler;
+    retiler.setTiles( tiles );
+    BOOST_REQUIRE( retiler.retile( frame ));
+    BOOST_REQUIRE_EQUAL( frame.segments.size(), 2 );
+
+    const deflect::SegmentParameters& left = frame.segments[0].parameters;
+    const deflect::SegmentParameters& right = frame.segments[1].parameters;
+    BOOST_CHECK_EQUAL( left.x, 0 );
+    BOOST_CHECK_EQUAL( left.width, 20 );
+    BOOST_CHECK_EQUAL( right.x, 20 );
+    BOOST_CHECK_EQUAL( right.width, 44 );
+    BOOST_CHECK_EQUAL( right.height, 32 );
+
+    const char* row = data.data() + 5 * 64 * 4;
+    const char* rightRow = frame.segments[1].imageData.constData() + 5 * 44 * 4;
+    BOOST_CHECK_EQUAL_COLLECTIONS( row + 20 * 4, row + 64 * 4,
+                                   rightRow, rightRow + 44 * 4 );
+
+    BOOST_REQUIRE_EQUAL( retiler.getTileSegments( 0 ).size(), 1 );
+    BOOST_CHECK_EQUAL( retiler.getTileSegments( 0 )[0], 0 );
+    BOOST_REQUIRE_EQUAL( retiler.getTileSegments( 1 ).size(), 1 );
+    BOOST_CHECK_EQUAL( retiler.getTileSegments( 1 )[0], 1 );
+}
+
+BOOST_AUTO_TEST_CASE( testJpegSegmentsAreCutLosslessly )
+{
+    std::vector<char> data = createTestImage();
+    deflect::Frame frame = createFrame( data, deflect::COMPRESSION_ON );
+    BOOST_REQUIRE_EQUAL( frame.segments.size(), 1 );
+
+    deflect::Frame reference = frame;
+    deflect::SegmentDecoder decoder;
+    decoder.decodeFrame( reference ).waitForFinished();
+
+    deflect::SegmentRetiler retiler;
+    retiler.setTiles( tiles );
+    BOOST_REQUIRE( retiler.retile( frame ));
+    BOOST_REQUIRE_EQUAL( frame.segments.size(), 2 );
+
+    // The cut is moved to the MCU boundary before the tile boundary
+    const deflect::SegmentParameters& left = frame.segments[0].parameters;
+    const deflect::SegmentParameters& right = frame.segments[1].parameters;
+    BOOST_CHECK( left.compressed && right.compressed );
+    BOOST_CHECK_EQUAL( left.x, 0 );
+    BOOST_CHECK_EQUAL( left.width, right.x );
+    BOOST_CHECK( right.x == 8 || right.x == 16 );
+    BOOST_CHECK_EQUAL( right.x + right.width, 64 );
+
+    // The right tile needs both sub-segments, as the first one overlaps it
+    BOOST_CHECK_EQUAL( retiler.getTileSegments( 0 ).size(), 1 );
+    BOOST_CHECK_EQUAL( retiler.getTileSegments( 1 ).size(), 2 );
+
+    // The crop does not alter the decoded pixels
+    decoder.decodeFrame( frame ).waitForFinished();
+    const deflect::Segment& decoded = frame.segments[1];
+    BOOST_REQUIRE_EQUAL( decoded.imageData.size(),
+                         int( right.width * right.height * 4 ));
+    const char* refRow = reference.segments[0].imageData.constData() +
+                         5 * 64 * 4 + right.x * 4;
+    const char* row = decoded.imageData.constData() + 5 * right.width * 4;
+    BOOST_CHECK_EQUAL_COLLECTIONS( refRow, refRow + right.width * 4,
+                                   row, row + right.width * 4 );
+}
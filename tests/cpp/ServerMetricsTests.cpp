@@ -0,0 +1,157 @@
+/*********************************************************************/
+/* Copyright (c) 2015, EPFL/Blue Brain Project                       */
+/*                     Raphael Dumusc <raphael.dumusc@epfl.ch>       */
+/* All rights reserved.                                              */
+/*                                                                   */
+/* Redistribution and use in source and binary forms, with or        */
+/* without modification, are permitted provided that the following   */
+/* conditions are met:                                               */
+/*                                                                   */
+/*   1. Redistributions of source code must retain the above         */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer.                                                  */
+/*                                                                   */
+/*   2. Redistributions in binary form must reproduce the above      */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer in the documentation and/or other materials       */
+/*      provided with the distribution.                              */
+/*                                                                   */
+/*    THIS  SOFTWARE IS PROVIDED  BY THE  UNIVERSITY OF  TEXAS AT    */
+/*    AUSTIN  ``AS IS''  AND ANY  EXPRESS OR  IMPLIED WARRANTIES,    */
+/*    INCLUDING, BUT  NOT LIMITED  TO, THE IMPLIED  WARRANTIES OF    */
+/*    MERCHANTABILITY  AND FITNESS FOR  A PARTICULAR  PURPOSE ARE    */
+/*    DISCLAIMED.  IN  NO EVENT SHALL THE UNIVERSITY  OF TEXAS AT    */
+/*    AUSTIN OR CONTRIBUTORS BE  LIABLE FOR ANY DIRECT, INDIRECT,    */
+/*    INCIDENTAL,  SPECIAL, EXEMPLARY,  OR  CONSEQUENTIAL DAMAGES    */
+/*    (INCLUDING, BUT  NOT LIMITED TO,  PROCUREMENT OF SUBSTITUTE    */
+/*    GOODS  OR  SERVICES; LOSS  OF  USE,  DATA,  OR PROFITS;  OR    */
+/*    BUSINESS INTERRUPTION) HOWEVER CAUSED  AND ON ANY THEORY OF    */
+/*    LIABILITY, WHETHER  IN CONTRACT, STRICT  LIABILITY, OR TORT    */
+/*    (INCLUDING NEGLIGENCE OR OTHERWISE)  ARISING IN ANY WAY OUT    */
+/*    OF  THE  USE OF  THIS  SOFTWARE,  EVEN  IF ADVISED  OF  THE    */
+/*    POSSIBILITY OF SUCH DAMAGE.                                    */
+/*                                                                   */
+/* The views and conclusions contained in the software and           */
+/* documentation are those of the authors and should not be          */
+/* interpreted as representing official policies, either expressed   */
+/* or implied, of The University of Texas at Austin.                 */
+/*********************************************************************/
+
+#define BOOST_TEST_MODULE ServerMetricsTests
+#include <boost/test/unit_test.hpp>
+namespace ut = boost::unit_test;
+
+#include <deflect/FrameDispatcher.h>
+#include <deflect/ServerMetrics.h>
+
+namespace
+{
+const QString uri( "teststream" );
+
+deflect::Segment createSegment( const int size )
+{
+    deflect::Segment segment;
+    segment.parameters.width = 8;
+    segment.parameters.height = 8;
+    segment.imageData = QByteArray( size, 'a' );
+    return segment;
+}
+
+bool contains( const std::string& text, const std::string& line )
+{
+    return text.find( line + "\n" ) != std::string::npos;
+}
+}
+
+BOOST_AUTO_TEST_CASE( testDispatcherCountsFramesAndSourceLag )
+{
+    deflect::FrameDispatcher dispatcher;
+    dispatcher.setDeliveryMode( uri, deflect::DELIVERY_EVERY_FRAME );
+    dispatcher.setMaxBufferedFrames( 2 );
+    BOOST_CHECK( dispatcher.getMetrics().empty( ));
+
+    dispatcher.addSource( uri, 0 );
+    dispatcher.addSource( uri, 1 );
+
+    // The first frame is dispatched, the next ones are buffered and the
+    // oldest dropped beyond the limit. Source 1 lags one frame behind.
+    for( size_t i = 0; i < 4; ++i )
+    {
+        dispatcher.processSegment( uri, 0, createSegment( 100 ));
+        dispatcher.processSegment( uri, 0, createSegment( 100 ));
+        dispatcher.processSegment( uri, 1, createSegment( 50 ));
+        dispatcher.processFrameFinished( uri, 0 );
+        if( i < 3 )
+            dispatcher.processFrameFinished( uri, 1 );
+    }
+
+    const std::vector< deflect::StreamMetrics > metrics =
+            dispatcher.getMetrics();
+    BOOST_REQUIRE_EQUAL( metrics.size(), 1u );
+    const deflect::StreamMetrics& stream = metrics[0];
+    BOOST_CHECK( stream.uri == uri );
+    BOOST_CHECK_EQUAL( stream.framesReceived, 4u );
+    BOOST_CHECK_EQUAL( stream.framesDispatched, 1u );
+    BOOST_CHECK_EQUAL( stream.framesDropped, 0u );
+    BOOST_CHECK_EQUAL( stream.bufferedFrames, 2u );
+    BOOST_CHECK_EQUAL( stream.segmentsReceived, 12u );
+    BOOST_CHECK_EQUAL( stream.bytesReceived, 1000u );
+    BOOST_CHECK_CLOSE( stream.segmentsPerFrame, 3.0, 1e-6 );
+
+    BOOST_REQUIRE_EQUAL( stream.sources.size(), 2u );
+    BOOST_CHECK_EQUAL( stream.sources[0].framesFinished, 4u );
+    BOOST_CHECK_EQUAL( stream.sources[0].framesBehind, 0u );
+    BOOST_CHECK_EQUAL( stream.sources[1].framesFinished, 3u );
+    BOOST_CHECK_EQUAL( stream.sources[1].framesBehind, 1u );
+
+    dispatcher.processFrameFinished( uri, 1 );
+    BOOST_CHECK_EQUAL( dispatcher.getMetrics()[0].framesDropped, 1u );
+
+    // A source joining mid-stream contributes from the first buffered frame,
+    // it only lags behind the frames received since then
+    dispatcher.addSource( uri, 2 );
+    std::vector< deflect::SourceMetrics > sources =
+            dispatcher.getMetrics()[0].sources;
+    BOOST_REQUIRE_EQUAL( sources.size(), 3u );
+    BOOST_CHECK_EQUAL( sources[2].sourceIndex, 2u );
+    BOOST_CHECK_EQUAL( sources[2].framesFinished, 0u );
+    BOOST_CHECK_EQUAL( sources[2].framesBehind, 2u );
+
+    dispatcher.processFrameFinished( uri, 2 );
+    dispatcher.processFrameFinished( uri, 2 );
+    sources = dispatcher.getMetrics()[0].sources;
+    BOOST_CHECK_EQUAL( sources[2].framesFinished, 2u );
+    BOOST_CHECK_EQUAL( sources[2].framesBehind, 0u );
+
+    dispatcher.deleteStream( uri );
+    BOOST_CHECK( dispatcher.getMetrics().empty( ));
+}
+
+BOOST_AUTO_TEST_CASE( testPrometheusExposition )
+{
+    deflect::ServerMetrics metrics;
+    metrics.connections = 2;
+
+    deflect::StreamMetrics stream;
+    stream.uri = "my \"stream\"";
+    stream.framesReceived = 42;
+    stream.bytesPerSecond = 1.5;
+    deflect::SourceMetrics source;
+    source.sourceIndex = 3;
+    source.framesBehind = 2;
+    stream.sources.push_back( source );
+    metrics.streams.push_back( stream );
+
+    const std::string text = metrics.toPrometheus();
+    BOOST_CHECK( contains( text, "# TYPE deflect_connections gauge" ));
+    BOOST_CHECK( contains( text, "deflect_connections 2" ));
+    BOOST_CHECK( contains( text,
+                           "# TYPE deflect_stream_frames_received_total "
+                           "counter" ));
+    BOOST_CHECK( contains( text, "deflect_stream_frames_received_total"
+                                 "{stream=\"my \\\"stream\\\"\"} 42" ));
+    BOOST_CHECK( contains( text, "deflect_stream_bytes_per_second"
+                                 "{stream=\"my \\\"stream\\\"\"} 1.5" ));
+    BOOST_CHECK( contains( text, "deflect_source_frames_behind"
+                                 "{stream=\"my \\\"stream\\\"\",source=\"3\"} 2" ));
+}
@@ -41,14 +41,67 @@
 #include <boost/test/unit_test.hpp>
 namespace ut = boost::unit_test;
 
+#include "ServerFixture.h"
 #include "MinimalGlobalQtApp.h"
 
+#include <deflect/Frame.h>
+#include <deflect/FrameDispatcher.h>
+#include <deflect/MessageHeader.h>
+#include <deflect/NetworkProtocol.h>
+#include <deflect/SegmentParameters.h>
+#include <deflect/Socket.h>
 #include <deflect/Stream.h>
 #include <deflect/Server.h>
 
+#include <QElapsedTimer>
 #include <QMutex>
+#include <QTcpSocket>
 #include <QThread>
 #include <QWaitCondition>
+#include <QtEndian>
+
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <thread>
+
+namespace
+{
+const int timeoutMs = 2000;
+
+template< typename Condition >
+bool waitFor( const Condition& condition )
+{
+    QElapsedTimer timer;
+    timer.start();
+    while( !condition( ))
+    {
+        if( timer.elapsed() > timeoutMs )
+            return false;
+        QThread::msleep( 10 );
+    }
+    return true;
+}
+
+/** Send a raw 4x4 segment and finish the frame, as a Stream would. */
+void sendFrame( deflect::Socket& socket, const std::string& uri )
+{
+    deflect::SegmentParameters parameters;
+    parameters.width = 4;
+    parameters.height = 4;
+    parameters.compressed = false;
+
+    QByteArray message( (const char*)&parameters, sizeof( parameters ));
+    message.append( QByteArray( 4 * 4 * 4, '\0' ));
+
+    BOOST_CHECK( socket.send( deflect::MessageHeader(
+                                  deflect::MESSAGE_TYPE_PIXELSTREAM,
+                                  message.size(), uri ), message ));
+    BOOST_CHECK( socket.send( deflect::MessageHeader(
+                                  deflect::MESSAGE_TYPE_PIXELSTREAM_FINISH_FRAME,
+                                  0, uri ), QByteArray( )));
+}
+}
 
 BOOST_GLOBAL_FIXTURE( MinimalGlobalQtApp );
 
@@ -91,3 +144,650 @@ BOOST_AUTO_TEST_CASE( testSizeHintsReceivedByServer )
     serverThread.wait();
     delete server;
 }
+
+BOOST_AUTO_TEST_CASE( testFrameAcksLimitFramesInFlight )
+{
+    const QString testURI( "teststream" );
+    const unsigned int maxFramesInFlight = 2;
+    const unsigned int frameCount = 5;
+
+    QThread serverThread;
+    deflect::Server* server = new deflect::Server( 0 /* OS-chosen port */ );
+    server->startDispatcherThread();
+    server->moveToThread( &serverThread );
+    serverThread.start();
+
+    deflect::FrameDispatcher& dispatcher = server->getPixelStreamDispatcher();
+    dispatcher.setDeliveryMode( testURI, deflect::DELIVERY_EVERY_FRAME );
+    std::atomic< unsigned int > framesDispatched( 0 );
+    dispatcher.connect( &dispatcher, &deflect::FrameDispatcher::sendFrame,
+                        [&]( deflect::FramePtr ) { ++framesDispatched; });
+
+    std::atomic< bool > flowControlEnabled( false );
+    std::atomic< unsigned int > framesFinished( 0 );
+    std::thread sender( [&]
+    {
+        deflect::Stream stream( testURI.toStdString(), "localhost",
+                                server->serverPort( ));
+        if( !stream.setMaxFramesInFlight( maxFramesInFlight ))
+            return;
+        flowControlEnabled = true;
+
+        std::vector< char > pixels( 8 * 8 * 4, 0 );
+        deflect::ImageWrapper image( pixels.data(), 8, 8, deflect::RGBA );
+        image.compressionPolicy = deflect::COMPRESSION_OFF;
+        for( unsigned int i = 0; i < frameCount; ++i )
+        {
+            if( !stream.send( image ) || !stream.finishFrame( ))
+                return;
+            ++framesFinished;
+        }
+    });
+
+    // The first frame is dispatched immediately, the next ones wait for the
+    // receiver to request them
+    BOOST_CHECK( waitFor( [&] { return framesFinished == maxFramesInFlight; }));
+    BOOST_CHECK( flowControlEnabled );
+    QThread::msleep( 100 );
+    BOOST_CHECK_EQUAL( framesFinished.load(), maxFramesInFlight );
+    BOOST_CHECK_EQUAL( framesDispatched.load(), 1u );
+
+    // Each consumed frame lets the sender finish one more frame
+    for( unsigned int i = 1; i <= frameCount - maxFramesInFlight; ++i )
+    {
+        dispatcher.requestFrame( testURI );
+        BOOST_CHECK( waitFor( [&] {
+            return framesFinished == maxFramesInFlight + i; }));
+        BOOST_CHECK_EQUAL( framesDispatched.load(), 1 + i );
+    }
+
+    sender.join();
+
+    serverThread.quit();
+    serverThread.wait();
+    delete server;
+}
+
+BOOST_AUTO_TEST_CASE( testFrameAcksCreditSupersededFrames )
+{
+    const QString testURI( "teststream" );
+    const unsigned int maxFramesInFlight = 2;
+    const unsigned int frameCount = 10;
+
+    QThread serverThread;
+    deflect::Server* server = new deflect::Server( 0 /* OS-chosen port */ );
+    server->startDispatcherThread();
+    server->moveToThread( &serverThread );
+    serverThread.start();
+
+    deflect::FrameDispatcher& dispatcher = server->getPixelStreamDispatcher();
+    std::atomic< unsigned int > framesDispatched( 0 );
+    dispatcher.connect( &dispatcher, &deflect::FrameDispatcher::sendFrame,
+                        [&]( deflect::FramePtr ) { ++framesDispatched; });
+
+    std::atomic< unsigned int > framesFinished( 0 );
+    std::thread sender( [&]
+    {
+        deflect::Stream stream( testURI.toStdString(), "localhost",
+                                server->serverPort( ));
+        if( !stream.setMaxFramesInFlight( maxFramesInFlight ))
+            return;
+
+        std::vector< char > pixels( 8 * 8 * 4, 0 );
+        deflect::ImageWrapper image( pixels.data(), 8, 8, deflect::RGBA );
+        image.compressionPolicy = deflect::COMPRESSION_OFF;
+        for( unsigned int i = 0; i < frameCount; ++i )
+        {
+            if( !stream.send( image ) || !stream.finishFrame( ))
+                return;
+            ++framesFinished;
+        }
+    });
+
+    // The receiver never requests a frame after the first one, the frames
+    // superseded in the latest-only buffer are acknowledged nonetheless
+    BOOST_CHECK( waitFor( [&] { return framesFinished == frameCount; }));
+    BOOST_CHECK_EQUAL( framesDispatched.load(), 1u );
+
+    sender.join();
+
+    serverThread.quit();
+    serverThread.wait();
+    delete server;
+}
+
+BOOST_AUTO_TEST_CASE( testLocalStreamSendsSegmentsThroughSharedMemory )
+{
+    const QString testURI( "teststream" );
+
+    QThread serverThread;
+    deflect::Server* server = new deflect::Server( 0 /* OS-chosen port */ );
+    server->startDispatcherThread();
+    server->moveToThread( &serverThread );
+    serverThread.start();
+
+    deflect::FrameDispatcher& dispatcher = server->getPixelStreamDispatcher();
+    dispatcher.setDeliveryMode( testURI, deflect::DELIVERY_EVERY_FRAME );
+    std::mutex mutex;
+    std::vector< deflect::FramePtr > frames;
+    dispatcher.connect( &dispatcher, &deflect::FrameDispatcher::sendFrame,
+                        [&]( deflect::FramePtr frame )
+    {
+        std::lock_guard< std::mutex > lock( mutex );
+        frames.push_back( frame );
+        dispatcher.requestFrame( testURI );
+    });
+
+    std::vector< char > pixels( 600 * 8 * 4 );
+    for( size_t i = 0; i < pixels.size(); ++i )
+        pixels[i] = char( i );
+
+    bool usedSharedMemory = false;
+    {
+        deflect::Stream stream( testURI.toStdString(), "localhost",
+                                server->serverPort( ));
+        BOOST_REQUIRE( stream.isConnected( ));
+        BOOST_CHECK( !stream.isUsingSharedMemory( ));
+        stream.setSharedMemoryEnabled( true );
+
+        deflect::ImageWrapper image( pixels.data(), 600, 8, deflect::RGBA );
+        image.compressionPolicy = deflect::COMPRESSION_OFF;
+
+        // The reply from the server is processed at the end of each frame
+        for( size_t i = 0; i < 3; ++i )
+        {
+            BOOST_CHECK( stream.send( image ));
+            BOOST_CHECK( stream.finishFrame( ));
+            QThread::msleep( 50 );
+        }
+        usedSharedMemory = stream.isUsingSharedMemory();
+    }
+    BOOST_CHECK( usedSharedMemory );
+
+    BOOST_CHECK( waitFor( [&] {
+        std::lock_guard< std::mutex > lock( mutex );
+        return frames.size() == 3;
+    }));
+
+    // Segments received through TCP and shared memory are identical
+    std::lock_guard< std::mutex > lock( mutex );
+    for( const deflect::FramePtr& frame : frames )
+    {
+        BOOST_REQUIRE_EQUAL( frame->segments.size(), 2 ); // 512 + 88 pixels
+        BOOST_CHECK( frame->computeDimensions() == QSize( 600, 8 ));
+        for( const deflect::Segment& segment : frame->segments )
+        {
+            const deflect::SegmentParameters& params = segment.parameters;
+            BOOST_REQUIRE_EQUAL( segment.imageData.size(),
+                                 int( params.width * params.height * 4 ));
+            const char* row = pixels.data() + params.x * 4;
+            BOOST_CHECK_EQUAL_COLLECTIONS( row, row + params.width * 4,
+                                           segment.imageData.constData(),
+                                           segment.imageData.constData() +
+                                           params.width * 4 );
+        }
+    }
+
+    serverThread.quit();
+    serverThread.wait();
+    delete server;
+}
+
+BOOST_AUTO_TEST_CASE( testStreamConnectsThroughLocalSocket )
+{
+    const QString testURI( "teststream" );
+
+    QThread serverThread;
+    deflect::Server* server = new deflect::Server( 0 /* OS-chosen port */ );
+    BOOST_REQUIRE( server->listenLocal( "deflect-servertests" ));
+    BOOST_REQUIRE( !server->getLocalSocketPath().isEmpty( ));
+    server->startDispatcherThread();
+    server->moveToThread( &serverThread );
+    serverThread.start();
+
+    deflect::FrameDispatcher& dispatcher = server->getPixelStreamDispatcher();
+    std::atomic< size_t > segmentsReceived( 0 );
+    dispatcher.connect( &dispatcher, &deflect::FrameDispatcher::sendFrame,
+                        [&]( deflect::FramePtr frame )
+    {
+        segmentsReceived = frame->segments.size();
+    });
+
+    {
+        const std::string address = "unix:" +
+                server->getLocalSocketPath().toStdString();
+        deflect::Stream stream( testURI.toStdString(), address );
+        BOOST_REQUIRE( stream.isConnected( ));
+        stream.setSharedMemoryEnabled( false );
+
+        std::vector< char > pixels( 8 * 8 * 4, 0 );
+        deflect::ImageWrapper image( pixels.data(), 8, 8, deflect::RGBA );
+        image.compressionPolicy = deflect::COMPRESSION_OFF;
+        BOOST_CHECK( stream.send( image ));
+        BOOST_CHECK( stream.finishFrame( ));
+    }
+    BOOST_CHECK( waitFor( [&] { return segmentsReceived == 1; }));
+
+    // Invalid addresses
+    deflect::Stream invalid( testURI.toStdString(), "unix:/no/such/socket" );
+    BOOST_CHECK( !invalid.isConnected( ));
+
+    serverThread.quit();
+    serverThread.wait();
+    delete server;
+}
+
+BOOST_AUTO_TEST_CASE( testIoUringReceiverDeliversSegments )
+{
+    const QString testURI( "teststream" );
+
+    QThread serverThread;
+    deflect::Server* server = new deflect::Server( 0 /* OS-chosen port */ );
+    if( !server->setIoUringEnabled( true ))
+    {
+        BOOST_TEST_MESSAGE( "io_uring receiver not available, skipping" );
+        BOOST_CHECK( !server->isIoUringEnabled( ));
+        delete server;
+        return;
+    }
+    BOOST_CHECK( server->isIoUringEnabled( ));
+    server->startDispatcherThread();
+    server->moveToThread( &serverThread );
+    serverThread.start();
+
+    deflect::FrameDispatcher& dispatcher = server->getPixelStreamDispatcher();
+    dispatcher.setDeliveryMode( testURI, deflect::DELIVERY_EVERY_FRAME );
+    std::mutex mutex;
+    std::vector< deflect::FramePtr > frames;
+    dispatcher.connect( &dispatcher, &deflect::FrameDispatcher::sendFrame,
+                        [&]( deflect::FramePtr frame )
+    {
+        std::lock_guard< std::mutex > lock( mutex );
+        frames.push_back( frame );
+        dispatcher.requestFrame( testURI );
+    });
+
+    // Large segments are read directly into their payload, small ones
+    // through the registered buffer of the connection
+    const std::vector< QSize > sizes = { QSize( 600, 520 ), QSize( 8, 8 ),
+                                         QSize( 600, 520 ), QSize( 8, 8 ) };
+    std::vector< char > pixels( 600 * 520 * 4 );
+    for( size_t i = 0; i < pixels.size(); ++i )
+        pixels[i] = char( i );
+
+    {
+        deflect::Stream stream( testURI.toStdString(), "localhost",
+                                server->serverPort( ));
+        BOOST_REQUIRE( stream.isConnected( ));
+        stream.setSharedMemoryEnabled( false );
+
+        for( const QSize& size : sizes )
+        {
+            deflect::ImageWrapper image( pixels.data(), size.width(),
+                                         size.height(), deflect::RGBA );
+            image.compressionPolicy = deflect::COMPRESSION_OFF;
+            BOOST_CHECK( stream.send( image ));
+            BOOST_CHECK( stream.finishFrame( ));
+        }
+    }
+
+    BOOST_CHECK( waitFor( [&] {
+        std::lock_guard< std::mutex > lock( mutex );
+        return frames.size() == sizes.size();
+    }));
+
+    std::lock_guard< std::mutex > lock( mutex );
+    BOOST_REQUIRE_EQUAL( frames.size(), sizes.size( ));
+    for( size_t i = 0; i < frames.size(); ++i )
+    {
+        BOOST_CHECK( frames[i]->computeDimensions() == sizes[i] );
+        for( const deflect::Segment& segment : frames[i]->segments )
+        {
+            const deflect::SegmentParameters& params = segment.parameters;
+            BOOST_REQUIRE_EQUAL( segment.imageData.size(),
+                                 int( params.width * params.height * 4 ));
+            const char* row = pixels.data() +
+                    ( params.y * sizes[i].width() + params.x ) * 4;
+            BOOST_CHECK_EQUAL_COLLECTIONS( row, row + params.width * 4,
+                                           segment.imageData.constData(),
+                                           segment.imageData.constData() +
+                                           params.width * 4 );
+        }
+    }
+
+    serverThread.quit();
+    serverThread.wait();
+    delete server;
+}
+
+BOOST_AUTO_TEST_CASE( testServerAcceptsRegularAndCompactHeaders )
+{
+    QThread serverThread;
+    deflect::Server* server = new deflect::Server( 0 /* OS-chosen port */ );
+    server->startDispatcherThread();
+    server->moveToThread( &serverThread );
+    serverThread.start();
+
+    deflect::FrameDispatcher& dispatcher = server->getPixelStreamDispatcher();
+    std::mutex mutex;
+    std::vector< QString > uris;
+    dispatcher.connect( &dispatcher, &deflect::FrameDispatcher::sendFrame,
+                        [&]( deflect::FramePtr frame )
+    {
+        BOOST_CHECK( frame->computeDimensions() == QSize( 4, 4 ));
+        std::lock_guard< std::mutex > lock( mutex );
+        uris.push_back( frame->uri );
+    });
+
+    // Protocol version 8 clients open the stream without payload and keep
+    // sending the uri in each message header
+    const std::string regularUri( "regularHeaders" );
+    deflect::Socket regular( "localhost", server->serverPort( ));
+    BOOST_REQUIRE( regular.isConnected( ));
+    BOOST_CHECK( regular.send( deflect::MessageHeader(
+                                   deflect::MESSAGE_TYPE_PIXELSTREAM_OPEN, 0,
+                                   regularUri ), QByteArray( )));
+    sendFrame( regular, regularUri );
+
+    // Version 9 clients request compact headers and receive their stream id
+    const std::string compactUri( "compactHeaders" );
+    deflect::Socket compact( "localhost", server->serverPort( ));
+    BOOST_REQUIRE( compact.isConnected( ));
+    QByteArray version( sizeof( quint32 ), '\0' );
+    qToLittleEndian< quint32 >( COMPACT_HEADER_PROTOCOL_VERSION,
+                                (uchar*)version.data( ));
+    BOOST_CHECK( compact.send( deflect::MessageHeader(
+                                   deflect::MESSAGE_TYPE_PIXELSTREAM_OPEN,
+                                   version.size(), compactUri ), version ));
+
+    deflect::MessageHeader reply;
+    QByteArray replyData;
+    BOOST_REQUIRE( compact.receive( reply, replyData ));
+    BOOST_REQUIRE_EQUAL( reply.type,
+                         deflect::MESSAGE_TYPE_PIXELSTREAM_OPEN_REPLY );
+    BOOST_REQUIRE_EQUAL( replyData.size(), 2 * sizeof( quint32 ));
+    const quint32 streamId =
+            qFromLittleEndian< quint32 >( (const uchar*)replyData.data( ));
+    BOOST_CHECK( streamId > 0 );
+    const quint32 features = qFromLittleEndian< quint32 >(
+                (const uchar*)replyData.data() + sizeof( quint32 ));
+    BOOST_CHECK( features & PROTOCOL_FEATURE_FRAME_ACKS );
+
+    // The uri is not sent anymore, messages with another id are ignored
+    compact.setStreamId( streamId + 1 );
+    sendFrame( compact, compactUri );
+    compact.setStreamId( streamId );
+    sendFrame( compact, compactUri );
+
+    BOOST_CHECK( waitFor( [&] {
+        std::lock_guard< std::mutex > lock( mutex );
+        return uris.size() == 2;
+    }));
+    QThread::msleep( 100 );
+    {
+        std::lock_guard< std::mutex > lock( mutex );
+        BOOST_REQUIRE_EQUAL( uris.size(), 2 );
+        BOOST_CHECK( std::count( uris.begin(), uris.end(),
+                                 QString::fromStdString( regularUri )) == 1 );
+        BOOST_CHECK( std::count( uris.begin(), uris.end(),
+                                 QString::fromStdString( compactUri )) == 1 );
+    }
+
+    serverThread.quit();
+    serverThread.wait();
+    delete server;
+}
+
+BOOST_AUTO_TEST_CASE( testEventsAreBatchedAndMovesCoalesced )
+{
+    const QString testURI( "teststream" );
+
+    ServerFixture fixture;
+
+    deflect::Stream stream( testURI.toStdString(), "localhost",
+                            fixture.server->serverPort( ));
+    BOOST_REQUIRE( stream.isConnected( ));
+    BOOST_REQUIRE( stream.registerForEvents( ));
+    BOOST_REQUIRE( fixture.receiver );
+
+    std::vector< deflect::Event > events( 6 );
+    events[0].type = deflect::Event::EVT_PRESS;
+    for( size_t i = 1; i < 4; ++i )
+    {
+        events[i].type = deflect::Event::EVT_MOVE;
+        events[i].mouseX = 0.1 * i;
+        events[i].dx = 0.1;
+        events[i].mouseLeft = true;
+    }
+    events[4].type = deflect::Event::EVT_RELEASE;
+    events[5].type = deflect::Event::EVT_MOVE;
+
+    // Queued while the worker is blocked, so they are all sent in one batch
+    fixture.blockReceiver();
+    for( const deflect::Event& event : events )
+        fixture.postEvent( event );
+    fixture.unblockReceiver();
+
+    const deflect::Event press = stream.getEvent();
+    const deflect::Event move = stream.getEvent();
+    const deflect::Event release = stream.getEvent();
+    const deflect::Event lastMove = stream.getEvent();
+
+    BOOST_CHECK_EQUAL( press.type, deflect::Event::EVT_PRESS );
+    BOOST_CHECK_EQUAL( move.type, deflect::Event::EVT_MOVE );
+    BOOST_CHECK_CLOSE( move.mouseX, 0.3, 1e-6 );
+    BOOST_CHECK_CLOSE( move.dx, 0.3, 1e-6 );
+    BOOST_CHECK( move.mouseLeft );
+    BOOST_CHECK_EQUAL( release.type, deflect::Event::EVT_RELEASE );
+    BOOST_CHECK_EQUAL( lastMove.type, deflect::Event::EVT_MOVE );
+    BOOST_CHECK( !lastMove.mouseLeft );
+    BOOST_CHECK( !stream.hasEvent( ));
+}
+
+BOOST_AUTO_TEST_CASE( testEventThreadQueuesEventsWhileStreaming )
+{
+    const QString testURI( "teststream" );
+
+    ServerFixture fixture;
+
+    deflect::Stream stream( testURI.toStdString(), "localhost",
+                            fixture.server->serverPort( ));
+    BOOST_REQUIRE( stream.isConnected( ));
+    BOOST_CHECK( !stream.startEventThread( ));
+    BOOST_REQUIRE( stream.registerForEvents( ));
+    BOOST_REQUIRE( fixture.receiver );
+    BOOST_REQUIRE( stream.startEventThread( ));
+
+    deflect::Event event;
+    event.type = deflect::Event::EVT_KEY_PRESS;
+    event.key = 42;
+    fixture.postEvent( event );
+
+    // The event arrives without the stream reading from the socket
+    BOOST_CHECK( waitFor( [&] { return stream.hasEvent(); }));
+    const deflect::Event received = stream.getEvent();
+    BOOST_CHECK_EQUAL( received.type, deflect::Event::EVT_KEY_PRESS );
+    BOOST_CHECK_EQUAL( received.key, 42 );
+    BOOST_CHECK( !stream.hasEvent( ));
+
+    std::vector< char > pixels( 8 * 8 * 4, 0 );
+    deflect::ImageWrapper image( pixels.data(), 8, 8, deflect::RGBA );
+    image.compressionPolicy = deflect::COMPRESSION_OFF;
+    BOOST_CHECK( stream.send( image ) && stream.finishFrame( ));
+}
+
+BOOST_AUTO_TEST_CASE( testCoalescedEventsReturnWhileEventsKeepArriving )
+{
+    const QString testURI( "teststream" );
+
+    ServerFixture fixture;
+
+    deflect::Stream stream( testURI.toStdString(), "localhost",
+                            fixture.server->serverPort( ));
+    BOOST_REQUIRE( stream.isConnected( ));
+    BOOST_REQUIRE( stream.registerForEvents( ));
+    BOOST_REQUIRE( fixture.receiver );
+    BOOST_REQUIRE( stream.startEventThread( ));
+
+    // Keys are never coalesced, their sequence tells if any was lost
+    std::atomic< bool > feeding( true );
+    std::thread feeder( [&]
+    {
+        deflect::Event event;
+        event.type = deflect::Event::EVT_KEY_PRESS;
+        for( event.key = 0; feeding; ++event.key )
+            fixture.postEvent( event );
+    });
+
+    // Each call returns with the events received so far even though the event
+    // thread keeps receiving new ones
+    int nextKey = 0;
+    for( size_t i = 0; i < 10; ++i )
+    {
+        BOOST_REQUIRE( waitFor( [&] { return stream.hasEvent(); }));
+        const std::vector< deflect::Event > events =
+                stream.getCoalescedEvents();
+        BOOST_REQUIRE( !events.empty( ));
+        for( const deflect::Event& event : events )
+            BOOST_REQUIRE_EQUAL( event.key, nextKey++ );
+    }
+
+    feeding = false;
+    feeder.join();
+}
+
+BOOST_AUTO_TEST_CASE( testEventThreadCallback )
+{
+    const QString testURI( "teststream" );
+
+    ServerFixture fixture;
+
+    deflect::Stream stream( testURI.toStdString(), "localhost",
+                            fixture.server->serverPort( ));
+    BOOST_REQUIRE( stream.isConnected( ));
+    BOOST_REQUIRE( stream.registerForEvents( ));
+    BOOST_REQUIRE( fixture.receiver );
+
+    std::mutex mutex;
+    std::vector< deflect::Event > events;
+    BOOST_REQUIRE( stream.startEventThread( [&]( const deflect::Event& evt )
+    {
+        std::lock_guard< std::mutex > lock( mutex );
+        events.push_back( evt );
+    }));
+
+    for( int key = 0; key < 3; ++key )
+    {
+        deflect::Event event;
+        event.type = deflect::Event::EVT_KEY_PRESS;
+        event.key = key;
+        fixture.postEvent( event );
+    }
+
+    BOOST_REQUIRE( waitFor( [&] {
+        std::lock_guard< std::mutex > lock( mutex );
+        return events.size() == 3;
+    }));
+    for( int key = 0; key < 3; ++key )
+        BOOST_CHECK_EQUAL( events[key].key, key );
+    BOOST_CHECK( !stream.hasEvent( ));
+}
+
+BOOST_AUTO_TEST_CASE( testHasEventIgnoresFrameAcks )
+{
+    const QString testURI( "teststream" );
+
+    ServerFixture fixture;
+    deflect::Server* server = fixture.server;
+
+    deflect::FrameDispatcher& dispatcher = server->getPixelStreamDispatcher();
+    std::atomic< unsigned int > framesDispatched( 0 );
+    dispatcher.connect( &dispatcher, &deflect::FrameDispatcher::sendFrame,
+                        [&]( deflect::FramePtr frame )
+    {
+        ++framesDispatched;
+        dispatcher.requestFrame( frame->uri );
+    });
+
+    deflect::Stream stream( testURI.toStdString(), "localhost",
+                            server->serverPort( ));
+    BOOST_REQUIRE( stream.isConnected( ));
+    BOOST_REQUIRE( stream.registerForEvents( ));
+    BOOST_REQUIRE( fixture.receiver );
+    BOOST_REQUIRE( stream.setMaxFramesInFlight( 8 ));
+
+    std::vector< char > pixels( 8 * 8 * 4, 0 );
+    deflect::ImageWrapper image( pixels.data(), 8, 8, deflect::RGBA );
+    image.compressionPolicy = deflect::COMPRESSION_OFF;
+    for( size_t i = 0; i < 3; ++i )
+        BOOST_CHECK( stream.send( image ) && stream.finishFrame( ));
+    BOOST_REQUIRE( waitFor( [&] { return framesDispatched == 3; }));
+
+    // The acknowledgements pending on the socket are not events
+    QThread::msleep( 100 );
+    BOOST_CHECK( !stream.hasEvent( ));
+    BOOST_CHECK( stream.getCoalescedEvents().empty( ));
+
+    deflect::Event event;
+    event.type = deflect::Event::EVT_KEY_PRESS;
+    event.key = 42;
+    fixture.postEvent( event );
+    BOOST_REQUIRE( waitFor( [&] { return stream.hasEvent(); }));
+    BOOST_CHECK_EQUAL( stream.getEvent().key, 42 );
+    BOOST_CHECK( !stream.hasEvent( ));
+}
+
+BOOST_AUTO_TEST_CASE( testServerMetrics )
+{
+    const QString testURI( "teststream" );
+
+    ServerFixture fixture( []( deflect::Server& server )
+    {
+        BOOST_REQUIRE( server.listenMetrics( 0 ));
+    });
+    deflect::Server* server = fixture.server;
+    const quint16 metricsPort = server->getMetricsPort();
+    BOOST_REQUIRE( metricsPort != 0 );
+
+    BOOST_CHECK_EQUAL( server->getMetrics().connections, 0u );
+    {
+        deflect::Stream stream( testURI.toStdString(), "localhost",
+                                server->serverPort( ));
+        BOOST_REQUIRE( stream.isConnected( ));
+
+        std::vector< char > pixels( 8 * 8 * 4, 0 );
+        deflect::ImageWrapper image( pixels.data(), 8, 8, deflect::RGBA );
+        image.compressionPolicy = deflect::COMPRESSION_OFF;
+        for( size_t i = 0; i < 3; ++i )
+            BOOST_CHECK( stream.send( image ) && stream.finishFrame( ));
+
+        BOOST_CHECK( waitFor( [&] {
+            const deflect::ServerMetrics metrics = server->getMetrics();
+            return metrics.streams.size() == 1 &&
+                   metrics.streams[0].framesReceived == 3;
+        }));
+        const deflect::ServerMetrics metrics = server->getMetrics();
+        BOOST_CHECK_EQUAL( metrics.connections, 1u );
+        BOOST_REQUIRE_EQUAL( metrics.streams.size(), 1u );
+        BOOST_CHECK( metrics.streams[0].uri == testURI );
+        BOOST_CHECK_GE( metrics.streams[0].framesDispatched, 1u );
+        BOOST_CHECK_GE( metrics.streams[0].bytesReceived, 3u * pixels.size( ));
+        BOOST_REQUIRE_EQUAL( metrics.streams[0].sources.size(), 1u );
+        BOOST_CHECK_EQUAL( metrics.streams[0].sources[0].framesBehind, 0u );
+
+        QTcpSocket scraper;
+        scraper.connectToHost( QHostAddress::LocalHost, metricsPort );
+        BOOST_REQUIRE( scraper.waitForConnected( timeoutMs ));
+        scraper.write( "GET /metrics HTTP/1.0\r\n\r\n" );
+        QByteArray response;
+        while( scraper.waitForReadyRead( timeoutMs ))
+            response.append( scraper.readAll( ));
+        BOOST_CHECK( response.startsWith( "HTTP/1.0 200 OK" ));
+        BOOST_CHECK( response.contains(
+                     "deflect_stream_frames_received_total"
+                     "{stream=\"teststream\"} 3\n" ));
+    }
+
+    BOOST_CHECK( waitFor( [&] {
+        return server->getMetrics().connections == 0; }));
+}
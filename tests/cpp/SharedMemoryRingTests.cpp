@@ -0,0 +1,104 @@
+/*********************************************************************/
+/* Copyright (c) 2015, EPFL/Blue Brain Project                       */
+/*                     Raphael Dumusc <raphael.dumusc@epfl.ch>       */
+/* All rights reserved.                                              */
+/*                                                                   */
+/* Redistribution and use in source and binary forms, with or        */
+/* without modification, are permitted provided that the following   */
+/* conditions are met:                                               */
+/*                                                                   */
+/*   1. Redistributions of source code must retain the above         */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer.                                                  */
+/*                                                                   */
+/*   2. Redistributions in binary form must reproduce the above      */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer in the documentation and/or other materials       */
+/*      provided with the distribution.                              */
+/*                                                                   */
+/*    THIS  SOFTWARE IS PROVIDED  BY THE  UNIVERSITY OF  TEXAS AT    */
+/*    AUSTIN  ``AS IS''  AND ANY  EXPRESS OR  IMPLIED WARRANTIES,    */
+/*    INCLUDING, BUT  NOT LIMITED  TO, THE IMPLIED  WARRANTIES OF    */
+/*    MERCHANTABILITY  AND FITNESS FOR  A PARTICULAR  PURPOSE ARE    */
+/*    DISCLAIMED.  IN  NO EVENT SHALL THE UNIVERSITY  OF TEXAS AT    */
+/*    AUSTIN OR CONTRIBUTORS BE  LIABLE FOR ANY DIRECT, INDIRECT,    */
+/*    INCIDENTAL,  SPECIAL, EXEMPLARY,  OR  CONSEQUENTIAL DAMAGES    */
+/*    (INCLUDING, BUT  NOT LIMITED TO,  PROCUREMENT OF SUBSTITUTE    */
+/*    GOODS  OR  SERVICES; LOSS  OF  USE,  DATA,  OR PROFITS;  OR    */
+/*    BUSINESS INTERRUPTION) HOWEVER CAUSED  AND ON ANY THEORY OF    */
+/*    LIABILITY, WHETHER  IN CONTRACT, STRICT  LIABILITY, OR TORT    */
+/*    (INCLUDING NEGLIGENCE OR OTHERWISE)  ARISING IN ANY WAY OUT    */
+/*    OF  THE  USE OF  THIS  SOFTWARE,  EVEN  IF ADVISED  OF  THE    */
+/*    POSSIBILITY OF SUCH DAMAGE.                                    */
+/*                                                                   */
+/* The views and conclusions contained in the software and           */
+/* documentation are those of the authors and should not be          */
+/* interpreted as representing official policies, either expressed   */
+/* or implied, of The University of Texas at Austin.                 */
+/*********************************************************************/
+
+#define BOOST_TEST_MODULE SharedMemoryRingTests
+#include <boost/test/unit_test.hpp>
+namespace ut = boost::unit_test;
+
+#include <deflect/SharedMemoryRing.h>
+
+#include <cstring>
+
+namespace
+{
+bool neverWait()
+{
+    return false;
+}
+
+typedef deflect::SharedMemoryRing::Record Record;
+}
+
+BOOST_AUTO_TEST_CASE( testReaderAttachesToWriterRing )
+{
+    deflect::SharedMemoryRing writer;
+    BOOST_REQUIRE( writer.create( 1024 ));
+    BOOST_CHECK_EQUAL( writer.getCapacity(), 1024 );
+
+    deflect::SharedMemoryRing reader;
+    BOOST_REQUIRE( reader.attach( writer.getKey( )));
+    BOOST_CHECK_EQUAL( reader.getCapacity(), 1024 );
+
+    Record record;
+    char* data = writer.reserve( 5, record, neverWait );
+    BOOST_REQUIRE( data );
+    std::memcpy( data, "hello", 5 );
+
+    const char* received = reader.getData( record );
+    BOOST_REQUIRE( received );
+    BOOST_CHECK_EQUAL( std::string( received, record.size ), "hello" );
+
+    deflect::SharedMemoryRing invalid;
+    BOOST_CHECK( !invalid.attach( "deflect-unknown-key" ));
+}
+
+BOOST_AUTO_TEST_CASE( testWriterWaitsForReleasedSpace )
+{
+    deflect::SharedMemoryRing writer;
+    BOOST_REQUIRE( writer.create( 100 ));
+    deflect::SharedMemoryRing reader;
+    BOOST_REQUIRE( reader.attach( writer.getKey( )));
+
+    Record first, second, third;
+    BOOST_REQUIRE( writer.reserve( 40, first, neverWait ));
+    BOOST_REQUIRE( writer.reserve( 40, second, neverWait ));
+    BOOST_CHECK_EQUAL( second.position, 40 );
+
+    // Does not fit before the end of the buffer nor in the used space
+    BOOST_CHECK( !writer.reserve( 40, third, neverWait ));
+
+    // Records are contiguous, the third one starts at the beginning
+    reader.release( first );
+    BOOST_REQUIRE( writer.reserve( 40, third, neverWait ));
+    BOOST_CHECK_EQUAL( third.position, 100 );
+    BOOST_CHECK( reader.getData( third ) == reader.getData( first ));
+
+    // Records larger than the capacity are rejected
+    BOOST_CHECK( !writer.reserve( 101, third, [] { return true; } ));
+}
@@ -0,0 +1,221 @@
+/*********************************************************************/
+/* Copyright (c) 2015, EPFL/Blue Brain Project                       */
+/*                     Raphael Dumusc <raphael.dumusc@epfl.ch>       */
+/* All rights reserved.                                              */
+/*                                                                   */
+/* Redistribution and use in source and binary forms, with or        */
+/* without modification, are permitted provided that the following   */
+/* conditions are met:                                               */
+/*                                                                   */
+/*   1. Redistributions of source code must retain the above         */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer.                                                  */
+/*                                                                   */
+/*   2. Redistributions in binary form must reproduce the above      */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer in the documentation and/or other materials       */
+/*      provided with the distribution.                              */
+/*                                                                   */
+/*    THIS  SOFTWARE IS PROVIDED  BY THE  UNIVERSITY OF  TEXAS AT    */
+/*    AUSTIN  ``AS IS''  AND ANY  EXPRESS OR  IMPLIED WARRANTIES,    */
+/*    INCLUDING, BUT  NOT LIMITED  TO, THE IMPLIED  WARRANTIES OF    */
+/*    MERCHANTABILITY  AND FITNESS FOR  A PARTICULAR  PURPOSE ARE    */
+/*    DISCLAIMED.  IN  NO EVENT SHALL THE UNIVERSITY  OF TEXAS AT    */
+/*    AUSTIN OR CONTRIBUTORS BE  LIABLE FOR ANY DIRECT, INDIRECT,    */
+/*    INCIDENTAL,  SPECIAL, EXEMPLARY,  OR  CONSEQUENTIAL DAMAGES    */
+/*    (INCLUDING, BUT  NOT LIMITED TO,  PROCUREMENT OF SUBSTITUTE    */
+/*    GOODS  OR  SERVICES; LOSS  OF  USE,  DATA,  OR PROFITS;  OR    */
+/*    BUSINESS INTERRUPTION) HOWEVER CAUSED  AND ON ANY THEORY OF    */
+/*    LIABILITY, WHETHER  IN CONTRACT, STRICT  LIABILITY, OR TORT    */
+/*    (INCLUDING NEGLIGENCE OR OTHERWISE)  ARISING IN ANY WAY OUT    */
+/*    OF  THE  USE OF  THIS  SOFTWARE,  EVEN  IF ADVISED  OF  THE    */
+/*    POSSIBILITY OF SUCH DAMAGE.                                    */
+/*                                                                   */
+/* The views and conclusions contained in the software and           */
+/* documentation are those of the authors and should not be          */
+/* interpreted as representing official policies, either expressed   */
+/* or implied, of The University of Texas at Austin.                 */
+/*********************************************************************/
+
+#define BOOST_TEST_MODULE DispatcherLatency
+#include <boost/test/unit_test.hpp>
+namespace ut = boost::unit_test;
+
+#include "MinimalGlobalQtApp.h"
+#include <deflect/Frame.h>
+#include <deflect/FrameDispatcher.h>
+#include <deflect/Server.h>
+#include <deflect/Stream.h>
+
+#include <boost/thread/barrier.hpp>
+
+#include <QElapsedTimer>
+#include <QSemaphore>
+#include <QThread>
+#include <QTimer>
+
+#include <algorithm>
+#include <iostream>
+#include <memory>
+
+// Measures the load that the ingest of frames puts on the application's main
+// (GUI) thread, with the FrameDispatcher running in the main thread or in its
+// own thread. The main thread runs a 1 ms timer, similar to a render loop, and
+// the delay with which the timer fires is reported while NSOURCES streamers
+// send raw frames to the same stream. Every frame is delivered, the sources
+// being paced by flow control.
+
+#define NSOURCES     (16u)
+#define SEGMENT_SIZE (512u)
+#define NFRAMES      (100u)
+#define TIMER_INTERVAL_MS (1)
+#define MAX_FRAMES_IN_FLIGHT (2u)
+#define DELIVERY_TIMEOUT_MS (30000)
+
+BOOST_GLOBAL_FIXTURE( MinimalGlobalQtApp );
+
+namespace
+{
+const std::string streamName( "dispatcherLatency" );
+
+class SourceThread : public QThread
+{
+public:
+    SourceThread( const unsigned short port, const unsigned int index,
+                  boost::barrier& barrier, QSemaphore& delivered )
+        : success( true )
+        , _port( port )
+        , _index( index )
+        , _barrier( barrier )
+        , _delivered( delivered )
+    {}
+
+    bool success;
+
+private:
+    void run() final
+    {
+        std::vector< uint8_t > pixels( SEGMENT_SIZE * SEGMENT_SIZE * 4,
+                                       uint8_t( _index ));
+        deflect::ImageWrapper image( pixels.data(), SEGMENT_SIZE,
+                                     SEGMENT_SIZE, deflect::RGBA,
+                                     _index * SEGMENT_SIZE, 0 );
+        image.compressionPolicy = deflect::COMPRESSION_OFF;
+
+        deflect::Stream stream( streamName, "localhost", _port );
+        success = stream.isConnected() &&
+                  stream.setMaxFramesInFlight( MAX_FRAMES_IN_FLIGHT );
+
+        // all sources must be opened before any of them starts sending
+        _barrier.wait();
+
+        for( size_t i = 0; success && i < NFRAMES; ++i )
+            success = stream.send( image ) && stream.finishFrame();
+
+        // closing the stream would discard the frames not yet dispatched
+        if( success )
+            success = _delivered.tryAcquire( 1, DELIVERY_TIMEOUT_MS );
+    }
+
+    const unsigned short _port;
+    const unsigned int _index;
+    boost::barrier& _barrier;
+    QSemaphore& _delivered;
+};
+
+struct Measurement
+{
+    Measurement() : maxDelayMs( 0 ), meanDelayMs( 0 ), frames( 0 ) {}
+
+    qint64 maxDelayMs;
+    double meanDelayMs;
+    size_t frames;
+};
+
+Measurement measureMainThreadLatency( const bool dispatcherThread )
+{
+    deflect::Server server( 0 /* OS-chosen port */ );
+    if( dispatcherThread )
+        server.startDispatcherThread();
+
+    deflect::FrameDispatcher& dispatcher = server.getPixelStreamDispatcher();
+    dispatcher.setDeliveryMode( QString::fromStdString( streamName ),
+                                deflect::DELIVERY_EVERY_FRAME );
+
+    Measurement measurement;
+    QSemaphore delivered;
+    QObject context;
+    QObject::connect( &dispatcher, &deflect::FrameDispatcher::sendFrame,
+                      &context, [&]( deflect::FramePtr frame )
+    {
+        if( ++measurement.frames == NFRAMES )
+            delivered.release( NSOURCES );
+        else
+            dispatcher.requestFrame( frame->uri );
+    });
+
+    QTimer timer;
+    QElapsedTimer elapsed;
+    qint64 totalDelayMs = 0;
+    size_t ticks = 0;
+    QObject::connect( &timer, &QTimer::timeout, [&]
+    {
+        const qint64 delay = elapsed.restart() - TIMER_INTERVAL_MS;
+        measurement.maxDelayMs = std::max( measurement.maxDelayMs, delay );
+        totalDelayMs += std::max( delay, qint64( 0 ));
+        ++ticks;
+    });
+
+    boost::barrier barrier( NSOURCES );
+    std::vector< std::unique_ptr< SourceThread >> sources;
+    size_t finished = 0;
+    for( unsigned int i = 0; i < NSOURCES; ++i )
+    {
+        sources.emplace_back( new SourceThread( server.serverPort(), i,
+                                                barrier, delivered ));
+        QObject::connect( sources.back().get(), &QThread::finished,
+                          &context, [&]
+        {
+            if( ++finished == NSOURCES )
+                QCoreApplication::instance()->quit();
+        });
+    }
+
+    elapsed.start();
+    timer.start( TIMER_INTERVAL_MS );
+    for( auto& source : sources )
+        source->start();
+
+    QCoreApplication::instance()->exec();
+    timer.stop();
+
+    for( auto& source : sources )
+    {
+        BOOST_CHECK( source->wait( ));
+        BOOST_CHECK( source->success );
+    }
+    BOOST_CHECK_EQUAL( measurement.frames, NFRAMES );
+
+    measurement.meanDelayMs = ticks ? double( totalDelayMs ) / ticks : 0.0;
+    return measurement;
+}
+
+void print( const std::string& mode, const Measurement& measurement )
+{
+    std::cout << mode << ": main thread timer delay mean "
+              << measurement.meanDelayMs << " ms, max "
+              << measurement.maxDelayMs << " ms; " << measurement.frames
+              << " frames dispatched from " << NSOURCES << " sources"
+              << std::endl;
+}
+}
+
+BOOST_AUTO_TEST_CASE( testMainThreadLatencyWithDispatcherInMainThread )
+{
+    print( "dispatcher in main thread", measureMainThreadLatency( false ));
+}
+
+BOOST_AUTO_TEST_CASE( testMainThreadLatencyWithDispatcherThread )
+{
+    print( "dispatcher in own thread ", measureMainThreadLatency( true ));
+}
@@ -0,0 +1,123 @@
+/*********************************************************************/
+/* Copyright (c) 2015, EPFL/Blue Brain Project                       */
+/*                     Raphael Dumusc <raphael.dumusc@epfl.ch>       */
+/* All rights reserved.                                              */
+/*                                                                   */
+/* Redistribution and use in source and binary forms, with or        */
+/* without modification, are permitted provided that the following   */
+/* conditions are met:                                               */
+/*                                                                   */
+/*   1. Redistributions of source code must retain the above         */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer.                                                  */
+/*                                                                   */
+/*   2. Redistributions in binary form must reproduce the above      */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer in the documentation and/or other materials       */
+/*      provided with the distribution.                              */
+/*                                                                   */
+/*    THIS  SOFTWARE IS PROVIDED  BY THE  UNIVERSITY OF  TEXAS AT    */
+/*    AUSTIN  ``AS IS''  AND ANY  EXPRESS OR  IMPLIED WARRANTIES,    */
+/*    INCLUDING, BUT  NOT LIMITED  TO, THE IMPLIED  WARRANTIES OF    */
+/*    MERCHANTABILITY  AND FITNESS FOR  A PARTICULAR  PURPOSE ARE    */
+/*    DISCLAIMED.  IN  NO EVENT SHALL THE UNIVERSITY  OF TEXAS AT    */
+/*    AUSTIN OR CONTRIBUTORS BE  LIABLE FOR ANY DIRECT, INDIRECT,    */
+/*    INCIDENTAL,  SPECIAL, EXEMPLARY,  OR  CONSEQUENTIAL DAMAGES    */
+/*    (INCLUDING, BUT  NOT LIMITED TO,  PROCUREMENT OF SUBSTITUTE    */
+/*    GOODS  OR  SERVICES; LOSS  OF  USE,  DATA,  OR PROFITS;  OR    */
+/*    BUSINESS INTERRUPTION) HOWEVER CAUSED  AND ON ANY THEORY OF    */
+/*    LIABILITY, WHETHER  IN CONTRACT, STRICT  LIABILITY, OR TORT    */
+/*    (INCLUDING NEGLIGENCE OR OTHERWISE)  ARISING IN ANY WAY OUT    */
+/*    OF  THE  USE OF  THIS  SOFTWARE,  EVEN  IF ADVISED  OF  THE    */
+/*    POSSIBILITY OF SUCH DAMAGE.                                    */
+/*                                                                   */
+/* The views and conclusions contained in the software and           */
+/* documentation are those of the authors and should not be          */
+/* interpreted as representing official policies, either expressed   */
+/* or implied, of The University of Texas at Austin.                 */
+/*********************************************************************/
+
+#define BOOST_TEST_MODULE EventThroughput
+#include <boost/test/unit_test.hpp>
+namespace ut = boost::unit_test;
+
+#include "ServerFixture.h"
+#include "MinimalGlobalQtApp.h"
+#include <deflect/Stream.h>
+
+#include <QElapsedTimer>
+
+#include <iostream>
+
+// Measures the rate at which the Server delivers events to a Stream, for
+// bursts of touch moves interleaved with presses and releases.
+
+#define NBURSTS (1000u)
+#define MOVES_PER_BURST (100u)
+#define LAST_KEY (42)
+
+BOOST_GLOBAL_FIXTURE( MinimalGlobalQtApp );
+
+BOOST_AUTO_TEST_CASE( testEventThroughput )
+{
+    ServerFixture fixture;
+
+    deflect::Stream stream( "eventThroughput", "localhost",
+                            fixture.server->serverPort( ));
+    BOOST_REQUIRE( stream.isConnected( ));
+    BOOST_REQUIRE( stream.registerForEvents( ));
+    BOOST_REQUIRE( fixture.receiver );
+
+    QElapsedTimer timer;
+    timer.start();
+
+    size_t posted = 0;
+    for( size_t i = 0; i < NBURSTS; ++i )
+    {
+        deflect::Event event;
+        event.type = deflect::Event::EVT_PRESS;
+        event.mouseLeft = true;
+        fixture.postEvent( event );
+        event.type = deflect::Event::EVT_MOVE;
+        for( size_t j = 0; j < MOVES_PER_BURST; ++j )
+        {
+            event.mouseX = double( j ) / MOVES_PER_BURST;
+            event.dx = 1.0 / MOVES_PER_BURST;
+            fixture.postEvent( event );
+        }
+        event.type = deflect::Event::EVT_RELEASE;
+        event.mouseLeft = false;
+        fixture.postEvent( event );
+        posted += MOVES_PER_BURST + 2;
+    }
+    deflect::Event last;
+    last.type = deflect::Event::EVT_KEY_PRESS;
+    last.key = LAST_KEY;
+    fixture.postEvent( last );
+    ++posted;
+
+    size_t received = 0;
+    size_t presses = 0;
+    double distance = 0.0;
+    while( true )
+    {
+        const deflect::Event event = stream.getEvent();
+        ++received;
+        if( event.type == deflect::Event::EVT_PRESS )
+            ++presses;
+        else if( event.type == deflect::Event::EVT_MOVE )
+            distance += event.dx;
+        else if( event.type == deflect::Event::EVT_KEY_PRESS ||
+                 event.type == deflect::Event::EVT_NONE )
+            break;
+    }
+    const double elapsedMs = timer.elapsed();
+
+    // Presses and releases are never dropped, merged moves keep the distance
+    BOOST_CHECK_EQUAL( presses, NBURSTS );
+    BOOST_CHECK_CLOSE( distance, double( NBURSTS ), 1e-3 );
+
+    std::cout << posted / ( elapsedMs / 1000 ) << " events/s posted, "
+              << received << " of " << posted << " events delivered after "
+              << "coalescing" << std::endl;
+}
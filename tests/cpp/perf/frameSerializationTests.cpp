@@ -0,0 +1,166 @@
+/*********************************************************************/
+/* Copyright (c) 2015, EPFL/Blue Brain Project                       */
+/*                     Raphael Dumusc <raphael.dumusc@epfl.ch>       */
+/* All rights reserved.                                              */
+/*                                                                   */
+/* Redistribution and use in source and binary forms, with or        */
+/* without modification, are permitted provided that the following   */
+/* conditions are met:                                               */
+/*                                                                   */
+/*   1. Redistributions of source code must retain the above         */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer.                                                  */
+/*                                                                   */
+/*   2. Redistributions in binary form must reproduce the above      */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer in the documentation and/or other materials       */
+/*      provided with the distribution.                              */
+/*                                                                   */
+/*    THIS  SOFTWARE IS PROVIDED  BY THE  UNIVERSITY OF  TEXAS AT    */
+/*    AUSTIN  ``AS IS''  AND ANY  EXPRESS OR  IMPLIED WARRANTIES,    */
+/*    INCLUDING, BUT  NOT LIMITED  TO, THE IMPLIED  WARRANTIES OF    */
+/*    MERCHANTABILITY  AND FITNESS FOR  A PARTICULAR  PURPOSE ARE    */
+/*    DISCLAIMED.  IN  NO EVENT SHALL THE UNIVERSITY  OF TEXAS AT    */
+/*    AUSTIN OR CONTRIBUTORS BE  LIABLE FOR ANY DIRECT, INDIRECT,    */
+/*    INCIDENTAL,  SPECIAL, EXEMPLARY,  OR  CONSEQUENTIAL DAMAGES    */
+/*    (INCLUDING, BUT  NOT LIMITED TO,  PROCUREMENT OF SUBSTITUTE    */
+/*    GOODS  OR  SERVICES; LOSS  OF  USE,  DATA,  OR PROFITS;  OR    */
+/*    BUSINESS INTERRUPTION) HOWEVER CAUSED  AND ON ANY THEORY OF    */
+/*    LIABILITY, WHETHER  IN CONTRACT, STRICT  LIABILITY, OR TORT    */
+/*    (INCLUDING NEGLIGENCE OR OTHERWISE)  ARISING IN ANY WAY OUT    */
+/*    OF  THE  USE OF  THIS  SOFTWARE,  EVEN  IF ADVISED  OF  THE    */
+/*    POSSIBILITY OF SUCH DAMAGE.                                    */
+/*                                                                   */
+/* The views and conclusions contained in the software and           */
+/* documentation are those of the authors and should not be          */
+/* interpreted as representing official policies, either expressed   */
+/* or implied, of The University of Texas at Austin.                 */
+/*********************************************************************/
+
+#define BOOST_TEST_MODULE FrameSerialization
+#include <boost/test/unit_test.hpp>
+namespace ut = boost::unit_test;
+
+#include <deflect/Frame.h>
+
+#include <boost/archive/binary_iarchive.hpp>
+#include <boost/archive/binary_oarchive.hpp>
+#include <boost/serialization/split_free.hpp>
+#include <boost/serialization/string.hpp>
+
+#include <QElapsedTimer>
+
+#include <iostream>
+#include <sstream>
+
+// Compares the flat binary layout of Frame::serializeFlat() with the boost
+// binary archives, for a raw 4K frame of 32 segments as broadcast by a wall
+// application from its master process to the render processes.
+
+#define WIDTH  (3840u)
+#define HEIGHT (2160u)
+#define COLUMNS (8u)
+#define ROWS    (4u)
+#define NITERATIONS (20u)
+
+namespace boost
+{
+namespace serialization
+{
+template< class Archive >
+void save( Archive& ar, const QString& string, const unsigned int )
+{
+    const std::string data = string.toStdString();
+    ar & data;
+}
+
+template< class Archive >
+void load( Archive& ar, QString& string, const unsigned int )
+{
+    std::string data;
+    ar & data;
+    string = QString::fromStdString( data );
+}
+}
+}
+BOOST_SERIALIZATION_SPLIT_FREE( QString )
+
+namespace
+{
+deflect::Frame createFrame()
+{
+    deflect::Frame frame;
+    frame.uri = "frameSerialization";
+    const unsigned int width = WIDTH / COLUMNS;
+    const unsigned int height = HEIGHT / ROWS;
+    for( unsigned int y = 0; y < ROWS; ++y )
+    {
+        for( unsigned int x = 0; x < COLUMNS; ++x )
+        {
+            deflect::Segment segment;
+            segment.parameters.x = x * width;
+            segment.parameters.y = y * height;
+            segment.parameters.width = width;
+            segment.parameters.height = height;
+            segment.parameters.compressed = false;
+            segment.imageData = QByteArray( width * height * 4, char( x + y ));
+            frame.segments.push_back( segment );
+        }
+    }
+    return frame;
+}
+
+void print( const std::string& mode, const qint64 writeNs,
+            const qint64 readNs, const size_t bytes )
+{
+    std::cout << mode << ": write " << writeNs / 1e6 / NITERATIONS
+              << " ms, read " << readNs / 1e6 / NITERATIONS << " ms, "
+              << bytes << " bytes" << std::endl;
+}
+}
+
+BOOST_AUTO_TEST_CASE( testFlatVersusBoostSerialization )
+{
+    const deflect::Frame frame = createFrame();
+    QElapsedTimer timer;
+
+    qint64 writeNs = 0, readNs = 0;
+    size_t bytes = 0;
+    for( size_t i = 0; i < NITERATIONS; ++i )
+    {
+        std::stringstream stream;
+        timer.start();
+        {
+            boost::archive::binary_oarchive archive( stream );
+            archive << frame;
+        }
+        writeNs += timer.nsecsElapsed();
+        bytes = stream.str().size();
+
+        deflect::Frame received;
+        timer.start();
+        {
+            boost::archive::binary_iarchive archive( stream );
+            archive >> received;
+        }
+        readNs += timer.nsecsElapsed();
+        BOOST_REQUIRE_EQUAL( received.segments.size(), frame.segments.size( ));
+    }
+    print( "boost binary archive", writeNs, readNs, bytes );
+
+    writeNs = readNs = 0;
+    QByteArray buffer;
+    for( size_t i = 0; i < NITERATIONS; ++i )
+    {
+        timer.start();
+        frame.serializeFlat( buffer );
+        writeNs += timer.nsecsElapsed();
+
+        deflect::Frame received;
+        timer.start();
+        BOOST_REQUIRE( received.deserializeFlat( buffer ));
+        readNs += timer.nsecsElapsed();
+        BOOST_REQUIRE_EQUAL( received.segments.size(), frame.segments.size( ));
+    }
+    print( "flat buffer         ", writeNs, readNs, buffer.size( ));
+}
@@ -0,0 +1,174 @@
+/*********************************************************************/
+/* Copyright (c) 2015, EPFL/Blue Brain Project                       */
+/*                     Raphael Dumusc <raphael.dumusc@epfl.ch>       */
+/* All rights reserved.                                              */
+/*                                                                   */
+/* Redistribution and use in source and binary forms, with or        */
+/* without modification, are permitted provided that the following   */
+/* conditions are met:                                               */
+/*                                                                   */
+/*   1. Redistributions of source code must retain the above         */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer.                                                  */
+/*                                                                   */
+/*   2. Redistributions in binary form must reproduce the above      */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer in the documentation and/or other materials       */
+/*      provided with the distribution.                              */
+/*                                                                   */
+/*    THIS  SOFTWARE IS PROVIDED  BY THE  UNIVERSITY OF  TEXAS AT    */
+/*    AUSTIN  ``AS IS''  AND ANY  EXPRESS OR  IMPLIED WARRANTIES,    */
+/*    INCLUDING, BUT  NOT LIMITED  TO, THE IMPLIED  WARRANTIES OF    */
+/*    MERCHANTABILITY  AND FITNESS FOR  A PARTICULAR  PURPOSE ARE    */
+/*    DISCLAIMED.  IN  NO EVENT SHALL THE UNIVERSITY  OF TEXAS AT    */
+/*    AUSTIN OR CONTRIBUTORS BE  LIABLE FOR ANY DIRECT, INDIRECT,    */
+/*    INCIDENTAL,  SPECIAL, EXEMPLARY,  OR  CONSEQUENTIAL DAMAGES    */
+/*    (INCLUDING, BUT  NOT LIMITED TO,  PROCUREMENT OF SUBSTITUTE    */
+/*    GOODS  OR  SERVICES; LOSS  OF  USE,  DATA,  OR PROFITS;  OR    */
+/*    BUSINESS INTERRUPTION) HOWEVER CAUSED  AND ON ANY THEORY OF    */
+/*    LIABILITY, WHETHER  IN CONTRACT, STRICT  LIABILITY, OR TORT    */
+/*    (INCLUDING NEGLIGENCE OR OTHERWISE)  ARISING IN ANY WAY OUT    */
+/*    OF  THE  USE OF  THIS  SOFTWARE,  EVEN  IF ADVISED  OF  THE    */
+/*    POSSIBILITY OF SUCH DAMAGE.                                    */
+/*                                                                   */
+/* The views and conclusions contained in the software and           */
+/* documentation are those of the authors and should not be          */
+/* interpreted as representing official policies, either expressed   */
+/* or implied, of The University of Texas at Austin.                 */
+/*********************************************************************/
+
+#define BOOST_TEST_MODULE LocalTransport
+#include <boost/test/unit_test.hpp>
+namespace ut = boost::unit_test;
+
+#include "MinimalGlobalQtApp.h"
+#include <deflect/Frame.h>
+#include <deflect/FrameDispatcher.h>
+#include <deflect/Server.h>
+#include <deflect/Stream.h>
+
+#include <QElapsedTimer>
+#include <QThread>
+
+#include <atomic>
+#include <iostream>
+
+// Measures the throughput of raw 4K frames streamed to a server on the same
+// host, through the TCP loopback, a Unix domain socket and shared memory.
+
+#define WIDTH  (3840u)
+#define HEIGHT (2160u)
+#define NFRAMES (100u)
+
+BOOST_GLOBAL_FIXTURE( MinimalGlobalQtApp );
+
+namespace
+{
+const std::string streamName( "localTransport" );
+const QString localSocketName( "deflect-localTransport" );
+
+enum Transport
+{
+    TRANSPORT_TCP,
+    TRANSPORT_LOCAL_SOCKET,
+    TRANSPORT_SHARED_MEMORY
+};
+
+class SourceThread : public QThread
+{
+public:
+    SourceThread( const std::string& address, const unsigned short port,
+                  const bool sharedMemory )
+        : usedSharedMemory( false )
+        , elapsedMs( 0 )
+        , _address( address )
+        , _port( port )
+        , _sharedMemory( sharedMemory )
+    {}
+
+    bool usedSharedMemory;
+    double elapsedMs;
+
+private:
+    void run() final
+    {
+        std::vector< uint8_t > pixels( WIDTH * HEIGHT * 4, 0 );
+        deflect::ImageWrapper image( pixels.data(), WIDTH, HEIGHT,
+                                     deflect::RGBA );
+        image.compressionPolicy = deflect::COMPRESSION_OFF;
+
+        deflect::Stream stream( streamName, _address, _port );
+        BOOST_CHECK( stream.isConnected( ));
+        if( !stream.isConnected( ))
+            return;
+        stream.setSharedMemoryEnabled( _sharedMemory );
+
+        // Let the server reply to the shared memory offer
+        BOOST_CHECK( stream.send( image ) && stream.finishFrame( ));
+        QThread::msleep( 100 );
+
+        QElapsedTimer timer;
+        timer.start();
+        for( size_t i = 0; i < NFRAMES; ++i )
+            BOOST_CHECK( stream.send( image ) && stream.finishFrame( ));
+        elapsedMs = timer.elapsed();
+        usedSharedMemory = stream.isUsingSharedMemory();
+    }
+
+    const std::string _address;
+    const unsigned short _port;
+    const bool _sharedMemory;
+};
+
+void measure( const Transport transport )
+{
+    deflect::Server server( 0 /* OS-chosen port */ );
+    server.startDispatcherThread();
+    BOOST_REQUIRE( server.listenLocal( localSocketName ));
+
+    // Consume all the frames, like a display at an unlimited refresh rate
+    deflect::FrameDispatcher& dispatcher = server.getPixelStreamDispatcher();
+    std::atomic< size_t > frames( 0 );
+    dispatcher.connect( &dispatcher, &deflect::FrameDispatcher::sendFrame,
+                        [&]( deflect::FramePtr frame )
+    {
+        ++frames;
+        dispatcher.requestFrame( frame->uri );
+    });
+
+    const bool sharedMemory = transport == TRANSPORT_SHARED_MEMORY;
+    const std::string address = transport == TRANSPORT_LOCAL_SOCKET ?
+                "unix:" + server.getLocalSocketPath().toStdString() :
+                "localhost";
+    SourceThread source( address, server.serverPort(), sharedMemory );
+    QObject::connect( &source, &QThread::finished,
+                      QCoreApplication::instance(), &QCoreApplication::quit );
+    source.start();
+    QCoreApplication::instance()->exec();
+    BOOST_CHECK( source.wait( ));
+    BOOST_CHECK_EQUAL( source.usedSharedMemory, sharedMemory );
+
+    const double bytes = double( WIDTH ) * HEIGHT * 4 * NFRAMES;
+    const char* names[] = { "tcp loopback: ", "unix socket:  ",
+                            "shared memory:" };
+    std::cout << names[transport] << " "
+              << bytes / ( 1024 * 1024 ) / ( source.elapsedMs / 1000 )
+              << " MB/s (" << NFRAMES / ( source.elapsedMs / 1000 )
+              << " FPS), " << frames << " frames dispatched" << std::endl;
+}
+}
+
+BOOST_AUTO_TEST_CASE( testRawThroughputOverTCPLoopback )
+{
+    measure( TRANSPORT_TCP );
+}
+
+BOOST_AUTO_TEST_CASE( testRawThroughputOverUnixSocket )
+{
+    measure( TRANSPORT_LOCAL_SOCKET );
+}
+
+BOOST_AUTO_TEST_CASE( testRawThroughputOverSharedMemory )
+{
+    measure( TRANSPORT_SHARED_MEMORY );
+}
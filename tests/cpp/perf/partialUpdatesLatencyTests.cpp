@@ -0,0 +1,281 @@
+/*********************************************************************/
+/* Copyright (c) 2015, EPFL/Blue Brain Project                       */
+/*                     Raphael Dumusc <raphael.dumusc@epfl.ch>       */
+/* All rights reserved.                                              */
+/*                                                                   */
+/* Redistribution and use in source and binary forms, with or        */
+/* without modification, are permitted provided that the following   */
+/* conditions are met:                                               */
+/*                                                                   */
+/*   1. Redistributions of source code must retain the above         */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer.                                                  */
+/*                                                                   */
+/*   2. Redistributions in binary form must reproduce the above      */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer in the documentation and/or other materials       */
+/*      provided with the distribution.                              */
+/*                                                                   */
+/*    THIS  SOFTWARE IS PROVIDED  BY THE  UNIVERSITY OF  TEXAS AT    */
+/*    AUSTIN  ``AS IS''  AND ANY  EXPRESS OR  IMPLIED WARRANTIES,    */
+/*    INCLUDING, BUT  NOT LIMITED  TO, THE IMPLIED  WARRANTIES OF    */
+/*    MERCHANTABILITY  AND FITNESS FOR  A PARTICULAR  PURPOSE ARE    */
+/*    DISCLAIMED.  IN  NO EVENT SHALL THE UNIVERSITY  OF TEXAS AT    */
+/*    AUSTIN OR CONTRIBUTORS BE  LIABLE FOR ANY DIRECT, INDIRECT,    */
+/*    INCIDENTAL,  SPECIAL, EXEMPLARY,  OR  CONSEQUENTIAL DAMAGES    */
+/*    (INCLUDING, BUT  NOT LIMITED TO,  PROCUREMENT OF SUBSTITUTE    */
+/*    GOODS  OR  SERVICES; LOSS  OF  USE,  DATA,  OR PROFITS;  OR    */
+/*    BUSINESS INTERRUPTION) HOWEVER CAUSED  AND ON ANY THEORY OF    */
+/*    LIABILITY, WHETHER  IN CONTRACT, STRICT  LIABILITY, OR TORT    */
+/*    (INCLUDING NEGLIGENCE OR OTHERWISE)  ARISING IN ANY WAY OUT    */
+/*    OF  THE  USE OF  THIS  SOFTWARE,  EVEN  IF ADVISED  OF  THE    */
+/*    POSSIBILITY OF SUCH DAMAGE.                                    */
+/*                                                                   */
+/* The views and conclusions contained in the software and           */
+/* documentation are those of the authors and should not be          */
+/* interpreted as representing official policies, either expressed   */
+/* or implied, of The University of Texas at Austin.                 */
+/*********************************************************************/
+
+#define BOOST_TEST_MODULE PartialUpdatesLatency
+#include <boost/test/unit_test.hpp>
+namespace ut = boost::unit_test;
+
+#include "MinimalGlobalQtApp.h"
+#include <deflect/Frame.h>
+#include <deflect/FrameDispatcher.h>
+#include <deflect/Server.h>
+#include <deflect/Stream.h>
+
+#include <boost/thread/barrier.hpp>
+
+#include <QThread>
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <mutex>
+
+// Measures the latency with which the updates of the sources of a stream are
+// dispatched, in every-frame and in partial updates mode, when one of the
+// NSOURCES sources renders much slower than the others. The latency of an
+// update is the time between the finishFrame() of its source and the dispatch
+// of the first frame containing it. Each source writes its frame number in the
+// first pixel of its region to identify the updates.
+
+#define NSOURCES      (4u)
+#define SEGMENT_SIZE  (256u)
+#define NFRAMES       (50u)
+#define FAST_FRAME_MS (5)
+#define SLOW_FRAME_MS (40)
+
+BOOST_GLOBAL_FIXTURE( MinimalGlobalQtApp );
+
+namespace
+{
+const std::string streamName( "partialUpdatesLatency" );
+const size_t slowSource = 0;
+
+typedef std::chrono::steady_clock Clock;
+
+/** The time at which each source finished each of its frames */
+struct FinishTimes
+{
+    FinishTimes()
+        : times( NSOURCES, std::vector< Clock::time_point >( NFRAMES ))
+    {}
+
+    void set( const size_t source, const uint32_t frame )
+    {
+        std::lock_guard< std::mutex > lock( mutex );
+        times[source][frame] = Clock::now();
+    }
+
+    Clock::time_point get( const size_t source, const uint32_t frame )
+    {
+        std::lock_guard< std::mutex > lock( mutex );
+        return times[source][frame];
+    }
+
+private:
+    std::mutex mutex;
+    std::vector< std::vector< Clock::time_point >> times;
+};
+
+class SourceThread : public QThread
+{
+public:
+    SourceThread( const unsigned short port, const unsigned int index,
+                  boost::barrier& barrier, FinishTimes& finishTimes )
+        : success( true )
+        , _port( port )
+        , _index( index )
+        , _barrier( barrier )
+        , _finishTimes( finishTimes )
+    {}
+
+    bool success;
+
+private:
+    void run() final
+    {
+        std::vector< uint8_t > pixels( SEGMENT_SIZE * SEGMENT_SIZE * 4, 0 );
+        deflect::ImageWrapper image( pixels.data(), SEGMENT_SIZE,
+                                     SEGMENT_SIZE, deflect::RGBA,
+                                     _index * SEGMENT_SIZE, 0 );
+        image.compressionPolicy = deflect::COMPRESSION_OFF;
+
+        deflect::Stream stream( streamName, "localhost", _port );
+        success = stream.isConnected();
+
+        // all sources must be opened before any of them starts sending
+        _barrier.wait();
+
+        const int frameTimeMs = _index == slowSource ? SLOW_FRAME_MS
+                                                     : FAST_FRAME_MS;
+        for( uint32_t frame = 0; success && frame < NFRAMES; ++frame )
+        {
+            QThread::msleep( frameTimeMs );
+            std::memcpy( pixels.data(), &frame, sizeof( frame ));
+            success = stream.send( image );
+            _finishTimes.set( _index, frame );
+            success = success && stream.finishFrame();
+        }
+
+        // the frames of the fast sources wait for the slow one in every-frame
+        // mode, closing the streams earlier would discard them
+        _barrier.wait();
+    }
+
+    const unsigned short _port;
+    const unsigned int _index;
+    boost::barrier& _barrier;
+    FinishTimes& _finishTimes;
+};
+
+struct Latency
+{
+    Latency() : updates( 0 ), totalMs( 0 ), maxMs( 0 ) {}
+
+    void add( const double ms )
+    {
+        ++updates;
+        totalMs += ms;
+        maxMs = std::max( maxMs, ms );
+    }
+
+    double meanMs() const { return updates ? totalMs / updates : 0.0; }
+
+    size_t updates;
+    double totalMs;
+    double maxMs;
+};
+
+struct Measurement
+{
+    Measurement() : frames( 0 ) {}
+
+    Latency fastSources;
+    Latency slowSource;
+    size_t frames;
+};
+
+Measurement measureLatency( const deflect::DeliveryMode mode )
+{
+    deflect::Server server( 0 /* OS-chosen port */ );
+    server.startDispatcherThread();
+
+    deflect::FrameDispatcher& dispatcher = server.getPixelStreamDispatcher();
+    dispatcher.setDeliveryMode( QString::fromStdString( streamName ), mode );
+
+    FinishTimes finishTimes;
+    Measurement measurement;
+    std::vector< int64_t > lastUpdates( NSOURCES, -1 );
+    QObject context;
+    QObject::connect( &dispatcher, &deflect::FrameDispatcher::sendFrame,
+                      &context, [&]( deflect::FramePtr frame )
+    {
+        const Clock::time_point now = Clock::now();
+        ++measurement.frames;
+        for( const deflect::Segment& segment : frame->segments )
+        {
+            const size_t source = segment.parameters.x / SEGMENT_SIZE;
+            uint32_t update = 0;
+            std::memcpy( &update, segment.imageData.constData(),
+                         sizeof( update ));
+
+            // partial updates reuse the latest segments of the other sources
+            if( source >= NSOURCES || int64_t( update ) <= lastUpdates[source] )
+                continue;
+            lastUpdates[source] = update;
+
+            const double ms = std::chrono::duration< double, std::milli >(
+                        now - finishTimes.get( source, update )).count();
+            if( source == slowSource )
+                measurement.slowSource.add( ms );
+            else
+                measurement.fastSources.add( ms );
+        }
+        dispatcher.requestFrame( frame->uri );
+    });
+
+    boost::barrier barrier( NSOURCES );
+    std::vector< std::unique_ptr< SourceThread >> sources;
+    size_t finished = 0;
+    for( unsigned int i = 0; i < NSOURCES; ++i )
+    {
+        sources.emplace_back( new SourceThread( server.serverPort(), i,
+                                                barrier, finishTimes ));
+        QObject::connect( sources.back().get(), &QThread::finished,
+                          &context, [&]
+        {
+            if( ++finished == NSOURCES )
+                QCoreApplication::instance()->quit();
+        });
+    }
+
+    for( auto& source : sources )
+        source->start();
+
+    QCoreApplication::instance()->exec();
+
+    for( auto& source : sources )
+    {
+        BOOST_CHECK( source->wait( ));
+        BOOST_CHECK( source->success );
+    }
+    return measurement;
+}
+
+void print( const std::string& mode, const Measurement& measurement )
+{
+    std::cout << mode << ": fast sources latency mean "
+              << measurement.fastSources.meanMs() << " ms, max "
+              << measurement.fastSources.maxMs << " ms ("
+              << measurement.fastSources.updates << " updates); slow source "
+              << "latency mean " << measurement.slowSource.meanMs()
+              << " ms, max " << measurement.slowSource.maxMs << " ms ("
+              << measurement.slowSource.updates << " updates); "
+              << measurement.frames << " frames dispatched" << std::endl;
+}
+}
+
+BOOST_AUTO_TEST_CASE( testPartialUpdatesLatency )
+{
+    const Measurement everyFrame =
+            measureLatency( deflect::DELIVERY_EVERY_FRAME );
+    print( "every frame    ", everyFrame );
+
+    const Measurement partial =
+            measureLatency( deflect::DELIVERY_PARTIAL_UPDATES );
+    print( "partial updates", partial );
+
+    BOOST_CHECK( everyFrame.fastSources.updates > 0 );
+    BOOST_CHECK( partial.fastSources.updates > 0 );
+
+    // The fast sources no longer wait for the slow one
+    BOOST_CHECK_LT( partial.fastSources.meanMs(),
+                    everyFrame.fastSources.meanMs( ));
+}
@@ -0,0 +1,158 @@
+/*********************************************************************/
+/* Copyright (c) 2015, EPFL/Blue Brain Project                       */
+/*                     Raphael Dumusc <raphael.dumusc@epfl.ch>       */
+/* All rights reserved.                                              */
+/*                                                                   */
+/* Redistribution and use in source and binary forms, with or        */
+/* without modification, are permitted provided that the following   */
+/* conditions are met:                                               */
+/*                                                                   */
+/*   1. Redistributions of source code must retain the above         */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer.                                                  */
+/*                                                                   */
+/*   2. Redistributions in binary form must reproduce the above      */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer in the documentation and/or other materials       */
+/*      provided with the distribution.                              */
+/*                                                                   */
+/*    THIS  SOFTWARE IS PROVIDED  BY THE  UNIVERSITY OF  TEXAS AT    */
+/*    AUSTIN  ``AS IS''  AND ANY  EXPRESS OR  IMPLIED WARRANTIES,    */
+/*    INCLUDING, BUT  NOT LIMITED  TO, THE IMPLIED  WARRANTIES OF    */
+/*    MERCHANTABILITY  AND FITNESS FOR  A PARTICULAR  PURPOSE ARE    */
+/*    DISCLAIMED.  IN  NO EVENT SHALL THE UNIVERSITY  OF TEXAS AT    */
+/*    AUSTIN OR CONTRIBUTORS BE  LIABLE FOR ANY DIRECT, INDIRECT,    */
+/*    INCIDENTAL,  SPECIAL, EXEMPLARY,  OR  CONSEQUENTIAL DAMAGES    */
+/*    (INCLUDING, BUT  NOT LIMITED TO,  PROCUREMENT OF SUBSTITUTE    */
+/*    GOODS  OR  SERVICES; LOSS  OF  USE,  DATA,  OR PROFITS;  OR    */
+/*    BUSINESS INTERRUPTION) HOWEVER CAUSED  AND ON ANY THEORY OF    */
+/*    LIABILITY, WHETHER  IN CONTRACT, STRICT  LIABILITY, OR TORT    */
+/*    (INCLUDING NEGLIGENCE OR OTHERWISE)  ARISING IN ANY WAY OUT    */
+/*    OF  THE  USE OF  THIS  SOFTWARE,  EVEN  IF ADVISED  OF  THE    */
+/*    POSSIBILITY OF SUCH DAMAGE.                                    */
+/*                                                                   */
+/* The views and conclusions contained in the software and           */
+/* documentation are those of the authors and should not be          */
+/* interpreted as representing official policies, either expressed   */
+/* or implied, of The University of Texas at Austin.                 */
+/*********************************************************************/
+
+#define BOOST_TEST_MODULE ReceiveEngine
+#include <boost/test/unit_test.hpp>
+namespace ut = boost::unit_test;
+
+#include "MinimalGlobalQtApp.h"
+#include <deflect/Frame.h>
+#include <deflect/FrameDispatcher.h>
+#include <deflect/Server.h>
+#include <deflect/Stream.h>
+
+#include <QElapsedTimer>
+#include <QThread>
+
+#include <atomic>
+#include <iostream>
+#include <memory>
+
+// Compares the time needed by the Server to receive small raw frames from
+// many simultaneous streams, with one thread per connection and with the
+// io_uring receiver.
+
+#define NSTREAMS (128u)
+#define WIDTH  (64u)
+#define HEIGHT (64u)
+#define NFRAMES (200u)
+
+BOOST_GLOBAL_FIXTURE( MinimalGlobalQtApp );
+
+namespace
+{
+class SourceThread : public QThread
+{
+public:
+    SourceThread( const std::string& name, const unsigned short port )
+        : _name( name )
+        , _port( port )
+    {}
+
+private:
+    void run() final
+    {
+        std::vector< uint8_t > pixels( WIDTH * HEIGHT * 4, 0 );
+        deflect::ImageWrapper image( pixels.data(), WIDTH, HEIGHT,
+                                     deflect::RGBA );
+        image.compressionPolicy = deflect::COMPRESSION_OFF;
+
+        deflect::Stream stream( _name, "localhost", _port );
+        BOOST_CHECK( stream.isConnected( ));
+        if( !stream.isConnected( ))
+            return;
+        stream.setSharedMemoryEnabled( false );
+
+        for( size_t i = 0; i < NFRAMES; ++i )
+            BOOST_CHECK( stream.send( image ) && stream.finishFrame( ));
+    }
+
+    const std::string _name;
+    const unsigned short _port;
+};
+
+void measure( const bool ioUring )
+{
+    deflect::Server server( 0 /* OS-chosen port */ );
+    if( ioUring && !server.setIoUringEnabled( true ))
+    {
+        std::cout << "io_uring receiver not available" << std::endl;
+        return;
+    }
+    server.startDispatcherThread();
+
+    deflect::FrameDispatcher& dispatcher = server.getPixelStreamDispatcher();
+    std::atomic< size_t > frames( 0 );
+    dispatcher.connect( &dispatcher, &deflect::FrameDispatcher::sendFrame,
+                        [&]( deflect::FramePtr frame )
+    {
+        ++frames;
+        dispatcher.requestFrame( frame->uri );
+    });
+
+    std::vector< std::unique_ptr< SourceThread >> sources;
+    std::atomic< size_t > finished( 0 );
+    for( size_t i = 0; i < NSTREAMS; ++i )
+    {
+        const std::string name = "stream" + std::to_string( i );
+        sources.emplace_back( new SourceThread( name, server.serverPort( )));
+        QObject::connect( sources.back().get(), &QThread::finished,
+                          QCoreApplication::instance(), [&]
+        {
+            if( ++finished == NSTREAMS )
+                QCoreApplication::instance()->quit();
+        });
+    }
+
+    QElapsedTimer timer;
+    timer.start();
+    for( auto& source : sources )
+        source->start();
+    QCoreApplication::instance()->exec();
+    for( auto& source : sources )
+        BOOST_CHECK( source->wait( ));
+    const double elapsedMs = timer.elapsed();
+
+    const double messages = double( NSTREAMS ) * NFRAMES * 2;
+    std::cout << ( ioUring ? "io_uring:          " : "thread per stream: " )
+              << NSTREAMS << " streams, "
+              << messages / ( elapsedMs / 1000 ) << " messages/s, "
+              << frames << " frames dispatched" << std::endl;
+}
+}
+
+BOOST_AUTO_TEST_CASE( testReceiveWithThreadPerConnection )
+{
+    measure( false );
+}
+
+BOOST_AUTO_TEST_CASE( testReceiveWithIoUring )
+{
+    measure( true );
+}
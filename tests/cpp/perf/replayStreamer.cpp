@@ -0,0 +1,457 @@
+/*********************************************************************/
+/* Copyright (c) 2015, EPFL/Blue Brain Project                       */
+/*                     Raphael Dumusc <raphael.dumusc@epfl.ch>       */
+/* All rights reserved.                                              */
+/*                                                                   */
+/* Redistribution and use in source and binary forms, with or        */
+/* without modification, are permitted provided that the following   */
+/* conditions are met:                                               */
+/*                                                                   */
+/*   1. Redistributions of source code must retain the above         */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer.                                                  */
+/*                                                                   */
+/*   2. Redistributions in binary form must reproduce the above      */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer in the documentation and/or other materials       */
+/*      provided with the distribution.                              */
+/*                                                                   */
+/*    THIS  SOFTWARE IS PROVIDED  BY THE  UNIVERSITY OF  TEXAS AT    */
+/*    AUSTIN  ``AS IS''  AND ANY  EXPRESS OR  IMPLIED WARRANTIES,    */
+/*    INCLUDING, BUT  NOT LIMITED  TO, THE IMPLIED  WARRANTIES OF    */
+/*    MERCHANTABILITY  AND FITNESS FOR  A PARTICULAR  PURPOSE ARE    */
+/*    DISCLAIMED.  IN  NO EVENT SHALL THE UNIVERSITY  OF TEXAS AT    */
+/*    AUSTIN OR CONTRIBUTORS BE  LIABLE FOR ANY DIRECT, INDIRECT,    */
+/*    INCIDENTAL,  SPECIAL, EXEMPLARY,  OR  CONSEQUENTIAL DAMAGES    */
+/*    (INCLUDING, BUT  NOT LIMITED TO,  PROCUREMENT OF SUBSTITUTE    */
+/*    GOODS  OR  SERVICES; LOSS  OF  USE,  DATA,  OR PROFITS;  OR    */
+/*    BUSINESS INTERRUPTION) HOWEVER CAUSED  AND ON ANY THEORY OF    */
+/*    LIABILITY, WHETHER  IN CONTRACT, STRICT  LIABILITY, OR TORT    */
+/*    (INCLUDING NEGLIGENCE OR OTHERWISE)  ARISING IN ANY WAY OUT    */
+/*    OF  THE  USE OF  THIS  SOFTWARE,  EVEN  IF ADVISED  OF  THE    */
+/*    POSSIBILITY OF SUCH DAMAGE.                                    */
+/*                                                                   */
+/* The views and conclusions contained in the software and           */
+/* documentation are those of the authors and should not be          */
+/* interpreted as representing official policies, either expressed   */
+/* or implied, of The University of Texas at Austin.                 */
+/*********************************************************************/
+
+#include <deflect/Frame.h>
+#include <deflect/FrameRecordReader.h>
+#include <deflect/ImageSegmenter.h>
+#include <deflect/ImageWrapper.h>
+#include <deflect/Segment.h>
+#include <deflect/Stream.h>
+#include <deflect/StreamPrivate.h>
+
+#include <QImage>
+#include <QMutex>
+#include <QMutexLocker>
+
+#include <boost/bind.hpp>
+#include <boost/program_options.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#define MEGABIT 1000000
+#define SEGMENT_SIZE 512
+
+// Load generator which replays recorded frames (see FrameRecorder), or
+// precomputed jpeg segments of a noise image, through one or many Streams.
+
+namespace
+{
+typedef std::chrono::steady_clock Clock;
+
+struct ReplayOptions
+{
+    ReplayOptions( int& argc, char** argv )
+        : desc( "Allowed options" )
+        , getHelp( true )
+        , streams( 0 )
+        , sources( 0 )
+        , framerate( 0 )
+        , originalSpeed( false )
+        , duration( 0 )
+        , maxFramesInFlight( 0 )
+        , width( 0 )
+        , height( 0 )
+        , quality( 0 )
+    {
+        initDesc();
+        parseCommandLineArguments( argc, argv );
+    }
+
+    void showSyntax() const
+    {
+        std::cout << desc;
+    }
+
+    void initDesc()
+    {
+        using namespace boost::program_options;
+        desc.add_options()
+            ("help", "produce help message")
+            ("recording", value<std::string>(),
+                     "file written by a FrameRecorder to replay (default: "
+                     "precomputed jpeg segments of a noise image)")
+            ("name", value<std::string>()->default_value( "ReplayStreamer" ),
+                     "identifier for the stream, suffixed by its index if "
+                     "there are several streams")
+            ("hostname", value<std::string>()->default_value( "localhost" ),
+                     "DisplayCluster host name")
+            ("streams", value<unsigned int>()->default_value( 1 ),
+                     "number of streams (windows)")
+            ("sources", value<unsigned int>()->default_value( 1 ),
+                     "number of sources per stream, which send the segments "
+                     "of each frame in turns")
+            ("framerate", value<unsigned int>()->default_value( 0 ),
+                     "framerate at which to send frames (default: unlimited)")
+            ("original-speed", "reproduce the timing of the recording")
+            ("duration", value<float>()->default_value( 0 ),
+                     "duration in seconds, looping over the frames (default: "
+                     "one pass through the recording, 10s for precomputed "
+                     "segments)")
+            ("max-frames-in-flight", value<unsigned int>()->default_value( 0 ),
+                     "limit the frames not yet consumed by the server "
+                     "(default: unlimited)")
+            ("width", value<unsigned int>()->default_value( 1920 ),
+                     "width of the precomputed image in pixels")
+            ("height", value<unsigned int>()->default_value( 1080 ),
+                     "height of the precomputed image in pixels")
+            ("quality", value<unsigned int>()->default_value( 80 ),
+                     "quality of the precomputed jpeg segments")
+        ;
+    }
+
+    void parseCommandLineArguments( int& argc, char** argv )
+    {
+        if( argc <= 1 )
+            return;
+
+        boost::program_options::variables_map vm;
+        try
+        {
+            using namespace boost::program_options;
+            store( parse_command_line( argc, argv, desc ), vm );
+            notify( vm );
+        }
+        catch( const std::exception& e )
+        {
+            std::cerr << e.what() << std::endl;
+            return;
+        }
+
+        getHelp = vm.count("help");
+        if( vm.count("recording"))
+            recording = vm["recording"].as<std::string>();
+        name = vm["name"].as<std::string>();
+        hostname = vm["hostname"].as<std::string>();
+        streams = std::max( 1u, vm["streams"].as<unsigned int>( ));
+        sources = std::max( 1u, vm["sources"].as<unsigned int>( ));
+        framerate = vm["framerate"].as<unsigned int>();
+        originalSpeed = vm.count("original-speed");
+        duration = vm["duration"].as<float>();
+        maxFramesInFlight = vm["max-frames-in-flight"].as<unsigned int>();
+        width = vm["width"].as<unsigned int>();
+        height = vm["height"].as<unsigned int>();
+        quality = vm["quality"].as<unsigned int>();
+    }
+
+    boost::program_options::options_description desc;
+
+    bool getHelp;
+    std::string recording;
+    std::string name;
+    std::string hostname;
+    unsigned int streams;
+    unsigned int sources;
+    unsigned int framerate;
+    bool originalSpeed;
+    float duration;
+    unsigned int maxFramesInFlight;
+    unsigned int width, height;
+    unsigned int quality;
+};
+
+bool append( deflect::Segments& segments, const deflect::Segment& segment )
+{
+    static QMutex lock;
+    QMutexLocker locker( &lock );
+    segments.push_back( segment );
+    return true;
+}
+
+/** Statistics of one Stream connection. */
+struct SourceStats
+{
+    SourceStats()
+        : frames( 0 ), bytes( 0 ), maxScheduleLag( 0 ), totalScheduleLag( 0 )
+        , maxFinishTime( 0 ), totalFinishTime( 0 ), connected( true )
+    {}
+
+    size_t frames;
+    size_t bytes;
+    Clock::duration maxScheduleLag;
+    Clock::duration totalScheduleLag;
+    Clock::duration maxFinishTime;
+    Clock::duration totalFinishTime;
+    bool connected;
+};
+
+float toMs( const Clock::duration& duration )
+{
+    return std::chrono::duration< float, std::milli >( duration ).count();
+}
+}
+
+/**
+ * Replay frames through many streams and sources.
+ *
+ * Named Application to send the segments as they are with the internal API of
+ * the Stream, like the benchmarkStreamer does.
+ */
+class Application
+{
+public:
+    explicit Application( const ReplayOptions& options )
+        : _options( options )
+        , _period( 0 )
+    {}
+
+    /** Load the frames to replay. */
+    bool load()
+    {
+        if( _options.recording.empty( ))
+            return precompute();
+
+        if( !_reader.open( QString::fromStdString( _options.recording )))
+        {
+            std::cerr << "Could not open recording " << _options.recording
+                      << std::endl;
+            return false;
+        }
+
+        quint64 timestamp = 0;
+        while( deflect::FramePtr frame = _reader.readFrame( timestamp ))
+        {
+            _frames.push_back( frame );
+            _timestamps.push_back( Clock::duration(
+                                     std::chrono::microseconds( timestamp )));
+        }
+        if( _frames.empty( ))
+        {
+            std::cerr << "No complete frame in " << _options.recording
+                      << std::endl;
+            return false;
+        }
+
+        // Loop with the average interval between the last and first frames
+        const Clock::duration span = _timestamps.back() - _timestamps.front();
+        if( _frames.size() > 1 )
+            _period = span + span / ( _frames.size() - 1 );
+        return true;
+    }
+
+    /** Replay the frames from all the sources, return false on failure. */
+    bool run()
+    {
+        const float defaultDuration = _options.recording.empty() ? 10.f : 0.f;
+        const float duration = _options.duration > 0 ? _options.duration
+                                                     : defaultDuration;
+        _start = Clock::now();
+        _end = _start + std::chrono::duration_cast< Clock::duration >(
+                            std::chrono::duration< float >( duration ));
+
+        const size_t count = _options.streams * _options.sources;
+        _stats.resize( count );
+        std::vector< std::thread > threads;
+        for( size_t i = 0; i < count; ++i )
+            threads.emplace_back( &Application::_replay, this, i );
+        for( std::thread& thread : threads )
+            thread.join();
+
+        _report( Clock::now() - _start );
+        return std::all_of( _stats.begin(), _stats.end(),
+                            []( const SourceStats& stats )
+                            { return stats.connected; });
+    }
+
+private:
+    const ReplayOptions& _options;
+    deflect::FrameRecordReader _reader;
+    std::vector< deflect::FramePtr > _frames;
+    std::vector< Clock::duration > _timestamps;
+    Clock::duration _period;
+    Clock::time_point _start;
+    Clock::time_point _end;
+    std::vector< SourceStats > _stats;
+
+    bool precompute()
+    {
+        QImage image( _options.width, _options.height, QImage::Format_RGB32 );
+        uchar* data = image.bits();
+        for( int i = 0; i < image.byteCount(); ++i )
+            data[i] = rand();
+
+        deflect::ImageWrapper deflectImage( (const void*)image.bits(),
+                                            image.width(), image.height(),
+                                            deflect::RGBA );
+        deflectImage.compressionPolicy = deflect::COMPRESSION_ON;
+        deflectImage.compressionQuality = _options.quality;
+
+        deflect::FramePtr frame( new deflect::Frame );
+        deflect::ImageSegmenter segmenter;
+        segmenter.setNominalSegmentDimensions( SEGMENT_SIZE, SEGMENT_SIZE );
+        if( !segmenter.generate( deflectImage, boost::bind(
+                                     &append, boost::ref( frame->segments ),
+                                     _1 )))
+        {
+            return false;
+        }
+
+        _frames.push_back( frame );
+        _timestamps.push_back( Clock::duration( 0 ));
+        return true;
+    }
+
+    Clock::time_point _getScheduledTime( const size_t pass,
+                                         const size_t index,
+                                         const size_t count ) const
+    {
+        if( _options.framerate )
+            return _start + std::chrono::duration_cast< Clock::duration >(
+                       std::chrono::duration< double >(
+                           double( count ) / _options.framerate ));
+        if( _options.originalSpeed )
+            return _start + _period * pass +
+                   ( _timestamps[index] - _timestamps.front( ));
+        return Clock::now();
+    }
+
+    void _replay( const size_t index )
+    {
+        const size_t streamIndex = index / _options.sources;
+        const size_t sourceIndex = index % _options.sources;
+        const std::string name = _options.streams == 1 ? _options.name :
+                                 _options.name + std::to_string( streamIndex );
+        SourceStats& stats = _stats[index];
+
+        deflect::Stream stream( name, _options.hostname );
+        if( !stream.isConnected() || ( _options.maxFramesInFlight &&
+                !stream.setMaxFramesInFlight( _options.maxFramesInFlight )))
+        {
+            std::cerr << "Could not connect stream " << name << std::endl;
+            stats.connected = false;
+            return;
+        }
+
+        // Without duration, the frames are sent once
+        const bool onePass = _end == _start;
+        size_t count = 0;
+        for( size_t pass = 0; !onePass || pass == 0; ++pass )
+        {
+            for( size_t i = 0; i < _frames.size(); ++i, ++count )
+            {
+                if( !onePass && count > 0 && Clock::now() >= _end )
+                    return;
+
+                const Clock::time_point scheduled =
+                    _getScheduledTime( pass, i, count );
+                std::this_thread::sleep_until( scheduled );
+
+                // The sources of a stream send the segments in turns
+                const deflect::Segments& segments = _frames[i]->segments;
+                for( size_t j = sourceIndex; j < segments.size();
+                     j += _options.sources )
+                {
+                    if( !stream._impl->sendPixelStreamSegment( segments[j] ))
+                    {
+                        stats.connected = false;
+                        return;
+                    }
+                    stats.bytes += segments[j].imageData.size();
+                }
+
+                const Clock::time_point finish = Clock::now();
+                if( !stream.finishFrame( ))
+                {
+                    stats.connected = false;
+                    return;
+                }
+                const Clock::time_point done = Clock::now();
+
+                ++stats.frames;
+                stats.totalFinishTime += done - finish;
+                stats.maxFinishTime = std::max( stats.maxFinishTime,
+                                                done - finish );
+                const Clock::duration lag = done - scheduled;
+                stats.totalScheduleLag += lag;
+                stats.maxScheduleLag = std::max( stats.maxScheduleLag, lag );
+            }
+        }
+    }
+
+    void _report( const Clock::duration& elapsed ) const
+    {
+        SourceStats total;
+        for( const SourceStats& stats : _stats )
+        {
+            total.frames += stats.frames;
+            total.bytes += stats.bytes;
+            total.totalScheduleLag += stats.totalScheduleLag;
+            total.maxScheduleLag = std::max( total.maxScheduleLag,
+                                             stats.maxScheduleLag );
+            total.totalFinishTime += stats.totalFinishTime;
+            total.maxFinishTime = std::max( total.maxFinishTime,
+                                            stats.maxFinishTime );
+        }
+
+        const float seconds = std::chrono::duration< float >( elapsed ).count();
+        const size_t frames = std::max( total.frames, size_t( 1 ));
+
+        std::cout << "Frames per recording pass: " << _frames.size()
+                  << std::endl;
+        std::cout << "Streams x sources:         " << _options.streams << " x "
+                  << _options.sources << std::endl;
+        std::cout << "Time [s]:                  " << seconds << std::endl;
+        std::cout << "Frames per stream [FPS]:   "
+                  << total.frames / float( _stats.size( )) / seconds
+                  << std::endl;
+        std::cout << "Throughput [Mbit/s]:       "
+                  << total.bytes * 8.f / MEGABIT / seconds << std::endl;
+        std::cout << "Lag behind schedule [ms]:  avg "
+                  << toMs( total.totalScheduleLag ) / frames << ", max "
+                  << toMs( total.maxScheduleLag ) << std::endl;
+        // finishFrame() waits for the server once too many frames are in
+        // flight, which measures how far the server lags behind the sources
+        std::cout << "Server lag [ms]:           avg "
+                  << toMs( total.totalFinishTime ) / frames
+                  << ", max " << toMs( total.maxFinishTime ) << std::endl;
+    }
+};
+
+int main( int argc, char** argv )
+{
+    const ReplayOptions options( argc, argv );
+
+    if( options.getHelp )
+    {
+        options.showSyntax();
+        return 0;
+    }
+
+    Application replayStreamer( options );
+    if( !replayStreamer.load( ))
+        return 1;
+
+    return replayStreamer.run() ? 0 : 1;
+}
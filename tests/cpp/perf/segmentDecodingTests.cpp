@@ -0,0 +1,131 @@
+/*********************************************************************/
+/* Copyright (c) 2015, EPFL/Blue Brain Project                       */
+/*                     Raphael Dumusc <raphael.dumusc@epfl.ch>       */
+/* All rights reserved.                                              */
+/*                                                                   */
+/* Redistribution and use in source and binary forms, with or        */
+/* without modification, are permitted provided that the following   */
+/* conditions are met:                                               */
+/*                                                                   */
+/*   1. Redistributions of source code must retain the above         */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer.                                                  */
+/*                                                                   */
+/*   2. Redistributions in binary form must reproduce the above      */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer in the documentation and/or other materials       */
+/*      provided with the distribution.                              */
+/*                                                                   */
+/*    THIS  SOFTWARE IS PROVIDED  BY THE  UNIVERSITY OF  TEXAS AT    */
+/*    AUSTIN  ``AS IS''  AND ANY  EXPRESS OR  IMPLIED WARRANTIES,    */
+/*    INCLUDING, BUT  NOT LIMITED  TO, THE IMPLIED  WARRANTIES OF    */
+/*    MERCHANTABILITY  AND FITNESS FOR  A PARTICULAR  PURPOSE ARE    */
+/*    DISCLAIMED.  IN  NO EVENT SHALL THE UNIVERSITY  OF TEXAS AT    */
+/*    AUSTIN OR CONTRIBUTORS BE  LIABLE FOR ANY DIRECT, INDIRECT,    */
+/*    INCIDENTAL,  SPECIAL, EXEMPLARY,  OR  CONSEQUENTIAL DAMAGES    */
+/*    (INCLUDING, BUT  NOT LIMITED TO,  PROCUREMENT OF SUBSTITUTE    */
+/*    GOODS  OR  SERVICES; LOSS  OF  USE,  DATA,  OR PROFITS;  OR    */
+/*    BUSINESS INTERRUPTION) HOWEVER CAUSED  AND ON ANY THEORY OF    */
+/*    LIABILITY, WHETHER  IN CONTRACT, STRICT  LIABILITY, OR TORT    */
+/*    (INCLUDING NEGLIGENCE OR OTHERWISE)  ARISING IN ANY WAY OUT    */
+/*    OF  THE  USE OF  THIS  SOFTWARE,  EVEN  IF ADVISED  OF  THE    */
+/*    POSSIBILITY OF SUCH DAMAGE.                                    */
+/*                                                                   */
+/* The views and conclusions contained in the software and           */
+/* documentation are those of the authors and should not be          */
+/* interpreted as representing official policies, either expressed   */
+/* or implied, of The University of Texas at Austin.                 */
+/*********************************************************************/
+
+#define BOOST_TEST_MODULE SegmentDecoding
+#include <boost/test/unit_test.hpp>
+namespace ut = boost::unit_test;
+
+#include <deflect/Frame.h>
+#include <deflect/ImageSegmenter.h>
+#include <deflect/ImageWrapper.h>
+#include <deflect/SegmentDecoder.h>
+
+#include <QElapsedTimer>
+#include <QMutex>
+
+#include <cstdlib>
+#include <iostream>
+
+// Compares the decoding of a compressed 4K frame to RGBA with its decoding to
+// planar YUV, for 4:4:4 and 4:2:0 chroma subsampling. Reports the decoding
+// time and the amount of data which would be uploaded to the GPU per frame.
+
+#define WIDTH  (3840u)
+#define HEIGHT (2160u)
+#define NFRAMES (20u)
+
+namespace
+{
+deflect::Frame compressFrame( std::vector<char>& pixels,
+                              const deflect::ChromaSubsampling subsampling )
+{
+    deflect::ImageWrapper image( pixels.data(), WIDTH, HEIGHT, deflect::RGBA );
+    image.compressionPolicy = deflect::COMPRESSION_ON;
+    image.subsampling = subsampling;
+
+    deflect::Frame frame;
+    QMutex mutex;
+    deflect::ImageSegmenter segmenter;
+    segmenter.generate( image, [&]( const deflect::Segment& segment )
+    {
+        QMutexLocker locker( &mutex );
+        frame.segments.push_back( segment );
+        return true;
+    });
+    return frame;
+}
+
+void measure( const std::string& mode, const deflect::Frame& compressed,
+              const bool toYUV )
+{
+    deflect::SegmentDecoder decoder;
+    qint64 totalMs = 0;
+    size_t bytes = 0;
+    for( size_t i = 0; i < NFRAMES; ++i )
+    {
+        deflect::Frame frame = compressed;
+        QElapsedTimer timer;
+        timer.start();
+        if( toYUV )
+            decoder.decodeFrameToYUV( frame ).waitForFinished();
+        else
+            decoder.decodeFrame( frame ).waitForFinished();
+        totalMs += timer.elapsed();
+
+        bytes = 0;
+        for( const auto& segment : frame.segments )
+        {
+            BOOST_REQUIRE( !segment.parameters.compressed );
+            bytes += segment.imageData.size();
+        }
+    }
+    std::cout << mode << ": " << double( totalMs ) / NFRAMES
+              << " ms/frame, " << bytes / ( 1024 * 1024 ) << " MB/frame"
+              << std::endl;
+}
+}
+
+BOOST_AUTO_TEST_CASE( testDecodingToRGBAandYUV )
+{
+    std::srand( 0 );
+    std::vector<char> pixels( WIDTH * HEIGHT * 4 );
+    // smooth content with some noise, closer to real content than random data
+    for( size_t i = 0; i < pixels.size(); ++i )
+        pixels[i] = char( ( i / 4 ) % WIDTH / 16 + std::rand() % 16 );
+
+    const deflect::Frame frame444 =
+            compressFrame( pixels, deflect::SUBSAMPLING_444 );
+    const deflect::Frame frame420 =
+            compressFrame( pixels, deflect::SUBSAMPLING_420 );
+
+    measure( "4:4:4 to RGBA", frame444, false );
+    measure( "4:4:4 to YUV ", frame444, true );
+    measure( "4:2:0 to RGBA", frame420, false );
+    measure( "4:2:0 to YUV ", frame420, true );
+}
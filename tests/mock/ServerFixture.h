@@ -0,0 +1,139 @@
+/*********************************************************************/
+/* Copyright (c) 2015, EPFL/Blue Brain Project                       */
+/*                     Raphael Dumusc <raphael.dumusc@epfl.ch>       */
+/* All rights reserved.                                              */
+/*                                                                   */
+/* Redistribution and use in source and binary forms, with or        */
+/* without modification, are permitted provided that the following   */
+/* conditions are met:                                               */
+/*                                                                   */
+/*   1. Redistributions of source code must retain the above         */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer.                                                  */
+/*                                                                   */
+/*   2. Redistributions in binary form must reproduce the above      */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer in the documentation and/or other materials       */
+/*      provided with the distribution.                              */
+/*                                                                   */
+/*    THIS  SOFTWARE IS PROVIDED  BY THE  UNIVERSITY OF  TEXAS AT    */
+/*    AUSTIN  ``AS IS''  AND ANY  EXPRESS OR  IMPLIED WARRANTIES,    */
+/*    INCLUDING, BUT  NOT LIMITED  TO, THE IMPLIED  WARRANTIES OF    */
+/*    MERCHANTABILITY  AND FITNESS FOR  A PARTICULAR  PURPOSE ARE    */
+/*    DISCLAIMED.  IN  NO EVENT SHALL THE UNIVERSITY  OF TEXAS AT    */
+/*    AUSTIN OR CONTRIBUTORS BE  LIABLE FOR ANY DIRECT, INDIRECT,    */
+/*    INCIDENTAL,  SPECIAL, EXEMPLARY,  OR  CONSEQUENTIAL DAMAGES    */
+/*    (INCLUDING, BUT  NOT LIMITED TO,  PROCUREMENT OF SUBSTITUTE    */
+/*    GOODS  OR  SERVICES; LOSS  OF  USE,  DATA,  OR PROFITS;  OR    */
+/*    BUSINESS INTERRUPTION) HOWEVER CAUSED  AND ON ANY THEORY OF    */
+/*    LIABILITY, WHETHER  IN CONTRACT, STRICT  LIABILITY, OR TORT    */
+/*    (INCLUDING NEGLIGENCE OR OTHERWISE)  ARISING IN ANY WAY OUT    */
+/*    OF  THE  USE OF  THIS  SOFTWARE,  EVEN  IF ADVISED  OF  THE    */
+/*    POSSIBILITY OF SUCH DAMAGE.                                    */
+/*                                                                   */
+/* The views and conclusions contained in the software and           */
+/* documentation are those of the authors and should not be          */
+/* interpreted as representing official policies, either expressed   */
+/* or implied, of The University of Texas at Austin.                 */
+/*********************************************************************/
+
+#ifndef DEFLECT_SERVERFIXTURE_H
+#define DEFLECT_SERVERFIXTURE_H
+
+#include <deflect/Event.h>
+#include <deflect/EventReceiver.h>
+#include <deflect/Server.h>
+
+#include <QSemaphore>
+#include <QThread>
+#include <QTimer>
+
+#include <boost/noncopyable.hpp>
+
+#include <atomic>
+#include <functional>
+
+/**
+ * A Server running in its own thread, with its dispatcher thread started,
+ * which accepts the event registrations of the Streams and keeps the
+ * EventReceiver of the last one.
+ */
+struct ServerFixture : public boost::noncopyable
+{
+    typedef std::function< void( deflect::Server& ) > SetupFunc;
+
+    /**
+     * @param setup Called before the Server is moved to its thread, for the
+     *        functions which must be called from the thread of the Server.
+     */
+    explicit ServerFixture( const SetupFunc& setup = SetupFunc( ))
+        : server( new deflect::Server( 0 /* OS-chosen port */ ))
+        , receiver( nullptr )
+        , _receiverBlocked( false )
+    {
+        if( setup )
+            setup( *server );
+        server->startDispatcherThread();
+        server->connect( server, &deflect::Server::registerToEvents,
+                         [this]( QString uri, bool,
+                                 deflect::EventReceiver* evtRcvr )
+        {
+            receiver = evtRcvr;
+            server->onEventRegistrationReply( uri, true );
+        });
+        server->moveToThread( &serverThread );
+        serverThread.start();
+    }
+
+    ~ServerFixture()
+    {
+        if( _receiverBlocked )
+            unblockReceiver();
+        serverThread.quit();
+        serverThread.wait();
+        delete server;
+    }
+
+    /** Send an event to the registered Stream. */
+    void postEvent( const deflect::Event& event )
+    {
+        QMetaObject::invokeMethod( receiver.load(), "processEvent",
+                                   Qt::QueuedConnection,
+                                   Q_ARG( deflect::Event, event ));
+    }
+
+    /**
+     * Block the thread of the EventReceiver until unblockReceiver(), so that
+     * all the events posted meanwhile are processed at once.
+     */
+    void blockReceiver()
+    {
+        QObject* context = new QObject;
+        context->moveToThread( receiver.load()->thread( ));
+        QTimer::singleShot( 0, context, [this, context]
+        {
+            _blocked.release();
+            _unblocked.acquire();
+            context->deleteLater();
+        });
+        _blocked.acquire();
+        _receiverBlocked = true;
+    }
+
+    void unblockReceiver()
+    {
+        _receiverBlocked = false;
+        _unblocked.release();
+    }
+
+    QThread serverThread;
+    deflect::Server* server;
+    std::atomic< deflect::EventReceiver* > receiver;
+
+private:
+    QSemaphore _blocked;
+    QSemaphore _unblocked;
+    bool _receiverBlocked;
+};
+
+#endif